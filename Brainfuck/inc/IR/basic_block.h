@@ -1,43 +1,43 @@
 #pragma once
 
 #include "instruction.h"
+#include "small_vector.h"
 
 #include <vector>
 #include <cstddef>
-#include <set>
-#include <memory>
+#include <cassert>
+#include <functional>
 
 namespace bf::IR {
 
+	/*Maximal sequence of instructions executed one after another. Control flow may only enter a block at its first instruction
+	and leave it after its last one, which is either a jump or falls through to the natural successor.
+	Instructions are stored by value in one contiguous buffer per block, so that passes iterating over them do not chase pointers.*/
 	class basic_block {
 
+	public:
+
 		std::ptrdiff_t label_;
 
-		std::vector<std::unique_ptr<instruction>> ops_;
+		std::vector<instruction> ops_;
 
-		std::set<basic_block*> predecessors_;
+		//set of blocks that may transfer control to this one. Most blocks have at most two of them, which are stored inline
+		small_vector<basic_block*, 2> predecessors_;
 
-		//TODO add analysis flags
+		basic_block* natural_successor_ = nullptr; //block executed after this one if the control does not leave via a jump
+		basic_block* jump_successor_ = nullptr; //destination of the terminating jump
 
-	public:
+		//pointers to both successor members, to make iteration over them possible
+		static constexpr basic_block* basic_block::* successor_ptrs[] = { &basic_block::natural_successor_, &basic_block::jump_successor_ };
 
-		basic_block(std::ptrdiff_t const label)
-			: label_{ label } {}
+		basic_block(std::ptrdiff_t const label, std::vector<instruction> ops)
+			: label_{ label }, ops_{ std::move(ops) } {}
 
 		basic_block(basic_block const&) = delete;
 		basic_block(basic_block&&) = delete;
 		basic_block& operator=(basic_block const&) = delete;
 		basic_block& operator=(basic_block&&) = delete;
 
-		[[nodiscard]]
-		bool has_terminator() const { return ops_.size() > 0 && ops_.back()->is_jump(); }
-
-		[[nodiscard]]
-		instruction const* get_terminator() const { return has_terminator() ? ops_.back().get() : nullptr; }
-
-		void add_instruction(std::unique_ptr<instruction>)
-
-#if 0
 		[[nodiscard]]
 		bool is_orphaned() const {
 			return natural_successor_ == nullptr && jump_successor_ == nullptr
@@ -45,20 +45,16 @@ namespace bf::IR {
 		}
 
 		void orphan() {
-			if (jump_successor_) {//unbind the block from its successors
+			if (jump_successor_) //unbind the block from its successors
 				jump_successor_->remove_predecessor(this);
-				jump_successor_ = nullptr;
-			}
-
-			if (natural_successor_) {
+			if (natural_successor_ && natural_successor_ != jump_successor_) //both edges may lead to the same block
 				natural_successor_->remove_predecessor(this);
-				natural_successor_ = nullptr;
-			}
+			jump_successor_ = natural_successor_ = nullptr;
 
 			for (basic_block* const predecessor : predecessors_) {
 				if (predecessor->jump_successor_ == this)
 					predecessor->jump_successor_ = nullptr;
-				else if (predecessor->natural_successor_ == this)
+				if (predecessor->natural_successor_ == this)
 					predecessor->natural_successor_ = nullptr;
 			}
 			predecessors_.clear();
@@ -69,9 +65,9 @@ namespace bf::IR {
 		bool empty() const { return ops_.empty(); }
 
 		[[nodiscard]]
-		bool is_pure_cjump() const { return ops_.size() == 1u && ops_.front().op_code_ == op_code::jump_not_zero; }
+		bool is_pure_cjump() const { return ops_.size() == 1u && ops_.front().op_code_ == op_code::branch_nz; }
 		[[nodiscard]]
-		bool is_pure_ujump() const { return ops_.size() == 1u && ops_.front().op_code_ == op_code::jump; }
+		bool is_pure_ujump() const { return ops_.size() == 1u && ops_.front().op_code_ == op_code::branch; }
 
 		[[nodiscard]]
 		bool is_inner_loop() const { return is_pure_cjump() && jump_successor_->has_successor(this); }
@@ -80,9 +76,9 @@ namespace bf::IR {
 		bool is_jump() const { return is_ujump() || is_cjump(); }
 
 		[[nodiscard]]
-		bool is_cjump() const { return !empty() && ops_.back().op_code_ == op_code::jump_not_zero; }
+		bool is_cjump() const { return !empty() && ops_.back().op_code_ == op_code::branch_nz; }
 		[[nodiscard]]
-		bool is_ujump() const { return !empty() && ops_.back().op_code_ == op_code::jump; }
+		bool is_ujump() const { return !empty() && ops_.back().op_code_ == op_code::branch; }
 
 		[[nodiscard]]
 		bool has_self_loop() const { return has_predecessor(this); }
@@ -122,15 +118,23 @@ namespace bf::IR {
 			return natural_successor_ != successor ? &basic_block::natural_successor_ : &basic_block::jump_successor_;
 		}
 
+		/*Returns iterators to all instructions satisfying the given predicate. The iterators are invalidated
+		as soon as instructions get inserted to or erased from the block.*/
+		template<typename PRED>
+		[[nodiscard]]
+		std::vector<std::vector<instruction>::iterator> inst_filter(PRED&& predicate) {
+			std::vector<std::vector<instruction>::iterator> res;
+			for (auto iter = ops_.begin(); iter != ops_.end(); ++iter)
+				if (std::invoke(predicate, *iter))
+					res.push_back(iter);
+			return res;
+		}
+
 		struct ptr_comparator {
-			bool operator()(basic_block const* const a, basic_block const* const b) {
+			bool operator()(basic_block const* const a, basic_block const* const b) const {
 				return a->label_ < b->label_;
 			}
 		};
-
-#endif
 	};
 
-
-
-}
\ No newline at end of file
+}
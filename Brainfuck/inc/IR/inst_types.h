@@ -3,156 +3,316 @@
 #include "IR/instruction.h"
 #include "source_location.h"
 
-
+#include <string_view>
 #include <cassert>
 
 
 namespace bf::IR {
 
-	class unary_instruction : public instruction {
+	/*Views are non-owning typed accessors to instructions stored in basic blocks. They give the generic fields of the instruction
+	record meaning specific for the given operation. Instructions of each kind are created by the static function make.*/
+	class instruction_view {
 
 	protected:
-		std::ptrdiff_t const argument_;
+		instruction const& inst_;
 
-		unary_instruction(op_code op_code, source_location loc, std::ptrdiff_t arg)
-			:instruction{ op_code, loc }, argument_{ arg } {
-			assert(arg > 0);
+		instruction_view(instruction const& inst, [[maybe_unused]] bool const has_expected_type)
+			:inst_{ inst } {
+			assert(has_expected_type && "The viewed instruction has different type!");
 		}
 
 	public:
-		std::ptrdiff_t argument() const { return argument_; }
+		[[nodiscard]]
+		op_code get_op_code() const { return inst_.op_code_; }
 
+		[[nodiscard]]
+		source_location get_source_location() const { return inst_.source_loc_; }
 	};
 
 
-	class nop_instruction : public instruction {
+	class nop_instruction : public instruction_view {
+
+	public:
+		explicit nop_instruction(instruction const& inst)
+			:instruction_view{ inst, inst.is_nop() } {}
+
+		[[nodiscard]]
+		static instruction make(source_location const loc) { return instruction{ op_code::nop, 0, loc }; }
+	};
 
+	class arithmetic_instruction : public instruction_view {
 	public:
-		nop_instruction(source_location loc)
-			:instruction{ op_code::nop, loc } {}
+		explicit arithmetic_instruction(instruction const& inst)
+			:instruction_view{ inst, inst.is_arithmetic() || inst.is_shift() } {}
+
+		[[nodiscard]]
+		bool is_inc() const { return inst_.op_code_ == op_code::inc; }
+		[[nodiscard]]
+		bool is_dec() const { return inst_.op_code_ == op_code::dec; }
+		[[nodiscard]]
+		bool is_right() const { return inst_.op_code_ == op_code::right || inst_.op_code_ == op_code::right_unchecked; }
+		[[nodiscard]]
+		bool is_left() const { return inst_.op_code_ == op_code::left; }
+
+		[[nodiscard]]
+		std::ptrdiff_t canonical_argument() const { return inst_.argument(); }
+
+		[[nodiscard]]
+		static instruction make(op_code const op_code, source_location const loc, std::ptrdiff_t const argument) {
+			assert(op_code == op_code::inc || op_code == op_code::dec || op_code == op_code::right || op_code == op_code::left);
+			assert(argument > 0);
+			return instruction{ op_code, argument, loc };
+		}
 	};
 
-	class arithmetic_instruction : public unary_instruction {
+
+	/*Jumps refer to their destination by address, which is only known after the executable code has been generated.
+	Until then, the targets are given by successors of the basic block terminated by the jump.*/
+	class branch_instruction : public instruction_view {
+
 	public:
+		explicit branch_instruction(instruction const& inst)
+			:instruction_view{ inst, inst.is_jump() } {}
+
+		[[nodiscard]]
+		bool is_conditional() const { return inst_.op_code_ == op_code::branch_nz; }
 
-		constexpr bool is_inc() const { return op_code_ == op_code::inc; }
-		constexpr bool is_dec() const { return op_code_ == op_code::dec; }
-		constexpr bool is_right() const { return op_code_ == op_code::right; }
-		constexpr bool is_left() const { return op_code_ == op_code::left; }
+		[[nodiscard]]
+		std::ptrdiff_t destination() const { return inst_.destination_; }
 
+		[[nodiscard]]
+		static instruction make(op_code const op_code, source_location const loc, std::ptrdiff_t const destination) {
+			assert(op_code == op_code::branch || op_code == op_code::branch_nz);
+			instruction res{ op_code, 0, loc };
+			res.destination_ = destination;
+			return res;
+		}
+	};
+
+	class read_instruction : public instruction_view {
 
-		std::ptrdiff_t canonical_argument() const { return is_inc() || is_right() ? argument_ : -argument_; }
+	public:
+		explicit read_instruction(instruction const& inst)
+			:instruction_view{ inst, inst.op_code_ == op_code::read } {}
 
-		using unary_instruction::unary_instruction;
+		[[nodiscard]]
+		static instruction make(source_location const loc) { return instruction{ op_code::read, 1, loc }; }
 	};
 
+	class write_instruction : public instruction_view {
 
-	class basic_block;
+	public:
+		explicit write_instruction(instruction const& inst)
+			:instruction_view{ inst, inst.op_code_ == op_code::write } {}
 
-	class branch_instruction : public instruction {
+		[[nodiscard]]
+		static instruction make(source_location const loc) { return instruction{ op_code::write, 1, loc }; }
+	};
 
-		union {
-			basic_block* destination_;
-			basic_block* if_then_ = nullptr;
+
+	class search_instruction : public instruction_view {
+
+	public:
+		enum class direction {
+			left, right
 		};
-		basic_block* if_else_ = nullptr;
-
-		void assert_ok() const {
-			assert(op_code_ == op_code::branch || op_code_ == op_code::branch_nz);
-			if (is_conditional())
-				assert(if_then_ && if_else_ && "Both targets have to exist!");
-			else
-				assert(destination_ && if_else_ == nullptr && "Target must exist!");
+
+		explicit search_instruction(instruction const& inst)
+			:instruction_view{ inst, inst.is_search() } {}
+
+		[[nodiscard]]
+		bool is_left() const { return inst_.op_code_ == op_code::search_left; }
+
+		[[nodiscard]]
+		bool is_right() const { return inst_.op_code_ == op_code::search_right; }
+
+		[[nodiscard]]
+		std::ptrdiff_t stride() const { return inst_.argument_; }
+
+		[[nodiscard]]
+		static instruction make(source_location const loc, direction const dir, std::ptrdiff_t const stride) {
+			assert(stride > 0);
+			return instruction{ dir == direction::left ? op_code::search_left : op_code::search_right, stride, loc };
 		}
+	};
+
+	//Search for zero cell that clears every cell it leaves, like [[-]>]. Unlike searches, it always terminates.
+	class clear_search_instruction : public instruction_view {
 
 	public:
+		using direction = search_instruction::direction;
 
-		branch_instruction(op_code op_code, source_location location, basic_block* dest)
-			: instruction{ op_code, location }, destination_{ dest } {
-			assert_ok();
-		}
+		explicit clear_search_instruction(instruction const& inst)
+			:instruction_view{ inst, inst.is_clear_search() } {}
 
-		branch_instruction(op_code op_code, source_location location, basic_block* ifthen, basic_block* ifelse)
-			:instruction{ op_code, location }, if_then_{ ifthen }, if_else_{ ifelse } {
-			assert_ok();
-		}
+		[[nodiscard]]
+		bool is_left() const { return inst_.op_code_ == op_code::clear_search_left; }
 
 		[[nodiscard]]
-		constexpr bool is_conditional() const { return op_code_ == op_code::branch_nz; }
+		bool is_right() const { return inst_.op_code_ == op_code::clear_search_right; }
 
 		[[nodiscard]]
-		basic_block* destination() const {
-			assert(!is_conditional());
-			return destination_;
-		}
+		std::ptrdiff_t stride() const { return inst_.argument_; }
 
 		[[nodiscard]]
-		constexpr bool has_destination(basic_block* dest) const {
-			return if_then_ == dest || if_else_ == dest;
+		static instruction make(source_location const loc, direction const dir, std::ptrdiff_t const stride) {
+			assert(stride > 0);
+			return instruction{ dir == direction::left ? op_code::clear_search_left : op_code::clear_search_right, stride, loc };
 		}
+	};
+
+
+	class load_const_instruction : public instruction_view {
+
+	public:
+		explicit load_const_instruction(instruction const& inst)
+			:instruction_view{ inst, inst.is_const() } {}
 
 		[[nodiscard]]
-		constexpr bool is_true_branch(basic_block* dest) const {
-			assert(is_conditional());
-			return if_then_ == dest;
-		}
+		std::ptrdiff_t value() const { return inst_.argument_; }
 
 		[[nodiscard]]
-		constexpr bool is_false_branch(basic_block* dest) const {
-			assert(is_conditional());
-			return if_else_ == dest;
+		static instruction make(source_location const loc, std::ptrdiff_t const value) { return instruction{ op_code::load_const, value, loc }; }
+	};
+
+	/*View of instructions that do not operate on the cell under the pointer, but on the cell at [cpr + offset].
+	They are produced by the pointer folding pass, which removes shifts of the cell pointer from within basic blocks.*/
+	class offset_instruction : public instruction_view {
+
+	protected:
+		[[nodiscard]]
+		static instruction make_offset(op_code const op_code, source_location const loc, std::ptrdiff_t const offset, std::ptrdiff_t const argument) {
+			assert(offset != 0 && "Instructions operating on the current cell shall be used instead!");
+			instruction res{ op_code, argument, loc };
+			res.offset_ = offset;
+			return res;
 		}
 
+	public:
+		explicit offset_instruction(instruction const& inst)
+			:instruction_view{ inst, inst.is_offset_addressed() } {}
+
+		[[nodiscard]]
+		std::ptrdiff_t offset() const { return inst_.offset_; }
+
+		[[nodiscard]]
+		std::ptrdiff_t argument() const { return inst_.argument_; }
 	};
 
-	class read_instruction : public instruction {
+	//add [cpr + offset], amount
+	class inc_offset_instruction : public offset_instruction {
 
 	public:
+		using offset_instruction::offset_instruction;
 
-		read_instruction(source_location loc)
-			:instruction{ op_code::read, loc } {}
-
+		[[nodiscard]]
+		static instruction make(source_location const loc, std::ptrdiff_t const offset, std::ptrdiff_t const amount) {
+			assert(amount != 0);
+			return make_offset(op_code::inc_offset, loc, offset, amount);
+		}
 	};
 
-	class write_instruction : public instruction {
+	//load_const [cpr + offset], value
+	class load_const_offset_instruction : public offset_instruction {
 
 	public:
-		write_instruction(source_location loc)
-			:instruction{ op_code::write, loc } {}
+		using offset_instruction::offset_instruction;
+
+		[[nodiscard]]
+		static instruction make(source_location const loc, std::ptrdiff_t const offset, std::ptrdiff_t const value) {
+			return make_offset(op_code::load_const_offset, loc, offset, value);
+		}
 	};
 
+	//write [cpr + offset]
+	class write_offset_instruction : public offset_instruction {
+
+	public:
+		using offset_instruction::offset_instruction;
+
+		[[nodiscard]]
+		static instruction make(source_location const loc, std::ptrdiff_t const offset) {
+			return make_offset(op_code::write_offset, loc, offset, 1);
+		}
+	};
 
-	class search_instruction : public unary_instruction {
+	//add [cpr + offset], factor * [cpr]
+	class mul_add_instruction : public offset_instruction {
 
 	public:
-		enum class direction {
-			left, right
-		};
+		using offset_instruction::offset_instruction;
 
-		search_instruction(source_location loc, direction dir, std::ptrdiff_t stride)
-			:unary_instruction{ dir == direction::left ? op_code::search_left : op_code::search_right, loc, stride } {}
+		[[nodiscard]]
+		std::ptrdiff_t factor() const { return inst_.argument_; }
 
+		[[nodiscard]]
+		static instruction make(source_location const loc, std::ptrdiff_t const offset, std::ptrdiff_t const factor) {
+			assert(factor != 0);
+			return make_offset(op_code::mul_add, loc, offset, factor);
+		}
+	};
+
+	//write_string pool_offset, length; writes length characters of the constant pool starting at pool_offset
+	class write_string_instruction : public instruction_view {
+
+	public:
+		explicit write_string_instruction(instruction const& inst)
+			:instruction_view{ inst, inst.op_code_ == op_code::write_string } {}
 
 		[[nodiscard]]
-		constexpr bool is_left() const { return op_code_ == op_code::search_left; }
+		std::ptrdiff_t pool_offset() const { return inst_.offset_; }
 
 		[[nodiscard]]
-		constexpr bool is_right() const { return op_code_ == op_code::search_right; }
+		std::ptrdiff_t length() const { return inst_.argument_; }
 
 		[[nodiscard]]
-		constexpr std::ptrdiff_t stride() const { return argument_; }
-	};
+		std::string_view string() const { return constant_string(inst_.offset_, inst_.argument_); }
 
+		[[nodiscard]]
+		static instruction make(source_location const loc, std::ptrdiff_t const pool_offset, std::ptrdiff_t const length) {
+			assert(pool_offset >= 0 && length > 0);
+			instruction res{ op_code::write_string, length, loc };
+			res.offset_ = pool_offset;
+			return res;
+		}
+	};
 
-	class load_const_instruction : public unary_instruction {
+	/*fill_range offset, value, count, stride; sets cells [cpr + offset + i * stride] for i in [0, count) to value.
+	The count is kept in the destination field, which only jumps use otherwise, the stride in the field of its own.*/
+	class fill_range_instruction : public instruction_view {
 
 	public:
+		explicit fill_range_instruction(instruction const& inst)
+			:instruction_view{ inst, inst.op_code_ == op_code::fill_range } {}
+
+		[[nodiscard]]
+		std::ptrdiff_t offset() const { return inst_.offset_; }
+
+		[[nodiscard]]
+		std::ptrdiff_t value() const { return inst_.argument_; }
 
-		load_const_instruction(source_location location, std::ptrdiff_t arg)
-			:unary_instruction{ op_code::load_const, location, arg } {}
+		[[nodiscard]]
+		std::ptrdiff_t count() const { return inst_.destination_; }
+
+		[[nodiscard]]
+		std::ptrdiff_t stride() const { return inst_.stride_; }
+
+		//Returns the offset of the last cell set by the instruction
+		[[nodiscard]]
+		std::ptrdiff_t last_offset() const { return inst_.offset_ + (inst_.destination_ - 1) * inst_.stride_; }
+
+		[[nodiscard]]
+		static instruction make(source_location const loc, std::ptrdiff_t const offset, std::ptrdiff_t const value, std::ptrdiff_t const count, std::int32_t const stride) {
+			assert(count > 1 && stride > 0);
+			instruction res{ op_code::fill_range, value, loc };
+			res.offset_ = offset;
+			res.destination_ = count;
+			res.stride_ = stride;
+			return res;
+		}
 	};
 
-	class infinite_instruction : public unary_instruction {
+	class infinite_instruction : public instruction_view {
 
 	public:
 
@@ -160,18 +320,19 @@ namespace bf::IR {
 			zero, not_zero
 		};
 
-		infinite_instruction(source_location location, when when)
-			:unary_instruction{ op_code::infinite, location, when == when::not_zero } {}
+		explicit infinite_instruction(instruction const& inst)
+			:instruction_view{ inst, inst.is_infinite() } {}
 
 		[[nodiscard]]
-		bool loops_on_nz() const { return argument_; }
+		bool loops_on_nz() const { return inst_.is_infinite_on_non_zero(); }
 
 		[[nodiscard]]
-		bool loops_on_zero() const { return argument_ == 0; }
+		bool loops_on_zero() const { return inst_.is_infinite_on_zero(); }
 
+		[[nodiscard]]
+		static instruction make(source_location const loc, when const when) {
+			return instruction{ op_code::infinite, when == when::not_zero, loc };
+		}
 	};
 
-
-
-
-}
\ No newline at end of file
+}
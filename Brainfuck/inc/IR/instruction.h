@@ -4,7 +4,9 @@
 
 #include <ostream>
 #include <cstdint>
+#include <cstddef>
 #include <string>
+#include <string_view>
 
 namespace bf::IR {
 
@@ -19,6 +21,8 @@ namespace bf::IR {
 		//shift the cell pointer towards higher address (jumps from the end of the address space to the beginning)
 		right,
 		left,
+		//shift to the right that has been proven not to leave the memory, therefore the wraparound need not be checked
+		right_unchecked,
 
 		//perform an unconditional jump to destination
 		branch,
@@ -34,9 +38,28 @@ namespace bf::IR {
 		search_right,
 		search_left,
 
+		//clear cells moving by stride until a zero cell is found; the result of optimized loops like [[-]>] or [[-]<<]
+		clear_search_right,
+		clear_search_left,
+
 		//set pointed to cell to the value of immediate
 		load_const,
 
+		//offset-addressed forms of inc, load_const and write added by the optimizer. They operate on the cell
+		//at address [cpr + offset] and leave the cell pointer where it is
+		inc_offset,
+		load_const_offset,
+		write_offset,
+
+		//[cpr + offset] += argument * [cpr]; the result of an optimized multiplication loop like [->++>+<<]
+		mul_add,
+
+		//write argument characters of the constant pool starting at offset; the result of folded writes of constants
+		write_string,
+
+		//set count cells starting at [cpr + offset] and stride cells apart to the value of argument; the result of folded runs of constant stores
+		fill_range,
+
 		//infinite loop like []
 		infinite,
 
@@ -56,38 +79,47 @@ namespace bf::IR {
 	/*Standard stream output operator for opcodes.*/
 	std::ostream& operator<<(std::ostream& str, op_code code);
 
+	/*Returns the string of given length at given offset of the pool of constant strings written by write_string instructions.
+	Strings are only ever appended to the pool and never move, therefore instructions of previous compilations stay valid and
+	strings may be read while other threads intern new ones.*/
+	[[nodiscard]]
+	std::string_view constant_string(std::ptrdiff_t offset, std::ptrdiff_t length);
 
-	/*Struct representing a single instruction in internal intermediate representation. Each instruction in the world of brainfuck
-	has an opcode representing the operation to be carried out as well as its argument and the location (offset) relative to the beginning
-	compiled source program to ease debugging process.*/
-	class instruction {
+	/*Returns the offset of given string within the constant pool. Appends it to the pool unless it is already present.
+	Thread-safe with respect to other calls of this function and to constant_string.*/
+	[[nodiscard]]
+	std::ptrdiff_t intern_constant(std::string_view str);
 
-	protected:
 
-		op_code const op_code_; //operation to be performed
+	/*Struct representing a single instruction in internal intermediate representation. Each instruction in the world of brainfuck
+	has an opcode representing the operation to be carried out as well as its argument and the location within the
+	compiled source program to ease debugging process.
+	Instructions are plain values without any virtual dispatch; basic blocks store them contiguously. Typed accessors to
+	individual kinds of instructions are provided by views in inst_types.h.*/
+	class instruction {
 
-		source_location const source_loc_; //Location within the original source code
+	public:
 
+		op_code op_code_; //operation to be performed
 
+		source_location source_loc_; //Location within the original source code
 
-		instruction(op_code op_code, source_location loc)
-			:op_code_{ op_code }, source_loc_{ loc } {}
+		std::int32_t stride_ = 0; //distance between cells set by fill_range; kept in the padding after source_loc_ so that the record does not grow
 
-	public:
+		std::ptrdiff_t argument_; //immediate operand - amount, value, stride or length depending on the op_code
 
-		virtual ~instruction() = default;
+		std::ptrdiff_t destination_ = 0; //address of the target of jumps; resolved when the executable code is generated. Number of cells set by fill_range
 
-		[[nodiscard]]
-		op_code get_op_code() const { return op_code_; }
+		std::ptrdiff_t offset_ = 0; //offset from the cell pointer for offset-addressed instructions, offset into the constant pool for write_string
 
-		[[nodiscard]]
-		source_location get_source_location() const { return source_loc_; }
+		constexpr instruction(op_code const op_code, std::ptrdiff_t const argument, source_location const loc)
+			:op_code_{ op_code }, source_loc_{ loc }, argument_{ argument } {}
 
 		[[nodiscard]]
 		constexpr bool is_arithmetic() const { return op_code_ == op_code::inc || op_code_ == op_code::dec; }
 
 		[[nodiscard]]
-		constexpr bool is_shift() const { return op_code_ == op_code::right || op_code_ == op_code::left; }
+		constexpr bool is_shift() const { return op_code_ == op_code::right || op_code_ == op_code::left || op_code_ == op_code::right_unchecked; }
 
 		//Returns true iff the instruction denotes an (un)conditional jump.
 		[[nodiscard]]
@@ -95,7 +127,7 @@ namespace bf::IR {
 
 		//Returns true iff the instruction denotes an input/output operation (reads or writes).
 		[[nodiscard]]
-		constexpr bool is_io() const { return op_code_ == op_code::read || op_code_ == op_code::write; }
+		constexpr bool is_io() const { return op_code_ == op_code::read || op_code_ == op_code::write || op_code_ == op_code::write_string; }
 
 		[[nodiscard]]
 		constexpr bool is_const() const { return op_code_ == op_code::load_const; }
@@ -106,8 +138,64 @@ namespace bf::IR {
 		[[nodiscard]]
 		constexpr bool is_infinite() const { return op_code_ == op_code::infinite; }
 
+		[[nodiscard]]
+		constexpr bool is_infinite_on_non_zero() const { return is_infinite() && argument_ != 0; }
+
+		[[nodiscard]]
+		constexpr bool is_infinite_on_zero() const { return is_infinite() && argument_ == 0; }
+
 		[[nodiscard]]
 		constexpr bool is_search() const { return op_code_ == op_code::search_left || op_code_ == op_code::search_right; }
 
+		[[nodiscard]]
+		constexpr bool is_clear_search() const { return op_code_ == op_code::clear_search_left || op_code_ == op_code::clear_search_right; }
+
+		//Returns true iff the instruction moves the cell pointer to the nearest zero cell in its direction, hence by an amount unknown until it executes.
+		[[nodiscard]]
+		constexpr bool moves_to_zero_cell() const { return is_search() || is_clear_search(); }
+
+		//Returns true iff the instruction operates on a cell at a constant offset from the cell pointer.
+		[[nodiscard]]
+		constexpr bool is_offset_addressed() const {
+			return op_code_ == op_code::inc_offset || op_code_ == op_code::load_const_offset || op_code_ == op_code::write_offset
+				|| op_code_ == op_code::mul_add;
+		}
+
+		/*Returns the argument of arithmetic instructions and shifts with sign corresponding to the direction of operation,
+		i.e. negative for decrements and shifts to the left. Arguments of other instructions are returned unchanged.*/
+		[[nodiscard]]
+		constexpr std::ptrdiff_t argument() const { return op_code_ == op_code::dec || op_code_ == op_code::left ? -argument_ : argument_; }
+
+		//Turns the instruction into a nop, keeping its source location.
+		constexpr void make_nop() {
+			op_code_ = op_code::nop;
+			argument_ = destination_ = offset_ = 0;
+			stride_ = 0;
+		}
+
+		//Turns the instruction into a search for zero cell. The sign of given pointer delta determines the direction, its magnitude the stride.
+		constexpr void make_search(std::ptrdiff_t const ptr_delta) {
+			op_code_ = ptr_delta < 0 ? op_code::search_left : op_code::search_right;
+			argument_ = ptr_delta < 0 ? -ptr_delta : ptr_delta;
+			destination_ = offset_ = 0;
+		}
+
+		//Turns the instruction into a search for zero cell clearing all cells it passes. The pointer delta is interpreted like in make_search.
+		constexpr void make_clear_search(std::ptrdiff_t const ptr_delta) {
+			make_search(ptr_delta);
+			op_code_ = ptr_delta < 0 ? op_code::clear_search_left : op_code::clear_search_right;
+		}
+
+		//Turns the instruction into an infinite loop executed whenever the current cell is not zero.
+		constexpr void make_infinite_on_not_zero() {
+			op_code_ = op_code::infinite;
+			argument_ = 1;
+			destination_ = offset_ = 0;
+		}
+
 	};
-}
\ No newline at end of file
+
+	/*Standard stream output operator for instructions. Prints the mnemonic followed by operands; cells addressed by offset-addressed
+	instructions and fill_range are printed as [cpr+offset].*/
+	std::ostream& operator<<(std::ostream& str, instruction const& inst);
+}
@@ -0,0 +1,60 @@
+#pragma once
+
+#include "IR/instruction.h"
+
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+
+namespace bf::IR {
+
+	/*Compact encoding of an instruction of executable code executed by the fast engine. Eight bytes per instruction keep hot loops
+	within the first level cache, whereas the full instruction record carries its source location and operands of all kinds.
+	The full records stay flashed alongside the packed code as its side table; the debugger, error reports and memory views read only them.
+
+	Operands keep the meaning they have in the full record with these exceptions:
+		- jumps store their target relative to their own address in argument_,
+		- write_string stores the offset into the constant pool in argument_ and the length of the string in offset_.
+	Values of cells are at most 32 bits wide, hence amounts, constants and factors are stored modulo 2^32. Instructions whose operands
+	do not fit otherwise (e.g. fill_range, long shifts or distant offsets) are packed in full form - the engine executes their full record.*/
+	struct packed_instruction {
+
+		std::uint8_t handler_; //op_code relative to op_code::nop, or full_form
+
+		std::uint8_t reserved_ = 0;
+
+		std::int16_t offset_; //offset from the cell pointer, length of strings written by write_string
+
+		std::int32_t argument_; //immediate operand or relative target of jumps
+
+		//Handler of instructions which must be executed from their full record
+		static constexpr std::uint8_t full_form = static_cast<std::uint8_t>(op_code::program_exit) - static_cast<std::uint8_t>(op_code::nop) + 1;
+
+		//Handler of the sentinel following the last instruction of packed code, which stops the engine should the code lack program_exit
+		static constexpr std::uint8_t end_of_code = full_form + 1;
+
+		//Number of distinct handlers; the engine's dispatch table has this many entries
+		static constexpr std::size_t handler_count = std::size_t{ end_of_code } + 1;
+
+		[[nodiscard]]
+		static constexpr std::uint8_t handler_of(op_code const code) {
+			return static_cast<std::uint8_t>(static_cast<std::uint8_t>(code) - static_cast<std::uint8_t>(op_code::nop));
+		}
+
+		/*Returns the packed form of the instruction located at the given address of executable code.
+		Breakpoints and instructions the fast engine does not execute itself are packed without operands.*/
+		[[nodiscard]]
+		static packed_instruction pack(instruction const& inst, std::ptrdiff_t address);
+
+		//Returns true iff the instruction has to be executed from its full record
+		[[nodiscard]]
+		constexpr bool is_full_form() const { return handler_ == full_form; }
+	};
+
+	static_assert(sizeof(packed_instruction) == 8, "Packed instructions must stay eight bytes large!");
+
+	/*Packs whole executable code as generated by previous_compilation::generate_executable_code. The i-th packed instruction
+	corresponds to the i-th instruction of the given code, the last one is followed by a sentinel with handler end_of_code.*/
+	[[nodiscard]]
+	std::vector<packed_instruction> pack_executable_code(std::vector<instruction> const& code);
+}
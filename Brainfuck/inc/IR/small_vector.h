@@ -0,0 +1,85 @@
+#pragma once
+
+#include <array>
+#include <vector>
+#include <algorithm>
+#include <cstddef>
+#include <cassert>
+#include <type_traits>
+
+namespace bf::IR {
+
+	/*Unordered collection of distinct values storing up to N elements inline, which avoids heap allocations for small sizes.
+	Most basic blocks have one or two predecessors, a set of pointers to them would cost a tree node allocation per edge.
+	Only trivially copyable types (e.g. pointers) are supported. Erasing an element invalidates iterators.*/
+	template<typename T, std::size_t N>
+	class small_vector {
+		static_assert(std::is_trivially_copyable_v<T>, "Only trivially copyable types can be stored in a small_vector!");
+
+		std::size_t size_ = 0;
+		std::array<T, N> inline_{};
+		std::vector<T> overflow_; //holds all elements once there are more than N of them
+
+		[[nodiscard]]
+		bool is_inline() const { return size_ <= N; }
+
+	public:
+		using value_type = T;
+		using iterator = T*;
+		using const_iterator = T const*;
+
+		[[nodiscard]]
+		T* begin() { return is_inline() ? inline_.data() : overflow_.data(); }
+		[[nodiscard]]
+		T* end() { return begin() + size_; }
+		[[nodiscard]]
+		T const* begin() const { return is_inline() ? inline_.data() : overflow_.data(); }
+		[[nodiscard]]
+		T const* end() const { return begin() + size_; }
+
+		[[nodiscard]]
+		std::size_t size() const { return size_; }
+		[[nodiscard]]
+		bool empty() const { return size_ == 0; }
+
+		//Returns the number of occurences of given value, i.e. either one or zero
+		[[nodiscard]]
+		std::size_t count(T const& value) const { return std::find(begin(), end(), value) != end() ? 1 : 0; }
+
+		//Inserts the value unless it is already present
+		void insert(T const& value) {
+			if (count(value))
+				return;
+			if (size_ < N)
+				inline_[size_] = value;
+			else {
+				if (size_ == N) //the inline storage is full, move the elements to the heap
+					overflow_.assign(inline_.begin(), inline_.end());
+				overflow_.push_back(value);
+			}
+			++size_;
+		}
+
+		//Removes the value if it is present. Returns the number of removed elements
+		std::size_t erase(T const& value) {
+			T* const position = std::find(begin(), end(), value);
+			if (position == end())
+				return 0;
+			*position = *(end() - 1); //the order does not matter
+			if (is_inline())
+				--size_;
+			else {
+				overflow_.pop_back();
+				if (--size_ == N) //the elements fit into the inline storage again
+					std::copy(overflow_.begin(), overflow_.end(), inline_.begin());
+			}
+			return 1;
+		}
+
+		void clear() {
+			size_ = 0;
+			overflow_.clear();
+		}
+	};
+
+}
@@ -4,21 +4,27 @@
 
 #include "program_code.h"
 #include "utils.h"
+#include "cell.h"
 
 #include <vector>
 #include <string_view>
 #include <set>
 #include <map>
 #include <optional>
+#include <cstdint>
 
 namespace bf::analysis {
 
+	/*Range of instructions executed with the cell pointer at a constant offset. Instructions moving the pointer by an unknown amount
+	(searches) end their range; the offsets of the following ranges are relative to the pointer left by the search, which is told
+	by the number of such instructions preceding the range.*/
 	struct ptr_stationary_range {
 		std::ptrdiff_t offset_;
 		std::vector<instruction>::iterator begin_, end_;
+		std::ptrdiff_t unknown_moves_; //number of instructions moving the pointer by an unknown amount executed before the range
 
 		bool operator<(ptr_stationary_range const& rhs) const {
-			return offset_ < rhs.offset_;
+			return unknown_moves_ != rhs.unknown_moves_ ? unknown_moves_ < rhs.unknown_moves_ : offset_ < rhs.offset_;
 		}
 	};
 
@@ -65,6 +71,8 @@ namespace bf::analysis {
 		basic_block* const subject_;
 		std::vector<ptr_stationary_range> stationary_ranges_;
 		std::ptrdiff_t ptr_delta_ = 0;
+		std::ptrdiff_t min_offset_ = 0, max_offset_ = 0; //extreme offsets the pointer reaches within the block
+		std::ptrdiff_t unknown_moves_ = 0; //number of instructions moving the pointer by an unknown amount
 		bool ptr_moves_ = false;
 
 		std::vector<ptr_stationary_range>::iterator get_range_iter(std::vector<instruction>::iterator inst) {
@@ -74,8 +82,8 @@ namespace bf::analysis {
 			MUST_NOT_BE_REACHED;
 		}
 
-		same_offset_iterator::bounds iterator_bounds(std::ptrdiff_t const offset) {
-			ptr_stationary_range const dummy{ offset, {}, {} };
+		same_offset_iterator::bounds iterator_bounds(std::ptrdiff_t const unknown_moves, std::ptrdiff_t const offset) {
+			ptr_stationary_range const dummy{ offset, {}, {}, unknown_moves };
 			auto const lower = std::lower_bound(stationary_ranges_.begin(), stationary_ranges_.end(), dummy);
 			auto const upper = std::upper_bound(stationary_ranges_.begin(), stationary_ranges_.end(), dummy);
 			assert(lower <= upper);
@@ -89,27 +97,48 @@ namespace bf::analysis {
 
 		static pointer_movement analyze(basic_block* const block) { return pointer_movement{ block }; }
 
+		/*Returns the offset of the pointer at block's exit from its value at block entry, or from its value after the last instruction
+		moving it by an unknown amount if there is one.*/
 		[[nodiscard]]
 		std::ptrdiff_t ptr_delta() const { return ptr_delta_; }
 
 		[[nodiscard]]
 		bool ptr_moves() const { return ptr_moves_; }
 
+		//Returns the number of instructions moving the pointer by an unknown amount, i.e. searches for zero cells
+		[[nodiscard]]
+		std::ptrdiff_t unknown_moves() const { return unknown_moves_; }
+
+		//Returns the lowest offset from its entry value the pointer reaches within the block (zero or negative). Meaningless if there are unknown moves
+		[[nodiscard]]
+		std::ptrdiff_t min_offset() const { return min_offset_; }
+
+		//Returns the highest offset from its entry value the pointer reaches within the block (zero or positive). Meaningless if there are unknown moves
+		[[nodiscard]]
+		std::ptrdiff_t max_offset() const { return max_offset_; }
+
 		[[nodiscard]]
 		bool only_moves_ptr() const { return ptr_moves_ && stationary_ranges_.empty(); }
 
+		/*Returns ranges of instructions executed with the cell pointer at a constant offset from its value at block entry
+		or after an instruction moving it by an unknown amount. Ranges are sorted by the number of such preceding instructions
+		and by their offset, ranges with equal both keep the order of execution.*/
+		[[nodiscard]]
+		std::vector<ptr_stationary_range> const& stationary_ranges() const { return stationary_ranges_; }
+
 		[[nodiscard]]
 		same_offset_iterator offset_iterator(std::vector<instruction>::iterator inst) {
 			auto const range = get_range_iter(inst);
-			auto const bounds = iterator_bounds(range->offset_);
+			auto const bounds = iterator_bounds(range->unknown_moves_, range->offset_);
 
 
 			return { inst, range, bounds };
 		}
 
+		//Returns the iterator over instructions executed at the given offset after the last instruction moving the pointer by an unknown amount
 		[[nodiscard]]
 		same_offset_iterator offset_iterator(std::ptrdiff_t const offset) {
-			auto const bounds = iterator_bounds(offset);
+			auto const bounds = iterator_bounds(unknown_moves_, offset);
 			auto const& lower = bounds.begin_;
 
 			if (bounds.begin_ == bounds.end_)
@@ -160,13 +189,18 @@ namespace bf::analysis {
 		[[nodiscard]]
 		std::ptrdiff_t const_result() const { return const_result_; }
 
+		/*Constants are computed without any wraparound, since the width of cells is not known yet. Nonzero multiples of the smallest
+		modulus are zero in cells narrow enough, hence they are neither known to be zero nor nonzero.*/
 		[[nodiscard]]
 		bool has_non_zero_result() const {
-			return (has_const_result() && const_result_ != 0) || state_ == result_state::known_not_zero;
+			return (has_const_result() && const_result_ % execution::min_cell_modulus != 0) || state_ == result_state::known_not_zero;
 		}
 
 		[[nodiscard]]
-		bool has_indeterminate_value() const { return !has_const_result() && !has_non_zero_result(); }
+		bool has_zero_result() const { return has_const_result() && const_result_ == 0; }
+
+		[[nodiscard]]
+		bool has_indeterminate_value() const { return !has_zero_result() && !has_non_zero_result(); }
 
 		[[nodiscard]]
 		bool has_visible_sideeffects() const { return has_sideeffect_ || ptr_movement_.ptr_moves(); }
@@ -181,6 +215,105 @@ namespace bf::analysis {
 
 	std::map<std::ptrdiff_t, bool> analyze_block_lives(std::vector<basic_block*> const& program);
 
+	/*Closed interval of possible values of the cell pointer, expressed as offsets from the first cell of memory.
+	An interval that is not bounded means that nothing is known about the pointer.*/
+	struct pointer_interval {
+		std::ptrdiff_t low_, high_;
+		bool bounded_;
+
+		[[nodiscard]]
+		static pointer_interval unknown() { return { 0, 0, false }; }
+
+		[[nodiscard]]
+		bool operator==(pointer_interval const& rhs) const {
+			return bounded_ == rhs.bounded_ && (!bounded_ || (low_ == rhs.low_ && high_ == rhs.high_));
+		}
+		[[nodiscard]]
+		bool operator!=(pointer_interval const& rhs) const { return !(*this == rhs); }
+
+		//Returns true iff all values within the interval address a valid cell of memory with the given size
+		[[nodiscard]]
+		bool within(std::ptrdiff_t const memory_size) const { return bounded_ && low_ >= 0 && high_ < memory_size; }
+	};
+
+	/*Computes a conservative interval of the cell pointer's values at the entry to each reachable basic block.
+	The program begins with the pointer at the first cell. The interval is propagated along the control flow graph
+	using the pointer movement of each block until a fixed point is reached. Loops whose body moves the pointer
+	make the interval grow on every iteration; such intervals are widened to unknown. Searches make the pointer unknown as well.
+	Unreachable blocks are not present in the returned map.*/
+	[[nodiscard]]
+	std::map<basic_block const*, pointer_interval> analyze_pointer_ranges(std::vector<basic_block*> const& program);
+
+	/*Computes a conservative interval of the cell pointer's values before each instruction of executable code, i.e. code with resolved
+	jumps as flashed into the emulator, executed in memory of the given size. The execution starts at the entry address with the pointer
+	at the given cell. Shifts which may wrap around the boundary of memory and searches make the pointer unknown.
+	Instructions unreachable from the entry have no interval.*/
+	[[nodiscard]]
+	std::vector<std::optional<pointer_interval>> analyze_code_pointer_ranges(std::vector<instruction> const& code, std::ptrdiff_t memory_size,
+		std::ptrdiff_t entry, std::ptrdiff_t entry_cell);
+
+	/*Values of cells known at some point of the program. Cells are identified by their offset from the cell pointer, values are
+	kept modulo 2^32, hence they are correct for cells of any width. Cells that are not stored explicitly are either all zero
+	(only the untouched tape) or unknown. The tape wraps around, hence offsets differing by a multiple of the memory size address
+	the same cell. Stored offsets always span less than the memory size, a cell which may alias one of them under another offset is unknown.*/
+	class known_cells {
+		std::ptrdiff_t memory_size_; //number of cells of the tape
+		bool others_zero_ = true; //value of cells missing in cells_
+		std::map<std::ptrdiff_t, std::optional<std::uint32_t>> cells_; //offset => value, empty optional for unknown values
+
+		explicit known_cells(std::ptrdiff_t const memory_size) : memory_size_{ memory_size } {}
+
+		void shift(std::ptrdiff_t delta);
+
+		//Returns true iff the offset is not stored, but it may address the same cell as some stored offset
+		[[nodiscard]]
+		bool may_alias(std::ptrdiff_t offset) const;
+
+	public:
+		//Returns the state of the zeroed tape of the given size at the beginning of the execution
+		[[nodiscard]]
+		static known_cells zeroed(std::ptrdiff_t const memory_size) { return known_cells{ memory_size }; }
+
+		//Returns the state in which nothing is known
+		[[nodiscard]]
+		static known_cells unknown(std::ptrdiff_t memory_size);
+
+		[[nodiscard]]
+		std::optional<std::uint32_t> value(std::ptrdiff_t offset) const;
+
+		[[nodiscard]]
+		bool is_zero(std::ptrdiff_t const offset) const { return value(offset) == std::uint32_t{ 0 }; }
+
+		//Returns true iff the cell is known to be nonzero regardless of the width of cells
+		[[nodiscard]]
+		bool is_non_zero(std::ptrdiff_t const offset) const {
+			std::optional<std::uint32_t> const val = value(offset);
+			return val && *val % execution::min_cell_modulus != 0;
+		}
+
+		void set(std::ptrdiff_t offset, std::optional<std::uint32_t> value);
+
+		//Updates the state by the effect of given instruction. Jumps do not change any cell
+		void execute(instruction const& inst);
+
+		//Returns the state known on both paths merging at a point of the program
+		[[nodiscard]]
+		known_cells join(known_cells const& other) const;
+
+		[[nodiscard]]
+		bool operator==(known_cells const& rhs) const { return others_zero_ == rhs.others_zero_ && cells_ == rhs.cells_; }
+		[[nodiscard]]
+		bool operator!=(known_cells const& rhs) const { return !(*this == rhs); }
+	};
+
+	/*Computes the values of cells known at the entry to each basic block, relative to the cell pointer at that entry. The program starts
+	with zeroed memory of the given size. Values are propagated forward along the control flow graph until a fixed point is reached; conditional jumps
+	whose outcome is known propagate along the taken edge only and the fall through edge of a conditional jump knows the current cell
+	is zero. Blocks whose state keeps changing are widened to unknown. Blocks that are unreachable, or only reachable along edges
+	which are never taken, are not present in the returned map.*/
+	[[nodiscard]]
+	std::map<basic_block const*, known_cells> analyze_known_cells(std::vector<basic_block*> const& program, std::ptrdiff_t memory_size);
+
 	class incoming_value_analyzer {
 
 		basic_block* const subject_;
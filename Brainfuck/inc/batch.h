@@ -0,0 +1,57 @@
+#pragma once
+#ifndef BATCH_H
+#define BATCH_H
+
+#include "program_code.h"
+#include "emulator.h"
+#include "opt/optimizer_pass.h"
+
+#include <cstddef>
+#include <memory>
+#include <set>
+#include <string>
+#include <vector>
+
+/*Concurrent execution of many programs within a single process. Every job is executed by its own emulator on one of the
+runner's threads, reading its input from a file and writing its output to another one. Jobs running the same program share
+its compiled code, therefore the program is compiled only once regardless of the number of inputs.*/
+namespace bf::batch {
+
+	/*A single execution performed by the runner. The job either executes code shared with other jobs, or compiles its own program.*/
+	struct job {
+		std::string name_; //identifies the job in reports, e.g. the name of its program or of its input
+		std::shared_ptr<std::vector<instruction> const> code_; //code shared read-only by multiple jobs; nullptr if the job compiles program_file_
+		std::string program_file_; //file with the source code compiled by the job itself
+		std::string input_file_; //empty if the program gets no input
+		std::string output_file_;
+	};
+
+	struct job_result {
+		execution::execution_state state_ = execution::execution_state::not_started;
+		std::ptrdiff_t executed_instructions_ = 0;
+		double seconds_ = 0;
+		std::string error_; //reason why the job has not been run, empty if it has
+		std::string diagnostics_; //messages of the job's emulator, e.g. that the end of input has been hit
+	};
+
+	struct settings {
+		std::set<opt::opt_level_t> optimizations_; //optimizations of programs compiled by the jobs
+		std::ptrdiff_t memory_size_ = execution::tape::default_size; //number of cells of each job's memory
+		execution::cell_width cell_width_ = execution::default_cell_width; //width of cells of each job's memory
+		bool jit_ = false; //true iff the jobs shall be executed by the JIT
+		bool tiered_ = false; //true iff the jobs shall be executed by the tiered engine
+		unsigned threads_ = 1;
+	};
+
+	/*Executes all jobs using the given number of threads and returns their results in the order of jobs. Jobs are independent
+	on each other as well as on the global emulator. If the operating system raises an interrupt signal, running jobs are
+	interrupted and the remaining ones are not started at all.*/
+	[[nodiscard]]
+	std::vector<job_result> run(std::vector<job> const& jobs, settings const& settings);
+
+	/*Function initializing cli commands. Shall be called only once from main.*/
+	void initialize();
+
+} //namespace bf::batch
+
+#endif
@@ -0,0 +1,15 @@
+#pragma once
+#ifndef BENCH_H
+#define BENCH_H
+
+/*Benchmark of the whole toolchain. A fixed corpus of well known programs is compiled, optimized and executed by all available
+engines, measuring the time spent in each stage. Programs are read from a directory, since the bigger ones are not distributed
+with the debugger; those that cannot be found are skipped.*/
+namespace bf::bench {
+
+	/*Function initializing cli commands. Shall be called only once from main.*/
+	void initialize();
+
+} //namespace bf::bench
+
+#endif
@@ -5,14 +5,21 @@
 
 #include "syntax_check.h"
 #include "program_code.h"
+#include "expression.h"
+#include "anal/analysis.h"
 
 #include <unordered_map>
 #include <functional>
 #include <unordered_set>
 #include <map>
+#include <optional>
 #include <vector>
 #include <algorithm>
 
+namespace bf::execution {
+	class cpu_emulator;
+}
+
 namespace bf::breakpoints {
 
 	/*Structure representing a breakpoint in execution. It most importantly stores the address at which the corresponding breakpoint resides.*/
@@ -28,23 +35,21 @@ namespace bf::breakpoints {
 		but since it's ignored, the replaced instruction is executed every time.*/
 		bool enabled_ = true;
 
-		//Function wrapper for breakpoint's condition. May contain a simple lambda determining whether breakpoint has been hit
-		std::function<bool()> hit_predicate_;
+		//Compiled condition of the breakpoint, which must evaluate to nonzero for the breakpoint to be hit. Empty for unconditional breakpoints
+		std::optional<expression::compiled_expression> condition_;
 
 	private:
 		/*Checks whether breakpoint has satisfied its condition. Returns true iff the breakpoint is unconditional
-		or the invocation of its condition predicate returns true.*/
+		or its condition evaluates to nonzero in the given state of the CPU.*/
 		[[nodiscard]]
-		bool is_condition_satisfied() const {
-			//TODO untill predicates are implemented, this always returns true
-			//return hit_predicate_ ? hit_predicate_{} : true;
-			return true;
+		bool is_condition_satisfied(expression::machine_state const& state) const {
+			return !condition_ || condition_->evaluate(state);
 		}
 
 	public:
 		/*Tries to hit the breakpoint. If it's enabled, its condition is satisfied and ignore count is not zero, decrease it.
 		If the ignore_count is zero, returns true and breakpoint handling in scheduled.*/
-		bool try_hit();
+		bool try_hit(expression::machine_state const& state);
 
 		breakpoint() noexcept
 			:id_{ -1 }, address_{ -1 }
@@ -64,23 +69,55 @@ namespace bf::breakpoints {
 	};
 
 
+	//Kinds of accesses to memory cells interrupting the execution
+	enum class access_kind {
+		write, //the cell is written to by an instruction; instructions modifying the cell like inc both read and write it
+		read //the value of the cell is used by an instruction, e.g. by write or a conditional jump
+	};
+
+	/*Structure representing a watchpoint, i.e. a data breakpoint interrupting the execution right before an instruction accesses the watched cell.
+	Watchpoints are not bound to any address. Instead, the instructions which may access the cell are found by an analysis of the program
+	and replaced by breakpoint instructions, which check the exact address of the cell accessed.*/
+	struct watchpoint {
+		int id_; //unique id of this watchpoint; watchpoints are numbered independently on breakpoints
+		std::ptrdiff_t cell_; //offset of the watched cell from the beginning of memory
+		access_kind kind_;
+	};
+
 	/*Breakpoint location. Since there can be more breakpoints at one address, this structure
-	stores a set of pointers as well as the replaced instruction.*/
+	stores a set of pointers as well as the replaced instruction. Locations are also created for instructions checked by watchpoints.*/
 	struct location {
-		std::unordered_set<breakpoint*> breakpoints_here_; //pointers to breakpoints located at the corresponding address
+		std::vector<breakpoint*> breakpoints_here_; //pointers to breakpoints located at the corresponding address
+		bool watched_ = false; //true iff the instruction may access a watched cell and shall be checked by watchpoints
 
 		//stored instruction that had been replaced by breakpoints. It gets executed when breakpoints are ignored or the execution is resumed
 		instruction replaced_instruction_;
 	};
 
+	/*Collection of breakpoints defined in the program flashed into a single emulator. Each emulator owns its manager.*/
 	class breakpoint_manager {
+		execution::cpu_emulator& cpu_; //the emulator whose program is altered by breakpoints of this manager
 		std::map<int, breakpoint> all_breakpoints_; //map of all breakpoints with their id as key
 		std::unordered_map<std::ptrdiff_t, location> breakpoint_locations_; //map of breakpoint locations with their address as key
 		std::unordered_set<breakpoint*> temp_breakpoints_; //set of temporary breakpoints that shall be erased after being hit
 
+		/*Locations indexed by address, nullptr where there is none. Hit breakpoints are found without hashing, since
+		a breakpoint in a hot loop is checked every iteration. Nodes of breakpoint_locations_ never move, hence the pointers stay valid.*/
+		std::vector<location*> location_table_;
+
 		//holds pointers to all breakpoints, which had been identified as reached in the should_ignore_breakpoints_at function
 		std::vector<breakpoint*> hit_breakpoints_;
 
+		std::map<int, watchpoint> watchpoints_; //map of all watchpoints with their id as key
+		std::vector<watchpoint const*> hit_watchpoints_; //watchpoints hit by the instruction at which the execution has been interrupted
+		std::vector<std::ptrdiff_t> watched_addresses_; //sorted addresses of instructions instrumented on behalf of watchpoints
+
+		/*Intervals of the cell pointer before each instruction computed when the watched instructions were last chosen.
+		The choice stays valid as long as the execution continues from a state covered by these intervals.*/
+		std::vector<std::optional<analysis::pointer_interval>> pointer_ranges_;
+		std::ptrdiff_t analyzed_memory_size_ = 0;
+		bool watchpoints_outdated_ = false; //set whenever watchpoints change or the program is reflashed
+
 		/*Finds an unused integer as a new breakpoint id.*/
 		[[nodiscard]]
 		int get_unused_breakpoint_id() const;
@@ -89,9 +126,26 @@ namespace bf::breakpoints {
 		If some breakpoint had already been set before, the new one is added. Otherwise alteration of program's code
 		is performed and the replaced instruction saved.
 		Pointer to the new breakpoint is returned provided the operation ends successfully. Otherwise nullptr is returned.*/
-		breakpoint* do_set_breakpoint_at(std::ptrdiff_t address);
+		breakpoint* do_set_breakpoint_at(std::ptrdiff_t address, std::optional<expression::compiled_expression> condition);
+
+		/*Returns the location at the given address. If there is none, the instruction is replaced by a breakpoint instruction
+		and a new location storing the original instruction is created.*/
+		location& instrument(std::ptrdiff_t address);
+
+		/*Restores the original instruction at the given address and erases its location provided neither breakpoints nor watchpoints need it.*/
+		void release_if_unused(std::ptrdiff_t address);
+
+		//Returns the location of breakpoints at the given address, nullptr if there are none
+		[[nodiscard]]
+		location* location_at(std::ptrdiff_t const address) const {
+			return address >= 0 && address < static_cast<std::ptrdiff_t>(location_table_.size()) ? location_table_[address] : nullptr;
+		}
 
 	public:
+		explicit breakpoint_manager(execution::cpu_emulator& cpu) noexcept : cpu_{ cpu } {}
+
+		breakpoint_manager(breakpoint_manager const&) = delete;
+		breakpoint_manager& operator=(breakpoint_manager const&) = delete;
 
 		//Returns a read only reference to the internal map of all existing breakpoints
 		[[nodiscard]]
@@ -102,13 +156,14 @@ namespace bf::breakpoints {
 		[[nodiscard]]
 		instruction const& get_replaced_instruction_at(std::ptrdiff_t address) const;
 
-		/*Delegates call to do_set_breakpoint_at, returns zero if operation ended successfully.*/
-		int set_breakpoint_at(std::ptrdiff_t address);
+		/*Delegates call to do_set_breakpoint_at, returns zero if operation ended successfully. The breakpoint is only hit
+		when the condition is satisfied, if there is any.*/
+		int set_breakpoint_at(std::ptrdiff_t address, std::optional<expression::compiled_expression> condition = std::nullopt);
 
 		/*Sets a temporary breakpoint at the specified address. A normal breakpoint is created, which is then
 		added to the set of temporary breakpoints which shall be deleted after being hit.
 		Returns zero if the operation ended successfully.*/
-		int set_temp_breakpoint_at(std::ptrdiff_t address);
+		int set_temp_breakpoint_at(std::ptrdiff_t address, std::optional<expression::compiled_expression> condition = std::nullopt);
 
 		/*Removes the breakpoint from code. If the specified breakpoint does not exist, crashes painfully*/
 		void remove_breakpoint(breakpoint* bp);
@@ -125,32 +180,56 @@ namespace bf::breakpoints {
 		/*Checks if specified breakpoint shall be ignored. If the specified breakpoint does not exist,
 		a unknown breakpoint had been hit and it shall be examined properly in the handle_breakpoint function.
 		If there are multiple breakpoints residing at the specified address, each of them is checked for its
-		ignore count reaching zero - in such case the breakpoint shall not be ignored.
-		Returns true if all breakpoints at address are known and have positive ignore count.*/
+		condition and ignore count reaching zero - in such case the breakpoint shall not be ignored.
+		Returns true if all breakpoints at address are known and are disabled, unsatisfied or have positive ignore count.
+		Called by the engines whenever a breakpoint instruction is executed; it neither allocates nor hashes.*/
 		[[nodiscard]]
 		bool should_ignore_breakpoints_at(std::ptrdiff_t address);
 
 		/*Returns a reference to read-only set of pointers to BPs residing at specified address.
 		This function assumes that there truly are breakpoints at the specified address. It fails painfully otherwise.*/
 		[[nodiscard]]
-		std::unordered_set<breakpoint*> const& get_breakpoints_at(std::ptrdiff_t address);
+		std::vector<breakpoint*> const& get_breakpoints_at(std::ptrdiff_t address);
 
 		/*Returns an integer - the number of breakpoints at given address.*/
 		[[nodiscard]]
 		int count_breakpoints_at(std::ptrdiff_t address);
 
-		/*Erases breakpoints from all internal containers.*/
+		/*Erases breakpoints from all internal containers. Watchpoints refer to memory rather than code, therefore they are kept
+		and the newly flashed program is instrumented before it is executed.*/
 		void clear_all();
 
+		/*Returns true iff the instruction at the given address has been replaced by a breakpoint instruction on behalf of
+		breakpoints or watchpoints. The original instruction is then returned by get_replaced_instruction_at.*/
+		[[nodiscard]]
+		bool is_instrumented(std::ptrdiff_t const address) const { return location_at(address); }
+
+		//Returns the flashed program with breakpoint instructions replaced by the instructions they had been placed over
+		[[nodiscard]]
+		std::vector<instruction> original_program() const;
+
+		//Returns a read only reference to the map of all existing watchpoints
+		[[nodiscard]]
+		std::map<int, watchpoint> const& all_watchpoints() const { return watchpoints_; }
+
+		/*Creates a new watchpoint interrupting the execution before the given cell is accessed in the given way.
+		Returns zero if the operation ended successfully.*/
+		int set_watchpoint(std::ptrdiff_t cell, access_kind kind);
+
+		/*Removes the watchpoint with the given id. Returns false if there is no such watchpoint.*/
+		bool remove_watchpoint(int id);
+
+		/*Chooses the instructions which may access watched cells when the execution continues from the current state of the CPU
+		and instruments them. Called by the emulator before each execution. The program is only analyzed again if watchpoints have changed
+		or the current state of the CPU has not been considered by the previous analysis, e.g. after the cell pointer has been modified.*/
+		void update_watchpoints();
+
 		/*Returns a pointer to breakpoint with specified id or nullptr if such breakpoint does not exist.*/
 		[[nodiscard]]
 		breakpoint* get_breakpoint(int id);
 
 	};
 
-	/*Single global instance of breakpoint_manager.*/
-	extern breakpoint_manager bp_manager;
-
 	/*Initialization function which shall be called just once by main. Creates CLI commands.*/
 	void initialize();
 
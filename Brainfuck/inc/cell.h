@@ -0,0 +1,102 @@
+#ifndef CELL_H
+#define CELL_H
+#pragma once
+
+#include <cassert>
+#include <climits>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <optional>
+#include <string_view>
+#include <type_traits>
+
+namespace bf::execution {
+
+	/*Widths of memory cells supported by the emulator. The width is chosen when a program is flashed; each width has its own
+	specialization of the engines, the JIT translation and the constant folding, therefore no engine ever branches on it.*/
+	enum class cell_width {
+		bits8 = 8,
+		bits16 = 16,
+		bits32 = 32
+	};
+
+	//width of cells used unless another one is requested
+	constexpr cell_width default_cell_width = cell_width::bits8;
+
+	//Maps a cell width to the unsigned integer type representing a single cell
+	template<cell_width WIDTH>
+	struct cell_traits;
+
+	template<>
+	struct cell_traits<cell_width::bits8> { using type = std::uint8_t; };
+	template<>
+	struct cell_traits<cell_width::bits16> { using type = std::uint16_t; };
+	template<>
+	struct cell_traits<cell_width::bits32> { using type = std::uint32_t; };
+
+	template<cell_width WIDTH>
+	using cell_type_t = typename cell_traits<WIDTH>::type;
+
+	//Returns the number of bytes occupied by a single cell of given width
+	[[nodiscard]]
+	constexpr std::size_t cell_size(cell_width const width) { return static_cast<std::size_t>(width) / CHAR_BIT; }
+
+	/*Calls the visitor with a value initialized cell of the type corresponding to given width and returns its result.
+	Callers branch on the width once and obtain code specialized for the cell type, e.g. a whole engine.*/
+	template<typename VISITOR>
+	decltype(auto) visit_cell_type(cell_width const width, VISITOR&& visitor) {
+		switch (width) {
+		case cell_width::bits16:
+			return visitor(cell_type_t<cell_width::bits16>{});
+		case cell_width::bits32:
+			return visitor(cell_type_t<cell_width::bits32>{});
+		default:
+			assert(width == cell_width::bits8);
+			return visitor(cell_type_t<cell_width::bits8>{});
+		}
+	}
+
+	//Parses a width given in bits, i.e. "8", "16" or "32". Returns an empty optional for anything else
+	[[nodiscard]]
+	inline std::optional<cell_width> parse_cell_width(std::string_view const str) {
+		if (str == "8")
+			return cell_width::bits8;
+		if (str == "16")
+			return cell_width::bits16;
+		if (str == "32")
+			return cell_width::bits32;
+		return std::nullopt;
+	}
+
+	//Returns the value of the cell with given index in memory consisting of cells of given width
+	[[nodiscard]]
+	inline std::uint32_t read_cell(void const* const memory, std::ptrdiff_t const index, cell_width const width) {
+		return visit_cell_type(width, [=](auto cell) -> std::uint32_t {
+			std::memcpy(&cell, static_cast<unsigned char const*>(memory) + index * sizeof(cell), sizeof(cell));
+			return cell;
+		});
+	}
+
+	/*Returns the value a cell of given width holds after given constant has been stored to it, i.e. the constant modulo 2^width.*/
+	[[nodiscard]]
+	constexpr std::int64_t wrap_unsigned(std::int64_t const value, cell_width const width) {
+		return static_cast<std::int64_t>(static_cast<std::uint64_t>(value) & ((std::uint64_t{ 1 } << static_cast<int>(width)) - 1));
+	}
+
+	/*Returns the increment of smallest magnitude equivalent to given one for cells of given width. The result lies in the range
+	[-2^(width-1), 2^(width-1)), hence small decrements remain negative.*/
+	[[nodiscard]]
+	constexpr std::int64_t wrap_signed(std::int64_t const value, cell_width const width) {
+		std::int64_t const modulus = std::int64_t{ 1 } << static_cast<int>(width);
+		std::int64_t const wrapped = wrap_unsigned(value, width);
+		return wrapped >= modulus / 2 ? wrapped - modulus : wrapped;
+	}
+
+	/*The smallest number of distinct values a cell can hold regardless of its width. Constants of the analysis which are
+	multiples of it are only known to be zero if the cells are known to be this narrow.*/
+	constexpr std::int64_t min_cell_modulus = std::int64_t{ 1 } << static_cast<int>(cell_width::bits8);
+
+} //namespace bf::execution
+
+#endif //CELL_H
@@ -3,28 +3,39 @@
 #define COMPILER_H
 
 #include "program_code.h"
+#include "syntax_check.h"
+#include "cell.h"
 #include <string>
+#include <string_view>
 #include <vector>
 #include <memory>
 #include <optional>
+#include <functional>
+#include <set>
 
 namespace bf {
 
 	/*Namespace wrapping functions observing the state of lastly performed compilation. Allows to query the validity of
-	this result (i.e. if some compilation had been run), encountered syntax errors, source code as well as compiled code.*/
+	this result (i.e. if some compilation had been run), encountered syntax errors, source code as well as compiled code.
+	The result is local to the calling thread; cli commands always work with the compilation of the main thread.*/
 	namespace previous_compilation {
 
-		//Returns reference to the source code of previous compilation
+		//Returns the source code of previous compilation. Sources compiled from files are viewed directly in their memory mapping
 		[[nodiscard]]
-		std::string& source_code();
+		std::string_view source_code();
 
 		//Returns vector of syntax errors encountered during compilation
 		[[nodiscard]]
 		std::vector<syntax_error>& syntax_errors();
 
-		//Returns the compiled code from last compilation. If it does not exist, throws
+		/*Returns the compiled code from last compilation. If it does not exist, throws.
+		If memory_size is given, shifts which provably keep the cell pointer within the first memory_size cells
+		are emitted as right_unchecked and, if enabled, the program's prefix independent on input is evaluated in memory of this size.
+		Such code may only be executed with memory at least this large. Constants are folded for cells of the given width,
+		the code may therefore only be executed by an emulator using the same width.*/
 		[[nodiscard]]
-		std::vector<instruction> generate_executable_code();
+		std::vector<instruction> generate_executable_code(std::optional<std::ptrdiff_t> memory_size = std::nullopt,
+			execution::cell_width width = execution::default_cell_width);
 
 		//Returns a vector of all basic blocks making up this program
 		[[nodiscard]]
@@ -32,6 +43,22 @@ namespace bf {
 		[[nodiscard]]
 		std::vector<std::unique_ptr<basic_block>>& basic_blocks_mutable();
 
+		/*Applies the transformation to basic blocks of the successful compilation. The description identifies the transformation
+		in the cache of compiled programs. If the compilation has been deferred, so is the transformation and false is returned.*/
+		bool transform(std::string_view description, std::function<void(std::vector<std::unique_ptr<basic_block>>&)> transformation);
+
+		/*Transformation applied by transform_incrementally. The flag is false while it transforms a single top-level loop. Blocks of the whole
+		program that have been transformed together with their loop and are connected to no other blocks are passed as settled,
+		the transformation need not visit them unless a change of some other block reaches them.*/
+		using loop_transformation = std::function<void(std::vector<std::unique_ptr<basic_block>>& blocks, bool whole_program,
+			std::set<basic_block const*> const& settled)>;
+
+		/*Like transform, but if the blocks are still the output of the frontend and incremental compilation is enabled, top-level loops of
+		the source are first transformed separately, as if they began in an unknown state of memory. Results are cached by the loop's source,
+		hence loops that have not changed since the previous incremental transformation are spliced back without transforming them again.
+		The transformation is then applied to the whole program with the inner blocks of the spliced loops settled.*/
+		bool transform_incrementally(std::string_view description, loop_transformation transformation);
+
 		//Returns true iff the compilation had been completed successfully. If an error had been found, returns false
 		[[nodiscard]]
 		bool successful();
@@ -43,6 +70,14 @@ namespace bf {
 
 
 
+	/*Compiles the given source code replacing the result of previous compilation, exactly like the "compile" command
+	but without printing anything. Returns true iff the code is valid. The compilation may be deferred if the cache is enabled.*/
+	bool compile_source(std::string source);
+
+	/*Returns true iff previous_compilation::transform_incrementally transforms top-level loops separately and caches them. Enabled by default.*/
+	[[nodiscard]]
+	bool& incremental_compilation();
+
 	/*Initialization function of cli commands controling compilation. Shall be called only once from main.*/
 	void compiler_initialize();
 
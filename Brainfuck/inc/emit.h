@@ -0,0 +1,25 @@
+#pragma once
+#ifndef EMIT_H
+#define EMIT_H
+
+#include "program_code.h"
+#include "cell.h"
+
+#include <string>
+#include <vector>
+
+/*Ahead-of-time backends translating compiled programs to source code of other languages.*/
+namespace bf::emit {
+
+	/*Translates the given executable code to a standalone C program operating on memory of given number of cells of given width.
+	Loops of the source program are lowered to structured while and do-while loops wherever the layout of jumps allows it,
+	the remaining jumps are emitted as gotos.*/
+	[[nodiscard]]
+	std::string generate_c_source(std::vector<instruction> const& code, std::ptrdiff_t memory_size, execution::cell_width width = execution::default_cell_width);
+
+	/*Function initializing cli commands. Shall be called only once from main.*/
+	void initialize();
+
+} //namespace bf::emit
+
+#endif
@@ -3,12 +3,22 @@
 #pragma once
 
 #include "program_code.h"
+#include "IR/packed_instruction.h"
 #include "breakpoint.h"
+#include "tape.h"
+#include "cell.h"
+#include "jit.h"
+#include "input_buffer.h"
 
 #include <cstdint>
 #include <ostream>
 #include <iostream>
 #include <array>
+#include <memory>
+#include <vector>
+#include <unordered_map>
+#include <algorithm>
+#include <ios>
 
 namespace bf::execution {
 
@@ -115,32 +125,137 @@ namespace bf::execution {
 	};
 
 
+	/*State of the CPU captured by cpu_emulator::take_checkpoint. Restoring it lets the program continue from the same point again,
+	since the only other input of the program, its input stream, is rewound as well if it is a file. Memory is shared page by page
+	with other checkpoints of the same run.*/
+	struct checkpoint {
+		int id_;
+		bool automatic_; //taken periodically by the emulator itself
+		std::ptrdiff_t program_counter_, executed_instructions_, cell_pointer_;
+		execution_state state_;
+		bool breakpoint_hit_, halt_, stdin_eof_;
+		std::streamoff input_position_; //position within the emulated program's input, -1 if the input cannot be rewound
+		std::shared_ptr<tape_snapshot const> memory_;
+	};
+
+
+	/*A single step recorded by the execution trace: the address of an instruction together with the CPR and the value of the current cell
+	right before the instruction has been executed. Stored as three 32-bit words; addresses and cell indices wider than that are truncated.*/
+	struct trace_record {
+		std::uint32_t address_;
+		std::uint32_t cell_;
+		std::uint32_t value_;
+	};
+
+	/*Ring buffer of the most recently executed steps. Its capacity is a power of two, hence recording a step is a store and an increment.
+	Once full, every recorded step overwrites the oldest one.*/
+	class trace_buffer {
+		std::unique_ptr<trace_record[]> records_;
+		std::size_t mask_ = 0; //capacity minus one
+		std::uint64_t recorded_ = 0; //number of steps recorded since the buffer has been cleared
+
+	public:
+		//Records a step. The buffer must have been allocated by resize
+		void record(std::ptrdiff_t const address, std::ptrdiff_t const cell, std::uint32_t const value) {
+			records_[recorded_++ & mask_] = trace_record{ static_cast<std::uint32_t>(address), static_cast<std::uint32_t>(cell), value };
+		}
+
+		/*Allocates a buffer holding at least the given number of steps rounded up to a power of two. Recorded steps are discarded.
+		Zero releases the buffer. Throws std::bad_alloc if the buffer cannot be allocated, the previous one is kept in such case.*/
+		void resize(std::size_t capacity);
+
+		//Discards all recorded steps
+		void clear() { recorded_ = 0; }
+
+		[[nodiscard]]
+		std::size_t capacity() const { return records_ ? mask_ + 1 : 0; }
+
+		//Returns the number of steps recorded since the buffer has been cleared, including the overwritten ones
+		[[nodiscard]]
+		std::uint64_t recorded() const { return recorded_; }
+
+		//Returns the number of steps held by the buffer
+		[[nodiscard]]
+		std::size_t size() const { return static_cast<std::size_t>(std::min<std::uint64_t>(recorded_, capacity())); }
+
+		//Returns the held step with given index, the oldest one has index zero
+		[[nodiscard]]
+		trace_record const& operator[](std::size_t const index) const { return records_[(recorded_ - size() + index) & mask_]; }
+	};
+
 	class cpu_emulator {
 
 		friend class breakpoints::breakpoint_manager;
 
-	public: //underlying type for memory cells
-		using memory_cell_t = unsigned char;
+		/*Engines specialized for a single width of cells. The emulator itself is unaware of the type of its cells,
+		all of them are selected at once whenever the width changes, hence no engine branches on the width.*/
+		struct engines {
+			void (cpu_emulator::* execute_)(instruction const&);
+			void (cpu_emulator::* debug_)();
+			void (cpu_emulator::* fast_)();
+			void (cpu_emulator::* jit_)();
+			void (cpu_emulator::* tiered_)();
+			void (cpu_emulator::* traced_)();
+		};
+
+		//Returns the engines operating on cells of the given width
+		[[nodiscard]]
+		static engines const& engines_for(cell_width width);
 
-	private:
 
+		/*Full records of the flashed code. They serve as the side table of packed_code_: the debugger, error reports, memory views and the JIT
+		read them, the fast engine only for instructions packed in full form.*/
 		std::vector<instruction> instructions_;
+		std::vector<IR::packed_instruction> packed_code_; //compact form of instructions_ plus a trailing sentinel, executed by the fast engine; kept in sync by patch_instruction
 		std::ptrdiff_t program_counter_ = 0,
 			executed_instructions_counter_ = 0;
 		flags_register volatile flags_register_;
-		std::array<memory_cell_t, 64> memory_ = { 0 };
-		memory_cell_t* cell_pointer_reg_ = memory_.data();
+		tape memory_;
+		cell_width cell_width_ = default_cell_width;
+		std::ptrdiff_t memory_size_ = memory_.size() / static_cast<std::ptrdiff_t>(cell_size(cell_width_)); //number of cells of memory
+		tape::byte_t* cell_pointer_reg_ = memory_.data(); //address of the first byte of the current cell
+		engines const* engines_ = &engines_for(default_cell_width);
+		std::ptrdiff_t unchecked_shifts_memory_size_ = 0; //size of memory for which the flashed right_unchecked instructions were proven safe
+		bool jit_enabled_ = false;
+		std::unique_ptr<jit::compiled_program> jit_program_; //native code of flashed instructions; generated lazily, nullptr if outdated
+		bool tiering_enabled_ = false;
+		std::vector<std::ptrdiff_t> back_edges_; //number of backward conditional jumps taken to each address by the tiered engine
+		std::unordered_map<std::ptrdiff_t, std::unique_ptr<jit::compiled_program>> compiled_loops_; //native code of hot loops keyed by their headers
+		std::ptrdiff_t hot_loop_end_ = 0; //set by the fast engine when it stops at the header of a loop which has become hot
+		bool profiling_ = false;
+		std::vector<std::ptrdiff_t> taken_jumps_; //number of times the jump at each address has been taken while profiling
+		std::ptrdiff_t profiled_runs_ = 0; //number of executions started at the program's entry while profiling
+		bool tracing_ = false;
+		trace_buffer trace_; //steps recorded while tracing; cleared whenever the program is flashed or the CPU is reset
+		std::vector<checkpoint> checkpoints_; //sorted by id; cleared whenever the program or memory is replaced
+		int next_checkpoint_id_ = 0;
+		std::ptrdiff_t automatic_checkpoint_interval_ = 0; //number of instructions between automatic checkpoints, zero if disabled
+		std::ptrdiff_t next_automatic_checkpoint_ = 0; //value of the instruction counter at which the next automatic checkpoint is due
 		execution_state state_ = execution_state::not_started;
+		breakpoints::breakpoint_manager breakpoints_{ *this }; //breakpoints placed in the flashed program
 
-		std::istream* emulated_program_stdin_ = &std::cin;
+		input_buffer input_; //input of the emulated program, the debugger's stdin by default
 		std::ostream* emulated_program_stdout_ = &std::cout;
+		std::ostream* diagnostics_ = &std::cout; //informational messages of the emulator itself, e.g. about the finished execution
 		bool stdin_eof_ = false;
+		std::size_t input_bytes_ = 0, output_bytes_ = 0; //bytes read and written by the emulated program since the emulator has been constructed
+
+		//Output of the emulated program is collected here and written to emulated_program_stdout_ in bulk
+		static constexpr std::size_t output_buffer_capacity = 1 << 14;
+		std::array<char, output_buffer_capacity> output_buffer_;
+		std::size_t output_buffer_size_ = 0;
 
 	public:
 		[[nodiscard]]
-		std::istream*& emulated_program_stdin() { return emulated_program_stdin_; }
+		input_buffer& emulated_program_input() { return input_; }
 		[[nodiscard]]
 		std::ostream*& emulated_program_stdout() { return emulated_program_stdout_; }
+		[[nodiscard]]
+		std::ostream*& diagnostics_stream() { return diagnostics_; }
+
+		/*Writes the buffered output of the emulated program to its output stream and flushes it. Called whenever the execution stops
+		or has to wait for input, shall also be called before the output stream is replaced.*/
+		void flush_output();
 
 	private:
 		/*Handler executed if a breakpoint instruction is hit. First sets the breakpoint_hit flag to prevent further execution.
@@ -149,18 +264,144 @@ namespace bf::execution {
 		breakpoint_hit flag and proceeds with execution. Otherwise emulator is stopped and breakpoints get handled.*/
 		void breakpoint_interrupt_handler();
 
-		/*MicroOP code for the "right" instruction. Advances the CPR one cell to right and wraps it around the boundary of memory if such
-		shift would overflow.*/
-		void right(std::ptrdiff_t count);
+		//Returns the memory as an array of cells of given type
+		template<typename CELL>
+		[[nodiscard]]
+		CELL* cells() { return reinterpret_cast<CELL*>(memory_.data()); }
+
+		//Returns the CPR as a pointer to a cell of given type
+		template<typename CELL>
+		[[nodiscard]]
+		CELL* current_cell() { return reinterpret_cast<CELL*>(cell_pointer_reg_); }
+
+		/*Returns the given cell pointer shifted by count cells. The result is wrapped around the boundary of memory if the shift would overflow.
+		Shared by all engines, the fast one keeps the CPR in a local variable.*/
+		template<typename CELL>
+		[[nodiscard]]
+		CELL* shifted_cell_pointer(CELL* pointer, std::ptrdiff_t count);
+
+		/*Moves the given pointer by stride until it points to a zero cell, like loops [>] or [<<] do. Negative stride searches to the left.
+		Returns nullptr if there is no reachable zero cell and the search would never terminate.*/
+		template<typename CELL>
+		[[nodiscard]]
+		CELL* search_zero_cell(CELL* pointer, std::ptrdiff_t stride);
+
+		/*Moves the given pointer by stride until it points to a zero cell clearing all cells it leaves, like loops [[-]>] or [[-]<<] do.
+		Returns the pointer to the zero cell, which always exists.*/
+		template<typename CELL>
+		[[nodiscard]]
+		CELL* clear_to_zero_cell(CELL* pointer, std::ptrdiff_t stride);
+
+		//Sets count cells starting at the given one and stride cells apart to value. Cells past the end of memory wrap around to its beginning
+		template<typename CELL>
+		void fill_cells(CELL* first, std::ptrdiff_t count, std::ptrdiff_t stride, CELL value);
+
+		//Appends a character to the output buffer, flushing it first if it is full
+		void put_output(char const character) {
+			if (output_buffer_size_ == output_buffer_capacity)
+				flush_output();
+			output_buffer_[output_buffer_size_++] = character;
+		}
+
+		//Appends a string to the output buffer. Strings that do not fit are written directly after the buffer is flushed
+		void write_output(char const* data, std::size_t length);
+
+		//Executes the flashed program until it stops
+		void resume_execution();
+
+		/*Executes a single specified instruction and returns. Dispatches to the specialization for the current width of cells.*/
+		void do_execute(instruction const& instruction) { (this->*engines_->execute_)(instruction); }
+
+		/*Executes a single specified instruction operating on cells of given type.*/
+		template<typename CELL>
+		void execute_instruction(instruction const& instruction);
+
+		/*The debug engine. Fetches and executes instructions one by one, checking all flags after each of them.
+		Used whenever single stepping is requested, since it is able to stop after every instruction.*/
+		template<typename CELL>
+		void execute_debug();
+
+		/*The fast engine. Dispatches instructions using computed goto (or a plain switch on compilers without support for labels as values)
+		keeping PC, CPR and the instruction counter in local variables. Flags are only consulted when a breakpoint instruction is executed,
+		after reads and periodically on taken backward jumps. The state of registers is written back whenever the engine stops.
+		The same engine counts back edges for the tiered engine and records every dispatched instruction to the trace if requested.*/
+		template<typename CELL, bool COUNT_BACK_EDGES = false, bool TRACE = false>
+		void execute_fast();
+
+		/*The JIT engine. Runs native code generated from the flashed instructions, which returns to this function whenever
+		an instruction has to be interpreted (e.g. a breakpoint) or CPU's flags need to be polled. The native code is generated
+		on first use and thrown away whenever the instructions or memory change.*/
+		template<typename CELL>
+		void execute_jit();
+
+		/*The tiered engine. Interprets the program by the fast engine counting backward jumps to each loop header. Once a loop
+		has been entered tier_up_threshold times, only its instructions are translated to native code, which is entered at the header
+		every time the interpreter gets there. The native code returns to the interpreter whenever the execution leaves the loop.*/
+		template<typename CELL>
+		void execute_tiered();
+
+		/*Runs native code from the current PC once and handles the reason of its return. Returns false if the execution shall stop.*/
+		template<typename CELL>
+		bool run_native(jit::compiled_program const& program, jit::context& context);
+
+		//Returns the context of native code calling helpers operating on cells of given type
+		template<typename CELL>
+		[[nodiscard]]
+		jit::context jit_context();
+
+		//Translates the hot loop spanning from the header up to end. Loops that cannot be translated are never promoted again
+		void promote_loop(std::ptrdiff_t header, std::ptrdiff_t end);
+
+		//number of backward jumps to a loop header after which the tiered engine translates the loop
+		static constexpr std::ptrdiff_t tier_up_threshold = 1 << 10;
+
+		/*Records that the jump at the given address has been taken. Executions of all basic blocks are later derived from these counts,
+		which keeps the profiling overhead at a single increment per taken jump.*/
+		void count_taken_jump(std::ptrdiff_t const address) {
+			if (profiling_)
+				++taken_jumps_[address];
+		}
 
-		/*Executes a single specified instruction and returns.*/
-		void do_execute(instruction const& instruction);
+		//Discards the native code; shall be called whenever flashed instructions or memory are replaced
+		void invalidate_jit() {
+			jit_program_.reset();
+			compiled_loops_.clear();
+		}
 
-		/*Performs some state housekeeping when the execution is interrupted. Flushes output stream,
+		/*Discards native code containing the instruction at the given address, which is being patched. Loops translated by the tiered
+		engine are deoptimized: the interpreter executes them until they become hot again and get translated with the patched instruction.*/
+		void deoptimize(std::ptrdiff_t address);
+
+		//Replaces the flashed instruction at the given address in both its full and packed form. Used to insert and remove breakpoints
+		void patch_instruction(std::ptrdiff_t address, instruction const& replacement);
+
+		/*Takes an automatic checkpoint provided one is due. Called by the engines whenever they poll the flags with registers written back.
+		Only the newest max_automatic_checkpoints automatic checkpoints are kept.*/
+		void take_automatic_checkpoint();
+
+		//Helpers called by the native code. They perform IO exactly like the emulator's interpreting engines do
+		template<typename CELL>
+		static int jit_read_helper(jit::context* context, unsigned char* cell);
+		template<typename CELL>
+		static void jit_write_helper(jit::context* context, unsigned char const* cell);
+		template<typename CELL>
+		static unsigned char* jit_search_helper(jit::context* context, unsigned char* from, std::ptrdiff_t stride);
+		template<typename CELL>
+		static unsigned char* jit_clear_search_helper(jit::context* context, unsigned char* from, std::ptrdiff_t stride);
+		//Performs the fill_range instruction at the given address, whose first cell has been computed by the native code
+		template<typename CELL>
+		static void jit_fill_helper(jit::context* context, unsigned char* first, std::ptrdiff_t address);
+
+		//number of taken conditional jumps after which the fast engine polls the flags register for pending interrupts
+		static constexpr std::ptrdiff_t interrupt_poll_interval = 1 << 16;
+
+		/*Performs some state housekeeping when the execution is interrupted. Flushes output buffer,
 		prints message if the execution reached end of program and fires "stop" cli command if suppression is disabled.*/
 		void execution_stops_callback();
 
 	public:
+		/*Emulators are independent on each other and may execute their programs on different threads at the same time,
+		as long as each of them is only used by a single thread. Only the global instance is controlled by cli commands.*/
 		cpu_emulator() = default; //no need to call reset here as the default initialization is sufficient
 		~cpu_emulator() = default;
 		cpu_emulator(cpu_emulator const&) = delete;
@@ -168,14 +409,99 @@ namespace bf::execution {
 		cpu_emulator& operator=(cpu_emulator const&) = delete;
 		cpu_emulator& operator=(cpu_emulator&&) = delete;
 
+		/*Loads new program into the CPU. Instructions right_unchecked contained in the code must have been proven safe
+		for the current size of memory. Should the memory shrink later, they are executed as ordinary checked shifts.*/
 		void flash_program(std::vector<instruction> new_instructions);
 
+		//Returns true iff shifts tagged as right_unchecked may skip the check of memory's boundaries
+		[[nodiscard]]
+		bool unchecked_shifts_safe() const { return memory_size() >= unchecked_shifts_memory_size_; }
+
 		/*Zeroes out memory, resets CPR and PC, in case input is redirected to a disk file, it's reset*/
 		void reset();
 
+		/*Chooses whether the program shall be executed by the JIT instead of the interpreter. Single stepping always uses the interpreter.
+		Enabling the JIT disables the tiering. Returns false if the JIT is not available on this platform.*/
+		bool enable_jit(bool enable);
+
+		[[nodiscard]]
+		bool jit_enabled() const { return jit_enabled_; }
+
+		/*Chooses whether the program shall be interpreted with hot loops translated to native code, see execute_tiered.
+		Enabling the tiering disables the JIT of the whole program. Returns false if the JIT is not available on this platform.*/
+		bool enable_tiering(bool enable);
+
+		[[nodiscard]]
+		bool tiering_enabled() const { return tiering_enabled_; }
+
+		//Returns the number of loops currently executed as native code by the tiered engine
+		[[nodiscard]]
+		std::size_t native_loops() const { return compiled_loops_.size(); }
+
+		/*Chooses whether the executions of basic blocks shall be counted. Profiled programs are always interpreted by the fast
+		or the debug engine, even if the JIT is enabled. Enabling the profiling clears all counters.*/
+		void enable_profiling(bool enable);
+
+		[[nodiscard]]
+		bool profiling_enabled() const { return profiling_; }
+
+		//Zeroes all counters of the profile
+		void reset_profile();
+
+		/*Chooses whether every executed instruction shall be recorded to the trace, which keeps the given number of the most recent steps.
+		Traced programs are always interpreted, even if the JIT or the tiering is enabled. Enabling the tracing clears the trace.
+		Throws std::bad_alloc if the trace cannot be allocated, the tracing stays disabled in such case.*/
+		void enable_tracing(bool enable, std::size_t capacity = 0);
+
+		[[nodiscard]]
+		bool tracing_enabled() const { return tracing_; }
+
+		//Returns the steps recorded while tracing
+		[[nodiscard]]
+		trace_buffer const& trace() const { return trace_; }
+
+		//Discards all recorded steps
+		void clear_trace() { trace_.clear(); }
+
+		//Returns the number of times the jump at each address has been taken while profiling. Other addresses have zero counts
+		[[nodiscard]]
+		std::vector<std::ptrdiff_t> const& taken_jumps() const { return taken_jumps_; }
+
+		//Returns the number of executions started at the program's entry while profiling
+		[[nodiscard]]
+		std::ptrdiff_t profiled_runs() const { return profiled_runs_; }
+
+		/*Captures the registers, interrupt flags, counters, position within the input stream and memory. Output buffered so far is flushed first.
+		Only the pages of memory written since the previous checkpoint (or restore) are copied. Throws std::bad_alloc if the writes cannot be tracked.*/
+		checkpoint const& take_checkpoint(bool automatic = false);
+
+		/*Returns the checkpoint with given id or nullptr if there is none.*/
+		[[nodiscard]]
+		checkpoint const* find_checkpoint(int id) const;
+
+		/*Returns the CPU to the state captured by the checkpoint. If the input is a file, it is rewound to the captured position;
+		returns false if it could not be. The output already written by the program stays as it is.*/
+		bool restore_checkpoint(checkpoint const& checkpoint);
+
+		[[nodiscard]]
+		std::vector<checkpoint> const& checkpoints() const { return checkpoints_; }
+
+		/*Chooses how many instructions shall be executed between automatic checkpoints. Zero disables them. Checkpoints are taken
+		when the engines poll for interrupts, therefore the actual distances are slightly larger.*/
+		void set_automatic_checkpoint_interval(std::ptrdiff_t instructions);
+
+		[[nodiscard]]
+		std::ptrdiff_t automatic_checkpoint_interval() const { return automatic_checkpoint_interval_; }
+
+		//number of automatic checkpoints kept; older ones are discarded
+		static constexpr std::size_t max_automatic_checkpoints = 16;
+
 		[[nodiscard]]
 		execution_state state() const { return state_; }
 
+		[[nodiscard]]
+		breakpoints::breakpoint_manager& breakpoints() { return breakpoints_; }
+
 		[[nodiscard]]
 		flag_reference<flag::halt> halt();
 		[[nodiscard]]
@@ -188,8 +514,15 @@ namespace bf::execution {
 		[[nodiscard]]
 		bool has_program() const { return !instructions_.empty(); }
 
+		/*Executes the flashed program until it stops. The execution is reported to the measurement of the running command, if there is one.*/
 		void do_execute();
 
+		//Returns the number of bytes read by the emulated program since the emulator has been constructed
+		[[nodiscard]]
+		std::size_t input_bytes() const { return input_bytes_; }
+		//Returns the number of bytes written by the emulated program since the emulator has been constructed
+		[[nodiscard]]
+		std::size_t output_bytes() const { return output_bytes_; }
 
 		[[nodiscard]]
 		std::ptrdiff_t program_counter() { return program_counter_; }
@@ -212,8 +545,21 @@ namespace bf::execution {
 
 
 
+		//Returns the number of cells of data memory
 		[[nodiscard]]
-		constexpr std::ptrdiff_t memory_size() const { return static_cast<std::ptrdiff_t>(memory_.size()); }
+		std::ptrdiff_t memory_size() const { return memory_size_; }
+
+		/*Replaces the data memory by a new one consisting of given number of cells and resets the CPU.
+		Throws std::bad_alloc if the memory cannot be allocated, the CPU is left untouched in such case.*/
+		void set_memory_size(std::ptrdiff_t cells);
+
+		[[nodiscard]]
+		cell_width get_cell_width() const { return cell_width_; }
+
+		/*Chooses the width of memory cells and selects the engines specialized for it. Memory keeps its number of cells, but is replaced by a new one
+		and the CPU is reset. The flashed program must have been generated for the same width, since it contains constants folded for it.
+		Throws std::bad_alloc if the memory cannot be allocated, the CPU is left untouched in such case.*/
+		void set_cell_width(cell_width width);
 
 		//returns a pointer to the first cell in data memory. Must be untyped due to raw byte manipulations done by some commands
 		[[nodiscard]]
@@ -225,26 +571,26 @@ namespace bf::execution {
 
 		//returns an address of the first element located past the memory's boundaries. Must be untyped due to raw byte manipulations done by some commands
 		[[nodiscard]]
-		void* memory_end() { return memory_.data() + memory_.size(); }
+		void* memory_end() { return memory_.end(); }
 		[[nodiscard]]
-		void const* memory_cend() const { return memory_.data() + memory_.size(); }
+		void const* memory_cend() const { return memory_.end(); }
 		[[nodiscard]]
-		void const* memory_end() const { return memory_.data() + memory_.size(); }
+		void const* memory_end() const { return memory_.end(); }
 
 		//Returns the value of CPU's CPR. Must be untyped due to raw byte manipulations done by some commands
 		[[nodiscard]]
 		void* cell_pointer() { return cell_pointer_reg_; }
 		[[nodiscard]]
 		void const* cell_pointer() const { return cell_pointer_reg_; }
-		//returns an offset of cpr from the memory's bounds
+		//returns the index of the cell pointed to by cpr
 		[[nodiscard]]
-		std::ptrdiff_t cell_pointer_offset() const { return std::distance(static_cast<unsigned char const*>(memory_begin()), static_cast<unsigned char const*>(cell_pointer())); }
+		std::ptrdiff_t cell_pointer_offset() const { return (cell_pointer_reg_ - memory_.data()) / static_cast<std::ptrdiff_t>(cell_size(cell_width_)); }
 
 
 
 	};
 
-	//global CPU instance 
+	//global CPU instance controlled by the debugger's commands
 	extern cpu_emulator emulator;
 
 
@@ -0,0 +1,77 @@
+#pragma once
+#ifndef EXPRESSION_H
+#define EXPRESSION_H
+
+#include "cell.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <vector>
+
+/*Expressions over the state of the emulated CPU entered by the user, e.g. conditions of breakpoints like "$cpr == 10 && mem[3] > 7".
+Expressions are compiled to a short program of a stack machine once, which allows to evaluate them cheaply very many times.*/
+namespace bf::expression {
+
+	/*Registers and memory of the CPU visible to expressions.*/
+	struct machine_state {
+		void const* memory_;
+		std::ptrdiff_t memory_size_; //in cells
+		execution::cell_width cell_width_;
+		std::ptrdiff_t cell_pointer_; //offset of the cell pointer from the beginning of memory
+		std::ptrdiff_t program_counter_;
+	};
+
+	/*Splits the expression to tokens - operators, register names, identifiers and literals. Whitespace separates tokens and is dropped.
+	Operators ==, !=, <=, >=, && and || are single tokens, other operators are single characters.*/
+	[[nodiscard]]
+	std::vector<std::string_view> tokenize(std::string_view expression);
+
+	/*Expression compiled to a program of a stack machine. Supported are decimal literals, registers $cpr and $pc, memory cells mem[index],
+	parentheses, unary - and !, binary * / % + - < <= > >= == != && || with their usual priorities. Indices of memory wrap around
+	the boundary of memory the same way the cell pointer does. Division by zero yields zero.*/
+	class compiled_expression {
+	public:
+		enum class op_code : std::uint8_t {
+			constant, cell_pointer, program_counter, cell,
+			negate, logical_not,
+			multiply, divide, remainder, add, subtract,
+			less, less_equal, greater, greater_equal, equal, not_equal,
+			logical_and, logical_or
+		};
+
+		struct instruction {
+			op_code op_code_;
+			std::ptrdiff_t value_; //value of a constant, unused by other operations
+		};
+
+		//maximal depth of the stack; deeper expressions are refused by the compiler, so that the evaluation needs no allocation
+		static constexpr std::size_t max_stack_depth = 32;
+
+	private:
+		std::string source_; //the expression as entered by the user
+		std::vector<instruction> code_;
+
+		compiled_expression(std::string source, std::vector<instruction> code) : source_{ std::move(source) }, code_{ std::move(code) } {}
+
+	public:
+		/*Compiles the expression. If it is invalid, the reason is printed and an empty optional is returned.*/
+		[[nodiscard]]
+		static std::optional<compiled_expression> compile(std::string_view source);
+
+		//Evaluates the expression in the given state of the CPU
+		[[nodiscard]]
+		std::ptrdiff_t evaluate(machine_state const& state) const;
+
+		[[nodiscard]]
+		std::string const& source() const { return source_; }
+
+		[[nodiscard]]
+		std::vector<instruction> const& code() const { return code_; }
+	};
+
+} //namespace bf::expression
+
+#endif
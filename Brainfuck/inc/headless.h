@@ -0,0 +1,27 @@
+#pragma once
+#ifndef HEADLESS_H
+#define HEADLESS_H
+
+/*Non-interactive execution of a single program, e.g. "brainfuck run -O2 program.b < input > output". The program is compiled,
+optimized and executed at once without registering any cli commands. The emulated program reads its standard input and writes
+its standard output directly, the debugger prints nothing but errors. Meant for use within shell pipelines.*/
+namespace bf::headless {
+
+	//Exit codes returned by run
+	enum exit_code : int {
+		success = 0, //the program has finished
+		invalid_usage = 1,
+		program_not_found = 2,
+		syntax_errors = 3,
+		execution_failed = 4 //the program has not finished, e.g. it has been halted or it kept reading past the end of input
+	};
+
+	/*Runs the program according to arguments following "run" on the command line and returns the exit code of the process.
+	Accepted arguments are [-O0 | -O1 | -O2] [-jit] [-mN] [-c8 | -c16 | -c32] [-v] file, where N is the number of memory cells,
+	-c selects the width of cells in bits (8 by default) and -v prints the emulator's informational messages to the standard error output.*/
+	[[nodiscard]]
+	int run(int argc, char const* const* argv);
+
+} //namespace bf::headless
+
+#endif
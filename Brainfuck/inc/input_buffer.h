@@ -0,0 +1,88 @@
+#ifndef INPUT_BUFFER_H
+#define INPUT_BUFFER_H
+#pragma once
+
+#include <cstddef>
+#include <istream>
+#include <iostream>
+#include <ios>
+#include <memory>
+#include <filesystem>
+
+namespace bf::execution {
+
+	/*Input of the emulated program owned by the emulator. Bytes are consumed from a window of contiguous memory, hence reading a byte
+	is a comparison and an increment in the common case. The window is supplied by one of three sources:
+		- a disk file mapped to memory as a whole; rewinding only resets the position within the mapping,
+		- a pipe, console or other descriptor that cannot be mapped; a background thread prefetches large chunks of it
+		  into a ring buffer, which cannot be rewound,
+		- a standard stream (e.g. the debugger's stdin or a string stream), read one byte at a time; the window is always empty.
+	The debugger's stdin is never prefetched, the debugger itself reads commands from it.*/
+	class input_buffer {
+		struct mapping;
+		struct prefetcher;
+
+		char const* position_ = nullptr; //next byte to consume
+		char const* end_ = nullptr; //end of the window of buffered bytes
+		char const* window_ = nullptr; //beginning of the window; the prefetcher learns the number of consumed bytes from it
+
+		std::istream* stream_ = &std::cin; //nullptr unless reading a standard stream
+		std::unique_ptr<mapping> mapping_;
+		std::shared_ptr<prefetcher> prefetcher_; //shared with the reader thread, which may outlive the buffer (it may be blocked in a read)
+
+		//Called when the window is exhausted. Returns the next byte or eof
+		[[nodiscard]]
+		int refill();
+
+		void close();
+
+	public:
+		input_buffer(); //reads the debugger's stdin
+		explicit input_buffer(std::istream& stream);
+		input_buffer(input_buffer&& other) noexcept;
+		input_buffer& operator=(input_buffer&& other) noexcept;
+		~input_buffer();
+
+		//Reads the given standard stream from now on
+		void attach(std::istream& stream);
+
+		/*Maps the given disk file and reads it from now on. Returns false and leaves the buffer unchanged if the file cannot be opened or mapped.*/
+		[[nodiscard]]
+		bool open_file(std::filesystem::path const& path);
+
+		/*Reads the given file descriptor from now on, starting at its current position. Regular files are mapped,
+		anything else is prefetched by a background thread. The descriptor must remain open while the buffer reads it.*/
+		void open_descriptor(int descriptor);
+
+		//Returns the next byte of input as an unsigned char converted to int, or eof if the input has ended
+		[[nodiscard]]
+		int get() {
+			if (position_ != end_)
+				return static_cast<unsigned char>(*position_++);
+			return refill();
+		}
+
+		/*Returns true iff the next byte can be read without waiting. Reading a standard stream may always wait,
+		the emulator thus flushes pending output, which may be a prompt, before it reads.*/
+		[[nodiscard]]
+		bool buffered() const { return position_ != end_; }
+
+		//Returns true iff the debugger's stdin is read
+		[[nodiscard]]
+		bool is_debugger_stdin() const { return stream_ == &std::cin; }
+
+		/*Returns the number of bytes consumed since the beginning of the input, or -1 if the input cannot be rewound
+		(the debugger's stdin and prefetched descriptors).*/
+		[[nodiscard]]
+		std::streamoff position() const;
+
+		/*Moves to the given position previously returned by position(). Returns false if the input cannot be rewound.*/
+		bool seek(std::streamoff position);
+
+		//Moves to the beginning of the input if possible; inputs that cannot be rewound are left as they are
+		void rewind();
+	};
+
+} //namespace bf::execution
+
+#endif
@@ -0,0 +1,100 @@
+#ifndef JIT_H
+#define JIT_H
+#pragma once
+
+#include "program_code.h"
+#include "cell.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+/*Just-in-time compiler translating the emulator's executable code to native x86-64 machine code.
+Every instruction of the flashed program gets its own region of native code, so that the execution may enter and leave
+the compiled code at any program counter. Instructions that the JIT does not translate (breakpoints, unknown ones)
+make the native code return to the emulator, which executes them and enters the native code again.
+Either the whole program or a region of it (e.g. a hot loop) is translated; jumps out of a region return to the emulator as well.*/
+namespace bf::execution::jit {
+
+#if defined(__x86_64__) || defined(_M_X64)
+	constexpr bool available = true;
+#else
+	constexpr bool available = false;
+#endif
+
+	//Reasons for which the native code returns control to the emulator
+	enum class exit_reason : std::int32_t {
+		poll,       //periodic check of CPU's flags or a request raised by a helper (e.g. end of input); resume if no flag is set
+		interpret,  //the instruction at the returned PC has to be executed by the emulator
+		finished,   //the program has executed its exit instruction
+		leave       //the instruction at the returned PC lies outside the translated region, the emulator continues from there
+	};
+
+	/*State shared by the native code and the emulator. The native code keeps the cell pointer and the instruction counter
+	in registers and writes them back here before it returns. Helpers are called to perform IO, searches and fills.
+	Cells are passed to helpers as pointers to their first byte, helpers know the width of cells they work with.*/
+	struct context {
+		unsigned char* cell_pointer_;
+		std::ptrdiff_t executed_instructions_;
+		std::ptrdiff_t poll_countdown_;   //number of backward jumps until the native code returns to check CPU's flags
+		exit_reason exit_reason_;
+
+		void* owner_; //object the helpers work for
+		//reads a character to the given cell; returns nonzero if the execution shall stop
+		int (*read_)(context*, unsigned char* cell);
+		//writes the given cell to output
+		void (*write_)(context*, unsigned char const* cell);
+		//searches for zero cell; returns nullptr if there is none
+		unsigned char* (*search_)(context*, unsigned char* from, std::ptrdiff_t stride);
+		//searches for zero cell clearing the cells on the way; always returns the found cell
+		unsigned char* (*clear_search_)(context*, unsigned char* from, std::ptrdiff_t stride);
+		//performs the fill_range instruction at the given address starting at the given cell
+		void (*fill_)(context*, unsigned char* first, std::ptrdiff_t address);
+	};
+
+	/*Native code generated for a single program. Owns the executable memory.*/
+	class compiled_program {
+		using entry_point_t = std::ptrdiff_t(*)(context*, std::ptrdiff_t);
+
+		void* memory_;
+		std::size_t size_;
+		entry_point_t entry_point_;
+		std::ptrdiff_t begin_, end_; //the translated region of code
+
+	public:
+		compiled_program(void* memory, std::size_t size, entry_point_t entry_point, std::ptrdiff_t begin, std::ptrdiff_t end)
+			: memory_{ memory }, size_{ size }, entry_point_{ entry_point }, begin_{ begin }, end_{ end } {}
+		~compiled_program();
+
+		compiled_program(compiled_program const&) = delete;
+		compiled_program& operator=(compiled_program const&) = delete;
+
+		/*Runs the native code starting at the instruction with given address, which must lie in the translated region, until it returns control.
+		Returns the address of the instruction which shall be executed next, context describes why the execution returned.*/
+		std::ptrdiff_t run(context& context, std::ptrdiff_t program_counter) const { return entry_point_(&context, program_counter); }
+
+		//Returns the number of bytes of generated machine code
+		[[nodiscard]]
+		std::size_t size() const { return size_; }
+
+		//Returns true iff the instruction at the given address has been translated
+		[[nodiscard]]
+		bool contains(std::ptrdiff_t const address) const { return begin_ <= address && address < end_; }
+	};
+
+	/*Translates the given executable code to native code operating on memory of given number of cells of given width
+	starting at the given address. The native code is specialized for the width. If unchecked_shifts is true, right_unchecked instructions are translated without the wraparound check.
+	Returns nullptr if the JIT is not available on this platform or the program cannot be compiled.*/
+	[[nodiscard]]
+	std::unique_ptr<compiled_program> compile(std::vector<instruction> const& code, unsigned char* memory,
+		std::ptrdiff_t memory_size, cell_width width, bool unchecked_shifts);
+
+	/*Translates only instructions at addresses from begin up to end, otherwise behaves as compile. The native code returns
+	with exit_reason::leave whenever the execution continues outside the region.*/
+	[[nodiscard]]
+	std::unique_ptr<compiled_program> compile_region(std::vector<instruction> const& code, std::ptrdiff_t begin, std::ptrdiff_t end,
+		unsigned char* memory, std::ptrdiff_t memory_size, cell_width width, bool unchecked_shifts);
+}
+
+#endif //JIT_H
@@ -0,0 +1,49 @@
+#ifndef MEMORY_KERNELS_H
+#define MEMORY_KERNELS_H
+#pragma once
+
+#include <cstddef>
+#include <optional>
+
+/*Low level routines operating on large ranges of the emulated memory. Where the target supports it, they are vectorized.
+They know nothing about the emulator itself, they only work with a contiguous array of cells. All of them are templates
+parametrized by the unsigned type of cells and are instantiated for the types of all supported cell widths.*/
+namespace bf::execution::kernels {
+
+	//Value returned by linear scans if they find no zero cell
+	constexpr std::ptrdiff_t npos = -1;
+
+	/*Scans cells tape[start], tape[start + stride], tape[start + 2*stride]... lying in range [start, size).
+	Returns the index of the first zero cell or npos if there is none. Stride must be positive.*/
+	template<typename CELL>
+	[[nodiscard]]
+	std::ptrdiff_t find_zero_right(CELL const* tape, std::ptrdiff_t size, std::ptrdiff_t start, std::ptrdiff_t stride);
+
+	/*Scans cells tape[start], tape[start - stride], tape[start - 2*stride]... lying in range [0, start].
+	Returns the index of the first zero cell or npos if there is none. Stride must be positive.*/
+	template<typename CELL>
+	[[nodiscard]]
+	std::ptrdiff_t find_zero_left(CELL const* tape, std::ptrdiff_t start, std::ptrdiff_t stride);
+
+	/*Performs the search for zero cell with the given (signed) stride starting at tape[start] exactly like a loop [>>>] or [<<] would,
+	including the wraparound at boundaries of the tape. Returns the index of found cell or an empty optional, if the search
+	visits all reachable cells without finding zero (the original loop would never terminate).*/
+	template<typename CELL>
+	[[nodiscard]]
+	std::optional<std::ptrdiff_t> find_zero(CELL const* tape, std::ptrdiff_t size, std::ptrdiff_t start, std::ptrdiff_t stride);
+
+	/*Sets count cells tape[start], tape[start + stride], tape[start + 2*stride]... to value, wrapping around the end of the tape
+	to its beginning. Stride must be positive. Contiguous cells are filled by memset, short strides by vector stores.*/
+	template<typename CELL>
+	void fill(CELL* tape, std::ptrdiff_t size, std::ptrdiff_t start, std::ptrdiff_t count, std::ptrdiff_t stride, CELL value);
+
+	/*Clears cells exactly like a loop [[-]>] or [[-]<<] would, i.e. performs the search for zero cell with the given (signed) stride
+	starting at tape[start] and zeroes every cell it leaves. Returns the index of the zero cell it stops at. Unlike the search,
+	it always terminates: if no other cell is zero, it returns to the cleared start cell.*/
+	template<typename CELL>
+	[[nodiscard]]
+	std::ptrdiff_t clear_to_zero(CELL* tape, std::ptrdiff_t size, std::ptrdiff_t start, std::ptrdiff_t stride);
+
+}
+
+#endif //MEMORY_KERNELS_H
@@ -2,11 +2,32 @@
 
 #include "program_code.h"
 #include "opt/optimizer_pass.h"
+#include "cell.h"
 #include <vector>
 
 namespace bf::opt {
 
-	DEFINE_PEEPHOLE_OPTIMIZER_PASS(local_const_propagator)
+	DEFINE_BLOCK_LOCAL_OPTIMIZER_PASS(local_const_propagator)
+
+	/*Propagates values of cells across basic blocks starting from the zeroed memory (see analysis::analyze_known_cells).
+	Conditional jumps whose condition is known are either removed or turned into unconditional jumps, which makes loops that are
+	never entered unreachable. Loads of constants to cells already holding them are turned into nops.
+
+	Returns the number of simplified jumps and eliminated loads. Only valid for memory of at least the given number of cells,
+	since the wrapping tape lets distant offsets address the same cell.*/
+	class global_const_propagator : public global_optimizer_pass {
+		std::ptrdiff_t const memory_size_;
+
+		std::ptrdiff_t do_optimize(std::vector<basic_block*>& program) const;
+
+	public:
+		explicit global_const_propagator(std::ptrdiff_t const memory_size)
+			: memory_size_{ memory_size } {}
+
+		std::ptrdiff_t optimize(std::vector<basic_block*>& program) override {
+			return do_optimize(program);
+		}
+	};
 
 	enum class arithmetic_tag {
 		pointer,	//Optimize shifts of the cell pointer
@@ -16,7 +37,21 @@ namespace bf::opt {
 
 
 	template<arithmetic_tag TAG>
-	DEFINE_PEEPHOLE_OPTIMIZER_PASS(arithmetic_simplifier)
+	DEFINE_BLOCK_LOCAL_OPTIMIZER_PASS(arithmetic_simplifier)
+
+	/*Removes shifts of the cell pointer from within the given basic block. Instructions executed while the pointer is
+	displaced are replaced by their offset-addressed forms (inc, load_const and write at [cpr + offset]) and the whole
+	movement of the pointer is performed by a single shift at the end of the block. Instructions without an offset-addressed
+	form are preceded by a shift which brings the pointer to the cell they operate on.
+	Shall be run after other peephole passes, since these only recognize instructions operating on the current cell.
+
+	Returns the number of eliminated shift instructions.*/
+	DEFINE_BLOCK_LOCAL_OPTIMIZER_PASS(pointer_folder)
+
+	/*Passes operating on basic blocks fold constants without any wraparound, since the width of cells is only known once
+	the executable code is generated. Reduces the constants of given executable instructions modulo 2^width. Increments and factors
+	of multiplications are reduced to the signed range of cells, loaded and filled constants to the unsigned one.*/
+	void fold_constants_for_cell_width(std::vector<instruction>::iterator first, std::vector<instruction>::iterator last, execution::cell_width width);
 
 
 
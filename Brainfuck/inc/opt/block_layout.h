@@ -0,0 +1,17 @@
+#pragma once
+
+#include "program_code.h"
+#include "profiler.h"
+#include <vector>
+
+namespace bf::opt {
+
+	/*Orders basic blocks of the program for code generation with respect to the profile of its previous runs.
+	Only edges to natural successors can fall through, therefore blocks are first joined into chains along
+	these edges, the hottest edges first, and then the chains are ordered by the executions of their hottest blocks.
+	The program's entry stays first and blocks never executed keep their original order at the end of the code.
+	Blocks absent from the profile are considered cold. With an empty profile the original layout is returned.*/
+	[[nodiscard]]
+	std::vector<basic_block*> profile_guided_layout(std::vector<basic_block*> const& layout, profiler::execution_profile const& profile);
+
+}
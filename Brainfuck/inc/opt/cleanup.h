@@ -15,7 +15,7 @@ namespace bf::opt {
 
 	DEFINE_PEEPHOLE_OPTIMIZER_PASS(block_merging);
 
-	DEFINE_PEEPHOLE_OPTIMIZER_PASS(nop_elimination);
+	DEFINE_BLOCK_LOCAL_OPTIMIZER_PASS(nop_elimination);
 
 	DEFINE_GLOBAL_OPTIMIZER_PASS(dead_code_elimination);
 
@@ -11,6 +11,24 @@ namespace bf::opt {
 	DEFINE_PEEPHOLE_OPTIMIZER_PASS(clear_loop_optimizer);
 	DEFINE_PEEPHOLE_OPTIMIZER_PASS(search_loop_optimizer);
 
+	/*Identifies loops that clear the loop cell and move the pointer by a constant, like [[-]>] or [[-]<<<], which are left after
+	clear loops have been optimized. Such loops are replaced by a single search clearing every cell it leaves.
+	Returns the number of eliminated loops.*/
+	DEFINE_PEEPHOLE_OPTIMIZER_PASS(clear_search_loop_optimizer);
+
+	/*Identifies balanced loops that decrement (or increment) the loop cell by one and add multiples of it to other cells,
+	like [->+>+++<<] or [-<+>]. Such loops are replaced by a sequence of mul_add instructions followed by clearing the loop cell.
+	Returns the number of eliminated loops.*/
+	DEFINE_PEEPHOLE_OPTIMIZER_PASS(multiplication_loop_optimizer);
+
+	/*Identifies runs of constant stores and shifts within a block, like the ones left after optimizing [-]>[-]>[-]> or >[-]<>>[-]<<,
+	and replaces stores of the same value to cells forming an arithmetic progression by a single fill_range instruction.
+	The remaining stores and a single shift by the run's pointer delta follow. Shall be run after clear loops have been
+	optimized and the pointer has been folded.
+
+	Returns the number of eliminated stores.*/
+	DEFINE_BLOCK_LOCAL_OPTIMIZER_PASS(fill_range_folder);
+
 
 	/*Eliminates all loops which have no observable side effects. Such loops perform no IO and don't move the cell pointer anywhere, they only
 	change the value of current cell. After this elimination, blocks that are no longer needed are removed and pointer connections between
@@ -24,7 +42,6 @@ namespace bf::opt {
 
 //TODO implement optimization of cond branches that have known incoming values
 
-//TODO all std::execution::par_unseq are now replaced by std::execution::seq for debugging
 /*Eliminates all loops which have no observable side effects. Such loops perform no IO and don't move the cell pointer anywhere, they only
 change the value of current cell. After this elimination, blocks that are no longer needed are removed and pointer connections between
 surrounding blocks are formed again.
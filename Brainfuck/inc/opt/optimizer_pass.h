@@ -3,22 +3,69 @@
 #include "program_code.h"
 
 #include <vector>
+#include <chrono>
+#include <map>
+#include <string>
 #include <execution>
 #include <numeric>
+#include <cstdint>
+#include <optional>
+#include <set>
+#include <string_view>
 
 namespace bf::opt {
 
-	enum class opt_level_t {
-		all = ~static_cast<std::underlying_type_t<opt_level_t>>(0),
+	/*Bitmask of optimizations. Each bit enables a group of related passes, levels are combinations thereof.*/
+	enum class opt_level_t : std::uint32_t {
+		none = 0,
+		op_folding = 1 << 0,         //folding of adjacent arithmetic instructions
+		const_propagation = 1 << 1,  //propagation of constants within and across basic blocks
+		loops = 1 << 2,              //replacement of clear, search, multiplication and infinite loops and folding of cleared ranges
+		jump_threading = 1 << 3,     //elimination of jumps to jumps and of conditions with known outcome
+		cleanup = 1 << 4,            //removal of nops, empty and dead blocks and merging of blocks
+		pointer_folding = 1 << 5,    //replacement of pointer shifts by offset-addressed instructions
+		write_folding = 1 << 6,      //folding of written constants into strings
+
+		O1 = op_folding | loops | cleanup,
+		O2 = O1 | const_propagation | jump_threading | pointer_folding | write_folding,
+		all = ~static_cast<std::uint32_t>(0)
 	};
 
+	[[nodiscard]]
+	constexpr opt_level_t operator|(opt_level_t const lhs, opt_level_t const rhs) {
+		return static_cast<opt_level_t>(static_cast<std::uint32_t>(lhs) | static_cast<std::uint32_t>(rhs));
+	}
+
+	//Returns true iff all optimizations of the given level are enabled in the bitmask
+	[[nodiscard]]
+	constexpr bool includes(opt_level_t const mask, opt_level_t const level) {
+		return (static_cast<std::uint32_t>(mask) & static_cast<std::uint32_t>(level)) == static_cast<std::uint32_t>(level);
+	}
+
 	/*Get optimization bitmask from its name.*/
 	[[nodiscard]]
 	std::optional<opt_level_t> get_opt_by_name(std::string_view optimization_name);
 
-	void perform_optimizations(std::vector<std::unique_ptr<basic_block>>& program, std::set<opt_level_t> const& optimizations);
+	/*Number of changes made by an optimizer pass and the time spent in it. Block-local passes run on many blocks concurrently,
+	their time is the sum over all threads.*/
+	struct pass_statistics {
+		std::ptrdiff_t changes_ = 0;
+		std::chrono::nanoseconds time_{ 0 };
+	};
+
+	//Statistics of optimizer passes keyed by their names
+	using optimization_statistics = std::map<std::string, pass_statistics>;
+
+	/*Runs all passes enabled by the requested optimizations until the program stops changing.
+	Passes are only rerun on blocks that changed or whose neighbours changed, which keeps the work proportional to the number of changes.
+	Settled blocks are known to be optimized already, they are only visited once a change of some other block reaches them.
+	The optimized program is only valid in memory of at least memory_size cells.
+	Returns statistics of all scheduled passes, which are printed as well unless quiet is set.*/
+	optimization_statistics perform_optimizations(std::vector<std::unique_ptr<basic_block>>& program, std::set<opt_level_t> const& optimizations,
+		std::ptrdiff_t memory_size, bool quiet = false, std::set<basic_block const*> const& settled = {});
 
 	struct global_optimizer_pass {
+		virtual ~global_optimizer_pass() = default;
 		virtual std::ptrdiff_t optimize(std::vector<basic_block*>&) = 0;
 	};
 
@@ -26,6 +73,10 @@ namespace bf::opt {
 
 		virtual std::ptrdiff_t optimize(basic_block*) = 0;
 		virtual std::ptrdiff_t optimize(std::vector<basic_block*>&) = 0;
+
+		//Returns true iff the pass touches nothing but instructions of the optimized block and may therefore run on many blocks in parallel
+		[[nodiscard]]
+		virtual bool is_block_local() const = 0;
 	};
 
 	/*Initialize CLI commands that control the function of optimizer.
@@ -45,14 +96,14 @@ class name : public global_optimizer_pass {																							\
 	}																																\
 };																																	
 
-#define DEFINE_PEEPHOLE_OPTIMIZER_PASS(name)																						\
+#define DEFINE_PEEPHOLE_OPTIMIZER_PASS_IMPL(name, policy, block_local)																\
 																																	\
 class name : public peephole_optimizer_pass {																						\
 																																	\
 	static std::ptrdiff_t do_optimize(basic_block*);																				\
 																																	\
 	static std::ptrdiff_t do_optimize(std::vector<basic_block*>& program) {															\
-		return std::transform_reduce(std::execution::seq, program.begin(), program.end(), std::ptrdiff_t{ 0 },						\
+		return std::transform_reduce(policy, program.begin(), program.end(), std::ptrdiff_t{ 0 },									\
 			std::plus{}, static_cast<std::ptrdiff_t(*)(basic_block*)>(do_optimize));												\
 	}																																\
 																																	\
@@ -62,4 +113,14 @@ class name : public peephole_optimizer_pass {																						\
 	std::ptrdiff_t optimize(std::vector<basic_block*>& program) override {															\
 		return do_optimize(program);																								\
 	}																																\
-};
\ No newline at end of file
+	bool is_block_local() const override {																							\
+		return block_local;																											\
+	}																																\
+};
+
+/*Defines a peephole pass that may modify the control flow graph. Such passes are always run serially.*/
+#define DEFINE_PEEPHOLE_OPTIMIZER_PASS(name) DEFINE_PEEPHOLE_OPTIMIZER_PASS_IMPL(name, std::execution::seq, false)
+
+/*Defines a peephole pass that only modifies instructions of the block it is given and reads nothing but these instructions
+(and thread-safe global state like the constant pool). Such passes are run on multiple blocks concurrently.*/
+#define DEFINE_BLOCK_LOCAL_OPTIMIZER_PASS(name) DEFINE_PEEPHOLE_OPTIMIZER_PASS_IMPL(name, std::execution::par, true)
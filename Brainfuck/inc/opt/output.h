@@ -0,0 +1,17 @@
+#pragma once
+
+#include "program_code.h"
+#include "opt/optimizer_pass.h"
+#include <vector>
+
+namespace bf::opt {
+
+	/*Identifies runs of writes of cells whose values are known constants, like the sequences of load_const and write
+	generated for banners and tables. Each run of at least two writes is replaced by a single write_string instruction referring
+	to the constant pool, followed by loads of the final values of all cells the run had assigned.
+	Shall be run after const propagation, which turns arithmetic on known cells into load_consts.
+
+	Returns the number of eliminated writes.*/
+	DEFINE_BLOCK_LOCAL_OPTIMIZER_PASS(write_string_folder);
+
+}
@@ -0,0 +1,29 @@
+#pragma once
+
+#include "program_code.h"
+#include "cell.h"
+#include <vector>
+#include <cstddef>
+
+namespace bf::opt {
+
+	//default maximal number of instructions executed at compile time
+	constexpr std::ptrdiff_t default_prefix_evaluation_budget = 50'000'000;
+
+	/*Returns the number of instructions the prefix evaluation may execute at compile time. Zero disables the evaluation.*/
+	[[nodiscard]]
+	std::ptrdiff_t& prefix_evaluation_budget();
+
+	/*Since memory starts zeroed, a program behaves deterministically until it reads input for the first time.
+	Executes the given executable code at compile time until it reaches the first read (or an instruction it cannot evaluate)
+	or executes step_budget instructions. The evaluated prefix is then replaced by code that stores the resulting image of memory,
+	writes the output produced so far using a single write_string, moves the cell pointer and jumps to the instruction at which
+	the evaluation stopped. The original code follows unchanged except for relocated jump destinations.
+	Memory consists of cells of the given width, the stored image is therefore only valid for cells of the same width.
+
+	Returns the given code unchanged if nothing could be evaluated.*/
+	[[nodiscard]]
+	std::vector<instruction> evaluate_io_free_prefix(std::vector<instruction> code, std::ptrdiff_t memory_size,
+		execution::cell_width width, std::ptrdiff_t step_budget);
+
+}
@@ -0,0 +1,80 @@
+#pragma once
+#ifndef PROFILER_H
+#define PROFILER_H
+
+#include "program_code.h"
+
+#include <cstddef>
+#include <map>
+#include <optional>
+#include <string>
+#include <vector>
+
+/*Profiling of executed programs. The emulator only counts taken jumps; since control flow may only enter a basic block through
+a jump or by falling through from the preceding block, executions of all blocks can be derived from these counts afterwards.*/
+namespace bf::profiler {
+
+	/*Profile of a single loop of the executed program, i.e. of the code between a backward conditional jump and its destination.*/
+	struct loop_profile {
+		source_location begin_; //location of the loop's first instruction
+		source_location end_; //location of the jump closing the loop
+		std::ptrdiff_t iterations_; //number of executions of the loop's body
+		std::ptrdiff_t executed_instructions_; //instructions executed within the loop including all nested loops
+	};
+
+	/*Profile of a program keyed by source locations instead of addresses. Locations survive recompilation of the same source
+	with different optimizations, which allows to use the profile of one build to guide optimizations of another.*/
+	struct execution_profile {
+		std::map<source_location, std::ptrdiff_t> executions_; //the highest number of executions of instructions originating at each location
+		std::map<source_location, std::ptrdiff_t> taken_jumps_; //the highest number of times conditional jumps at each location had been taken
+
+		//Returns the number of executions of instructions originating at the location, zero if there are none in the profile
+		[[nodiscard]]
+		std::ptrdiff_t executions(source_location const loc) const {
+			auto const found = executions_.find(loc);
+			return found == executions_.end() ? 0 : found->second;
+		}
+
+		//Returns the number of times the conditional jump at the location had been taken, zero if there is none in the profile
+		[[nodiscard]]
+		std::ptrdiff_t taken(source_location const loc) const {
+			auto const found = taken_jumps_.find(loc);
+			return found == taken_jumps_.end() ? 0 : found->second;
+		}
+	};
+
+	/*Returns the number of executions of each instruction of the code, which equals the number of executions of its basic block.
+	Taken_jumps hold the number of times each jump has been taken, runs the number of executions started at the program's entry.*/
+	[[nodiscard]]
+	std::vector<std::ptrdiff_t> instruction_executions(std::vector<instruction> const& code, std::vector<std::ptrdiff_t> const& taken_jumps, std::ptrdiff_t runs);
+
+	/*Returns profiles of all loops of the code ordered by the number of instructions executed within them, the hottest first.*/
+	[[nodiscard]]
+	std::vector<loop_profile> hottest_loops(std::vector<instruction> const& code, std::vector<std::ptrdiff_t> const& taken_jumps, std::ptrdiff_t runs);
+
+	/*Converts the profile of the code given by counts of taken jumps and runs to a profile keyed by source locations.*/
+	[[nodiscard]]
+	execution_profile collect(std::vector<instruction> const& code, std::vector<std::ptrdiff_t> const& taken_jumps, std::ptrdiff_t runs);
+
+	/*Returns the textual representation of the profile, which is stored in profile files.*/
+	[[nodiscard]]
+	std::string to_text(execution_profile const& profile);
+
+	/*Writes the profile to the file. Returns false if the file cannot be written.*/
+	[[nodiscard]]
+	bool save(std::string const& file_name, execution_profile const& profile);
+
+	/*Reads the profile from a file created by save. Returns an empty optional if the file does not exist or it is malformed.*/
+	[[nodiscard]]
+	std::optional<execution_profile> load(std::string const& file_name);
+
+	/*Returns the profile guiding the optimizations of programs, an empty optional if no profile shall be used.*/
+	[[nodiscard]]
+	std::optional<execution_profile>& active_profile();
+
+	/*Function initializing cli commands. Shall be called only once from main.*/
+	void initialize();
+
+} //namespace bf::profiler
+
+#endif
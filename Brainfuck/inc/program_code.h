@@ -1,6 +1,6 @@
 #pragma once
-#include "basic_block.h"
-#include "instruction.h"
+#include "IR/basic_block.h"
+#include "IR/instruction.h"
 #include "utils.h"
 
 
@@ -15,7 +15,11 @@
 
 namespace bf {
 
-
+	using IR::op_code;
+	using IR::instruction;
+	using IR::basic_block;
+	using IR::constant_string;
+	using IR::intern_constant;
 
 	class program_code {
 
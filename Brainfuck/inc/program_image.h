@@ -0,0 +1,68 @@
+#pragma once
+#ifndef PROGRAM_IMAGE_H
+#define PROGRAM_IMAGE_H
+
+#include "program_code.h"
+#include "cell.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <vector>
+
+/*Binary images of executable code. An image stores the instructions exactly as they are laid out in memory,
+followed by the part of the constant pool they refer to, therefore loading an image amounts to mapping the file
+and copying the instructions to the emulator without any parsing. Images are only portable between builds with
+identical layout of instructions; the header records enough information to reject images of other builds.*/
+namespace bf::image {
+
+	/*Executable code loaded from an image together with the size of memory and the width of cells it had been generated for.*/
+	struct loaded_image {
+		std::vector<instruction> code_;
+		std::ptrdiff_t memory_size_;
+		execution::cell_width cell_width_;
+	};
+
+	/*Writes the executable code generated for memory of the given size and width of cells to a file. The key is stored as well and
+	allows to recognize images in the cache. Returns false if the file cannot be written.*/
+	[[nodiscard]]
+	bool save(std::string const& file_name, std::vector<instruction> const& code, std::ptrdiff_t memory_size,
+		execution::cell_width width, std::string_view key = {});
+
+	/*Loads an image from the file. If the key is given, the image is only accepted if it had been saved with the same key.
+	Returns an empty optional if the file does not exist, it is not a valid image or the key differs.*/
+	[[nodiscard]]
+	std::optional<loaded_image> load(std::string const& file_name, std::optional<std::string_view> key = std::nullopt);
+
+	/*Returns 64bit hash of given bytes. Used to identify sources and programs in the cache.*/
+	[[nodiscard]]
+	std::uint64_t hash(std::string_view bytes);
+
+	/*Compiled programs are cached on disk in images identified by a key describing the source code and all transformations
+	applied to it. When the cache is enabled, compilation and optimization are deferred until the code is needed and skipped
+	altogether if the cache contains its image.*/
+	namespace cache {
+
+		//Returns true iff the cache is enabled. Disabled by default
+		[[nodiscard]]
+		bool& enabled();
+
+		//Returns the image cached under the given key, if there is any
+		[[nodiscard]]
+		std::optional<loaded_image> lookup(std::string_view key);
+
+		//Stores the image in the cache under the given key. Failures are silently ignored, the cache is only an optimization
+		void store(std::string_view key, std::vector<instruction> const& code, std::ptrdiff_t memory_size, execution::cell_width width);
+
+		//Removes all cached images. Returns the number of removed files
+		std::ptrdiff_t clear();
+	}
+
+	/*Function initializing cli commands. Shall be called only once from main.*/
+	void initialize();
+
+} //namespace bf::image
+
+#endif
@@ -1,5 +1,7 @@
 #pragma once
 
+#include <ostream>
+
 namespace bf {
 
 	struct source_location {
@@ -15,7 +17,12 @@ namespace bf {
 	/*Relational operator for source locations. If the lines are same, the smaller location is identified by lower column.
 	Otherwise orderes errors by line numbers. */
 	[[nodiscard]]
-	bool operator<(source_location const& lhs, source_location const& rhs) noexcept {
+	inline bool operator<(source_location const& lhs, source_location const& rhs) noexcept {
 		return lhs.line_ != rhs.line_ ? lhs.line_ < rhs.line_ : lhs.column_ < rhs.column_;
 	}
+
+	/*Standard stream output operator for source locations. Prints them as line:column.*/
+	inline std::ostream& operator<<(std::ostream& str, source_location const& loc) {
+		return str << loc.line_ << ':' << loc.column_;
+	}
 }
\ No newline at end of file
@@ -0,0 +1,64 @@
+#pragma once
+#ifndef STATS_H
+#define STATS_H
+
+#include "opt/optimizer_pass.h"
+
+#include <chrono>
+#include <cstddef>
+#include <functional>
+#include <string_view>
+
+/*Timing instrumentation of cli commands. A command prefixed by "time", or any command while the "stats" mode is on, is measured:
+the compiler reports the time spent in its phases, the optimizer the statistics of its passes and the emulator every execution
+of the program for as long as the command runs. The report is printed after the command finishes and may be appended to a JSON file
+as well. Measurements belong to the thread running the command, work of other threads (e.g. of batch jobs) is not reported.*/
+namespace bf::stats {
+
+	using clock = std::chrono::steady_clock;
+
+	//Returns true iff the calling thread is measuring a command, i.e. iff recorded measurements are kept
+	[[nodiscard]]
+	bool measuring();
+
+	//Returns true iff the "stats" mode is on, i.e. iff every command shall be measured
+	[[nodiscard]]
+	bool measuring_every_command();
+
+	/*Measures the command executed by the given function, prints the report and appends it to the JSON file, if one is chosen.
+	Returns the value returned by the function. Commands executed while another one is being measured belong to that measurement.*/
+	int measure(std::string_view command, std::function<int()> const& execute);
+
+	//Adds the time spent in the named phase to the measured command. Phases are reported in the order they have first been entered
+	void record_phase(std::string_view phase, clock::duration time);
+
+	//Adds the statistics of optimizer passes run by the measured command
+	void record_passes(opt::optimization_statistics const& passes);
+
+	//Adds an execution of the emulated program, which has executed the given number of instructions and transferred the given number of bytes
+	void record_execution(std::ptrdiff_t instructions, clock::duration time, std::size_t input_bytes, std::size_t output_bytes);
+
+	/*Records the time between its construction and destruction as a phase of the measured command. Does not read the clock
+	unless a command is being measured.*/
+	class phase_timer {
+		std::string_view const phase_;
+		clock::time_point const start_;
+
+	public:
+		explicit phase_timer(std::string_view const phase) : phase_{ phase }, start_{ measuring() ? clock::now() : clock::time_point{} } {}
+
+		~phase_timer() {
+			if (measuring())
+				record_phase(phase_, clock::now() - start_);
+		}
+
+		phase_timer(phase_timer const&) = delete;
+		phase_timer& operator=(phase_timer const&) = delete;
+	};
+
+	/*Function initializing cli commands. Shall be called only once from main.*/
+	void initialize();
+
+} //namespace bf::stats
+
+#endif
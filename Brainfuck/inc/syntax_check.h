@@ -5,6 +5,8 @@
 #include <string>
 #include <vector>
 #include <string_view>
+#include <cstdint>
+#include <cstddef>
 
 namespace bf {
 
@@ -33,5 +35,51 @@ namespace bf {
 	when only the validity of syntax is in question but specific errors are not requested. */
 	[[nodiscard]]
 	std::vector<syntax_error> syntax_validation_detailed(std::string_view source_code);
+
+	/*Summary of a part of source code, from which parts scanned independently of each other (e.g. by different threads)
+	are placed within the whole source code and checked for matching brackets. Depths are relative to the beginning of the part.*/
+	struct source_summary {
+		std::size_t newlines_ = 0; //number of line breaks
+		std::size_t last_newline_ = static_cast<std::size_t>(-1); //position of the last line break within the part, -1 if there is none
+		std::ptrdiff_t depth_ = 0; //number of opening brackets minus the number of closing ones
+		std::ptrdiff_t min_depth_ = 0; //the lowest depth reached within the part; negative iff it closes loops opened before it
+	};
+
+	/*Classifies the part of source code by the vectorized classifier and summarizes its line breaks and brackets.*/
+	[[nodiscard]]
+	source_summary summarize_source(std::string_view part);
+
+	/*Bitmaps of positions of the eight command characters and of line breaks within a source code, computed by a vectorized
+	classifier processing 16 or 32 bytes at a time. Bracket balance is checked during the classification as well.
+	Allows the compiler to visit commands only, skipping comments in big strides. The source code must outlive the bitmap.*/
+	class command_bitmap {
+
+		std::vector<std::uint64_t> commands_; //bit i of word w is set iff source_code[64*w + i] is a command
+		std::vector<std::uint64_t> newlines_; //the same for '\n'
+		std::size_t size_;
+		bool brackets_match_;
+
+		[[nodiscard]]
+		static std::size_t next_set_bit(std::vector<std::uint64_t> const& bitmap, std::size_t position, std::size_t size);
+
+	public:
+		//Value returned by searches if there is no following command or line break
+		static constexpr std::size_t npos = static_cast<std::size_t>(-1);
+
+		explicit command_bitmap(std::string_view source_code);
+
+		//Returns true iff all brackets in the source code are matched, i.e. iff the source code is syntactically valid
+		[[nodiscard]]
+		bool brackets_match() const { return brackets_match_; }
+
+		//Returns the position of the first command at or after the given position, or npos if there is none
+		[[nodiscard]]
+		std::size_t next_command(std::size_t const position) const { return next_set_bit(commands_, position, size_); }
+
+		//Returns the position of the first line break at or after the given position, or npos if there is none
+		[[nodiscard]]
+		std::size_t next_newline(std::size_t const position) const { return next_set_bit(newlines_, position, size_); }
+	};
+
 } //namespace bf
 
@@ -0,0 +1,132 @@
+#ifndef TAPE_H
+#define TAPE_H
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+namespace bf::execution {
+
+	class write_tracker;
+
+	/*Contents of a tape captured by tape::take_snapshot. A snapshot only stores pages written since the tape was derived from its parent,
+	i.e. since the parent had been taken or restored. The zeroed tape is the root of all snapshots and is represented by nullptr.*/
+	class tape_snapshot {
+		friend class tape;
+
+		std::shared_ptr<tape_snapshot const> parent_;
+		std::uint64_t mapping_id_; //snapshots can only be restored to the mapping they have been taken from
+		std::vector<std::size_t> pages_; //sorted indices of stored pages
+		std::vector<unsigned char> contents_; //contents of stored pages in the order of pages_
+
+	public:
+		//Returns the number of pages stored by this snapshot itself
+		[[nodiscard]]
+		std::size_t page_count() const { return pages_.size(); }
+	};
+
+	/*Data memory of the emulated CPU. Its bytes are stored in a region of virtual memory obtained directly from the operating system
+	(mmap or VirtualAlloc) which is surrounded by inaccessible guard pages. Any access that strays past the tape's boundaries
+	therefore faults immediately instead of silently corrupting the emulator's own memory. Freshly mapped pages are zeroed by the OS.
+	Once the first snapshot is taken, writes are tracked at the granularity of pages. Pages are kept read-only until they are written,
+	the first write faults and marks the page dirty (write watching of the OS is used on Windows instead).
+	The tape is unaware of the width of cells, the emulator interprets its bytes as cells of the chosen width.*/
+	class tape {
+		friend class write_tracker;
+
+	public:
+		using byte_t = unsigned char;
+
+		//number of bytes a newly constructed tape has; also the default number of cells of the emulator's memory
+		static constexpr std::ptrdiff_t default_size = 30'000;
+
+	private:
+		byte_t* bytes_ = nullptr;
+		std::ptrdiff_t size_ = 0;
+
+		void* mapping_ = nullptr; //beginning of the whole mapped region including both guards
+		std::size_t mapping_size_ = 0;
+		std::size_t guard_size_ = 0;
+		std::uint64_t mapping_id_ = 0; //unique for each mapping, identifies the origin of snapshots
+
+		bool tracking_ = false; //true iff writes are being tracked
+		std::vector<unsigned char> dirty_; //one flag per page, set if the page has been written since base_
+		std::vector<std::size_t> dirty_pages_; //indices of dirty pages; capacity for all pages is reserved, the fault handler never allocates
+		std::shared_ptr<tape_snapshot const> base_; //snapshot the contents derive from, nullptr if they derive from the zeroed tape
+
+		void map(std::ptrdiff_t size);
+		void unmap();
+
+		//Returns the number of pages between the guards
+		[[nodiscard]]
+		std::size_t page_count() const { return mapping_size_ / guard_size_ - 2; }
+
+		//Starts tracking of writes. The current contents become the base, they are captured by the first snapshot
+		void start_tracking();
+		void stop_tracking();
+
+		//Returns sorted indices of pages written since the last call to clean_pages
+		[[nodiscard]]
+		std::vector<std::size_t> written_pages() const;
+
+		//Makes the given sorted pages clean, so that their next write is tracked again
+		void clean_pages(std::vector<std::size_t> const& pages);
+
+		//Makes the given sorted pages writable without tracking the writes
+		void unprotect_pages(std::vector<std::size_t> const& pages);
+
+		//Called by the fault handler. Marks the page containing the given address dirty and returns true, if it belongs to this tape
+		bool mark_written(void const* address) noexcept;
+
+	public:
+		explicit tape(std::ptrdiff_t size = default_size);
+		~tape();
+
+		tape(tape const&) = delete;
+		tape& operator=(tape const&) = delete;
+
+		/*Discards the current contents and maps a new zeroed region for size bytes. Throws std::bad_alloc on failure,
+		in which case the tape keeps its original contents.*/
+		void resize(std::ptrdiff_t size);
+
+		/*Sets all bytes to zero.*/
+		void clear();
+
+		/*Captures the current contents. Only pages written since the tape has been derived from the previous snapshot are copied,
+		the cost is therefore proportional to the memory modified in the meantime. Only the first snapshot of a mapping scans all pages.*/
+		[[nodiscard]]
+		std::shared_ptr<tape_snapshot const> take_snapshot();
+
+		/*Replaces the contents by the captured ones. Only pages which may differ, i.e. pages written since the current contents' base
+		and pages stored by either snapshot or their ancestors, are copied. Returns false if the snapshot comes from a different mapping,
+		e.g. if the tape has been resized since.*/
+		bool restore(std::shared_ptr<tape_snapshot const> const& snapshot);
+
+		[[nodiscard]]
+		byte_t* data() { return bytes_; }
+		[[nodiscard]]
+		byte_t const* data() const { return bytes_; }
+
+		[[nodiscard]]
+		std::ptrdiff_t size() const { return size_; }
+
+		[[nodiscard]]
+		byte_t* begin() { return bytes_; }
+		[[nodiscard]]
+		byte_t const* begin() const { return bytes_; }
+
+		[[nodiscard]]
+		byte_t* end() { return bytes_ + size_; }
+		[[nodiscard]]
+		byte_t const* end() const { return bytes_ + size_; }
+
+		//size of the guard region on either side of the tape in bytes
+		[[nodiscard]]
+		std::size_t guard_size() const { return guard_size_; }
+	};
+
+}
+
+#endif //TAPE_H
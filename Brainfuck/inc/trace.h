@@ -0,0 +1,26 @@
+#pragma once
+#ifndef TRACE_H
+#define TRACE_H
+
+#include "program_code.h"
+#include "emulator.h"
+
+#include <cstddef>
+#include <ostream>
+#include <vector>
+
+/*Execution traces of emulated programs. While tracing, the emulator records the address, CPR and the value of the current cell
+of every executed instruction into a ring buffer of a fixed size. Records are only decoded when they are shown or dumped:
+addresses are then mapped to source locations and mnemonics of the flashed program.*/
+namespace bf::trace {
+
+	/*Writes count held steps of the trace starting at the given index (the oldest step has index zero) to the stream, one per line.
+	Steps are decoded with respect to the given code, which shall be the flashed program with breakpoints replaced by original instructions.*/
+	void print_steps(std::ostream& stream, execution::trace_buffer const& trace, std::vector<instruction> const& code, std::size_t first, std::size_t count);
+
+	/*Function initializing cli commands. Shall be called only once from main.*/
+	void initialize();
+
+} //namespace bf::trace
+
+#endif
@@ -10,6 +10,8 @@
 #include <vector>
 #include <algorithm>
 #include <cassert>
+#include <utility>
+#include <string>
 
 //Defines static local boolean and asserts that the code is run just once
 #define ASSERT_IS_CALLED_ONLY_ONCE static bool _____first_time___ = true; assert(_____first_time___); _____first_time___ = false;
@@ -62,6 +64,41 @@ namespace bf::utils {
 	[[nodiscard]]
 	std::optional<std::string> read_file(std::string_view file_name);
 
+	/*Read-only memory mapping of a whole file. Its content is accessible as a string_view without being copied,
+	the operating system loads the pages lazily and may drop them again under memory pressure.
+	The mapping is released when the object is destroyed, therefore views of the content must not outlive it.*/
+	class mapped_file {
+
+		char const* data_ = nullptr;
+		std::size_t size_ = 0;
+
+		mapped_file(char const* const data, std::size_t const size)
+			: data_{ data }, size_{ size } {}
+
+	public:
+		/*Maps the file with given name to memory. If file_name does not specify a valid path to file
+		or the mapping cannot be created, empty std::optional is returned.*/
+		[[nodiscard]]
+		static std::optional<mapped_file> open(std::string_view file_name);
+
+		mapped_file(mapped_file const&) = delete;
+		mapped_file& operator=(mapped_file const&) = delete;
+
+		mapped_file(mapped_file&& other) noexcept
+			: data_{ std::exchange(other.data_, nullptr) }, size_{ std::exchange(other.size_, 0) } {}
+
+		mapped_file& operator=(mapped_file&& other) noexcept {
+			std::swap(data_, other.data_);
+			std::swap(size_, other.size_);
+			return *this;
+		}
+
+		~mapped_file();
+
+		[[nodiscard]]
+		std::string_view view() const { return { data_, size_ }; }
+	};
+
 	/*Prompts the user for an answer to a yes/no question.
 	Returns true if user agrees, false otherwise*/
 	[[nodiscard]]
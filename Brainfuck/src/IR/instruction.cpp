@@ -1,6 +1,12 @@
 #include "IR/instruction.h"
 
 #include <map>
+#include <ostream>
+#include <mutex>
+#include <array>
+#include <atomic>
+#include <memory>
+#include <algorithm>
 #include <cassert>
 
 namespace bf::IR {
@@ -15,13 +21,23 @@ namespace bf::IR {
 			{op_code::right,			   "right"s},
 			{op_code::left,			        "left"s},
 			{op_code::branch,	              "br"s},
+			{op_code::right_unchecked,   "right_u"s},
 			{op_code::branch_nz,           "br_nz"s},
 			{op_code::read,				    "read"s},
 			{op_code::write,		       "write"s},
-			{op_code::search,             "search"s},
+			{op_code::search_right,     "search_r"s},
+			{op_code::search_left,      "search_l"s},
+			{op_code::clear_search_right, "clear_search_r"s},
+			{op_code::clear_search_left,  "clear_search_l"s},
 			{op_code::infinite,         "inf_when"s},
 			{op_code::breakpoint,     "breakpoint"s},
 			{op_code::load_const,     "load_const"s},
+			{op_code::inc_offset,        "inc_off"s},
+			{op_code::load_const_offset, "load_const_off"s},
+			{op_code::write_offset,      "write_off"s},
+			{op_code::mul_add,             "mul_add"s},
+			{op_code::write_string,      "write_str"s},
+			{op_code::fill_range,       "fill_range"s},
 			{op_code::program_exit,         "exit"s},
 			{op_code::program_entry,       "entry"s}
 		};
@@ -34,4 +50,97 @@ namespace bf::IR {
 		return str << get_mnemonic(code);
 	}
 
+	std::ostream& operator<<(std::ostream& str, instruction const& inst) {
+		str << inst.op_code_ << ' ';
+		auto const target = [&str](std::ptrdiff_t const offset) -> std::ostream& {
+			return str << "[cpr" << std::showpos << offset << std::noshowpos << ']';
+		};
+		switch (inst.op_code_) {
+		case op_code::write_offset:
+			return target(inst.offset_);
+		case op_code::inc_offset:
+		case op_code::load_const_offset:
+		case op_code::mul_add: //argument is the amount, the value or the factor respectively
+			return target(inst.offset_) << ' ' << inst.argument_;
+		case op_code::branch:
+		case op_code::branch_nz:
+			return str << inst.destination_;
+		case op_code::fill_range:
+			return target(inst.offset_) << ' ' << inst.argument_ << " count " << inst.destination_ << " stride " << inst.stride_;
+		default:
+			return str << inst.argument_;
+		}
+	}
+
+	namespace {
+
+		/*Append-only storage of the constant pool. Chunk i holds first_chunk_size << i characters and is never reallocated, hence
+		strings may be read by some threads while others intern new ones. Offsets address the concatenation of all chunks; a string
+		never spans two chunks, the rest of a chunk is left unused when the next string does not fit in it.*/
+		class constant_storage {
+			static constexpr std::size_t first_chunk_size = std::size_t{ 1 } << 12;
+			static constexpr std::size_t max_chunks = 40;
+
+			std::array<std::atomic<char*>, max_chunks> chunks_{}; //read without the lock, published once the chunk is allocated
+			std::array<std::unique_ptr<char[]>, max_chunks> owned_chunks_;
+			std::array<std::size_t, max_chunks> used_{}; //number of characters used in each chunk
+			std::size_t chunk_count_ = 0;
+			std::mutex mutex_; //serializes interning, which is the only writer
+
+			[[nodiscard]]
+			static constexpr std::size_t chunk_size(std::size_t const chunk) { return first_chunk_size << chunk; }
+
+			[[nodiscard]]
+			static constexpr std::size_t chunk_begin(std::size_t const chunk) { return chunk_size(chunk) - first_chunk_size; }
+
+		public:
+			[[nodiscard]]
+			std::string_view get(std::size_t const offset, std::size_t const length) const {
+				if (length == 0)
+					return {};
+				std::size_t chunk = 0;
+				while (chunk_begin(chunk + 1) <= offset)
+					++chunk;
+				char const* const data = chunks_[chunk].load(std::memory_order_acquire);
+				assert(data && offset - chunk_begin(chunk) + length <= chunk_size(chunk));
+				return { data + (offset - chunk_begin(chunk)), length };
+			}
+
+			[[nodiscard]]
+			std::size_t intern(std::string_view const str) {
+				std::scoped_lock const lock{ mutex_ };
+				for (std::size_t chunk = 0; chunk < chunk_count_; ++chunk)
+					if (std::size_t const found = std::string_view{ owned_chunks_[chunk].get(), used_[chunk] }.find(str); found != std::string_view::npos)
+						return chunk_begin(chunk) + found;
+
+				while (chunk_count_ == 0 || used_[chunk_count_ - 1] + str.size() > chunk_size(chunk_count_ - 1)) {
+					assert(chunk_count_ < max_chunks);
+					owned_chunks_[chunk_count_] = std::make_unique<char[]>(chunk_size(chunk_count_));
+					chunks_[chunk_count_].store(owned_chunks_[chunk_count_].get(), std::memory_order_release);
+					++chunk_count_;
+				}
+				std::size_t const chunk = chunk_count_ - 1;
+				std::copy(str.begin(), str.end(), owned_chunks_[chunk].get() + used_[chunk]);
+				used_[chunk] += str.size();
+				return chunk_begin(chunk) + used_[chunk] - str.size();
+			}
+		};
+
+		[[nodiscard]]
+		constant_storage& constant_pool() {
+			static constant_storage pool;
+			return pool;
+		}
+
+	} //namespace bf::IR::`anonymous`
+
+	std::string_view constant_string(std::ptrdiff_t const offset, std::ptrdiff_t const length) {
+		assert(offset >= 0 && length >= 0);
+		return constant_pool().get(static_cast<std::size_t>(offset), static_cast<std::size_t>(length));
+	}
+
+	std::ptrdiff_t intern_constant(std::string_view const str) {
+		return static_cast<std::ptrdiff_t>(constant_pool().intern(str));
+	}
+
 }
\ No newline at end of file
@@ -0,0 +1,82 @@
+#include "IR/packed_instruction.h"
+
+#include <limits>
+
+namespace bf::IR {
+
+	namespace {
+
+		template<typename T>
+		[[nodiscard]]
+		constexpr bool fits(std::ptrdiff_t const value) {
+			return value >= std::numeric_limits<T>::min() && value <= std::numeric_limits<T>::max();
+		}
+
+		//Returns the value modulo 2^32, which determines the effect of the value on cells of any width
+		[[nodiscard]]
+		constexpr std::int32_t wrap_to_32_bits(std::ptrdiff_t const value) {
+			return static_cast<std::int32_t>(static_cast<std::uint32_t>(value));
+		}
+	} //namespace bf::IR::`anonymous`
+
+	packed_instruction packed_instruction::pack(instruction const& inst, std::ptrdiff_t const address) {
+		packed_instruction res{ handler_of(inst.op_code_), 0, 0, 0 };
+		packed_instruction const full{ full_form, 0, 0, 0 };
+
+		switch (inst.op_code_) {
+		case op_code::inc:
+		case op_code::load_const:
+			res.argument_ = wrap_to_32_bits(inst.argument_);
+			return res;
+		case op_code::inc_offset:
+		case op_code::load_const_offset:
+		case op_code::mul_add:
+			if (!fits<std::int16_t>(inst.offset_))
+				return full;
+			res.offset_ = static_cast<std::int16_t>(inst.offset_);
+			res.argument_ = wrap_to_32_bits(inst.argument_);
+			return res;
+		case op_code::write_offset:
+			if (!fits<std::int16_t>(inst.offset_))
+				return full;
+			res.offset_ = static_cast<std::int16_t>(inst.offset_);
+			return res;
+		case op_code::right: //the amount of shifts and strides of searches matter whole, they cannot be wrapped
+		case op_code::right_unchecked:
+		case op_code::search_right:
+		case op_code::search_left:
+		case op_code::clear_search_right:
+		case op_code::clear_search_left:
+			if (!fits<std::int32_t>(inst.argument_))
+				return full;
+			res.argument_ = static_cast<std::int32_t>(inst.argument_);
+			return res;
+		case op_code::branch:
+		case op_code::branch_nz:
+			if (!fits<std::int32_t>(inst.destination_ - address))
+				return full;
+			res.argument_ = static_cast<std::int32_t>(inst.destination_ - address);
+			return res;
+		case op_code::write_string:
+			if (!fits<std::int32_t>(inst.offset_) || !fits<std::int16_t>(inst.argument_))
+				return full;
+			res.argument_ = static_cast<std::int32_t>(inst.offset_);
+			res.offset_ = static_cast<std::int16_t>(inst.argument_);
+			return res;
+		case op_code::fill_range: //the value, count, stride and offset never fit together
+		case op_code::infinite: //rare enough to be executed by the debug engine
+			return full;
+		default:
+			return res;
+		}
+	}
+
+	std::vector<packed_instruction> pack_executable_code(std::vector<instruction> const& code) {
+		std::vector<packed_instruction> res;
+		res.reserve(code.size() + 1);
+		for (std::ptrdiff_t address = 0; address < static_cast<std::ptrdiff_t>(code.size()); ++address)
+			res.push_back(packed_instruction::pack(code[address], address));
+		res.push_back(packed_instruction{ packed_instruction::end_of_code, 0, 0, 0 });
+		return res;
+	}
+}
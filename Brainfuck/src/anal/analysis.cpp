@@ -89,7 +89,20 @@ namespace bf::analysis {
 			ptr_delta_ += std::transform_reduce(first_shift_op, begin, std::ptrdiff_t{ 0 }, std::plus{}, std::mem_fn(&instruction::argument));
 			if (ptr_delta_)
 				ptr_moves_ = true;
-			stationary_ranges_.push_back({ ptr_delta_, begin, end });
+			min_offset_ = std::min(min_offset_, ptr_delta_);
+			max_offset_ = std::max(max_offset_, ptr_delta_);
+			//a search ends its range, the pointer is at an unknown offset afterwards
+			for (auto range_begin = begin; range_begin != end;) {
+				auto const search = std::find_if(range_begin, end, std::mem_fn(&instruction::moves_to_zero_cell));
+				auto const range_end = search == end ? end : std::next(search);
+				stationary_ranges_.push_back({ ptr_delta_, range_begin, range_end, unknown_moves_ });
+				if (search != end) {
+					++unknown_moves_;
+					ptr_delta_ = 0;
+					ptr_moves_ = true;
+				}
+				range_begin = range_end;
+			}
 			first_shift_op = end;
 		}
 		std::stable_sort(stationary_ranges_.begin(), stationary_ranges_.end());
@@ -98,6 +111,17 @@ namespace bf::analysis {
 			std::plus{}, std::mem_fn(&instruction::argument));
 		if (ptr_delta_)
 			ptr_moves_ = true;
+		min_offset_ = std::min(min_offset_, ptr_delta_);
+		max_offset_ = std::max(max_offset_, ptr_delta_);
+	}
+
+	//Returns true iff following unique predecessors from the block runs in a cycle, that is never entered from the rest of the program
+	static bool on_detached_cycle(basic_block* const block) {
+		std::set<basic_block const*> visited{ block };
+		for (basic_block* pred = block; pred->predecessors_.size() == 1;)
+			if (pred = pred->get_unique_predecessor(); !visited.insert(pred).second)
+				return true;
+		return false;
 	}
 
 	void block_evaluation::analyze_predecessors() {
@@ -110,6 +134,8 @@ namespace bf::analysis {
 			break;
 		case 1:
 		{
+			if (on_detached_cycle(subject_))
+				break; //unreachable code, whose evaluation would never terminate
 			block_evaluation const pred_analysis{ subject_->get_unique_predecessor() };
 
 			state_ = pred_analysis.state_;
@@ -156,8 +182,37 @@ namespace bf::analysis {
 					state_ = result_state::indeterminate_read;
 					[[fallthrough]] ;
 				case op_code::write:
+				case op_code::write_string:
+				case op_code::write_offset:
+					has_sideeffect_ = true;
+					break;
+				case op_code::inc_offset:
+				case op_code::load_const_offset:
+				case op_code::mul_add:
+				case op_code::fill_range: //modify cells at other offsets, which may alias the analyzed one on the wrapping tape
+				case op_code::clear_search_right:
+				case op_code::clear_search_left:
 					has_sideeffect_ = true;
+					state_ = result_state::unknown;
+					break;
+				case op_code::search_right:
+				case op_code::search_left: //the pointer moves by an unknown amount
+					state_ = result_state::unknown;
+					break;
+				case op_code::nop:
+				case op_code::right:
+				case op_code::left:
+				case op_code::right_unchecked:
+				case op_code::branch:
+				case op_code::branch_nz:
+				case op_code::breakpoint:
+				case op_code::program_entry:
+				case op_code::program_exit: //do not access memory
 					break;
+				case op_code::inc:
+				case op_code::dec:
+				case op_code::load_const: //handled above
+					MUST_NOT_BE_REACHED;
 				}
 
 		}
@@ -170,6 +225,14 @@ namespace bf::analysis {
 		analyze_predecessors();
 		const_result_ = entry_value_;
 		analyze_within_block();
+		/*Offset-addressed instructions and fills modify other cells than the one analyzed, even if the pointer does not move.
+		Searches move the pointer by an unknown amount which the pointer movement does not account for. Either may change the cell
+		the analysis ends at without the analysis seeing it, hence its value is not known.*/
+		if (std::any_of(subject_->ops_.begin(), subject_->ops_.end(), [](instruction const& inst) {
+			return inst.is_offset_addressed() || inst.op_code_ == op_code::fill_range || inst.moves_to_zero_cell(); })) {
+			has_sideeffect_ = true;
+			state_ = result_state::unknown;
+		}
 	}
 
 
@@ -224,6 +287,289 @@ namespace bf::analysis {
 		return reachable;
 	}
 
+	namespace {
+
+		//Number of times the entry interval of a block may change before it is widened to unknown
+		constexpr int widening_threshold = 3;
+
+		pointer_interval join_intervals(pointer_interval const& lhs, pointer_interval const& rhs) {
+			if (!lhs.bounded_ || !rhs.bounded_)
+				return pointer_interval::unknown();
+			return { std::min(lhs.low_, rhs.low_), std::max(lhs.high_, rhs.high_), true };
+		}
+
+		//Computes the interval of the pointer at block's exit given the interval at its entry
+		pointer_interval transfer_interval(basic_block* const block, pointer_interval const& entry) {
+			if (!entry.bounded_ || std::any_of(block->ops_.begin(), block->ops_.end(), std::mem_fn(&instruction::moves_to_zero_cell)))
+				return pointer_interval::unknown();
+
+			std::ptrdiff_t const delta = pointer_movement{ block }.ptr_delta();
+			return { entry.low_ + delta, entry.high_ + delta, true };
+		}
+	}
+
+	std::map<basic_block const*, pointer_interval> analyze_pointer_ranges(std::vector<basic_block*> const& program) {
+		assert(!program.empty());
+
+		std::map<basic_block const*, pointer_interval> entry_intervals;
+		std::map<basic_block const*, int> change_counts;
+
+		/*Worklist algorithm: a block is (re)visited whenever the interval at its entry changes. Its exit interval is then joined
+		into the entry intervals of its successors. Widening guarantees termination, because each interval may change only
+		a bounded number of times before it becomes unknown, which is the top of the lattice.*/
+		std::queue<basic_block*> worklist;
+		entry_intervals[program.front()] = { 0, 0, true };
+		worklist.push(program.front());
+
+		while (!worklist.empty()) {
+			basic_block* const block = worklist.front();
+			worklist.pop();
+
+			pointer_interval const exit = transfer_interval(block, entry_intervals.at(block));
+			for (basic_block* const successor : { block->natural_successor_, block->jump_successor_ }) {
+				if (!successor)
+					continue;
+
+				auto const [iter, inserted] = entry_intervals.try_emplace(successor, exit);
+				if (!inserted) {
+					pointer_interval joined = join_intervals(iter->second, exit);
+					if (joined == iter->second)
+						continue; //nothing new is known, no need to visit the successor again
+					if (++change_counts[successor] > widening_threshold)
+						joined = pointer_interval::unknown();
+					iter->second = joined;
+				}
+				worklist.push(successor);
+			}
+		}
+		return entry_intervals;
+	}
+
+	std::vector<std::optional<pointer_interval>> analyze_code_pointer_ranges(std::vector<instruction> const& code, std::ptrdiff_t const memory_size,
+		std::ptrdiff_t const entry, std::ptrdiff_t const entry_cell) {
+		std::ptrdiff_t const code_size = static_cast<std::ptrdiff_t>(code.size());
+		std::vector<std::optional<pointer_interval>> intervals(code.size());
+		std::vector<int> change_counts(code.size(), 0);
+
+		//the same worklist algorithm as for basic blocks, but every instruction is a node of the graph
+		std::queue<std::ptrdiff_t> worklist;
+		auto const propagate = [&](std::ptrdiff_t const address, pointer_interval const& interval) {
+			if (address < 0 || address >= code_size) //the execution ends there
+				return;
+			std::optional<pointer_interval>& known = intervals[address];
+			if (known) {
+				pointer_interval joined = join_intervals(*known, interval);
+				if (joined == *known)
+					return;
+				if (++change_counts[address] > widening_threshold)
+					joined = pointer_interval::unknown();
+				*known = joined;
+			}
+			else
+				known = interval;
+			worklist.push(address);
+		};
+
+		propagate(entry, { entry_cell, entry_cell, true });
+		while (!worklist.empty()) {
+			std::ptrdiff_t const address = worklist.front();
+			worklist.pop();
+
+			instruction const& inst = code[address];
+			pointer_interval exit = *intervals[address];
+			switch (inst.op_code_) {
+			case op_code::right:
+			case op_code::right_unchecked:
+				if (exit.bounded_) {
+					exit = { exit.low_ + inst.argument_, exit.high_ + inst.argument_, true };
+					if (!exit.within(memory_size)) //the pointer may wrap around
+						exit = pointer_interval::unknown();
+				}
+				break;
+			case op_code::left:
+			case op_code::search_right:
+			case op_code::search_left:
+			case op_code::clear_search_right:
+			case op_code::clear_search_left:
+				exit = pointer_interval::unknown();
+				break;
+			case op_code::branch:
+				propagate(inst.destination_, exit);
+				continue;
+			case op_code::branch_nz:
+				propagate(inst.destination_, exit);
+				break;
+			case op_code::infinite:
+			case op_code::program_exit:
+				continue;
+			default: //other instructions leave the pointer where it is
+				break;
+			}
+			propagate(address + 1, exit);
+		}
+		return intervals;
+	}
+
+	known_cells known_cells::unknown(std::ptrdiff_t const memory_size) {
+		known_cells res{ memory_size };
+		res.others_zero_ = false;
+		return res;
+	}
+
+	bool known_cells::may_alias(std::ptrdiff_t const offset) const {
+		return !cells_.empty() && cells_.count(offset) == 0
+			&& std::max(cells_.rbegin()->first, offset) - std::min(cells_.begin()->first, offset) >= memory_size_;
+	}
+
+	std::optional<std::uint32_t> known_cells::value(std::ptrdiff_t const offset) const {
+		if (auto const iter = cells_.find(offset); iter != cells_.end())
+			return iter->second;
+		if (may_alias(offset))
+			return std::nullopt;
+		return others_zero_ ? std::optional<std::uint32_t>{ 0 } : std::nullopt;
+	}
+
+	void known_cells::set(std::ptrdiff_t const offset, std::optional<std::uint32_t> const value) {
+		if (may_alias(offset)) //the store may overwrite any stored cell, whose values are therefore forgotten
+			*this = unknown(memory_size_);
+		if (value == (others_zero_ ? std::optional<std::uint32_t>{ 0 } : std::nullopt))
+			cells_.erase(offset); //cells equal to the default are not stored, so that equal states compare equal
+		else
+			cells_[offset] = value;
+	}
+
+	void known_cells::shift(std::ptrdiff_t const delta) {
+		if (delta == 0)
+			return;
+		std::map<std::ptrdiff_t, std::optional<std::uint32_t>> shifted;
+		for (auto const& [offset, value] : cells_) //keys keep their order, hence each one is inserted at the end
+			shifted.emplace_hint(shifted.end(), offset - delta, value);
+		cells_ = std::move(shifted);
+	}
+
+	void known_cells::execute(instruction const& inst) {
+		auto const add = [this](std::ptrdiff_t const offset, std::uint32_t const addend) {
+			std::optional<std::uint32_t> const current = value(offset);
+			set(offset, current ? std::optional<std::uint32_t>{ *current + addend } : std::nullopt); //an unknown cell may still alias a stored one
+		};
+
+		switch (inst.op_code_) {
+		case op_code::inc:
+		case op_code::dec:
+			add(0, static_cast<std::uint32_t>(inst.argument()));
+			break;
+		case op_code::inc_offset:
+			add(inst.offset_, static_cast<std::uint32_t>(inst.argument_));
+			break;
+		case op_code::load_const:
+			set(0, static_cast<std::uint32_t>(inst.argument_));
+			break;
+		case op_code::load_const_offset:
+			set(inst.offset_, static_cast<std::uint32_t>(inst.argument_));
+			break;
+		case op_code::mul_add:
+			if (std::optional<std::uint32_t> const factor = value(0))
+				add(inst.offset_, *factor * static_cast<std::uint32_t>(inst.argument_));
+			else
+				set(inst.offset_, std::nullopt);
+			break;
+		case op_code::right:
+		case op_code::left:
+		case op_code::right_unchecked:
+			shift(inst.argument());
+			break;
+		case op_code::read:
+			set(0, std::nullopt);
+			break;
+		case op_code::search_right:
+		case op_code::search_left:
+			if (!is_zero(0)) { //the pointer ends at some zero cell, nothing else is known about its neighbourhood
+				*this = unknown(memory_size_);
+				set(0, 0);
+			}
+			break;
+		case op_code::clear_search_right:
+		case op_code::clear_search_left:
+			if (!is_zero(0)) { //unlike the search, the loop also clears cells whose offsets from the zero cell are not known
+				*this = unknown(memory_size_);
+				set(0, 0);
+			}
+			break;
+		case op_code::fill_range:
+			for (std::ptrdiff_t i = 0; i < inst.destination_; ++i)
+				set(inst.offset_ + i * inst.stride_, static_cast<std::uint32_t>(inst.argument_));
+			break;
+		case op_code::infinite: //the execution only continues past the loop if it is not entered
+			if (inst.is_infinite_on_non_zero())
+				set(0, 0);
+			break;
+		default: //other instructions do not modify memory
+			break;
+		}
+	}
+
+	known_cells known_cells::join(known_cells const& other) const {
+		assert(memory_size_ == other.memory_size_);
+		known_cells res{ memory_size_ };
+		res.others_zero_ = others_zero_ && other.others_zero_;
+		auto const join_cell = [&](std::ptrdiff_t const offset) {
+			std::optional<std::uint32_t> const lhs = value(offset), rhs = other.value(offset);
+			res.set(offset, lhs == rhs ? lhs : std::nullopt);
+		};
+		for (auto const& cell : cells_)
+			join_cell(cell.first);
+		for (auto const& cell : other.cells_)
+			join_cell(cell.first);
+		return res;
+	}
+
+	std::map<basic_block const*, known_cells> analyze_known_cells(std::vector<basic_block*> const& program, std::ptrdiff_t const memory_size) {
+		assert(!program.empty() && memory_size > 0);
+
+		std::map<basic_block const*, known_cells> entry_states;
+		std::map<basic_block const*, int> change_counts;
+
+		//the same worklist algorithm as for pointer ranges, states are widened to unknown once they change too often
+		std::queue<basic_block*> worklist;
+		auto const propagate = [&](basic_block* const successor, known_cells const& state) {
+			auto const [iter, inserted] = entry_states.try_emplace(successor, state);
+			if (!inserted) {
+				known_cells joined = iter->second.join(state);
+				if (joined == iter->second)
+					return;
+				if (++change_counts[successor] > widening_threshold)
+					joined = known_cells::unknown(memory_size);
+				iter->second = std::move(joined);
+			}
+			worklist.push(successor);
+		};
+
+		entry_states.emplace(program.front(), known_cells::zeroed(memory_size));
+		worklist.push(program.front());
+		while (!worklist.empty()) {
+			basic_block* const block = worklist.front();
+			worklist.pop();
+
+			known_cells state = entry_states.at(block);
+			for (instruction const& inst : block->ops_)
+				state.execute(inst);
+
+			if (block->is_cjump()) { //an edge is only followed if the jump may take it
+				if (!state.is_zero(0))
+					propagate(block->jump_successor_, state);
+				if (!state.is_non_zero(0)) {
+					state.set(0, 0);
+					propagate(block->natural_successor_, state);
+				}
+			}
+			else
+				for (basic_block* const successor : { block->natural_successor_, block->jump_successor_ })
+					if (successor)
+						propagate(successor, state);
+		}
+		return entry_states;
+	}
+
 	incoming_value_analyzer::incoming_value_analyzer(basic_block* const block)
 		: subject_{ block } {
 		assert(block);
@@ -0,0 +1,309 @@
+#include "batch.h"
+#include "cli.h"
+#include "utils.h"
+#include "compiler.h"
+
+#include <iostream>
+#include <iomanip>
+#include <fstream>
+#include <sstream>
+#include <filesystem>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <algorithm>
+#include <limits>
+#include <chrono>
+#include <cstdint>
+#include <cassert>
+
+namespace bf::batch {
+
+	namespace {
+
+		using clock = std::chrono::steady_clock;
+
+		//period in which the main thread checks for interrupt signals while jobs are running
+		constexpr std::chrono::milliseconds interrupt_poll_period{ 50 };
+
+		/*Emulator of the job currently executed by a worker thread. The main thread interrupts it if the OS raises an interrupt signal.*/
+		struct worker_slot {
+			std::mutex mutex_;
+			execution::cpu_emulator* cpu_ = nullptr; //nullptr while the worker does not execute any program
+		};
+
+		[[nodiscard]]
+		char const* state_name(execution::execution_state const state) {
+			switch (state) {
+			case execution::execution_state::not_started: return "not started";
+			case execution::execution_state::halted: return "halted";
+			case execution::execution_state::finished: return "finished";
+			case execution::execution_state::running: return "running";
+			case execution::execution_state::interrupted: return "interrupted";
+				ASSERT_NO_OTHER_OPTION;
+			}
+			return nullptr;
+		}
+
+		/*Compiles the job's program in the compilation context of the calling thread. Returns nullptr and sets the result's error on failure.*/
+		[[nodiscard]]
+		std::shared_ptr<std::vector<instruction> const> compile_program(job const& job, settings const& settings, job_result& result) {
+			std::optional<std::string> source = utils::read_file(job.program_file_);
+			if (!source.has_value()) {
+				result.error_ = "program not found";
+				return nullptr;
+			}
+			if (!compile_source(std::move(*source))) {
+				result.error_ = "syntax errors";
+				return nullptr;
+			}
+			if (!settings.optimizations_.empty()) {
+				std::uint32_t mask = 0; //identifies the optimizations in the cache of compiled programs
+				for (opt::opt_level_t const optimization : settings.optimizations_)
+					mask |= static_cast<std::uint32_t>(optimization);
+				previous_compilation::transform("optimize:" + std::to_string(mask) + ";memory:" + std::to_string(settings.memory_size_), [&settings](auto& program) {
+					static_cast<void>(opt::perform_optimizations(program, settings.optimizations_, settings.memory_size_, true));
+				});
+			}
+			return std::make_shared<std::vector<instruction> const>(previous_compilation::generate_executable_code(settings.memory_size_, settings.cell_width_));
+		}
+
+		/*Executes the job by a new emulator, which is made visible to the main thread through the slot while it is running.*/
+		[[nodiscard]]
+		job_result execute(job const& job, settings const& settings, worker_slot& slot) {
+			job_result res;
+			std::shared_ptr<std::vector<instruction> const> const code = job.code_ ? job.code_ : compile_program(job, settings, res);
+			if (!code)
+				return res;
+			if (code->empty()) {
+				res.error_ = "empty program";
+				return res;
+			}
+
+			std::istringstream no_input;
+			execution::input_buffer input{ no_input };
+			if (!job.input_file_.empty() && !input.open_file(job.input_file_)) {
+				res.error_ = "input not found";
+				return res;
+			}
+			std::ofstream output{ job.output_file_, std::ios::binary | std::ios::trunc };
+			if (!output) {
+				res.error_ = "cannot write output";
+				return res;
+			}
+			std::ostringstream diagnostics;
+
+			std::unique_ptr<execution::cpu_emulator> const cpu = std::make_unique<execution::cpu_emulator>(); //too big for the stack
+			try {
+				cpu->set_cell_width(settings.cell_width_);
+				cpu->set_memory_size(settings.memory_size_);
+			}
+			catch (std::bad_alloc const&) {
+				res.error_ = "cannot allocate memory";
+				return res;
+			}
+			cpu->emulated_program_input() = std::move(input);
+			cpu->emulated_program_stdout() = &output;
+			cpu->diagnostics_stream() = &diagnostics;
+			cpu->enable_jit(settings.jit_);
+			cpu->enable_tiering(settings.tiered_);
+			cpu->flash_program(*code); //the emulator gets its own copy, which its breakpoints may alter
+			cpu->reset();
+			cpu->suppress_stop_interrupt() = true; //the "stop" command belongs to the global emulator
+
+			{
+				std::lock_guard const lock{ slot.mutex_ };
+				slot.cpu_ = cpu.get();
+			}
+			auto const start = clock::now();
+			cpu->do_execute();
+			res.seconds_ = std::chrono::duration<double>(clock::now() - start).count();
+			{
+				std::lock_guard const lock{ slot.mutex_ };
+				slot.cpu_ = nullptr;
+			}
+
+			res.state_ = cpu->state();
+			res.executed_instructions_ = cpu->executed_instructions_counter();
+			res.diagnostics_ = diagnostics.str();
+			return res;
+		}
+
+		/*Returns the name of the file the output of a job shall be written to. Its extension is replaced by .out.*/
+		[[nodiscard]]
+		std::string output_file_name(std::filesystem::path const& file) {
+			std::filesystem::path res = file;
+			res.replace_extension(".out");
+			if (res == file) //never overwrite the file itself
+				res += ".out";
+			return res.string();
+		}
+
+		void print_results(std::vector<job> const& jobs, std::vector<job_result> const& results) {
+			std::cout << std::fixed << std::setprecision(3);
+			for (std::size_t i = 0; i < jobs.size(); ++i) {
+				job_result const& result = results[i];
+				std::cout << "Job " << i << " (" << jobs[i].name_ << "): ";
+				if (!result.error_.empty()) {
+					std::cout << "not run, " << result.error_ << ".\n";
+					continue;
+				}
+				std::cout << state_name(result.state_) << " after " << result.executed_instructions_ << " instruction"
+					<< utils::print_plural(result.executed_instructions_) << " in " << result.seconds_ << " s, output written to "
+					<< jobs[i].output_file_ << ".\n";
+
+				std::istringstream diagnostics{ result.diagnostics_ };
+				for (std::string line; std::getline(diagnostics, line);)
+					if (!line.empty())
+						std::cout << '\t' << line << '\n';
+			}
+			std::cout << std::defaultfloat;
+		}
+
+		/*Function callback for the "batch" cli command. Expects optional number of threads and optimization level followed by
+		the kind of files and the files themselves.*/
+		int batch_callback(cli::command_parameters_t const& argv) {
+			if (int const code = utils::check_command_argc(3, std::numeric_limits<std::ptrdiff_t>::max(), argv))
+				return code;
+
+			settings settings;
+			settings.memory_size_ = execution::emulator.memory_size();
+			settings.cell_width_ = execution::emulator.get_cell_width();
+			settings.jit_ = execution::emulator.jit_enabled();
+			settings.tiered_ = execution::emulator.tiering_enabled();
+			settings.threads_ = std::max(1u, std::thread::hardware_concurrency());
+			opt::opt_level_t level = opt::opt_level_t::none;
+
+			std::size_t arg = 1;
+			for (; arg < argv.size() && argv[arg].substr(0, 1) == "-"; ++arg)
+				if (argv[arg].substr(0, 2) == "-j") {
+					std::optional<int> const threads = utils::parse_positive_argument(argv[arg].substr(2));
+					if (!threads.has_value()) {
+						cli::print_command_error(cli::command_error::argument_not_recognized);
+						return 4;
+					}
+					settings.threads_ = static_cast<unsigned>(*threads);
+				}
+				else if (argv[arg] == "-O0")
+					level = opt::opt_level_t::none;
+				else if (std::optional<opt::opt_level_t> const parsed = opt::get_opt_by_name(argv[arg]); parsed.has_value())
+					level = *parsed;
+				else {
+					cli::print_command_error(cli::command_error::argument_not_recognized);
+					return 4;
+				}
+			if (level != opt::opt_level_t::none)
+				settings.optimizations_.insert(level);
+
+			if (argv.size() - arg < 2 || (argv[arg] != "inputs" && argv[arg] != "programs")) {
+				cli::print_command_error(cli::command_error::argument_not_recognized);
+				return 4;
+			}
+			bool const same_program = argv[arg] == "inputs";
+
+			std::shared_ptr<std::vector<instruction> const> code;
+			if (same_program) {
+				if (!previous_compilation::ready() || !previous_compilation::successful()) {
+					std::cerr << "There is no successfully compiled program to run.\n";
+					return 5;
+				}
+				code = std::make_shared<std::vector<instruction> const>(previous_compilation::generate_executable_code(settings.memory_size_, settings.cell_width_));
+			}
+
+			std::vector<job> jobs;
+			for (std::size_t i = arg + 1; i < argv.size(); ++i) {
+				std::filesystem::path const file{ argv[i] };
+				job& job = jobs.emplace_back();
+				job.name_ = file.string();
+				job.output_file_ = output_file_name(file);
+				if (same_program) {
+					job.code_ = code;
+					job.input_file_ = file.string();
+				}
+				else {
+					job.program_file_ = file.string();
+					std::filesystem::path input = file;
+					if (std::error_code error; std::filesystem::exists(input.replace_extension(".in"), error))
+						job.input_file_ = input.string();
+				}
+			}
+			settings.threads_ = std::min<unsigned>(settings.threads_, static_cast<unsigned>(jobs.size()));
+
+			std::cout << "Running " << jobs.size() << " job" << utils::print_plural(jobs.size()) << " on " << settings.threads_
+				<< " thread" << utils::print_plural(settings.threads_) << "...\n";
+			auto const start = clock::now();
+			std::vector<job_result> const results = run(jobs, settings);
+			double const seconds = std::chrono::duration<double>(clock::now() - start).count();
+
+			print_results(jobs, results);
+			std::cout << "All jobs done in " << std::fixed << std::setprecision(3) << seconds << std::defaultfloat << " s.\n";
+			return 0;
+		}
+
+	} //namespace bf::batch::`anonymous`
+
+	std::vector<job_result> run(std::vector<job> const& jobs, settings const& settings) {
+		assert(settings.threads_ > 0);
+		std::vector<job_result> results(jobs.size());
+		std::vector<worker_slot> slots(settings.threads_);
+
+		std::atomic<std::size_t> next_job{ 0 };
+		std::atomic<bool> cancelled{ false };
+		std::mutex mutex;
+		std::condition_variable all_done;
+		unsigned running_workers = settings.threads_;
+
+		auto const worker = [&](worker_slot& slot) {
+			for (std::size_t i; (i = next_job++) < jobs.size();)
+				if (cancelled)
+					results[i].error_ = "cancelled";
+				else
+					results[i] = execute(jobs[i], settings, slot);
+
+			std::lock_guard const lock{ mutex };
+			if (--running_workers == 0)
+				all_done.notify_one();
+		};
+
+		execution::emulator.os_interrupt() = false; //the signal handler only knows the global emulator; its flag is forwarded to the jobs
+		std::vector<std::thread> workers;
+		workers.reserve(slots.size());
+		for (worker_slot& slot : slots)
+			workers.emplace_back(worker, std::ref(slot));
+
+		for (std::unique_lock lock{ mutex }; !all_done.wait_for(lock, interrupt_poll_period, [&] { return running_workers == 0; });) {
+			if (execution::emulator.os_interrupt())
+				cancelled = true;
+			if (!cancelled)
+				continue;
+			//keep interrupting, an emulator clears the flag when it starts executing
+			for (worker_slot& slot : slots) {
+				std::lock_guard const slot_lock{ slot.mutex_ };
+				if (slot.cpu_)
+					slot.cpu_->os_interrupt() = true;
+			}
+		}
+
+		for (std::thread& thread : workers)
+			thread.join();
+		execution::emulator.os_interrupt() = false;
+		return results;
+	}
+
+	void initialize() {
+		ASSERT_IS_CALLED_ONLY_ONCE;
+
+		cli::add_command("batch", cli::command_category::execution, "Executes many programs or inputs at the same time.",
+			"Usage: \"batch\" [-jN] [optimization_level] (\"inputs\" | \"programs\") files...\n"
+			"With \"inputs\" runs the compiled program once for each of the given input files. The program is compiled only once\n"
+			"including all performed optimizations and its code is shared by all runs.\n"
+			"With \"programs\" compiles and runs each of the given source files, optimizing them on the given level (e.g. -O1, -O2;\n"
+			"-O0 by default). Input of a program is read from the file of the same name with extension .in, if it exists.\n"
+			"Jobs are executed by N threads (-j4 for four threads), by default as many as the machine has processors.\n"
+			"Each job runs on its own emulator with memory of the global emulator's size and cell width and writes its output to a file\n"
+			"of the same name with extension .out. The global emulator and breakpoints are not affected."
+			, &batch_callback);
+	}
+
+} //namespace bf::batch
@@ -0,0 +1,331 @@
+#include "bench.h"
+#include "cli.h"
+#include "utils.h"
+#include "compiler.h"
+#include "emulator.h"
+#include "jit.h"
+#include "program_image.h"
+#include "opt/optimizer_pass.h"
+#include "opt/prefix_evaluation.h"
+
+#include <iostream>
+#include <iomanip>
+#include <sstream>
+#include <streambuf>
+#include <filesystem>
+#include <chrono>
+#include <string>
+#include <string_view>
+#include <vector>
+#include <system_error>
+#include <cassert>
+
+namespace bf::bench {
+
+	namespace {
+
+		using clock = std::chrono::steady_clock;
+
+		[[nodiscard]]
+		double seconds_since(clock::time_point const start) {
+			return std::chrono::duration<double>(clock::now() - start).count();
+		}
+
+		[[nodiscard]]
+		std::string no_input() { return {}; }
+
+		//Several megabytes of text terminated by a zero byte, which stops the echo loop ,[.,]
+		[[nodiscard]]
+		std::string echo_input() {
+			std::string_view const line = "The quick brown fox jumps over the lazy dog. 0123456789\n";
+			std::string res;
+			for (std::size_t i = 0; i < (std::size_t{ 8 } << 20) / line.size(); ++i)
+				res.append(line);
+			res.push_back('\0');
+			return res;
+		}
+
+		[[nodiscard]]
+		std::string factor_input() { return "123456789012345\n"; }
+
+		/*A program of the corpus. The program is read from file name.b in the benchmark's directory. Its input is read
+		from file name.in provided it exists, otherwise it is generated.*/
+		struct workload {
+			char const* name_;
+			std::string(*input_)();
+		};
+
+		constexpr workload corpus[] = {
+			{ "mandelbrot", &no_input },
+			{ "hanoi", &no_input },
+			{ "factor", &factor_input },
+			{ "bench", &no_input },
+			{ "echo", &echo_input }
+		};
+
+		/*Stream buffer discarding everything written to it, only the number of characters is counted.*/
+		class counting_buffer : public std::streambuf {
+			std::size_t count_ = 0;
+
+		protected:
+			int_type overflow(int_type const character) override {
+				if (!traits_type::eq_int_type(character, traits_type::eof()))
+					++count_;
+				return traits_type::not_eof(character);
+			}
+
+			std::streamsize xsputn(char const*, std::streamsize const count) override {
+				count_ += static_cast<std::size_t>(count);
+				return count;
+			}
+
+		public:
+			[[nodiscard]]
+			std::size_t count() const { return count_; }
+		};
+
+		/*Redirects std::cout to a sink for its lifetime. The toolchain reports its progress there, which would obscure the results.*/
+		class muted_stdout {
+			counting_buffer sink_;
+			std::streambuf* const original_;
+
+		public:
+			muted_stdout() : original_{ std::cout.rdbuf(&sink_) } {}
+			~muted_stdout() { std::cout.rdbuf(original_); }
+
+			muted_stdout(muted_stdout const&) = delete;
+			muted_stdout& operator=(muted_stdout const&) = delete;
+		};
+
+		//Result of executing a workload by one of the engines
+		struct run_result {
+			char const* engine_;
+			std::ptrdiff_t instructions_;
+			double seconds_;
+			std::size_t output_bytes_;
+			bool finished_; //false if the execution had been interrupted e.g. by an exhausted input
+		};
+
+		struct workload_result {
+			char const* name_;
+			char const* skipped_ = nullptr; //reason why the workload has not been run, nullptr if it has
+			double compile_seconds_ = 0;
+			double optimize_seconds_ = 0;
+			double codegen_seconds_ = 0;
+			std::size_t code_size_ = 0;
+			opt::optimization_statistics passes_;
+			std::vector<run_result> runs_;
+		};
+
+		enum class engine_t { interpreter, jit, tiered };
+
+		/*Executes the code by the chosen engine feeding it the given input.*/
+		[[nodiscard]]
+		run_result execute(std::vector<instruction> const& code, std::string const& input, engine_t const engine) {
+			execution::cpu_emulator& cpu = execution::emulator;
+			bool const jit_was_enabled = cpu.jit_enabled(), tiering_was_enabled = cpu.tiering_enabled();
+			cpu.enable_jit(engine == engine_t::jit);
+			cpu.enable_tiering(engine == engine_t::tiered);
+			cpu.flash_program(code);
+
+			std::istringstream in{ input };
+			counting_buffer output;
+			std::ostream out{ &output };
+			execution::input_buffer original_input = std::exchange(cpu.emulated_program_input(), execution::input_buffer{ in });
+			std::ostream* const original_stdout = std::exchange(cpu.emulated_program_stdout(), &out);
+
+			cpu.reset();
+			cpu.suppress_stop_interrupt() = true;
+			auto const start = clock::now();
+			cpu.do_execute();
+			double const seconds = seconds_since(start);
+
+			cpu.emulated_program_input() = std::move(original_input);
+			cpu.emulated_program_stdout() = original_stdout;
+			cpu.enable_jit(jit_was_enabled);
+			cpu.enable_tiering(tiering_was_enabled);
+			return run_result{ engine == engine_t::jit ? "jit" : engine == engine_t::tiered ? "tiered" : "interpreter", cpu.executed_instructions_counter(), seconds, output.count(),
+				cpu.state() == execution::execution_state::finished };
+		}
+
+		[[nodiscard]]
+		std::filesystem::path program_path(workload const& workload, std::filesystem::path const& directory) {
+			return directory / (std::string{ workload.name_ } + ".b");
+		}
+
+		[[nodiscard]]
+		workload_result run_workload(workload const& workload, std::filesystem::path const& directory, opt::opt_level_t const level) {
+			workload_result res;
+			res.name_ = workload.name_;
+
+			std::optional<std::string> source = utils::read_file(program_path(workload, directory).string());
+			if (!source.has_value()) {
+				res.skipped_ = "cannot be read";
+				return res;
+			}
+			std::filesystem::path const input_file = directory / (std::string{ workload.name_ } + ".in");
+			std::optional<std::string> input = utils::read_file(input_file.string());
+			if (!input.has_value())
+				input = workload.input_();
+
+			muted_stdout const muted;
+			auto start = clock::now();
+			if (!compile_source(std::move(*source))) {
+				res.skipped_ = "syntax errors";
+				return res;
+			}
+			res.compile_seconds_ = seconds_since(start);
+
+			start = clock::now();
+			if (level != opt::opt_level_t::none)
+				res.passes_ = opt::perform_optimizations(previous_compilation::basic_blocks_mutable(), { level }, execution::emulator.memory_size(), true);
+			res.optimize_seconds_ = seconds_since(start);
+
+			start = clock::now();
+			std::vector<instruction> const code = previous_compilation::generate_executable_code(execution::emulator.memory_size(), execution::emulator.get_cell_width());
+			res.codegen_seconds_ = seconds_since(start);
+			res.code_size_ = code.size();
+
+			res.runs_.push_back(execute(code, *input, engine_t::interpreter));
+			if (execution::jit::available) {
+				res.runs_.push_back(execute(code, *input, engine_t::jit));
+				res.runs_.push_back(execute(code, *input, engine_t::tiered));
+			}
+			return res;
+		}
+
+		void print_text(std::vector<workload_result> const& results) {
+			auto const milliseconds = [](double const seconds) { return seconds * 1e3; };
+			std::cout << std::fixed << std::setprecision(3);
+			for (workload_result const& result : results) {
+				if (result.skipped_) {
+					std::cout << result.name_ << ": skipped (" << result.skipped_ << ").\n";
+					continue;
+				}
+				std::cout << result.name_ << ": compiled in " << milliseconds(result.compile_seconds_) << " ms, optimized in "
+					<< milliseconds(result.optimize_seconds_) << " ms, " << result.code_size_ << " instructions generated in "
+					<< milliseconds(result.codegen_seconds_) << " ms.\n";
+				for (auto const& [name, statistics] : result.passes_)
+					std::cout << "\t" << std::left << std::setw(28) << name << std::right << std::setw(8) << statistics.changes_
+					<< " changes" << std::setw(12) << std::chrono::duration<double, std::milli>(statistics.time_).count() << " ms\n";
+				for (run_result const& run : result.runs_)
+					std::cout << '\t' << std::left << std::setw(12) << run.engine_ << std::right << std::setw(14) << run.instructions_
+					<< " instructions in " << run.seconds_ << " s, " << std::setprecision(1) << run.instructions_ / run.seconds_ / 1e6
+					<< std::setprecision(3) << " M instructions/s, " << run.output_bytes_ << " bytes of output"
+					<< (run.finished_ ? "" : ", interrupted") << ".\n";
+			}
+			std::cout << std::defaultfloat;
+		}
+
+		//Prints the results as a single JSON object
+		void print_json(std::vector<workload_result> const& results, std::string_view const level) {
+			std::ostringstream json;
+			json << std::setprecision(9);
+			json << "{\"optimization\":\"" << level << "\",\"memory_size\":" << execution::emulator.memory_size() << ",\"workloads\":[";
+			for (std::size_t i = 0; i < results.size(); ++i) {
+				workload_result const& result = results[i];
+				json << (i ? "," : "") << "{\"name\":\"" << result.name_ << '"';
+				if (result.skipped_) {
+					json << ",\"skipped\":\"" << result.skipped_ << "\"}";
+					continue;
+				}
+				json << ",\"compile_seconds\":" << result.compile_seconds_ << ",\"optimize_seconds\":" << result.optimize_seconds_
+					<< ",\"codegen_seconds\":" << result.codegen_seconds_ << ",\"code_size\":" << result.code_size_ << ",\"passes\":{";
+				bool first = true;
+				for (auto const& [name, statistics] : result.passes_) {
+					json << (first ? "" : ",") << '"' << name << "\":{\"changes\":" << statistics.changes_
+						<< ",\"seconds\":" << std::chrono::duration<double>(statistics.time_).count() << '}';
+					first = false;
+				}
+				json << "},\"runs\":[";
+				for (std::size_t j = 0; j < result.runs_.size(); ++j) {
+					run_result const& run = result.runs_[j];
+					json << (j ? "," : "") << "{\"engine\":\"" << run.engine_ << "\",\"instructions\":" << run.instructions_
+						<< ",\"seconds\":" << run.seconds_ << ",\"instructions_per_second\":" << run.instructions_ / run.seconds_
+						<< ",\"output_bytes\":" << run.output_bytes_ << ",\"finished\":" << (run.finished_ ? "true" : "false") << '}';
+				}
+				json << "]}";
+			}
+			json << "]}\n";
+			std::cout << json.str();
+		}
+
+		/*Function callback for the "bench" cli command. Accepts an optional output format, optimization level and directory with the corpus.*/
+		int bench_callback(cli::command_parameters_t const& argv) {
+			if (int const code = utils::check_command_argc(1, 4, argv))
+				return code;
+
+			bool json = false;
+			std::string_view level_name = "-O2";
+			std::filesystem::path directory = "bench";
+			for (std::size_t i = 1; i < argv.size(); ++i)
+				if (argv[i] == "json")
+					json = true;
+				else if (argv[i].substr(0, 2) == "-O")
+					level_name = argv[i];
+				else
+					directory = std::filesystem::path{ argv[i] };
+
+			opt::opt_level_t level = opt::opt_level_t::none;
+			if (level_name != "-O0") {
+				std::optional<opt::opt_level_t> const parsed = opt::get_opt_by_name(level_name);
+				if (!parsed.has_value()) {
+					cli::print_command_error(cli::command_error::argument_not_recognized);
+					return 4;
+				}
+				level = *parsed;
+			}
+
+			//results of an incomplete corpus cannot be compared with other runs, hence nothing is measured
+			std::vector<std::string> missing;
+			for (workload const& workload : corpus)
+				if (std::error_code error; !std::filesystem::is_regular_file(program_path(workload, directory), error))
+					missing.push_back(program_path(workload, directory).string());
+			if (!missing.empty()) {
+				std::cerr << "The corpus is incomplete, missing " << utils::print_plural(missing.size(), "program", "programs") << ':';
+				for (std::string const& program : missing)
+					std::cerr << ' ' << program;
+				std::cerr << ".\nSee " << (directory / "README.md").string() << " for where to get them.\n";
+				return 5;
+			}
+
+			//the cache and the prefix evaluation would skip exactly the work that shall be measured
+			bool const cache_was_enabled = std::exchange(image::cache::enabled(), false);
+			std::ptrdiff_t const prefix_evaluation_budget = std::exchange(opt::prefix_evaluation_budget(), 0);
+
+			std::vector<workload_result> results;
+			for (workload const& workload : corpus) {
+				if (!json)
+					std::cout << "Running " << workload.name_ << "...\n";
+				results.push_back(run_workload(workload, directory, level));
+			}
+
+			image::cache::enabled() = cache_was_enabled;
+			opt::prefix_evaluation_budget() = prefix_evaluation_budget;
+
+			if (json)
+				print_json(results, level_name);
+			else
+				print_text(results);
+			return 0;
+		}
+
+	} //namespace bf::bench::`anonymous`
+
+	void initialize() {
+		ASSERT_IS_CALLED_ONLY_ONCE;
+
+		cli::add_command("bench", cli::command_category::execution, "Measures the performance of the toolchain on a fixed corpus of programs.",
+			"Usage: \"bench\" [json] [optimization_level] [directory]\n"
+			"Compiles, optimizes and executes programs mandelbrot, hanoi, factor, bench and echo, reading each of them from file name.b\n"
+			"in the given directory (\"bench\" by default). Nothing is measured unless all of them are present. Input is read from file name.in,\n"
+			"if there is none, echo gets several megabytes of text and factor a fifteen digit number.\n"
+			"Reports the time of compilation, of each optimizer pass and of code generation, the number of executed instructions\n"
+			"and instructions per second of every available engine. Programs are optimized with -O2 unless another level (e.g. -O0, -O1)\n"
+			"is given. The cache of compiled programs and the prefix evaluation are disabled for the benchmark.\n"
+			"With \"json\" the results are printed as a single JSON object to allow automated comparison of builds.\n"
+			"The emulator is left with the last program of the corpus flashed."
+			, &bench_callback);
+	}
+
+} //namespace bf::bench
@@ -9,15 +9,84 @@
 #include <iomanip>
 #include <array>
 #include <utility>
+#include <limits>
 
 namespace bf::breakpoints {
 
-	breakpoint_manager bp_manager;
+	namespace {
+
+		//Cell accessed by an instruction, addressed relative to the cell pointer
+		struct cell_access {
+			std::ptrdiff_t offset_;
+			bool read_, write_;
+		};
+
+		/*Returns true iff the predicate holds for any cell accessed by the instruction. Searches, clearing ones included, are not considered,
+		since the cells they access depend on the contents of memory. Checked whenever a watched instruction is reached, hence it does not allocate.*/
+		template<typename PREDICATE>
+		[[nodiscard]]
+		bool any_accessed_cell(instruction const& inst, PREDICATE const& predicate) {
+			switch (inst.op_code_) {
+			case op_code::inc: return predicate(cell_access{ 0, true, true });
+			case op_code::load_const: case op_code::read: return predicate(cell_access{ 0, false, true });
+			case op_code::write: case op_code::branch_nz: return predicate(cell_access{ 0, true, false });
+			case op_code::inc_offset: return predicate(cell_access{ inst.offset_, true, true });
+			case op_code::load_const_offset: return predicate(cell_access{ inst.offset_, false, true });
+			case op_code::write_offset: return predicate(cell_access{ inst.offset_, true, false });
+			case op_code::mul_add: return predicate(cell_access{ 0, true, false }) || predicate(cell_access{ inst.offset_, true, true });
+			case op_code::fill_range:
+				for (std::ptrdiff_t i = 0; i < inst.destination_; ++i)
+					if (predicate(cell_access{ inst.offset_ + i * inst.stride_, false, true }))
+						return true;
+				return false;
+			default: return false;
+			}
+		}
+
+		/*Returns true iff the cell at the given offset from the cell pointer may be the watched one, provided the pointer lies within the interval.
+		Offsets wrap around the boundary of memory the same way the emulator wraps them.*/
+		[[nodiscard]]
+		bool may_be_watched(analysis::pointer_interval const& pointer, std::ptrdiff_t const offset, std::ptrdiff_t const cell, std::ptrdiff_t const memory_size) {
+			if (!pointer.bounded_)
+				return true;
+			std::ptrdiff_t const distance = ((cell - offset - pointer.low_) % memory_size + memory_size) % memory_size;
+			return distance <= pointer.high_ - pointer.low_;
+		}
 
+		/*Returns true iff the instruction may access the watched cell in the watched way when executed with the pointer within the interval.*/
+		[[nodiscard]]
+		bool may_access(instruction const& inst, analysis::pointer_interval const& pointer, watchpoint const& wp, std::ptrdiff_t const memory_size) {
+			if (inst.is_search()) //reads all cells on its way
+				return wp.kind_ == access_kind::read;
+			if (inst.is_clear_search()) //reads all cells on its way and clears them as well
+				return true;
+			return any_accessed_cell(inst, [&](cell_access const& access) {
+				return (wp.kind_ == access_kind::read ? access.read_ : access.write_) && may_be_watched(pointer, access.offset_, wp.cell_, memory_size);
+			});
+		}
+
+		/*Returns true iff a search starting at the given cell accesses the watched one in the given way before it stops at a zero cell.
+		Searches only read the cells, clearing searches also write every nonzero cell they leave.*/
+		[[nodiscard]]
+		bool search_accesses(void const* const memory, std::ptrdiff_t const memory_size, execution::cell_width const width, std::ptrdiff_t cell,
+			instruction const& search, std::ptrdiff_t const watched, access_kind const kind) {
+			std::ptrdiff_t const stride = search.op_code_ == op_code::search_left || search.op_code_ == op_code::clear_search_left ? -search.argument_ : search.argument_;
+			for (std::ptrdiff_t steps = 0; steps < memory_size; ++steps) { //a search without any zero cell never terminates
+				bool const zero = !execution::read_cell(memory, cell, width);
+				if (cell == watched)
+					return kind == access_kind::read || (search.is_clear_search() && !zero);
+				if (zero)
+					return false;
+				cell = ((cell + stride) % memory_size + memory_size) % memory_size;
+			}
+			return false;
+		}
 
-	bool breakpoint::try_hit() {
+	} //namespace bf::breakpoints::`anonymous`
+
+	bool breakpoint::try_hit(expression::machine_state const& state) {
 		assert(ignore_count_ >= 0); //sanity check
-		if (!enabled_ || !is_condition_satisfied()) //if condition is not satisfied, return false straight away
+		if (!enabled_ || !is_condition_satisfied(state)) //if condition is not satisfied, return false straight away
 			return false;
 
 		//we have hit a breakpoint, but it may have ignore_count set; in such a case, decrease it and ignore 
@@ -33,7 +102,101 @@ namespace bf::breakpoints {
 		temp_breakpoints_.clear();
 		all_breakpoints_.clear();
 		breakpoint_locations_.clear();
+		location_table_.clear();
 		hit_breakpoints_.clear();
+		hit_watchpoints_.clear();
+		watched_addresses_.clear();
+		pointer_ranges_.clear();
+		watchpoints_outdated_ = true;
+	}
+
+	location& breakpoint_manager::instrument(std::ptrdiff_t const address) {
+		assert(address >= 0 && address < cpu_.instructions_size());
+		auto const [iter, inserted] = breakpoint_locations_.try_emplace(address, location{ {}, false, cpu_.instructions_[address] }); //save the original instruction
+		if (inserted) {
+			instruction breakpoint = cpu_.instructions_[address];
+			breakpoint.op_code_ = op_code::breakpoint; //insert a breakpoint instruction to program code, keeping the source location
+			cpu_.patch_instruction(address, breakpoint);
+			location_table_.resize(cpu_.instructions_.size(), nullptr);
+			location_table_[address] = &iter->second;
+		}
+		return iter->second;
+	}
+
+	void breakpoint_manager::release_if_unused(std::ptrdiff_t const address) {
+		location* const here = location_at(address);
+		assert(here);
+		if (!here->breakpoints_here_.empty() || here->watched_)
+			return;
+		cpu_.patch_instruction(address, here->replaced_instruction_);
+		location_table_[address] = nullptr;
+		breakpoint_locations_.erase(address);
+	}
+
+	std::vector<instruction> breakpoint_manager::original_program() const {
+		std::vector<instruction> res{ cpu_.instructions_cbegin(), cpu_.instructions_cend() };
+		for (auto const& [address, location] : breakpoint_locations_)
+			res[address] = location.replaced_instruction_;
+		return res;
+	}
+
+	int breakpoint_manager::set_watchpoint(std::ptrdiff_t const cell, access_kind const kind) {
+		if (cell < 0 || cell >= cpu_.memory_size()) {
+			std::cerr << "Cell out of bounds. Valid range is [0, " << cpu_.memory_size() - 1 << "] inclusive.\n";
+			return 1;
+		}
+		int id = 0;
+		while (watchpoints_.count(id)) //watchpoints are few, use the smallest free id
+			++id;
+		watchpoints_.emplace(id, watchpoint{ id, cell, kind });
+		watchpoints_outdated_ = true;
+		std::cout << "New watchpoint " << id << " created.\n";
+		return 0;
+	}
+
+	bool breakpoint_manager::remove_watchpoint(int const id) {
+		if (!watchpoints_.erase(id))
+			return false;
+		watchpoints_outdated_ = true;
+		return true;
+	}
+
+	void breakpoint_manager::update_watchpoints() {
+		std::ptrdiff_t const address = cpu_.program_counter_, cell = cpu_.cell_pointer_offset();
+		bool const state_covered = cpu_.memory_size() == analyzed_memory_size_ && address < static_cast<std::ptrdiff_t>(pointer_ranges_.size())
+			&& pointer_ranges_[address] && (!pointer_ranges_[address]->bounded_ || (pointer_ranges_[address]->low_ <= cell && cell <= pointer_ranges_[address]->high_));
+		if (!watchpoints_outdated_ && (watchpoints_.empty() || state_covered))
+			return;
+		watchpoints_outdated_ = false;
+
+		//watchpoints outside of memory may remain after it has shrunk; they cannot be hit
+		std::vector<watchpoint const*> active;
+		for (auto const& [id, wp] : watchpoints_)
+			if (wp.cell_ < cpu_.memory_size())
+				active.push_back(&wp);
+
+		std::vector<std::ptrdiff_t> addresses;
+		pointer_ranges_.clear();
+		analyzed_memory_size_ = cpu_.memory_size();
+		if (!active.empty()) {
+			std::vector<instruction> const code = original_program();
+			pointer_ranges_ = analysis::analyze_code_pointer_ranges(code, cpu_.memory_size(), address, cell);
+			for (std::ptrdiff_t i = 0; i < static_cast<std::ptrdiff_t>(code.size()); ++i)
+				if (pointer_ranges_[i] && std::any_of(active.begin(), active.end(), [&](watchpoint const* const wp) {
+					return may_access(code[i], *pointer_ranges_[i], *wp, cpu_.memory_size());
+				}))
+					addresses.push_back(i);
+		}
+		if (addresses == watched_addresses_)
+			return;
+
+		for (std::ptrdiff_t const watched : watched_addresses_) {
+			location_at(watched)->watched_ = false;
+			release_if_unused(watched);
+		}
+		for (std::ptrdiff_t const watched : addresses)
+			instrument(watched).watched_ = true;
+		watched_addresses_ = std::move(addresses);
 	}
 
 
@@ -55,47 +218,43 @@ namespace bf::breakpoints {
 			: iter_before_gap->first + 1; //the next following element has key GREATER than this_iterator's key plus one
 	}
 
-	breakpoint* breakpoint_manager::do_set_breakpoint_at(std::ptrdiff_t const address) {
+	breakpoint* breakpoint_manager::do_set_breakpoint_at(std::ptrdiff_t const address, std::optional<expression::compiled_expression> condition) {
 		assert(address >= 0);
-		if (!execution::emulator.has_program()) {
+		if (!cpu_.has_program()) {
 			std::cerr << "No program has been flashed to CPU's memory.\n";
 			return nullptr;
 		}
-		if (address >= execution::emulator.instructions_size()) {
-			std::cerr << "Breakpoint out of bounds. Valid range is [0, " << execution::emulator.instructions_size() - 1 << "] inclusive.\n";
+		if (address >= cpu_.instructions_size()) {
+			std::cerr << "Breakpoint out of bounds. Valid range is [0, " << cpu_.instructions_size() - 1 << "] inclusive.\n";
 			return nullptr;
 		}
 
 		//either an existing location is returned or a new one is created 
-		location& bp_location = breakpoint_locations_[address];
-		if (bp_location.breakpoints_here_.empty()) { //if that's the first breakpoint
-			bp_location.replaced_instruction_ = execution::emulator.instructions_[address]; //save the original instruction
-			execution::emulator.instructions_[address].op_code_ = op_code::breakpoint; //insert a breakpoint instruction to program code
-		}
+		location& bp_location = instrument(address);
 
 		// breakpoint_id of the new breakpoint. Smallest non-negative integer not yet denoting an existing breakpoint 
 		int const new_index = get_unused_breakpoint_id();
 		//creates new breakpoint struct and places it into the map of defined breakpoints
 		breakpoint* const new_breakpoint_ptr = std::addressof(all_breakpoints_[new_index] = breakpoint{new_index, address});
+		new_breakpoint_ptr->condition_ = std::move(condition);
 
-
-
-		bp_location.breakpoints_here_.insert(new_breakpoint_ptr); //insert pointer to the new breakpoint
+		bp_location.breakpoints_here_.push_back(new_breakpoint_ptr); //insert pointer to the new breakpoint
 		std::cout << "New breakpoint " << new_index << " created.\n";
 		return new_breakpoint_ptr;
 	}
 
-	int breakpoint_manager::set_breakpoint_at(std::ptrdiff_t const address) {
-		return do_set_breakpoint_at(address) == nullptr;
+	int breakpoint_manager::set_breakpoint_at(std::ptrdiff_t const address, std::optional<expression::compiled_expression> condition) {
+		return do_set_breakpoint_at(address, std::move(condition)) == nullptr;
 	}
 
 	instruction const& breakpoint_manager::get_replaced_instruction_at(std::ptrdiff_t const address) const {
-		assert(breakpoint_locations_.count(address));
-		return breakpoint_locations_.at(address).replaced_instruction_;
+		location const* const here = location_at(address);
+		assert(here);
+		return here->replaced_instruction_;
 	}
 
-	int breakpoint_manager::set_temp_breakpoint_at(std::ptrdiff_t address) {
-		breakpoint* const bp = do_set_breakpoint_at(address);
+	int breakpoint_manager::set_temp_breakpoint_at(std::ptrdiff_t address, std::optional<expression::compiled_expression> condition) {
+		breakpoint* const bp = do_set_breakpoint_at(address, std::move(condition));
 		if (bp)
 			temp_breakpoints_.insert(bp);
 		return !bp;
@@ -105,15 +264,11 @@ namespace bf::breakpoints {
 		assert(all_breakpoints_.count(bp->id_)); //make sure the breakpoint exists at all
 		assert(std::addressof(all_breakpoints_.at(bp->id_)) == bp); //make sure the argument bp points into the internal map
 		assert(breakpoint_locations_.count(bp->address_)); //make sure breakpoint location exists
-		assert(breakpoint_locations_.at(bp->address_).breakpoints_here_.count(bp)); //make sure specified location contains the bp
-
 		location& brk_location = breakpoint_locations_.at(bp->address_); //get the breakpoint location
-		brk_location.breakpoints_here_.erase(bp); //remove current breakpoint from this location
-
-		if (brk_location.breakpoints_here_.empty()) { //if we erased the last one, we need to restore the original instruction
-			execution::emulator.instructions_[bp->address_] = brk_location.replaced_instruction_;
-			breakpoint_locations_.erase(bp->address_);
-		}
+		auto const here = std::find(brk_location.breakpoints_here_.begin(), brk_location.breakpoints_here_.end(), bp);
+		assert(here != brk_location.breakpoints_here_.end()); //make sure specified location contains the bp
+		brk_location.breakpoints_here_.erase(here); //remove current breakpoint from this location
+		release_if_unused(bp->address_); //if we erased the last one, we need to restore the original instruction
 		if (temp_breakpoints_.count(bp)) //if the breakpoint is temporary, 
 			temp_breakpoints_.erase(bp); //delete it from the container as well
 
@@ -130,7 +285,7 @@ namespace bf::breakpoints {
 			return;
 		}
 		std::cout << "Creating a new breakpoint at address " << address << ".\n"
-			"New breakpoint no. " << do_set_breakpoint_at(address)->id_ << " defined.\n";
+			"New breakpoint no. " << do_set_breakpoint_at(address, std::nullopt)->id_ << " defined.\n";
 		assert(breakpoint_locations_.at(address).breakpoints_here_.size() == 1); //sanity check; this location shall now contain just one breakpoint
 	}
 
@@ -138,6 +293,13 @@ namespace bf::breakpoints {
 		if (breakpoint_locations_.count(address) == 0) //if an unknown breakpoint had been hit, 
 			return handle_unknown_breakpoint_at(address); //initiate the defining procedure 
 
+		location const& here = breakpoint_locations_.at(address);
+		for (watchpoint const* const hit_wp : hit_watchpoints_)
+			std::cout << "Watchpoint no. " << hit_wp->id_ << " has been hit! Instruction " << here.replaced_instruction_.op_code_
+			<< " at address " << address << " is about to " << (hit_wp->kind_ == access_kind::write ? "write" : "read") << " cell " << hit_wp->cell_
+			<< " (value " << execution::read_cell(cpu_.memory_cbegin(), hit_wp->cell_, cpu_.get_cell_width()) << ").\n";
+		hit_watchpoints_.clear();
+
 		for (breakpoint* hit_bp : hit_breakpoints_) {//traverse vector and print all breakpoints
 			assert(hit_bp->address_ == address); //sanity check, we cannot hit breakpoints at multiple addresses simultaneously
 
@@ -152,38 +314,50 @@ namespace bf::breakpoints {
 	}
 
 	bool breakpoint_manager::should_ignore_breakpoints_at(std::ptrdiff_t const address) {
+		location const* const here = location_at(address);
 		//If we encounter a breakpoint which has not been set via a command (i.e. programmatical breakpoint),
-		if (breakpoint_locations_.count(address) == 0) //don't ignore. Let function handle_breakpoint take care of it
+		if (!here) //don't ignore. Let function handle_breakpoint take care of it
 			return false;
 
-		assert(execution::emulator.has_program()); //make sure there is some program..
-		assert(hit_breakpoints_.empty()); //sanity check; all breakpoints had been processed before the new ones were reached
-		assert(breakpoint_locations_.count(address)); //make sure the specified address has a corresponding breakpoint location
-		assert(std::any_of(all_breakpoints_.cbegin(), all_breakpoints_.cend(), //make sure at least one breakpoint resides at the specified address 
-			[address](std::pair<int const, breakpoint> const& pair) -> bool { return pair.second.address_ == address; }));
+		assert(cpu_.has_program()); //make sure there is some program..
+		assert(hit_breakpoints_.empty() && hit_watchpoints_.empty()); //sanity check; all breakpoints had been processed before the new ones were reached
+		assert(!here->breakpoints_here_.empty() || here->watched_); //make sure at least one breakpoint or watchpoint needs the specified address
 
-
-		std::unordered_set<breakpoint*> const& breaks_here = get_breakpoints_at(address);
+		//conditions observe the registers as they are when the breakpoint instruction is reached
+		expression::machine_state const state{ cpu_.memory_cbegin(), cpu_.memory_size(), cpu_.get_cell_width(),
+			cpu_.cell_pointer_offset(), address };
 		/*Traverse all possibly hit breakpoints trying to hit them. If it's successful, add them to the vector of
 		hit but unprocessed breakpoints.*/
-		std::copy_if(breaks_here.cbegin(), breaks_here.cend(), std::back_inserter(hit_breakpoints_),
-			[](breakpoint* const b) {return b->try_hit(); });
-		return hit_breakpoints_.empty(); //if none has been hit, ignore them
+		for (breakpoint* const bp : here->breakpoints_here_)
+			if (bp->try_hit(state))
+				hit_breakpoints_.push_back(bp);
+
+		//the instruction is checked for the exact cells it is about to access
+		if (here->watched_) {
+			instruction const& inst = here->replaced_instruction_;
+			analysis::pointer_interval const pointer{ state.cell_pointer_, state.cell_pointer_, true };
+			for (auto const& [id, wp] : watchpoints_)
+				if (wp.cell_ < state.memory_size_ && (inst.moves_to_zero_cell()
+					? search_accesses(state.memory_, state.memory_size_, state.cell_width_, state.cell_pointer_, inst, wp.cell_, wp.kind_)
+					: may_access(inst, pointer, wp, state.memory_size_)))
+					hit_watchpoints_.push_back(&wp);
+		}
+		return hit_breakpoints_.empty() && hit_watchpoints_.empty(); //if none has been hit, ignore them
 	}
 
-	std::unordered_set<breakpoint*> const& breakpoint_manager::get_breakpoints_at(std::ptrdiff_t const address) {
-		assert(execution::emulator.has_program());
-		assert(address >= 0 && address < execution::emulator.instructions_size());
-		assert(breakpoint_locations_.count(address)); //sanity check - this function assumes that the breakpoint location exists
-		return breakpoint_locations_.at(address).breakpoints_here_;
+	std::vector<breakpoint*> const& breakpoint_manager::get_breakpoints_at(std::ptrdiff_t const address) {
+		assert(cpu_.has_program());
+		assert(address >= 0 && address < cpu_.instructions_size());
+		location const* const here = location_at(address);
+		assert(here); //sanity check - this function assumes that the breakpoint location exists
+		return here->breakpoints_here_;
 	}
 
 	int breakpoint_manager::count_breakpoints_at(std::ptrdiff_t const address) {
-		assert(execution::emulator.has_program());
-		assert(address >= 0 && address < execution::emulator.instructions_size());
-		return breakpoint_locations_.count(address) ?
-			static_cast<int>(breakpoint_locations_.at(address).breakpoints_here_.size())
-			: 0;
+		assert(cpu_.has_program());
+		assert(address >= 0 && address < cpu_.instructions_size());
+		location const* const here = location_at(address);
+		return here ? static_cast<int>(here->breakpoints_here_.size()) : 0;
 	}
 
 	breakpoint* breakpoint_manager::get_breakpoint(int const id) {
@@ -204,19 +378,46 @@ namespace bf::breakpoints {
 				static constexpr std::array<int, 4> const widths = { 6,12,10,8 }; //field widths
 
 				buffer << "Defined breakpoints:\n" << std::right << std::setw(widths[0]) << "ID" << std::setw(widths[1]) << "ADDRESS"
-					<< std::setw(widths[2]) << "ENABLED" << std::setw(widths[3]) << "IGNORE COUNT\n";
+					<< std::setw(widths[2]) << "ENABLED" << std::setw(widths[3]) << "IGNORE COUNT" << "   CONDITION\n";
 
-				for (auto const& [id, breakpoint] : bp_manager.all_breakpoints())
+				for (auto const& [id, breakpoint] : execution::emulator.breakpoints().all_breakpoints()) {
 					buffer << std::setw(widths[0]) << std::right << breakpoint.id_ << '.' << std::setw(widths[1]) << breakpoint.address_
 					<< std::setw(widths[2]) << (breakpoint.enabled_ ? "enabled" : "disabled") << std::setw(widths[3]) << breakpoint.ignore_count_;
+					if (breakpoint.condition_)
+						buffer << "   " << breakpoint.condition_->source();
+					buffer << '\n';
+				}
 
 				std::cout << buffer.str();
 			}
+
+			/*Compiles the condition given by arguments following the first index arguments. They are joined by spaces,
+			since the command line splits the expression. Returns false if the condition is invalid.*/
+			[[nodiscard]]
+			bool compile_condition(cli::command_parameters_t const& argv, std::size_t const first, std::optional<expression::compiled_expression>& condition) {
+				std::string source;
+				for (std::size_t i = first; i < argv.size(); ++i)
+					source.append(i == first ? "" : " ").append(argv[i]);
+				condition = expression::compiled_expression::compile(source);
+				return condition.has_value();
+			}
+
+			/*Parses arguments of break and tbreak commands, i.e. an address optionally followed by "if" and a condition.*/
+			[[nodiscard]]
+			std::optional<std::pair<std::ptrdiff_t, std::optional<expression::compiled_expression>>> parse_breakpoint(cli::command_parameters_t const& argv) {
+				std::optional<int> const parsed_address = utils::parse_nonnegative_argument(argv[1]);
+				if (!parsed_address.has_value())
+					return std::nullopt;
+				std::optional<expression::compiled_expression> condition;
+				if (argv.size() > 2 && (argv[2] != "if" || argv.size() == 3 || !compile_condition(argv, 3, condition)))
+					return std::nullopt;
+				return std::pair{ std::ptrdiff_t{ *parsed_address }, std::move(condition) };
+			}
 		}
 
 		/*Function callback for the break cli command. */
 		int break_callback(cli::command_parameters_t const& argv) {
-			if (int const code = utils::check_command_argc(1, 2, argv)) //check the parameter count
+			if (int const code = utils::check_command_argc(1, std::numeric_limits<std::ptrdiff_t>::max(), argv)) //check the parameter count
 				return code;
 
 			if (argv.size() == 1) {
@@ -224,21 +425,45 @@ namespace bf::breakpoints {
 				return 0;
 			}
 
-			std::optional<int> const parsed_address = utils::parse_nonnegative_argument(argv[1]);
-			//if parameter is ok, delegate the call to breakpoint_manager, otherwise return an error code
-			return parsed_address.has_value() ? bp_manager.set_breakpoint_at(*parsed_address) : 3;
+			auto breakpoint = break_helper::parse_breakpoint(argv);
+			//if parameters are ok, delegate the call to breakpoint_manager, otherwise return an error code
+			return breakpoint.has_value() ? execution::emulator.breakpoints().set_breakpoint_at(breakpoint->first, std::move(breakpoint->second)) : 3;
 
 		}
 
-		/*Function callback for the tbreak cli command. Accepts one argument - the address at which temporary breakpoint shall be set*/
+		/*Function callback for the tbreak cli command. Accepts the address at which temporary breakpoint shall be set and optionally its condition.*/
 		int tbreak_callback(cli::command_parameters_t const& argv) {
-			if (int const code = utils::check_command_argc(2, 2, argv))
+			if (int const code = utils::check_command_argc(2, std::numeric_limits<std::ptrdiff_t>::max(), argv))
 				return code;
 
-			std::optional<int> const parsed_address = utils::parse_nonnegative_argument(argv[1]);
-
+			auto breakpoint = break_helper::parse_breakpoint(argv);
 			//if parameters are ok, delegate the call to breakpoint_manager, otherwise return an error code
-			return parsed_address.has_value() ? bp_manager.set_temp_breakpoint_at(*parsed_address) : 3;
+			return breakpoint.has_value() ? execution::emulator.breakpoints().set_temp_breakpoint_at(breakpoint->first, std::move(breakpoint->second)) : 3;
+		}
+
+		/*Function callback for the condition cli command. Sets the condition of an existing breakpoint, or removes it if no condition is given.*/
+		int condition_callback(cli::command_parameters_t const& argv) {
+			if (int const code = utils::check_command_argc(2, std::numeric_limits<std::ptrdiff_t>::max(), argv))
+				return code;
+
+			std::optional<int> const breakpoint_id = utils::parse_nonnegative_argument(argv[1]);
+			if (!breakpoint_id.has_value())
+				return 3;
+			breakpoint* const bp = execution::emulator.breakpoints().get_breakpoint(*breakpoint_id);
+			if (!bp) {
+				std::cerr << "The specified breakpoint does not exist!\n";
+				return 5;
+			}
+
+			std::optional<expression::compiled_expression> condition;
+			if (argv.size() > 2 && !break_helper::compile_condition(argv, 2, condition))
+				return 4;
+			bp->condition_ = std::move(condition);
+			if (bp->condition_)
+				std::cout << "Breakpoint " << *breakpoint_id << " will only be hit if " << bp->condition_->source() << ".\n";
+			else
+				std::cout << "Breakpoint " << *breakpoint_id << " is now unconditional.\n";
+			return 0;
 		}
 
 		int ignore_callback(cli::command_parameters_t const& argv) {
@@ -250,7 +475,7 @@ namespace bf::breakpoints {
 			if (!breakpoint_id.has_value() || !ignore_count.has_value())
 				return 3;
 
-			breakpoint* const bp = bp_manager.get_breakpoint(*breakpoint_id);
+			breakpoint* const bp = execution::emulator.breakpoints().get_breakpoint(*breakpoint_id);
 			if (!bp) {
 				std::cerr << "The specified breakpoint does not exist!\n";
 				return 5;
@@ -272,7 +497,7 @@ namespace bf::breakpoints {
 					return 3;
 
 				//perform a lookup of the passed identifier
-				struct breakpoint* breakpoint = bp_manager.get_breakpoint(*breakpoint_id);
+				struct breakpoint* breakpoint = execution::emulator.breakpoints().get_breakpoint(*breakpoint_id);
 				if (!breakpoint) {
 					std::cerr << "Breakpoint " << *breakpoint_id << " does not exist.\n";
 					return 6;
@@ -301,24 +526,90 @@ namespace bf::breakpoints {
 			return disable_enable_helper::modify_breakpoint_state(argv[1], true);
 		}
 
+		namespace watch_helper {
+			//Print a table containing information about watchpoints
+			void print_watchpoint_info() {
+				std::ostringstream buffer;
+				buffer << "Defined watchpoints:\n" << std::right << std::setw(6) << "ID" << std::setw(12) << "CELL" << std::setw(10) << "ACCESS\n";
+				for (auto const& [id, watchpoint] : execution::emulator.breakpoints().all_watchpoints())
+					buffer << std::setw(6) << watchpoint.id_ << '.' << std::setw(12) << watchpoint.cell_
+					<< std::setw(10) << (watchpoint.kind_ == access_kind::write ? "write" : "read") << '\n';
+				std::cout << buffer.str();
+			}
+
+			//Parses the cell given as the only argument and creates a watchpoint of the given kind
+			int create_watchpoint(cli::command_parameters_t const& argv, access_kind const kind) {
+				std::optional<int> const cell = utils::parse_nonnegative_argument(argv[1]);
+				return cell.has_value() ? execution::emulator.breakpoints().set_watchpoint(*cell, kind) : 3;
+			}
+		}
+
+		/*Function callback for the watch cli command. Lists watchpoints or creates a new one watching writes to the given cell.*/
+		int watch_callback(cli::command_parameters_t const& argv) {
+			if (int const code = utils::check_command_argc(1, 2, argv))
+				return code;
+
+			if (argv.size() == 1) {
+				watch_helper::print_watchpoint_info();
+				return 0;
+			}
+			return watch_helper::create_watchpoint(argv, access_kind::write);
+		}
+
+		/*Function callback for the rwatch cli command. Creates a new watchpoint watching reads of the given cell.*/
+		int rwatch_callback(cli::command_parameters_t const& argv) {
+			if (int const code = utils::check_command_argc(2, 2, argv))
+				return code;
+
+			return watch_helper::create_watchpoint(argv, access_kind::read);
+		}
+
+		/*Function callback for the unwatch cli command. Removes the watchpoint with the given id.*/
+		int unwatch_callback(cli::command_parameters_t const& argv) {
+			if (int const code = utils::check_command_argc(2, 2, argv))
+				return code;
+
+			std::optional<int> const watchpoint_id = utils::parse_nonnegative_argument(argv[1]);
+			if (!watchpoint_id.has_value())
+				return 3;
+			if (!execution::emulator.breakpoints().remove_watchpoint(*watchpoint_id)) {
+				std::cerr << "Watchpoint " << *watchpoint_id << " does not exist.\n";
+				return 6;
+			}
+			std::cout << "Watchpoint " << *watchpoint_id << " removed.\n";
+			return 0;
+		}
+
 	}
 	void initialize() {
 		ASSERT_IS_CALLED_ONLY_ONCE;
 
 		cli::add_command("break", cli::command_category::debugging, "Creates a new breakpoint or lists existing ones.",
-			"Usage: \"break\" [address]\n"
+			"Usage: \"break\" [address [\"if\" condition]]\n"
 			"If no argument is specified, the command prints a list of all set breakpoints.\n"
-			"If an integer address is specified, the command sets a new breakpoint at the given location."
+			"If an integer address is specified, the command sets a new breakpoint at the given location.\n"
+			"The breakpoint may be given a condition, e.g. \"break 42 if $cpr == 10 && mem[3] > 7\". Such breakpoint is only hit\n"
+			"if the condition evaluates to nonzero. Conditions consist of numbers, registers $cpr and $pc, cells of memory mem[index],\n"
+			"parentheses and operators ! * / % + - < <= > >= == != && || of usual meanings and priorities. Conditions are compiled\n"
+			"when the breakpoint is created and evaluated without interrupting the execution."
 			, &break_callback);
 		cli::add_command_alias("breakpoint", "break");
 		cli::add_command_alias("b", "break");
 		cli::add_command_alias("br", "break");
 
 		cli::add_command("tbreak", cli::command_category::debugging, "Creates a temporary breakpoint.",
-			"Usage: \"tbreak\" address\n"
-			"Creates a new breakpoint at specified location which will be automatically destroyed after it is hit for the first time."
+			"Usage: \"tbreak\" address [\"if\" condition]\n"
+			"Creates a new breakpoint at specified location which will be automatically destroyed after it is hit for the first time.\n"
+			"The condition has the same form as the one of the \"break\" command."
 			, &tbreak_callback);
 
+		cli::add_command("condition", cli::command_category::debugging, "Sets breakpoint's condition.",
+			"Usage: \"condition\" breakpoint_number [condition]\n"
+			"Sets the condition of the specified breakpoint, which is then only hit if the condition evaluates to nonzero.\n"
+			"If no condition is given, the breakpoint becomes unconditional. See \"break\" for the form of conditions.\n"
+			"The ignore count only decreases on hits satisfying the condition."
+			, &condition_callback);
+
 		cli::add_command("ignore", cli::command_category::debugging, "Sets breakpoint's ignore count.",
 			"Usage: \"ignore\" breakpoint_number ignore_count\n"
 			"Sets the number of times the execution shall continue if the specified breakpoint is hit."
@@ -334,6 +625,25 @@ namespace bf::breakpoints {
 			"Enables the breakpoint with the same index as the specified parameter.\n"
 			"Enabled breakpoints interrupt execution when hit.",
 			&enable_callback);
+
+		cli::add_command("watch", cli::command_category::debugging, "Creates a watchpoint on writes or lists existing watchpoints.",
+			"Usage: \"watch\" [cell]\n"
+			"If no argument is specified, the command prints a list of all watchpoints.\n"
+			"Otherwise creates a watchpoint interrupting the execution right before an instruction writes the given cell of memory.\n"
+			"Only instructions which may reach the cell according to an analysis of the cell pointer's movement are checked,\n"
+			"the rest of the program runs at full speed. Watchpoints are kept when a new program is flashed."
+			, &watch_callback);
+
+		cli::add_command("rwatch", cli::command_category::debugging, "Creates a watchpoint on reads.",
+			"Usage: \"rwatch\" cell\n"
+			"Creates a watchpoint interrupting the execution right before an instruction reads the given cell of memory,\n"
+			"e.g. outputs it, tests it by a conditional jump or modifies it. See \"watch\" for details."
+			, &rwatch_callback);
+
+		cli::add_command("unwatch", cli::command_category::debugging, "Removes a watchpoint.",
+			"Usage: \"unwatch\" watchpoint_number\n"
+			"Removes the watchpoint with the specified number."
+			, &unwatch_callback);
 	}
 
 } //namespace bf::breakpoints
\ No newline at end of file
@@ -1,6 +1,7 @@
 #include "cli.h"
 #include "emulator.h"
 #include "utils.h"
+#include "stats.h"
 #include <map>
 #include <charconv>
 #include <vector>
@@ -640,7 +641,7 @@ namespace bf::cli {
 			std::cout << "Brainfuck optimizing compiler and CPU emulator CLI\nVersion up to date as of " __TIMESTAMP__
 				"\nCompiled at " __TIME__ " " __DATE__ "\n"
 
-				"The emulator is currently in " << sizeof(decltype(execution::emulator)::memory_cell_t) * CHAR_BIT << "-bit mode.\n"
+				"The emulator is currently in " << static_cast<int>(execution::emulator.get_cell_width()) << "-bit mode.\n"
 				"The emulator's address space is currently " << execution::emulator.memory_size() << " cell" << utils::print_plural(execution::emulator.memory_size()) << " wide.\n\n"
 
 				<< help_callback_helper::get_general_help() << "\n\n"
@@ -733,7 +734,12 @@ namespace bf::cli {
 		In another words: this protects the program in case the called command is deleted before the hook check occures.*/
 		class command const* const hook = command->hook();
 		try { //As it appears, command does exist. Execute it saving the returned value
-			return_code = command->callback()(tokens);
+			//in the "stats" mode commands are measured as if prefixed by "time", except for the commands controlling the measurement
+			if (stats::measuring_every_command() && !stats::measuring() && command->name() != "time" && command->name() != "stats")
+				return_code = stats::measure(from_tty ? std::string_view{ cli_history.previous_commands_.back() } : std::string_view{ cmd_line },
+					[command, &tokens] { return command->callback()(tokens); });
+			else
+				return_code = command->callback()(tokens);
 			if (return_code)
 				std::cout << "Command returned with exit code " << return_code << ".\n";
 		}
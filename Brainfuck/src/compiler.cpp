@@ -2,27 +2,79 @@
 #include "syntax_check.h"
 #include "cli.h"
 #include "utils.h"
+#include "anal/analysis.h"
+#include "IR/inst_types.h"
+#include "opt/prefix_evaluation.h"
+#include "opt/arithmetic.h"
+#include "opt/block_layout.h"
+#include "program_image.h"
+#include "profiler.h"
+#include "stats.h"
 
 #include <execution>
 #include <iostream>
 #include <numeric>
 #include <map>
+#include <set>
 #include <cassert>
 #include <algorithm>
 #include <string_view>
 #include <charconv>
 #include <iomanip>
-#include <stack>
+#include <functional>
+#include <iterator>
+#include <variant>
+#include <unordered_map>
+#include <optional>
+#include <thread>
 
 namespace bf {
 
+	/*Source code of a compilation. Code from the command line is owned, files are mapped to memory and never copied.*/
+	using source_code_t = std::variant<std::string, utils::mapped_file>;
+
+	/*Loop of the source code which is not nested in any other loop. The frontend emits its blocks contiguously,
+	they are labelled body_label_ through condition_label_ and entered by the unconditional jump terminating the previous block.*/
+	struct top_level_loop {
+		std::size_t begin_, end_; //positions of the opening bracket and one past the closing bracket
+		source_location location_; //location of the opening bracket
+		std::ptrdiff_t body_label_, condition_label_;
+	};
+
+	namespace {
+
+		[[nodiscard]]
+		std::string_view view_of(source_code_t const& source) {
+			return std::holds_alternative<std::string>(source) ? std::string_view{ std::get<std::string>(source) } : std::get<utils::mapped_file>(source).view();
+		}
+
+		/*Compiles syntactically valid source code to basic blocks and lists its top-level loops. Defined after the compiler itself.*/
+		[[nodiscard]]
+		std::vector<std::unique_ptr<basic_block>> build_blocks(std::string_view code, std::vector<top_level_loop>& top_level_loops);
+
+		/*Replaces top-level loops of the frontend's output by their separately transformed copies, reusing those cached for loops
+		with the same source. Returns the spliced blocks connected to no blocks but those of their own loop. Defined after the compiler itself.*/
+		[[nodiscard]]
+		std::set<basic_block const*> splice_transformed_loops(std::vector<std::unique_ptr<basic_block>>& program, std::string_view source,
+			std::vector<top_level_loop> const& top_level_loops, std::string_view description, previous_compilation::loop_transformation const& transformation);
+
+	} //namespace bf::`anonymous`
 
 	/*Structure containing information about the result of a compilation; Mainly vector of syntax errors
 	and optionally syntax_tree provided compilation was successful are present.*/
 	struct compilation_result {
-		std::string source_code_; //source code that has been compiled
+		source_code_t source_code_; //source code that has been compiled
 		std::vector<syntax_error> syntax_errors_; //vector of encountered syntax_errors
 		std::vector<std::unique_ptr<basic_block>> basic_blocks_; //compiled instructions.
+		std::vector<top_level_loop> top_level_loops_; //loops of the source not nested in others, in the order of the source
+		bool blocks_transformed_ = false; //true iff the blocks may differ from the output of the frontend
+
+		//Identifies the source code and all transformations applied to it in the cache of compiled programs. Empty if the result shall not be cached
+		std::string cache_key_;
+		//true iff the basic blocks have not been built yet, because the executable code may be found in the cache
+		bool compilation_pending_ = false;
+		//transformations requested before the blocks had been built, in the order of requests
+		std::vector<std::function<void(std::vector<std::unique_ptr<basic_block>>&)>> pending_transformations_;
 
 		template<typename A, typename B, typename C>
 		compilation_result(A&& source_code, B&& syntax_errors, C&& basic_blocks) noexcept
@@ -30,17 +82,22 @@ namespace bf {
 			syntax_errors_{ std::forward<B>(syntax_errors) },
 			basic_blocks_{ std::forward<C>(basic_blocks) }
 		{}
+
+		[[nodiscard]]
+		std::string_view source_code() const {
+			return view_of(source_code_);
+		}
 	};
 
 	namespace previous_compilation {
 
 		/*Internal unique pointer to the result of last compilation. After the first compilation finishes, a meaningful value is set;
-		until then contains nullptr.*/
-		std::unique_ptr<compilation_result> prev_compilation_result;
+		until then contains nullptr. Each thread has its own, therefore programs can be compiled by multiple threads at the same time.*/
+		thread_local std::unique_ptr<compilation_result> prev_compilation_result;
 
-		std::string& source_code() {
+		std::string_view source_code() {
 			assert(ready());
-			return prev_compilation_result->source_code_;
+			return prev_compilation_result->source_code();
 		}
 
 		std::vector<syntax_error>& syntax_errors() {
@@ -48,38 +105,159 @@ namespace bf {
 			return prev_compilation_result->syntax_errors_;
 		}
 
-		std::vector<instruction> generate_executable_code() {
+		/*Builds the basic blocks and applies all deferred transformations, unless it has already been done.*/
+		void finish_deferred_compilation() {
 			assert(ready());
+			compilation_result& result = *prev_compilation_result;
+			if (!result.compilation_pending_)
+				return;
+
+			result.compilation_pending_ = false;
+			result.basic_blocks_ = build_blocks(result.source_code(), result.top_level_loops_);
+			for (auto const& transformation : result.pending_transformations_) {
+				transformation(result.basic_blocks_);
+				result.blocks_transformed_ = true;
+			}
+			result.pending_transformations_.clear();
+		}
 
-			//TODO fix
+		bool compilation_deferred() {
+			assert(ready());
+			return prev_compilation_result->compilation_pending_;
+		}
 
-			std::vector<instruction> res;
-			res.reserve(std::accumulate(prev_compilation_result->basic_blocks_.cbegin(), prev_compilation_result->basic_blocks_.cend(), std::size_t(0),
-				[](std::size_t const tmp, std::unique_ptr<basic_block> const& block) -> std::size_t {
-					return tmp + block->ops_.size();
-				}));
+		bool transform(std::string_view const description, std::function<void(std::vector<std::unique_ptr<basic_block>>&)> transformation) {
+			assert(ready());
+			compilation_result& result = *prev_compilation_result;
+			if (!result.cache_key_.empty())
+				result.cache_key_.append(";").append(description);
 
+			if (result.compilation_pending_) {
+				result.pending_transformations_.push_back(std::move(transformation));
+				return false;
+			}
+			transformation(result.basic_blocks_);
+			result.blocks_transformed_ = true;
+			return true;
+		}
+
+		bool transform_incrementally(std::string_view const description, loop_transformation transformation) {
+			return transform(description, [description = std::string{ description }, transformation = std::move(transformation)](auto& program) {
+				compilation_result const& result = *prev_compilation_result; //the transformation runs when the blocks are built
+				std::set<basic_block const*> settled;
+				if (incremental_compilation() && !result.blocks_transformed_)
+					settled = splice_transformed_loops(program, result.source_code(), result.top_level_loops_, description, transformation);
+				transformation(program, true, settled);
+			});
+		}
+
+		std::vector<instruction> generate_executable_code(std::optional<std::ptrdiff_t> const memory_size, execution::cell_width const width) {
+			assert(ready());
+
+			//the executable code depends on the memory size, the width of cells and the prefix evaluation as well
+			std::string cache_key;
+			if (image::cache::enabled() && memory_size.has_value() && !prev_compilation_result->cache_key_.empty()) {
+				cache_key = prev_compilation_result->cache_key_ + ";memory:" + std::to_string(*memory_size) + ";cells:" + std::to_string(static_cast<int>(width))
+					+ ";prefix:" + std::to_string(opt::prefix_evaluation_budget());
+				if (profiler::active_profile())
+					cache_key += ";profile:" + std::to_string(image::hash(profiler::to_text(*profiler::active_profile())));
+				if (std::optional<image::loaded_image> cached = image::cache::lookup(cache_key))
+					return std::move(cached->code_);
+			}
+			finish_deferred_compilation();
+			stats::phase_timer const timer{ "code generation" };
+
+			std::map<basic_block const*, analysis::pointer_interval> pointer_ranges;
+			if (memory_size.has_value()) {
+				std::vector<basic_block*> program;
+				program.reserve(prev_compilation_result->basic_blocks_.size());
+				std::transform(prev_compilation_result->basic_blocks_.begin(), prev_compilation_result->basic_blocks_.end(), std::back_inserter(program),
+					std::mem_fn(&std::unique_ptr<basic_block>::get));
+				pointer_ranges = analysis::analyze_pointer_ranges(program);
+			}
 
+			/*Returns true iff the pointer cannot leave the memory during execution of the given block. Searches make
+			the pointer unknown within the block itself, so blocks containing them are never considered safe.*/
+			auto const block_stays_in_memory = [&](basic_block* const block) {
+				auto const range = pointer_ranges.find(block);
+				if (range == pointer_ranges.end() || !range->second.bounded_
+					|| std::any_of(block->ops_.begin(), block->ops_.end(), std::mem_fn(&instruction::moves_to_zero_cell)))
+					return false;
+				analysis::pointer_movement const movement{ block };
+				analysis::pointer_interval const reach{ range->second.low_ + movement.min_offset(), range->second.high_ + movement.max_offset(), true };
+				return reach.within(*memory_size);
+			};
+
+			/*Blocks are laid out in the order of their labels, unless a profile guides their layout. Jumps are resolved to addresses of their
+			targets' leaders and an unconditional jump is appended to blocks whose natural successor does not immediately follow them.*/
+			std::vector<basic_block*> layout;
 			for (auto const& block : prev_compilation_result->basic_blocks_)
-				res.insert(res.end(), block->ops_.cbegin(), block->ops_.cend());
+				if (!block->is_orphaned())
+					layout.push_back(block.get());
+			if (profiler::active_profile())
+				layout = opt::profile_guided_layout(layout, *profiler::active_profile());
+
+			auto const needs_fallthrough_jump = [&layout](std::size_t const index) {
+				basic_block const* const successor = layout[index]->natural_successor_;
+				return successor && (index + 1 == layout.size() || layout[index + 1] != successor);
+			};
+
+			std::map<basic_block const*, std::ptrdiff_t> block_addresses;
+			std::ptrdiff_t code_size = 0;
+			for (std::size_t i = 0; i < layout.size(); ++i) {
+				block_addresses.emplace(layout[i], code_size);
+				code_size += static_cast<std::ptrdiff_t>(layout[i]->ops_.size()) + needs_fallthrough_jump(i);
+			}
+
+			std::vector<instruction> res;
+			res.reserve(code_size);
+
+			for (std::size_t i = 0; i < layout.size(); ++i) {
+				basic_block* const block = layout[i];
+				auto const first = res.insert(res.end(), block->ops_.cbegin(), block->ops_.cend());
+				opt::fold_constants_for_cell_width(first, res.end(), width);
+				if (memory_size.has_value() && block_stays_in_memory(block))
+					for (auto inst = first; inst != res.end(); ++inst)
+						if (inst->op_code_ == op_code::right)
+							inst->op_code_ = op_code::right_unchecked;
+
+				if (block->is_jump()) {
+					assert(block->jump_successor_);
+					res.back().destination_ = block_addresses.at(block->jump_successor_);
+				}
+				if (needs_fallthrough_jump(i))
+					res.push_back(IR::branch_instruction::make(op_code::branch, block->ops_.empty() ? source_location{ 0, 0 } : block->ops_.back().source_loc_,
+						block_addresses.at(block->natural_successor_)));
+			}
+			assert(static_cast<std::ptrdiff_t>(res.size()) == code_size);
+
+			//the prefix is evaluated in memory of the target's size, which must therefore be known
+			if (memory_size.has_value() && opt::prefix_evaluation_budget() > 0)
+				res = opt::evaluate_io_free_prefix(std::move(res), *memory_size, width, opt::prefix_evaluation_budget());
 
+			if (!cache_key.empty())
+				image::cache::store(cache_key, res, *memory_size, width);
 			return res;
 		}
 
 		std::vector<std::unique_ptr<basic_block>> const& basic_blocks() {
 			assert(ready());
+			finish_deferred_compilation();
 			return prev_compilation_result->basic_blocks_;
 		}
 
 		std::vector<std::unique_ptr<basic_block>>& basic_blocks_mutable() {
 			assert(ready());
+			finish_deferred_compilation();
+			prev_compilation_result->blocks_transformed_ = true; //the caller may change them
 			return prev_compilation_result->basic_blocks_;
 		}
 
 		bool successful() {
 			assert(ready());
-			assert(prev_compilation_result->syntax_errors_.empty() == !prev_compilation_result->basic_blocks_.empty());
-			return !prev_compilation_result->basic_blocks_.empty();
+			compilation_result const& result = *prev_compilation_result;
+			assert(result.syntax_errors_.empty() == (result.compilation_pending_ || !result.basic_blocks_.empty()));
+			return result.syntax_errors_.empty();
 		}
 
 		bool ready() {
@@ -88,274 +266,582 @@ namespace bf {
 
 	} //namespace bf::previous_compilation
 
+	/*The Brainfuck compiler frontend. Translates source code to the net of basic blocks in a single pass over the characters.
+	Runs of arithmetic and pointer shifts are folded into single instructions while scanning and matching brackets are resolved
+	using a stack of opened loops, therefore the compilation takes linear time and each block is allocated right in its final storage.
+	Large sources are split into parts compiled by separate instances of the compiler. A part begins right after a bracket,
+	where no block is being built and no run can be folded, hence the parts only need to be stitched together at loops crossing them.*/
 	class compiler {
 
-		std::vector<instruction> instructions_;
-		std::vector<instruction const*> labels_; //addresses of labels (jump targets)
-		std::vector<instruction*> jumps_; //vector of pointers to jump instructions
+		std::vector<std::unique_ptr<basic_block>> blocks_; //blocks finished so far; block's label equals its index
+		std::vector<instruction> current_; //instructions of the block being built
+		basic_block* falls_through_ = nullptr; //finished block, whose natural successor will be the next finished block
+
+		/*Stack of pairs of (block terminated by the unconditional jump at the opening bracket, label of the loop body).*/
+		std::vector<std::pair<basic_block*, std::ptrdiff_t>> opened_loops_;
+
+		std::ptrdiff_t enclosing_loops_ = 0; //number of loops opened before the compiled part of the source code that are still open
+		std::vector<basic_block*> closing_conditions_; //conditional jumps closing loops opened before the compiled part, in the order of the source
+
+		std::vector<top_level_loop> top_level_loops_; //loops closed so far which are not nested in others
 
 		/*Performs cleanup of data stored from the previous compilation and prepares the object to compile new code.*/
 		void reset_compiler_state() {
-			instructions_.clear();
-			jumps_.clear();
-			labels_.clear();
-
-		}
-
-
-		/*The Brainfuck compiler frontend. Converts source code to instructions one by one without any optimizations or analysis. The returned vector is however potentially ready
-		for execution as all jumps in the code get relocated to point to destinations correctly. */
-		void generate_intermediate_code(std::string_view const source_code) {
-			//invalid source code cannot appear here; it must be tested against functions from the syntax_check.h header
-			assert(is_syntactically_valid(source_code)); //one more test for the validity of the program
-
-			instructions_.reserve(2 + source_code.size()); //reserve enough space for all instructions and program prologue and epilogue
-			instructions_.push_back({ op_code::program_entry, 1, 0 }); //the prologue - program's entry instruction
-
-			for (std::size_t source_offset = 0; source_offset < source_code.size(); ++source_offset)  //loop though the code char by char
-				switch (source_code[source_offset]) { //and add a new instruction if the char is a command
-				case '+': instructions_.push_back({ op_code::inc, 1, source_offset });	  break;
-				case '-': instructions_.push_back({ op_code::inc, -1, source_offset });	  break;
-				case '>': instructions_.push_back({ op_code::right, 1, source_offset });  break;
-				case '<': instructions_.push_back({ op_code::right, -1, source_offset }); break;
-				case ',': instructions_.push_back({ op_code::read, 1, source_offset });   break;
-				case '.': instructions_.push_back({ op_code::write, 1, source_offset });  break;
-				case '[':
-					instructions_.push_back({ op_code::jump, std::ptrdiff_t{0xdead'beef}, source_offset }); //Argument will be resolved later
-					jumps_.push_back(&instructions_.back());
-					break;
-				case ']':
-					instructions_.push_back({ op_code::jump_not_zero, std::ptrdiff_t{0xdead'beef}, source_offset });
-					jumps_.push_back(&instructions_.back());
-					break;
-					//any other characater is only a comment, therefore we ignore it
+			blocks_.clear();
+			current_.clear();
+			falls_through_ = nullptr;
+			opened_loops_.clear();
+			enclosing_loops_ = 0;
+			closing_conditions_.clear();
+			top_level_loops_.clear();
+		}
+
+		/*Computes locations of characters of a part of the source code. Positions within the part must not decrease between calls.*/
+		class locator {
+			command_bitmap const& commands_; //bitmap of the part
+			std::size_t const offset_; //position of the part within the whole source code
+			int line_;
+			std::size_t line_start_; //position of the first character on the current line within the whole source code
+			std::size_t next_newline_; //position within the part
+
+		public:
+			locator(command_bitmap const& commands, std::size_t const offset, int const line, std::size_t const line_start)
+				: commands_{ commands }, offset_{ offset }, line_{ line }, line_start_{ line_start }, next_newline_{ commands.next_newline(0) } {}
+
+			source_location operator()(std::size_t const position) {
+				for (; next_newline_ < position; next_newline_ = commands_.next_newline(next_newline_ + 1)) {
+					++line_;
+					line_start_ = offset_ + next_newline_ + 1;
 				}
+				return source_location{ line_, static_cast<int>(offset_ + position - line_start_) + 1 };
+			}
+		};
 
-			instructions_.push_back({ op_code::program_exit, 1, source_code.size() }); //the epilogue of the program
-			assert(jumps_.size() % 2 == 0); //there must be an even number of jump instructions 
-		}
+		/*Turns the instructions collected so far into a new basic block and links it with the preceding block falling through to it.*/
+		basic_block* finish_block() {
+			basic_block* const block = blocks_.emplace_back(std::make_unique<basic_block>(static_cast<std::ptrdiff_t>(blocks_.size()), std::move(current_))).get();
+			current_.clear();
 
-		/*Identifies labels in the generated intermediate code and prepares this information for usage during the construction of basic blocks.*/
-		void identify_labels() {
+			if (falls_through_) {
+				falls_through_->natural_successor_ = block;
+				block->predecessors_.insert(falls_through_);
+			}
+			falls_through_ = block->is_ujump() ? nullptr : block;
+			return block;
+		}
 
-			assert(instructions_.size() >= 2); //at least program_entry and program_exit must be present
-			//make sure that the generated source_code has proper format
-			assert(instructions_.front().op_code_ == op_code::program_entry && instructions_.back().op_code_ == op_code::program_exit);
-			assert(jumps_.size() % 2 == 0); //there must be an even number of jump instructions 
-			assert(std::all_of(jumps_.cbegin(), jumps_.cend(), std::mem_fn(&instruction::is_jump)));
+		/*Adds the value to the argument of the last instruction if it has the given op_code. Otherwise appends a new instruction.
+		A run of instructions compensating each other is removed altogether.*/
+		void fold(op_code const op_code, std::ptrdiff_t const value, source_location const loc) {
+			if (current_.empty() || current_.back().op_code_ != op_code)
+				current_.push_back({ op_code, value, loc });
+			else if ((current_.back().argument_ += value) == 0)
+				current_.pop_back();
+		}
 
-			/*Each label marks a single leader. Leaders of basic blocks are found by applying the following algorithm:
-				1) The first instruction is a leader.
-				2) Conditional jumps at closing brace are leaders of their own single instruction blocks
-				3) Instructions after opening brackets are leaders of the loop body.
-				*/
+		//Links both jumps of a loop with their targets
+		static void link_loop(basic_block* const opening, basic_block* const condition, basic_block* const body) {
+			//The destination for unconditional jump from the opening brace is the block with the conditional jump
+			opening->jump_successor_ = condition;
+			condition->predecessors_.insert(opening);
 
-				//For unconditional jumps, their destination (conditional jump) is a leader 
-				//For conditional jumps, their destination and well as the instruction after them (fallthrough) are leaders
-				//Two additional labels for program_entry and one past program_exit instructions
-			std::size_t const expected_label_count = jumps_.size() + jumps_.size() / 2 + 2;
-			labels_.reserve(expected_label_count);
+			//The destination for conditional jump from the closing brace is the loop body
+			condition->jump_successor_ = body;
+			body->predecessors_.insert(condition);
+		}
 
-			labels_.push_back(&instructions_.front()); //the entry instruction is a leader
+		void open_loop(std::size_t const position, source_location const loc) {
+			current_.push_back(IR::branch_instruction::make(op_code::branch, loc, 0xdead'beef)); //Destination is resolved when the executable code is generated
+			basic_block* const opening = finish_block();
+			std::ptrdiff_t const body_label = static_cast<std::ptrdiff_t>(blocks_.size()); //the loop body is the following block
+			if (opened_loops_.empty() && enclosing_loops_ == 0) //the end and the condition are filled in once the loop is closed
+				top_level_loops_.push_back({ position, 0, loc, body_label, 0 });
+			opened_loops_.emplace_back(opening, body_label);
+		}
 
-			for (instruction const* const jump : jumps_)  //see comment five lines above
-				if (jump->op_code_ == op_code::jump)
-					labels_.push_back(jump + 1);
-				else if (jump->op_code_ == op_code::jump_not_zero) {
-					labels_.push_back(jump);
-					labels_.push_back(jump + 1);
-				}
-				else
-					MUST_NOT_BE_REACHED;
+		void close_loop(std::size_t const position, source_location const loc) {
+			if (!current_.empty()) //the conditional jump is the leader of its own block
+				finish_block();
+			current_.push_back(IR::branch_instruction::make(op_code::branch_nz, loc, 0xdead'beef));
+			basic_block* const condition = finish_block();
+
+			if (opened_loops_.empty()) { //the loop has been opened by a preceding part, which links it once all parts are compiled
+				assert(enclosing_loops_ > 0); //in valid code there still has to be some loop remaining
+				closing_conditions_.push_back(condition);
+				if (--enclosing_loops_ == 0)
+					top_level_loops_.push_back({ opened_before_part, position + 1, source_location{}, 0, condition->label_ });
+				return;
+			}
 
-			labels_.push_back(&instructions_.back() + 1); //one more label pointing at the past the end instruction
-			assert(labels_.size() == expected_label_count); //all precalculated capacity should have been filled
+			auto const [opening, body_label] = opened_loops_.back();
+			opened_loops_.pop_back();
+			link_loop(opening, condition, blocks_[body_label].get()); //the body is the condition itself for empty loops
 
-			//there may be multiple labels on the same instruction with this code (two ']' in a row)
-			auto const unique_end = std::unique(labels_.begin(), labels_.end()); //remove multiple labels on the same instruction (may happen because of an empty loop)
-			labels_.erase(unique_end, labels_.end()); //remove trailing elements
+			if (opened_loops_.empty() && enclosing_loops_ == 0) {
+				top_level_loop& loop = top_level_loops_.back();
+				loop.end_ = position + 1;
+				loop.condition_label_ = condition->label_;
+			}
 		}
 
-		void resolve_jump_targets() const {
-			assert(instructions_.size() >= 2); //at least program_entry and program_exit must be present
-			//make sure that the generated source_code has proper format
-			assert(instructions_.front().op_code_ == op_code::program_entry && instructions_.back().op_code_ == op_code::program_exit);
-			assert(jumps_.size() % 2 == 0); //there must be an even number of jump instructions 
-			assert(std::all_of(std::execution::seq, jumps_.begin(), jumps_.end(), std::mem_fn(&instruction::is_jump)));
-			//assert that all jump instructions are contained in the jumps_ vector
-			assert(jumps_.size() == std::size_t(std::count_if(std::execution::seq, instructions_.begin(), instructions_.end(), std::mem_fn(&instruction::is_jump))));
-			assert(std::all_of(std::execution::seq, instructions_.begin(), instructions_.end(), [this](instruction const& i) {return i.is_jump() ? std::find(jumps_.begin(), jumps_.end(), &i) != jumps_.end() : true; }));
-
-			//we have a std::vector<instruction *> containing jump instructions
-			//and a std::vector<instruction *> with labels. Element at labels_[i] is the address of instruction under the i-th label
+		/*Adds instructions for all commands of a part of the source code located at the given offset.*/
+		void scan(std::string_view const part, std::size_t const offset, command_bitmap const& commands, locator& locate) {
+			for (std::size_t position = commands.next_command(0); position != command_bitmap::npos; position = commands.next_command(position + 1)) {
+				source_location const loc = locate(position);
+				switch (part[position]) { //add a new instruction for each command
+				case '+': fold(op_code::inc, 1, loc);	        break;
+				case '-': fold(op_code::inc, -1, loc);	        break;
+				case '>': fold(op_code::right, 1, loc);         break;
+				case '<': fold(op_code::right, -1, loc);        break;
+				case ',': current_.push_back({ op_code::read, 1, loc });   break;
+				case '.': current_.push_back({ op_code::write, 1, loc });  break;
+				case '[': open_loop(offset + position, loc);    break;
+				case ']': close_loop(offset + position, loc);   break;
+				ASSERT_NO_OTHER_OPTION;
+				}
+			}
+		}
 
-			//number of the next label to be processed. Start at one (it is incremented after the loop body)
-			auto next_label = labels_.cbegin();
-			std::stack<std::pair<instruction*, std::ptrdiff_t>> opened_loops; //pair of (pointer to the unconditional jump, number of label pointing to the following instruction)
+	public:
 
-			for (instruction* const jump : jumps_)
-				switch (jump->op_code_) { //for each jump instruction perform an operation
-				case op_code::jump:   //for opening brace instructions (the unconditional jump):
-					next_label = std::find(next_label, labels_.cend(), jump + 1);
-					assert(next_label != labels_.cend());
-					opened_loops.emplace(jump, std::distance(labels_.cbegin(), next_label)); //push the address of this jump instruction and the corresponding label's index. 
-					break;
+		//Value of top_level_loop::begin_ of loops closed by a part of the source code, which have been opened by a preceding part
+		static constexpr std::size_t opened_before_part = static_cast<std::size_t>(-1);
 
-				case op_code::jump_not_zero:
-				{
-					assert(!opened_loops.empty()); //in valid code there still has to be some loop remaining
-					next_label = std::find(next_label, labels_.cend(), jump);
-					assert(next_label != labels_.cend());
-					auto const [uncond_jump, target_label_for_cj] = opened_loops.top();
+		/*Blocks compiled from a part of the source code, labelled from zero. Loops crossing the boundaries of the part are left unlinked.*/
+		struct compiled_part {
+			std::vector<std::unique_ptr<basic_block>> blocks_;
+			std::vector<std::pair<basic_block*, std::ptrdiff_t>> opened_loops_; //loops still open at the end of the part, the outermost first
+			std::vector<basic_block*> closing_conditions_; //conditional jumps closing loops opened by preceding parts, in the order of the source
+			std::vector<top_level_loop> top_level_loops_; //the first one may have been opened by a preceding part, see opened_before_part
+		};
 
-					//The destination for conditional jump from the closing brace is the label at the instruction following the opening brace
-					jump->destination_ = target_label_for_cj;
+		/*Compiles the given source code. The bitmap of commands must have been computed from the same code.*/
+		std::vector<std::unique_ptr<basic_block>> compile(std::string_view const code, command_bitmap const& commands) {
 
-					//The destination for unconditional jump from the opening brace is the label at the closing brace
-					uncond_jump->destination_ = std::distance(labels_.cbegin(), next_label);
+			/* STEPS OF THE COMPILATION PROCESS:
+				starting conditions:
+					compiler object in an possibly undefined state if some conmpilation had already been perfromed
+					source code of the to-be-compiled program. It must be syntactically correct (otherwise an exception or crash occures)
 
+				1) Perform an assertion that the source code is valid as it's expected to be free of any syntax errors when given to the compiler.
 
-					opened_loops.pop();   //Must be the last statement, because structured binding to tuple-like structure introduces references! Otherwise dangling reference
-					break;
-				}
-				ASSERT_NO_OTHER_OPTION;
-				}
+				2) Reset the compiler's state.
 
-			//all instructions must have their destination different from 0xdead'beef placeholder value
-			assert(std::none_of(std::execution::seq, instructions_.begin(), instructions_.end(), [](instruction const& i) {return i.is_jump() ? i.destination_ == 0xdead'beef : false; }));
-		}
+				3) Scan the commands of the source code, skipping comments using the bitmap of commands:
+					- Runs of +- and <> are folded into a single instruction.
+					- Opening bracket terminates the current block by an unconditional jump. The block is pushed to the stack of opened loops.
+					- Closing bracket becomes the leader of a new block consisting of a single conditional jump. Both jumps of the loop are
+						linked with their targets using the block from the top of the stack.
 
-		std::vector<std::unique_ptr<basic_block>> construct_program_blocks() const {
-			{ //A lot of sanity checks...
-				assert(labels_.size() >= 2); //at least two labels must exist (entry one and the one past the end)
-				assert(instructions_.size() >= 2); //at least program_entry and program_exit must be present
-				//make sure that the generated source_code has proper format
-				assert(instructions_.front().op_code_ == op_code::program_entry && instructions_.back().op_code_ == op_code::program_exit);
-				assert(jumps_.size() % 2 == 0); //there must be an even number of jump instructions 
-				assert(std::all_of(std::execution::seq, jumps_.begin(), jumps_.end(), std::mem_fn(&instruction::is_jump)));
-				//assert that all jump instructions are contained in the jumps_ vector
-				assert(jumps_.size() == std::size_t(std::count_if(std::execution::seq, instructions_.begin(), instructions_.end(), std::mem_fn(&instruction::is_jump))));
-				assert(std::all_of(std::execution::seq, instructions_.begin(), instructions_.end(), [this](instruction const& i) {return i.is_jump() ? std::find(jumps_.begin(), jumps_.end(), &i) != jumps_.end() : true; }));
-				//all instructions must have their destination different from 0xdead'beef placeholder value
-				assert(std::all_of(std::execution::seq, instructions_.begin(), instructions_.end(), [](instruction const& i) {return i.is_jump() ? i.destination_ != 0xdead'beef : true; }));
-			}
+				4) End of algorithm. The block with the program's exit is finished and all blocks are returned.
 
-			std::vector<std::unique_ptr<basic_block>> basic_blocks;
-			basic_blocks.reserve(labels_.size() - 1);
+			*/
 
-			for (std::size_t index = 0; index < labels_.size() - 1; ++index)
-				basic_blocks.push_back(std::make_unique<basic_block>(static_cast<std::ptrdiff_t>(index),
-					std::vector(labels_[index], labels_[index + 1]))); //instructions 
+			assert(commands.brackets_match());
 
+			reset_compiler_state();
 
-			assert(!basic_blocks.empty()); //otherwise the following loop would be infinite
-			for (std::size_t i = 0; i < basic_blocks.size() - 1; ++i)
-				switch (instruction & last_instruction = basic_blocks[i]->ops_.back(); last_instruction.op_code_) {
-				case op_code::jump:
-				case op_code::jump_not_zero:
+			locator locate{ commands, 0, 1, 0 };
+			current_.push_back({ op_code::program_entry, 1, locate(0) }); //the prologue - program's entry instruction
+			scan(code, 0, commands, locate);
+			assert(opened_loops_.empty()); //all loops must have been closed
 
-					basic_blocks[i]->jump_successor_ = basic_blocks[last_instruction.destination_].get();
-					basic_blocks[last_instruction.destination_]->predecessors_.insert(basic_blocks[i].get());
-					//We set the target of this jump to some invalid value, because during the process of optimizations, we'll be using pointers
-					last_instruction.destination_ = 0xdead'beef;
+			current_.push_back({ op_code::program_exit, 1, locate(code.size()) }); //the epilogue of the program
+			finish_block();
+			return std::move(blocks_);
+		}
 
-					if (last_instruction.op_code_ == op_code::jump)
-						break;
+		/*Compiles a part of syntactically valid source code. The part is located at the given offset, which is either zero or the position
+		following a bracket, and starts on the given line, where depth loops are still open. The last part gets the program's exit.*/
+		compiled_part compile_part(std::string_view const part, std::size_t const offset, int const line, std::size_t const line_start,
+			std::ptrdiff_t const depth, bool const last) {
+			reset_compiler_state();
+			enclosing_loops_ = depth;
+
+			command_bitmap const commands{ part };
+			locator locate{ commands, offset, line, line_start };
+			if (offset == 0)
+				current_.push_back({ op_code::program_entry, 1, locate(0) });
+			scan(part, offset, commands, locate);
+
+			if (last) {
+				assert(opened_loops_.empty() && enclosing_loops_ == 0);
+				current_.push_back({ op_code::program_exit, 1, locate(part.size()) });
+				finish_block();
+			}
+			assert(current_.empty()); //the other parts end by a bracket
+			return { std::move(blocks_), std::move(opened_loops_), std::move(closing_conditions_), std::move(top_level_loops_) };
+		}
 
-				default:
-					basic_blocks[i]->natural_successor_ = basic_blocks[i + 1].get();
-					basic_blocks[i + 1]->predecessors_.insert(basic_blocks[i].get());
+		/*Joins the compiled parts of the source code in the order of the source, relabels their blocks and links loops crossing the parts.
+		The result equals the output of the compiler given the whole source code.*/
+		static std::vector<std::unique_ptr<basic_block>> stitch(std::vector<compiled_part>& parts, std::vector<top_level_loop>& top_level_loops) {
+			std::vector<std::ptrdiff_t> offsets(parts.size() + 1, 0); //label of the first block of each part
+			for (std::size_t i = 0; i < parts.size(); ++i) {
+				assert(!parts[i].blocks_.empty()); //each part contains a bracket or the program's exit
+				offsets[i + 1] = offsets[i] + static_cast<std::ptrdiff_t>(parts[i].blocks_.size());
+			}
 
-					break;
+			std::vector<std::unique_ptr<basic_block>> res(static_cast<std::size_t>(offsets.back()));
+			std::vector<std::size_t> indices(parts.size());
+			std::iota(indices.begin(), indices.end(), std::size_t{ 0 });
+			std::for_each(std::execution::par, indices.begin(), indices.end(), [&](std::size_t const i) {
+				std::vector<std::unique_ptr<basic_block>>& blocks = parts[i].blocks_;
+				for (std::size_t j = 0; j < blocks.size(); ++j) {
+					blocks[j]->label_ += offsets[i];
+					res[offsets[i] + j] = std::move(blocks[j]);
+				}
+				});
+
+			std::vector<std::pair<basic_block*, std::ptrdiff_t>> opened_loops;
+			top_level_loops.clear();
+			for (std::size_t i = 0; i < parts.size(); ++i) {
+				compiled_part const& part = parts[i];
+				basic_block* const first = res[offsets[i]].get();
+				if (basic_block* const previous = i ? res[offsets[i] - 1].get() : nullptr; previous && !previous->is_ujump()) {
+					previous->natural_successor_ = first;
+					first->predecessors_.insert(previous);
 				}
 
-			return basic_blocks;
+				for (basic_block* const condition : part.closing_conditions_) {
+					assert(!opened_loops.empty());
+					auto const [opening, body_label] = opened_loops.back();
+					opened_loops.pop_back();
+					link_loop(opening, condition, res[body_label].get());
+				}
+				for (auto const& [opening, body_label] : part.opened_loops_)
+					opened_loops.emplace_back(opening, body_label + offsets[i]);
+
+				for (top_level_loop loop : part.top_level_loops_) {
+					loop.condition_label_ += offsets[i];
+					if (loop.begin_ == opened_before_part) { //completes the last loop of a preceding part
+						top_level_loops.back().end_ = loop.end_;
+						top_level_loops.back().condition_label_ = loop.condition_label_;
+					}
+					else {
+						loop.body_label_ += offsets[i];
+						top_level_loops.push_back(loop);
+					}
+				}
+			}
+			assert(opened_loops.empty());
+			return res;
 		}
 
-	public:
-
-		std::vector<std::unique_ptr<basic_block>> compile(std::string_view const code) {
+		//Returns the top-level loops of the code compiled last
+		[[nodiscard]]
+		std::vector<top_level_loop> const& top_level_loops() const { return top_level_loops_; }
 
-			/* STEPS OF THE COMPILATION PROCESS:
-				starting conditions:
-					compiler object in an possibly undefined state if some conmpilation had already been perfromed
-					source code of the to-be-compiled program. It must be syntactically correct (otherwise an exception or crash occures)
-
-				1) Perform an assertion that the source code is valid as it's expected to be free of any syntax errors when given to the compiler.
-						- It does not matter whether the first and second steps are swapped, because should the code is invalid a crash will occur anyway.
+	};
 
-				2) Reset the compiler's state.
+	namespace {
 
-				3) Generate the ntermediate code - transform the given source code into a sequence of IR instructions.
+		compiler& compiler_instance() {
+			thread_local static compiler compiler;
+			return compiler;
+		}
 
-				4) Cache addresses of jump instructions to prevent repeating excess searches.
-					- Should be done simultaneously with the previous step
+		//Sources shorter than this are compiled by a single thread, splitting them would not pay off
+		constexpr std::size_t parallel_frontend_min_size = std::size_t{ 1 } << 24;
+		constexpr std::size_t min_part_size = std::size_t{ 1 } << 20;
+		constexpr std::size_t parts_per_thread = 4; //parts are not equally long, more of them balance the load of threads
+
+		/*Splits the source code into at most the given number of parts. Returns positions of their beginnings followed by the size of the code.
+		The code is split evenly first, then each boundary is moved forward right after the next bracket. A part without a bracket is merged
+		with the preceding one.*/
+		[[nodiscard]]
+		std::vector<std::size_t> split_source(std::string_view const code, std::size_t const parts) {
+			std::vector<std::size_t> boundaries(parts + 1);
+			std::iota(boundaries.begin(), boundaries.end(), std::size_t{ 0 });
+			std::for_each(std::execution::par, boundaries.begin() + 1, boundaries.end() - 1, [code, parts](std::size_t& boundary) {
+				auto const begin = code.begin() + code.size() * boundary / parts, end = code.begin() + code.size() * (boundary + 1) / parts;
+				auto const bracket = std::find_if(begin, end, [](char const c) { return c == '[' || c == ']'; });
+				boundary = bracket == end ? command_bitmap::npos : static_cast<std::size_t>(bracket - code.begin()) + 1;
+				});
+			boundaries.back() = code.size();
+
+			boundaries.erase(std::remove(boundaries.begin(), boundaries.end(), command_bitmap::npos), boundaries.end());
+			if (boundaries.size() > 2 && boundaries[boundaries.size() - 2] == code.size()) //the last bracket ends the code
+				boundaries.pop_back();
+			return boundaries;
+		}
 
-				5) Indentify and number labels (targets of jump instructions).
-					- Found labels mark instructions, that will later become the leaders of basic blocks.
+		/*Compiles source code by parts on all cores. The first pass summarizes the parts, which tells each of them its first line
+		and the number of loops opened before it and finds mismatched brackets by prefix sums of the depths. The second pass
+		compiles the parts and links loops crossing them afterwards. Returns std::nullopt if the brackets do not match.*/
+		[[nodiscard]]
+		std::optional<std::vector<std::unique_ptr<basic_block>>> build_blocks_in_parallel(std::string_view const code, std::vector<top_level_loop>& top_level_loops) {
+			std::size_t const threads = std::max(1u, std::thread::hardware_concurrency());
+			std::vector<std::size_t> const boundaries = split_source(code, std::clamp(code.size() / min_part_size, std::size_t{ 1 }, parts_per_thread * threads));
+			std::size_t const parts = boundaries.size() - 1;
+			auto const part_of = [&](std::size_t const i) { return code.substr(boundaries[i], boundaries[i + 1] - boundaries[i]); };
+			std::vector<std::size_t> indices(parts);
+			std::iota(indices.begin(), indices.end(), std::size_t{ 0 });
+
+			std::vector<source_summary> summaries(parts);
+			{
+				stats::phase_timer const timer{ "syntax check" };
+				std::transform(std::execution::par, indices.begin(), indices.end(), summaries.begin(), [&](std::size_t const i) { return summarize_source(part_of(i)); });
+			}
 
-				6) Resolve destinations of jump instructions to target labels instead of instructions.
+			struct part_start {
+				int line_;
+				std::size_t line_start_; //position of the first character on the line
+				std::ptrdiff_t depth_; //number of loops opened by preceding parts that are still open
+			};
+			std::vector<part_start> starts(parts);
+			part_start next{ 1, 0, 0 };
+			for (std::size_t i = 0; i < parts; ++i) {
+				starts[i] = next;
+				if (next.depth_ + summaries[i].min_depth_ < 0) //some closing bracket has no matching opening one
+					return std::nullopt;
+				next.line_ += static_cast<int>(summaries[i].newlines_);
+				if (summaries[i].newlines_)
+					next.line_start_ = boundaries[i] + summaries[i].last_newline_ + 1;
+				next.depth_ += summaries[i].depth_;
+			}
+			if (next.depth_ != 0) //some loop is not closed
+				return std::nullopt;
 
-				7) Construct a net of basic blocks, each having an ID equal to the label denoting its leader instruction.
+			stats::phase_timer const timer{ "frontend" };
+			std::vector<compiler::compiled_part> compiled(parts);
+			std::transform(std::execution::par, indices.begin(), indices.end(), compiled.begin(), [&](std::size_t const i) {
+				return compiler{}.compile_part(part_of(i), boundaries[i], starts[i].line_, starts[i].line_start_, starts[i].depth_, i + 1 == parts);
+				});
+			return compiler::stitch(compiled, top_level_loops);
+		}
 
-				8) End of algorithm. The entry block is returned.
+		std::vector<std::unique_ptr<basic_block>> build_blocks(std::string_view const code, std::vector<top_level_loop>& top_level_loops) {
+			if (code.size() >= parallel_frontend_min_size) {
+				std::optional<std::vector<std::unique_ptr<basic_block>>> res = build_blocks_in_parallel(code, top_level_loops);
+				assert(res); //the syntax has been checked before
+				return std::move(*res);
+			}
 
-			*/
+			stats::phase_timer const timer{ "frontend" };
+			command_bitmap const commands{ code };
+			std::vector<std::unique_ptr<basic_block>> res = compiler_instance().compile(code, commands);
+			top_level_loops = compiler_instance().top_level_loops();
+			return res;
+		}
 
-			assert(is_syntactically_valid(code));
+		//Shorter loops are left to the transformation of the whole program, transforming them separately would not pay off
+		constexpr std::size_t min_incremental_loop_length = 256;
+
+		/*Top-level loop transformed as a program of its own. Source locations are relative to its opening bracket located at 1:1.*/
+		struct transformed_loop {
+			std::vector<std::unique_ptr<basic_block>> blocks_; //the block entered from the code preceding the loop comes first
+			std::size_t exit_index_; //index of the block falling through to the code following the loop
+		};
+
+		/*Loops transformed by the latest incremental transformation of this thread keyed by its description and the source of the loop.
+		Loops the latest transformation did not use are dropped, hence the cache does not outgrow the program.*/
+		thread_local std::unordered_map<std::string, transformed_loop> transformed_loops;
+
+		/*Returns a copy of the blocks with edges among them redirected to the copies. Source locations relative to a loop are moved
+		to the location of its opening bracket.*/
+		[[nodiscard]]
+		std::vector<std::unique_ptr<basic_block>> copy_blocks(std::vector<std::unique_ptr<basic_block>> const& blocks, source_location const origin) {
+			std::map<basic_block const*, basic_block*> copies;
+			std::vector<std::unique_ptr<basic_block>> res;
+			res.reserve(blocks.size());
+			for (auto const& block : blocks) {
+				basic_block* const copy = res.emplace_back(std::make_unique<basic_block>(block->label_, block->ops_)).get();
+				copies.emplace(block.get(), copy);
+				for (instruction& inst : copy->ops_) {
+					if (inst.source_loc_.line_ == 1)
+						inst.source_loc_.column_ += origin.column_ - 1;
+					inst.source_loc_.line_ += origin.line_ - 1;
+				}
+			}
+			for (auto const& block : blocks) {
+				basic_block* const copy = copies.at(block.get());
+				for (auto const successor : basic_block::successor_ptrs)
+					if (block.get()->*successor)
+						copy->*successor = copies.at(block.get()->*successor);
+				for (basic_block* const predecessor : block->predecessors_)
+					copy->predecessors_.insert(copies.at(predecessor));
+			}
+			return res;
+		}
 
-			reset_compiler_state();
+		/*Transforms the source of a top-level loop as a program of its own. The program's entry is followed by a read, a search and another read.
+		The search starts on an unknown cell, hence it forgets the zeroed tape and the position of the cell pointer, and the second read forgets
+		the zero it stops at. Nothing is known about the memory nor the cell pointer afterwards, therefore the transformed loop is valid wherever it is spliced.
+		Returns an empty optional if the transformation has not kept the entry and the exit of the program recognizable.*/
+		[[nodiscard]]
+		std::optional<transformed_loop> transform_loop(std::string_view const source, previous_compilation::loop_transformation const& transformation) {
+			std::vector<top_level_loop> nested;
+			std::vector<std::unique_ptr<basic_block>> blocks = build_blocks(source, nested);
+			std::vector<instruction>& entry = blocks.front()->ops_;
+			source_location const loc = entry.front().source_loc_;
+			entry.insert(entry.begin() + 1, { instruction{ op_code::read, 1, loc }, instruction{ op_code::search_right, 1, loc }, instruction{ op_code::read, 1, loc } });
+
+			transformation(blocks, false, {});
+
+			std::vector<instruction> const& prologue = blocks.front()->ops_;
+			if (prologue.size() < 4 || prologue[0].op_code_ != op_code::program_entry || prologue[1].op_code_ != op_code::read
+				|| prologue[2].op_code_ != op_code::search_right || prologue[2].argument_ != 1 || prologue[3].op_code_ != op_code::read)
+				return std::nullopt;
+			auto const exits = [](std::unique_ptr<basic_block> const& block) {
+				return std::count_if(block->ops_.begin(), block->ops_.end(), [](instruction const& inst) { return inst.op_code_ == op_code::program_exit; });
+			};
+			auto const exit = std::find_if(blocks.begin(), blocks.end(), exits);
+			if (exit == blocks.end() || exits(*exit) != 1 || (*exit)->ops_.back().op_code_ != op_code::program_exit || (*exit)->natural_successor_
+				|| std::any_of(std::next(exit), blocks.end(), exits))
+				return std::nullopt;
 
-			generate_intermediate_code(code); //performs steps 3 and 4
+			blocks.front()->ops_.erase(blocks.front()->ops_.begin(), blocks.front()->ops_.begin() + 4);
+			(*exit)->ops_.pop_back();
+			std::size_t const exit_index = static_cast<std::size_t>(exit - blocks.begin());
+			return transformed_loop{ std::move(blocks), exit_index };
+		}
 
-			identify_labels();
+		std::set<basic_block const*> splice_transformed_loops(std::vector<std::unique_ptr<basic_block>>& program, std::string_view const source,
+			std::vector<top_level_loop> const& top_level_loops, std::string_view const description, previous_compilation::loop_transformation const& transformation) {
+			std::unordered_map<std::string, transformed_loop> used;
+			std::set<basic_block const*> settled;
+			std::vector<std::unique_ptr<basic_block>> res;
+			res.reserve(program.size());
+			std::ptrdiff_t next = 0; //label of the first block of the frontend's output not taken over yet
+
+			for (top_level_loop const& loop : top_level_loops) {
+				if (loop.end_ - loop.begin_ < min_incremental_loop_length)
+					continue;
+				std::string_view const loop_source = source.substr(loop.begin_, loop.end_ - loop.begin_);
+				std::string key = std::string{ description }.append("\n").append(loop_source);
+				auto cached = used.find(key);
+				if (cached == used.end()) {
+					if (auto const found = transformed_loops.find(key); found != transformed_loops.end())
+						cached = used.insert(transformed_loops.extract(found)).position;
+					else if (std::optional<transformed_loop> transformed = transform_loop(loop_source, transformation))
+						cached = used.emplace(std::move(key), std::move(*transformed)).first;
+					else
+						continue; //the loop is left to the transformation of the whole program
+				}
 
-			resolve_jump_targets();
+				//the block preceding the loop jumps to its condition; it falls through to the transformed loop instead
+				std::move(program.begin() + next, program.begin() + loop.body_label_, std::back_inserter(res));
+				basic_block* const opening = res.back().get();
+				basic_block const* const condition = program[loop.condition_label_].get();
+				basic_block* const following = program[loop.condition_label_ + 1].get();
+				assert(opening->is_ujump() && opening->jump_successor_ == condition && following->has_predecessor(condition));
+				next = loop.condition_label_ + 1;
+
+				std::vector<std::unique_ptr<basic_block>> copy = copy_blocks(cached->second.blocks_, loop.location_);
+				basic_block* const exit = copy[cached->second.exit_index_].get();
+				opening->ops_.pop_back();
+				opening->jump_successor_ = nullptr;
+				opening->natural_successor_ = copy.front().get();
+				copy.front()->add_predecessor(opening);
+				following->remove_predecessor(const_cast<basic_block*>(condition));
+				exit->natural_successor_ = following;
+				following->add_predecessor(exit);
+
+				//the entry and the exit have lost the prologue and the epilogue, their neighbours have to be revisited
+				auto const touches = [](basic_block const* const block, basic_block const* const other) {
+					return block == other || block->natural_successor_ == other || block->jump_successor_ == other || block->has_predecessor(other);
+				};
+				for (auto const& block : copy)
+					if (!touches(block.get(), copy.front().get()) && !touches(block.get(), exit))
+						settled.insert(block.get());
+				std::move(copy.begin(), copy.end(), std::back_inserter(res));
+			}
+			std::move(program.begin() + next, program.end(), std::back_inserter(res));
 
-			return construct_program_blocks();
+			program = std::move(res); //blocks of the replaced loops are released
+			for (std::size_t i = 0; i < program.size(); ++i)
+				program[i]->label_ = static_cast<std::ptrdiff_t>(i);
+			transformed_loops = std::move(used);
+			return settled;
 		}
 
-	};
-
-	namespace {
-
 		/*Wrapper namespace for types and functions for compile_callback. One shall not pollute global namespace.*/
 		namespace compile_callback_helper {
+			//Returns true iff the brackets of the source code match
+			[[nodiscard]]
+			bool check_syntax(std::string_view const code) {
+				stats::phase_timer const timer{ "syntax check" };
+				return is_syntactically_valid(code);
+			}
+
+			/*Classifies the characters of the source code, which checks that its brackets match as well.*/
+			[[nodiscard]]
+			command_bitmap scan_commands(std::string_view const code) {
+				stats::phase_timer const timer{ "syntax check" };
+				return command_bitmap{ code };
+			}
+
+			/*Collects all syntax errors of invalid source code and saves them as the result of compilation. Always returns false.*/
+			bool do_compile_invalid(source_code_t source) {
+				std::vector<syntax_error> syntax_errors = [&source] {
+					stats::phase_timer const timer{ "syntax check" };
+					return syntax_validation_detailed(view_of(source));
+				}();
+				assert(syntax_errors.size()); //must contain some errors; we can assert this just for fun :D
+				previous_compilation::prev_compilation_result = std::make_unique<compilation_result>(std::move(source), std::move(syntax_errors), std::vector<std::unique_ptr<basic_block>>{}); //empty vector for illegal code
+				return false; //indicate that compilation failed
+			}
+
 			/*Tries to validate and compile given code and set global variable last_compilation_result
 			according to the compilation's outcome.	If there are no errors, new syntax_tree is generated,
 			otherwise only list of errors is saved. Returns true if compilation was OK.*/
-			bool do_compile(std::string code) { // takes code by value, because it is moved later
-				thread_local static compiler compiler;
+			bool do_compile(source_code_t source) { // takes source by value, because it is moved later
+				std::string_view const code = view_of(source);
+
+				//with the cache enabled the compilation is deferred, because its result may be found in the cache
+				if (image::cache::enabled()) {
+					if (!check_syntax(code))
+						return do_compile_invalid(std::move(source));
+					std::string cache_key = "source:" + std::to_string(image::hash(code)) + ":" + std::to_string(code.size());
+					auto& result = previous_compilation::prev_compilation_result = std::make_unique<compilation_result>(std::move(source), std::vector<syntax_error>{},
+						std::vector<std::unique_ptr<basic_block>>{});
+					result->cache_key_ = std::move(cache_key);
+					result->compilation_pending_ = true;
+					return true;
+				}
+
+				//large code is checked and compiled by all cores
+				if (code.size() >= parallel_frontend_min_size) {
+					std::vector<top_level_loop> top_level_loops;
+					std::optional<std::vector<std::unique_ptr<basic_block>>> code_blocks = build_blocks_in_parallel(code, top_level_loops);
+					if (!code_blocks)
+						return do_compile_invalid(std::move(source));
+					auto& result = previous_compilation::prev_compilation_result = std::make_unique<compilation_result>(std::move(source), std::vector<syntax_error>{},
+						std::move(*code_blocks));
+					result->top_level_loops_ = std::move(top_level_loops);
+					return true;
+				}
 
-				if (is_syntactically_valid(code)) { //first perform quick scan for errors. If there are none, proceed with compilation
-					auto code_blocks = compiler.compile(code);
+				//first perform quick scan for errors. If there are none, proceed with compilation reusing the classified source code
+				if (command_bitmap const commands = scan_commands(code); commands.brackets_match()) {
+					stats::phase_timer const timer{ "frontend" };
+					auto code_blocks = compiler_instance().compile(code, commands);
 					assert(!code_blocks.empty()); //must be true, as the code had already undergone a syntax check
-					previous_compilation::prev_compilation_result = std::make_unique<compilation_result>(std::move(code), std::vector<syntax_error>{},
+					auto& result = previous_compilation::prev_compilation_result = std::make_unique<compilation_result>(std::move(source), std::vector<syntax_error>{},
 						std::move(code_blocks)); //move the entry_block pointer
+					result->top_level_loops_ = compiler_instance().top_level_loops();
 					return true; //return true indicating that compilation did not encounter any errors
 				}
-				else { //quick scan found some errors. Scan again collecting all possible information
-					std::vector<syntax_error> syntax_errors = syntax_validation_detailed(code);
-					assert(syntax_errors.size()); //must contain some errors; we can assert this just for fun :D
-					previous_compilation::prev_compilation_result = std::make_unique<compilation_result>(std::move(code), std::move(syntax_errors), std::vector<std::unique_ptr<basic_block>>{}); //empty vector for illegal code
-					return false; //indicate that compilation failed
-				}
+				else //quick scan found some errors
+					return do_compile_invalid(std::move(source));
 			}
 
 			/*Reads the source code for compilation and reports errors if reading does not succeed.
-			If the arguments are ok, returns std::optional containing the source code. An empty object is returned otherwise.*/
-			std::optional<std::string> get_source_code(std::string_view const source, std::string_view const arg) {
+			If the arguments are ok, returns std::optional containing the source code. An empty object is returned otherwise.
+			Files are mapped to memory instead of being read.*/
+			std::optional<source_code_t> get_source_code(std::string_view const source, std::string_view const arg) {
 				if (source == "code") //second arg is raw source code
 					return std::string{ arg };
 
 				//the first arg is "file", therefore the second one is file name
 				if (source == "file") {
-					std::optional<std::string> const file_content = utils::read_file(arg);
-					if (!file_content.has_value()) //if file doesn't exist, print error
+					std::optional<utils::mapped_file> file_content = utils::mapped_file::open(arg);
+					if (!file_content.has_value()) { //if file doesn't exist, print error
 						cli::print_command_error(cli::command_error::file_not_found);
-
-					//return the optional. On success this holds a valid source code, on failure this is constructed from std::nullopt
-					return file_content;
+						return std::nullopt;
+					}
+					return std::move(*file_content);
 				}
 
 				//first argument is not valid - print error
@@ -376,7 +862,7 @@ namespace bf {
 			if (int const ret_code = utils::check_command_argc(3, 3, argv))
 				return ret_code; //there must be three arguments
 
-			std::optional<std::string> source_code = helper::get_source_code(argv[1], argv[2]);
+			std::optional<source_code_t> source_code = helper::get_source_code(argv[1], argv[2]);
 			if (!source_code.has_value())
 				return 4;
 
@@ -389,6 +875,10 @@ namespace bf {
 				return 1;
 			}
 			//compilation was successful 
+			if (previous_compilation::compilation_deferred()) {
+				std::cout << "Source code is valid. The compilation is deferred until the program is needed, it may be found in the cache.\n";
+				return 0;
+			}
 			std::size_t const instruction_count = previous_compilation::generate_executable_code().size();
 			std::cout << "Successfully compiled " << instruction_count << " instruction" << utils::print_plural(instruction_count) << ".\n";
 			return 0;
@@ -465,8 +955,39 @@ namespace bf {
 			}
 		}
 
+		/*Function callback for the "incremental" cli command. Expects an optional argument "on" or "off".
+		Prints the current setting if there is no argument.*/
+		int incremental_callback(cli::command_parameters_t const& argv) {
+			if (int const ret_code = utils::check_command_argc(1, 2, argv))
+				return ret_code;
+
+			if (argv.size() == 2) {
+				if (argv[1] == "on")
+					incremental_compilation() = true;
+				else if (argv[1] == "off") {
+					incremental_compilation() = false;
+					transformed_loops.clear();
+				}
+				else {
+					cli::print_command_error(cli::command_error::argument_not_recognized);
+					return 4;
+				}
+			}
+
+			std::cout << "Incremental compilation is " << (incremental_compilation() ? "enabled" : "disabled") << ".\n";
+			return 0;
+		}
+
 	} //namespace bf::`anonymous namespace`
 
+	bool& incremental_compilation() {
+		static bool enabled = true;
+		return enabled;
+	}
+
+	bool compile_source(std::string source) {
+		return compile_callback_helper::do_compile(std::move(source));
+	}
 
 	void compiler_initialize() {
 		ASSERT_IS_CALLED_ONLY_ONCE;
@@ -487,6 +1008,15 @@ namespace bf {
 			"\targument == non-negative number => prints information about a single error specified by the number\n"
 			"\targument value of \"full\" has therefore the same effect as consecutive calls of this command specifying err numbers in increasing order.\n"
 			, &errors_callback);
+
+		add_command("incremental", command_category::compilation, "Controls incremental optimization of edited programs.",
+			"Usage: \"incremental\" [on | off]\n"
+			"If enabled, the \"optimize\" command optimizes top-level loops of the program separately before the whole program and remembers\n"
+			"the results. After the source is edited and compiled again, only loops whose text has changed are optimized from scratch,\n"
+			"the others are spliced into the new program. The whole program is then optimized, but the spliced loops are only revisited where\n"
+			"they meet the surrounding code or constants propagated into them. Loops shorter than " + std::to_string(min_incremental_loop_length) + " characters\n"
+			"are always optimized as a part of the whole program. Without arguments prints the current setting. Enabled by default."
+			, &incremental_callback);
 	}
 
 
@@ -1,4 +1,5 @@
 #include "data_inspection.h"
+#include "expression.h"
 #include "utils.h"
 #include "cli.h"
 #include "emulator.h"
@@ -12,6 +13,11 @@
 #include <iostream>
 #include <cassert>
 #include <charconv>
+#include <array>
+#include <climits>
+#include <memory>
+#include <fstream>
+#include <optional>
 
 //TODO due to possibility of unaligned memory inspection, either force reads be memory-alined, or use packed struct
 
@@ -231,8 +237,7 @@ namespace bf::data_inspection {
 					if (expression.empty()) //empty expression does not need to be split further, does it?
 						return {};
 					std::vector<std::string_view> tokens;
-					std::string_view::const_iterator iter = expression.cbegin(),
-						end = expression.cend();
+					std::string_view::const_iterator iter = expression.cbegin();
 
 					//Check for and handle situation that the expression starts with an operator
 					if (char c = *iter; c == '+') //if we start with a single prefix plus, we ignore it
@@ -244,18 +249,9 @@ namespace bf::data_inspection {
 						++iter;
 					}
 
-					for (; iter != end; ) {
-						std::string_view::const_iterator end_of_token = std::next(iter);
-						if (*iter == '$') //parse a name of a variable
-							while (end_of_token != end && std::isalpha(*end_of_token, std::locale{}))
-								++end_of_token;
-						else if (std::isdigit(*iter, std::locale{}))  //parse numeric literal
-							while (end_of_token != end && std::isdigit(*end_of_token, std::locale{}))
-								++end_of_token;
-						//operators are always single letter -> just append them to the list
-						tokens.emplace_back(expression.data() + std::distance(expression.cbegin(), iter), std::distance(iter, end_of_token));
-						iter = end_of_token;
-					}
+					//the rest is split by the tokenizer shared with expressions of breakpoints' conditions
+					std::vector<std::string_view> const rest = expression::tokenize(expression.substr(std::distance(expression.cbegin(), iter)));
+					tokens.insert(tokens.end(), rest.begin(), rest.end());
 					return tokens;
 				}
 
@@ -395,8 +391,8 @@ namespace bf::data_inspection {
 						else if (token.front() == '$') { //a variable encountered
 							if (token == "$pc") //program counter
 								return execution::emulator.program_counter();
-							else if (token == "$cpr") //cell pointer register
-								return execution::emulator.cell_pointer_offset();
+							else if (token == "$cpr") //cell pointer register; data is addressed in bytes, hence the cell's index is scaled by its size
+								return execution::emulator.cell_pointer_offset() * static_cast<std::ptrdiff_t>(execution::cell_size(execution::emulator.get_cell_width()));
 							else
 								MUST_NOT_BE_REACHED; //validating function should have cought all errors and typos
 						}
@@ -485,21 +481,28 @@ namespace bf::data_inspection {
 				}
 
 
+				/*Evaluates an arithmetic expression specifying an offset in the given address space. If the expression contains an error
+				(multiple operators in a row, multiple occurences of register, address space mismatch and so on), an error message is printed
+				and an empty optional returned, since there is no point trying to evaluate it.*/
+				std::optional<std::ptrdiff_t> evaluate_offset(std::string_view const expression, address_space const space) {
+					std::vector<std::string_view> const expression_pieces = tokenize_arithmetic_expression(expression);
+					if (expression_pieces.size() % 2 == 0 || expression_validator{ space }(expression_pieces)) {
+						std::cerr << "Unable to examine memory using invalid syntax for address string. Check help message for this command.\n";
+						return std::nullopt;
+					}
+					return expression_evaluator{}(expression_pieces);
+				}
+
 				/*Tries to parse a string containing the address and sets the corresponding field in the referenced structure accordingly.
 				If an erroneous string is given or any other error is encountered, non-zero integer is returned. If the address is specified relative to some
 				cpu register then the calculation of offsets is performed and pointer directly to the requested instruction is calculated.*/
 				int resolve_address(request_params& request, std::string_view const address_string) {
 					address_space const expected_address_space = request.type_ == data_type::instruction ? address_space::code : address_space::data;
-					std::vector<std::string_view> expression_pieces = tokenize_arithmetic_expression(address_string);
-
-					/*If the arithmetic expression contains an error (multiple operators in a row, multiple occurences of register and so on),
-					or an address space mismatch occures, there is no point trying to evaluate it. Return error code*/
-					if (expression_validator{ expected_address_space }(expression_pieces)) {
-						std::cerr << "Unable to examine memory using invalid syntax for address string. Check help message for this command.\n";
+					std::optional<std::ptrdiff_t> const evaluated_offset = evaluate_offset(address_string, expected_address_space);
+					if (!evaluated_offset)
 						return 4;
-					}
 
-					std::ptrdiff_t memory_offset = expression_evaluator{}(expression_pieces);		//calculate the memory offset specified by the user
+					std::ptrdiff_t memory_offset = *evaluated_offset;		//the memory offset specified by the user
 					if (request.print_preceding_memory_) //and take the possible inversion of direction into account
 					//if the user requested printing memory cells before address, decrease the starting offset to the address of first printed element
 						memory_offset -= request.count_ * sizeof_data_type(request.type_);
@@ -509,7 +512,7 @@ namespace bf::data_inspection {
 							return 1; //in case we were too far out of bounds, return err code
 
 					if (expected_address_space == address_space::data) { //data memory shall be inspected
-						if (memory_offset >= execution::emulator.memory_size()) {//we want some data behind the end of memory
+						if (memory_offset >= distance_in_bytes(execution::emulator.memory_begin(), execution::emulator.memory_end())) {//we want some data behind the end of memory
 							std::cerr << "Specified address was out of bounds.\n";
 							return 2;
 						}
@@ -582,27 +585,37 @@ namespace bf::data_inspection {
 				}
 
 
-				/*Helper function for do_print. If the given character is printable, it is returned as it is. If it denotes an escape
-				sequence, a short string represenation is printed. Otherwise hex value is printed.*/
-				std::string get_readable_char_representation(char const c) {
-					using namespace std::string_literals;
-					static std::unordered_map<char, std::string> const escape_sequences{
-						{'\0', "NUL"s},
-						{'\n', "LF"s},
-						{'\t', "HT"s},
-						{'\v', "VT"s},
-						{'\a', "BEL"s},
-						{'\b', "BS"s},
-						{'\r', "CR"s}
-					};
-					if (std::isprint(c, std::locale{})) //alphanumeric chars and punctuation can be printed
-						return { c };
-					if (escape_sequences.count(c)) //escape sequences
-						return escape_sequences.at(c);
-
-					std::array<char, 8> buffer = { "0x" };
-					std::to_chars(buffer.data() + 2, buffer.data() + buffer.size(), static_cast<unsigned int>(c), 16);
-					return buffer.data(); //hex value for others
+				/*Helper function for do_print. If the given character is printable, it is represented by itself. If it denotes an escape
+				sequence, a short string represenation is used. Otherwise its hex value is used. Representations of all characters
+				are prepared just once, since one is looked up for each printed byte.*/
+				std::string_view get_readable_char_representation(char const c) {
+					static std::array<std::string, 1 << CHAR_BIT> const representations = [] {
+						using namespace std::string_literals;
+						std::unordered_map<char, std::string> const escape_sequences{
+							{'\0', "NUL"s},
+							{'\n', "LF"s},
+							{'\t', "HT"s},
+							{'\v', "VT"s},
+							{'\a', "BEL"s},
+							{'\b', "BS"s},
+							{'\r', "CR"s}
+						};
+						std::array<std::string, 1 << CHAR_BIT> result;
+						for (int i = 0; i < static_cast<int>(result.size()); ++i) {
+							char const character = static_cast<char>(i);
+							if (std::isprint(character, std::locale{})) //alphanumeric chars and punctuation can be printed
+								result[i] = { character };
+							else if (escape_sequences.count(character)) //escape sequences
+								result[i] = escape_sequences.at(character);
+							else { //hex value for others
+								std::array<char, 8> buffer = { "0x" };
+								std::to_chars(buffer.data() + 2, buffer.data() + buffer.size(), i, 16);
+								result[i] = buffer.data();
+							}
+						}
+						return result;
+					}();
+					return representations[static_cast<unsigned char>(c)];
 				}
 
 				//Constants specifying the expected ideal maximum width of single element's string representation. Based on an educated guess
@@ -661,22 +674,97 @@ namespace bf::data_inspection {
 
 				//TODO add binary printing
 
-				/*I've been writing this function for half an hour and am fed up with it, so comment has to wait for now.
-				This function does the heavy lifting of printing to stdout and is a victim of severe optimizations of mine.
+				/*Buffer of formatted output of fixed capacity allocated just once. Rows of the table are formatted directly into it
+				and the buffer is written to stdout whenever it runs out of space. Inspecting the entire memory therefore neither reallocates
+				nor builds the whole table in memory.*/
+				class output_buffer {
+					static constexpr std::size_t capacity = 1 << 20;
+
+					std::unique_ptr<char[]> const data_ = std::make_unique<char[]>(capacity);
+					std::size_t size_ = 0;
+
+				public:
+					output_buffer() = default;
+					~output_buffer() { flush(); }
+
+					output_buffer(output_buffer const&) = delete;
+					output_buffer& operator=(output_buffer const&) = delete;
+
+					//Returns a pointer to at least count free characters, the buffer is flushed if necessary. Characters are then written by commit
+					[[nodiscard]]
+					char* reserve(std::size_t const count) {
+						assert(count <= capacity);
+						if (capacity - size_ < count)
+							flush();
+						return data_.get() + size_;
+					}
+
+					//Marks characters up to the given pointer as written. The pointer must have been obtained from reserve
+					void commit(char const* const end) {
+						assert(data_.get() + size_ <= end && end <= data_.get() + capacity);
+						size_ = end - data_.get();
+					}
+
+					void append(std::string_view const text) {
+						commit(std::copy(text.begin(), text.end(), reserve(text.size())));
+					}
+
+					void flush() {
+						std::cout.write(data_.get(), size_);
+						size_ = 0;
+					}
+				};
+
+				//Maximal length of a number's string representation including the radix prefix (64-bit number in octal)
+				constexpr std::size_t max_number_length = 32;
+
+				/*Writes the given text right-aligned in a field of the given width the same way std::setw would.
+				Returns pointer past the last written character.*/
+				char* write_field(char* out, std::string_view const text, std::size_t const width) {
+					if (text.size() < width)
+						out = std::fill_n(out, width - text.size(), ' ');
+					return std::copy(text.begin(), text.end(), out);
+				}
+
+				/*Converts the given number to a string in the given format using std::to_chars. The result matches what a stream
+				would print with std::showbase and std::uppercase set (i.e. zero has no radix prefix). A view of the string stored in buffer is returned.*/
+				template<printing_format FORMAT, typename NUMBER>
+				std::string_view format_number(std::array<char, max_number_length>& buffer, NUMBER const value) {
+					static_assert(FORMAT == printing_format::hex || FORMAT == printing_format::oct
+						|| FORMAT == printing_format::dec_signed || FORMAT == printing_format::dec_unsigned);
+					constexpr int radix = FORMAT == printing_format::hex ? 16 : FORMAT == printing_format::oct ? 8 : 10;
+
+					char* digits = buffer.data();
+					if constexpr (FORMAT == printing_format::hex) {
+						if (value)
+							digits = std::copy_n("0X", 2, digits);
+					}
+					else if constexpr (FORMAT == printing_format::oct) {
+						if (value)
+							*digits++ = '0';
+					}
+					char* const end = std::to_chars(digits, buffer.data() + buffer.size(), value, radix).ptr;
+					if constexpr (FORMAT == printing_format::hex)
+						std::transform(digits, end, digits, [](char const c) { return c >= 'a' ? static_cast<char>(c - 'a' + 'A') : c; });
+					return { buffer.data(), static_cast<std::size_t>(end - buffer.data()) };
+				}
+
+				/*This function does the heavy lifting of printing to stdout and is a victim of severe optimizations of mine.
 				Previously 5 functions were used, each of them operating on a single width of data, but that had proven useless,
-				messy, unmaintainable and the worst thing - template-less. It has been fixed since.
+				messy, unmaintainable and the worst thing - template-less. It has been fixed since. Later on formatting through
+				stream manipulators had proven too slow for inspection of megabytes of memory, so rows are now formatted by hand.
 
 				This function prints a table filled with count pieces of data located at the requested address.
 				This function accepts an address and a number of elements, which shall be read from memory starting at that address.
-				The type of data is passed as type template parameter, the other two template parameters are a pointer specifying
-				the IO manipulator which shall be used to convert numbers to the correct radix and an integer literal specifying
-				the width (number of characters) that shall be reserved for a single element's string representation to preserve
-				nice formatting of the table. Hopefully.
+				The type of data is passed as type template parameter, the other template parameter specifies the format
+				in which elements are printed. Traits of these parameters specify the width (number of characters) that shall be reserved
+				for a single element's string representation to preserve nice formatting of the table. Hopefully.
 
 				First the memory region which is to be inspected is located and it is ensured that the function will only read
 				elements from valid memory by shrinking the range so that it fits withing the boundaries of cpu's memory.
-				Then a buffer is constructed and the first line containing the address offsets is printed. After that lines are
-				printed one by one advancing the pointer until it traverses the entire sequence. The function then returns.
+				Then the first line containing the address offsets is printed. After that lines are formatted one by one using std::to_chars
+				into a single preallocated buffer advancing the pointer until it traverses the entire sequence. Runs of rows identical
+				to the previous one are collapsed to a single asterisk like xxd does, which makes long stretches of zeroes cheap to skip.
 				*/
 				template<typename T, printing_format FORMAT>
 				void do_print_data(void* const address, std::ptrdiff_t const count) {
@@ -685,54 +773,69 @@ namespace bf::data_inspection {
 
 					using traits = do_print_data_traits<T, FORMAT>;
 					static_assert(traits::value, "Invalid arguments specified to the function!");
+					using ELEMENT_TYPE = typename traits::ELEMENT_TYPE;
 
 					//Get boundaries between which it is safe to read values from memory
-					inspected_memory_region<typename traits::ELEMENT_TYPE> inspected_memory = get_inspected_memory_region<typename traits::ELEMENT_TYPE>(address, count);
+					inspected_memory_region<ELEMENT_TYPE> inspected_memory = get_inspected_memory_region<ELEMENT_TYPE>(address, count);
 					if (count == inspected_memory.unreachable_count_)   //we are too close to boundary, must return
 						return;
 					constexpr std::size_t bytes_per_line = 16;
-					constexpr std::ptrdiff_t elements_on_line = bytes_per_line / sizeof(typename traits::ELEMENT_TYPE); //number of consecutive elements which will reside on single line
-
-					std::ostringstream stream; //Output buffer enormously increasing the speed of printing
-					stream << std::uppercase << std::right << std::setw(12) << "address/offset" << std::hex; //set alignment to left and enable printing of radix-prefix
-					for (int i = 0; i < elements_on_line; ++i) //print column descriptions (=offsets from the address printed at the beginning of line)
-						stream << std::setw(traits::NUMBER_WIDTH) << i * sizeof(typename traits::ELEMENT_TYPE);
-					stream << std::setfill('0') << std::showbase << "\n\n";
+					constexpr std::ptrdiff_t elements_on_line = bytes_per_line / sizeof(ELEMENT_TYPE); //number of consecutive elements which will reside on single line
+					constexpr std::size_t address_width = 12;
+					//upper bound of a single line's length; fields longer than their width overflow it just like they would with std::setw
+					constexpr std::size_t max_line_length = max_number_length + elements_on_line * std::max<std::size_t>(traits::NUMBER_WIDTH, max_number_length) + 2;
+
+					output_buffer buffer;
+					std::array<char, max_number_length> number;
+
+					//print column descriptions (=offsets from the address printed at the beginning of line)
+					char* header = write_field(buffer.reserve(max_line_length), "address/offset", address_width);
+					for (std::ptrdiff_t i = 0; i < elements_on_line; ++i)
+						header = write_field(header, { &"0123456789ABCDEF"[i * sizeof(ELEMENT_TYPE)], 1 }, traits::NUMBER_WIDTH);
+					buffer.commit(std::copy_n("\n\n", 2, header));
+
+					//prints the offset of the first element followed by elements in the given range
+					auto const print_line = [&](std::ptrdiff_t const memory_offset, ELEMENT_TYPE const* const begin, ELEMENT_TYPE const* const end) {
+						char* out = write_field(buffer.reserve(max_line_length), format_number<printing_format::hex>(number, memory_offset), address_width);
+						for (ELEMENT_TYPE const* element = begin; element != end; ++element)
+							if constexpr (FORMAT == printing_format::character)
+								out = write_field(out, get_readable_char_representation(*element), traits::NUMBER_WIDTH); //print as character
+							else
+								out = write_field(out, format_number<FORMAT>(number, *element), traits::NUMBER_WIDTH); //print as a number
+						*out++ = '\n';
+						buffer.commit(out);
+					};
 
 					std::ptrdiff_t memory_offset = distance_in_bytes(execution::emulator.memory_begin(), inspected_memory.begin_);
+					ELEMENT_TYPE const* previous_line = nullptr; //beginning of the last printed full line
+					bool collapsing = false; //true iff the previous line was identical to the last printed line and has been replaced by an asterisk
 
 					//While there are more elements than can fit on a single line, print them by lines
-					while (distance_in_bytes(inspected_memory.begin_, inspected_memory.end_) >= elements_on_line) {
-						//first print the pointer value and follow it with the given manipulator 
-						stream << std::setw(12) << std::setfill(' ') << std::hex << memory_offset << traits::RADIX_MANIPULATOR;
-						memory_offset += bytes_per_line;
-
-						for (int i = 0; i < elements_on_line; ++i, ++inspected_memory.begin_) {//print values
-							stream << std::setw(traits::NUMBER_WIDTH); //reserves enough space in output stream
-							if constexpr (std::is_same_v<std::remove_cv_t<typename traits::ELEMENT_TYPE>, char>)
-								stream << get_readable_char_representation(*inspected_memory.begin_); //print as character
-							else
-								stream << +*inspected_memory.begin_; //print as a number
+					for (; inspected_memory.end_ - inspected_memory.begin_ >= elements_on_line; inspected_memory.begin_ += elements_on_line, memory_offset += bytes_per_line) {
+						ELEMENT_TYPE const* const line_end = inspected_memory.begin_ + elements_on_line;
+						if (previous_line && std::equal(inspected_memory.begin_, line_end, previous_line)) {
+							if (!collapsing)
+								buffer.append("*\n");
+							collapsing = true;
+							continue;
 						}
-						stream << '\n';
+						collapsing = false;
+						print_line(memory_offset, inspected_memory.begin_, line_end);
+						previous_line = inspected_memory.begin_;
 					}
+					if (collapsing) //the last full line is printed even if it was collapsed to show where the inspected region ends
+						print_line(memory_offset - bytes_per_line, inspected_memory.begin_ - elements_on_line, inspected_memory.begin_);
 					if (inspected_memory.begin_ != inspected_memory.end_) { //if there is a part of line remaining
-						stream << std::setw(12) << std::setfill(' ') << std::hex << memory_offset << traits::RADIX_MANIPULATOR;
-						for (; inspected_memory.begin_ != inspected_memory.end_; ++inspected_memory.begin_) {//print the address followed by consecutive values again
-							stream << std::setw(traits::NUMBER_WIDTH); //reserve space once more
-							if constexpr (std::is_same_v<std::remove_cv_t<typename traits::ELEMENT_TYPE>, char>)
-								stream << get_readable_char_representation(*inspected_memory.begin_); //print as char 
-							else
-								stream << +*inspected_memory.begin_; //print as number
-						}
-						stream << '\n';
+						print_line(memory_offset, inspected_memory.begin_, inspected_memory.end_);
+						inspected_memory.begin_ = inspected_memory.end_;
 					}
+					buffer.flush();
+
 					if (inspected_memory.unreachable_count_) //requested memory would exceed cpu's internal memory
-						stream << "Another " << std::dec << inspected_memory.unreachable_count_ << " element" << utils::print_plural(inspected_memory.unreachable_count_, " has", "s have")
+						std::cout << "Another " << inspected_memory.unreachable_count_ << " element" << utils::print_plural(inspected_memory.unreachable_count_, " has", "s have")
 						<< " been requested, but " << utils::print_plural(inspected_memory.unreachable_count_, "was", "were") << " out of bounds of cpu's memory.\n";
 					if (std::ptrdiff_t const misalign = distance_in_bytes(inspected_memory.begin_, execution::emulator.memory_end()))
-						stream << "There have also been " << misalign << " misaligned memory locations between last printed address and memory's boundary.\n";
-					std::cout << stream.str(); //print buffer's content to stdout
+						std::cout << "There have also been " << misalign << " misaligned memory locations between last printed address and memory's boundary.\n";
 				}
 
 				/*Performs static dispatch and calls appropriate function for given combination of type (=byte width) and requested printing format.
@@ -779,19 +882,24 @@ namespace bf::data_inspection {
 							<< std::setw(6) << instruction_address++ << "   ";
 
 						if (current_instruction->op_code_ == op_code::breakpoint) { //if we encounter a breakpoint, we print the replaced instruction instead
-							//get the address of this instruction
-							std::ptrdiff_t const addr = distance_in_bytes(execution::emulator.instructions_begin(), current_instruction);
-							instruction const& replaced_instruction = breakpoints::bp_manager.get_replaced_instruction_at(addr); //the replaced instruction to be printed
-							auto const& breakpoints_here = breakpoints::bp_manager.get_breakpoints_at(addr); //get all breakpoints_here located at this address
-
-							stream << replaced_instruction.op_code_ << ' ' << std::left << std::setw(12) << replaced_instruction.argument_
-								<< " <= breakpoint" << utils::print_plural(breakpoints_here.size()) << ' ';
+							//get the address of this instruction; breakpoints are identified by the index of the instruction
+							std::ptrdiff_t const addr = std::distance(execution::emulator.instructions_cbegin(), current_instruction);
+							instruction const& replaced_instruction = execution::emulator.breakpoints().get_replaced_instruction_at(addr); //the replaced instruction to be printed
+							auto const& breakpoints_here = execution::emulator.breakpoints().get_breakpoints_at(addr); //get all breakpoints_here located at this address
+
+							std::ostringstream replaced;
+							replaced << replaced_instruction;
+							stream << std::left << std::setw(24) << replaced.str();
+							if (breakpoints_here.empty()) //the instruction is only checked by watchpoints
+								stream << " <= watched";
+							else
+								stream << " <= breakpoint" << utils::print_plural(breakpoints_here.size()) << ' ';
 
 							std::transform(breakpoints_here.cbegin(), breakpoints_here.cend(), std::ostream_iterator<int>{ stream, " " },
 								[](breakpoints::breakpoint const* const bp) -> int {return bp->id_; });
 						}
 						else
-							stream << current_instruction->op_code_ << ' ' << current_instruction->argument_; //normal instructions are simply printed
+							stream << *current_instruction; //normal instructions are simply printed
 						stream << '\n';
 					}
 					std::ptrdiff_t const instructions_not_printed = std::distance(current_instruction, static_cast<instruction const*>(starting_address) + count);
@@ -835,6 +943,44 @@ namespace bf::data_inspection {
 				print_functions.at(request.type_)(request.address_, request.count_, request.format_);
 			}
 
+
+			/*Writes the raw content of a range of data memory to a binary file. The range is specified as a string "begin:end", both bounds being
+			address expressions like in the case of memory inspection. A missing bound is replaced by the beginning or the end of memory respectively.
+			If no range is given, the entire memory is written. Returns zero if everything goes well, some non-zero integer otherwise.*/
+			int dump_memory(std::string_view const file_name, std::optional<std::string_view> const range) {
+				std::ptrdiff_t const memory_bytes = distance_in_bytes(execution::emulator.memory_begin(), execution::emulator.memory_end());
+				std::ptrdiff_t begin = 0, end = memory_bytes;
+
+				if (range) {
+					std::size_t const colon = range->find(':');
+					if (colon == std::string_view::npos) {
+						std::cerr << "Range of memory must be specified as begin:end.\n";
+						return 3;
+					}
+					std::string_view const bounds[] = { range->substr(0, colon), range->substr(colon + 1) };
+					std::ptrdiff_t* const values[] = { &begin, &end };
+					for (int i = 0; i < 2; ++i)
+						if (!bounds[i].empty()) {
+							std::optional<std::ptrdiff_t> const value = parsing::evaluate_offset(bounds[i], parsing::address_space::data);
+							if (!value)
+								return 4;
+							*values[i] = std::clamp<std::ptrdiff_t>(*value, 0, memory_bytes);
+						}
+				}
+				if (begin >= end) {
+					std::cerr << "The specified range of memory is empty.\n";
+					return 5;
+				}
+
+				std::ofstream file{ std::string{ file_name }, std::ios::binary | std::ios::trunc };
+				if (!file.write(static_cast<char const*>(execution::emulator.memory_begin()) + begin, end - begin)) {
+					std::cerr << "Cannot write to file " << file_name << ".\n";
+					return 6;
+				}
+				std::cout << "Written " << end - begin << " byte" << utils::print_plural(end - begin) << " of memory [" << begin << ", " << end << ") to " << file_name << ".\n";
+				return 0;
+			}
+
 		} //namespace bf::data_inspection::`anonymous`::mem_callback_helper
 
 		/*Callback function for the "mem" cli command. Accepts two arguments, the first one being the inspection request
@@ -843,7 +989,7 @@ namespace bf::data_inspection {
 		Returns zero if everything goes well, some non-zero integer otherwise.*/
 		int mem_callback(cli::command_parameters_t const& argv) {
 			namespace helper = mem_callback_helper;
-			if (int const code = utils::check_command_argc(3, 3, argv))
+			if (int const code = utils::check_command_argc(3, 4, argv))
 				return code;
 
 			if (!execution::emulator.has_program()) {
@@ -853,6 +999,13 @@ namespace bf::data_inspection {
 				return 18;
 			}
 
+			if (argv[1] == "dump") //raw content of memory shall be written to a file
+				return helper::dump_memory(argv[2], argv.size() == 4 ? std::optional<std::string_view>{ argv[3] } : std::nullopt);
+			if (argv.size() == 4) {
+				cli::print_command_error(cli::command_error::too_many_arguments);
+				return 2;
+			}
+
 			auto const [request_params, code] = helper::parsing::parse_parameters(argv[1], argv[2]);
 			if (code)
 				return code;
@@ -876,8 +1029,9 @@ namespace bf::data_inspection {
 				};
 
 				void print_cpr() {
+					int const width = static_cast<int>(execution::emulator.get_cell_width());
 					std::cout << std::setw(20) << std::left << "Cell Pointer:" << execution::emulator.cell_pointer_offset()
-						<< ", valid address space [0, " << execution::emulator.memory_size() << ").\n";
+						<< ", valid address space [0, " << execution::emulator.memory_size() << "), cells have " << width << " bits.\n";
 				};
 
 			}
@@ -915,12 +1069,14 @@ namespace bf::data_inspection {
 		ASSERT_IS_CALLED_ONLY_ONCE;
 
 		cli::add_command("mem", cli::command_category::debugging, "Examines emulator's memory",
-			"Usage: \"mem\" request address\n\n"
+			"Usage: \"mem\" request address\n"
+			"   or: \"mem\" dump file [range]\n\n"
 
 			"Parameter address denotes the address relative to which the examination shall be performed.\n"
 			"Its value may be specified as an arithmetic expression using addition, subtraction and simple multiplication of integers\n"
 			"as well as using one of the variables \"$cpr\" or \"$pc\", which are replaced by the current values of emulator's\n"
-			"cell pointer register ($cpr) and the program counter register ($pc) respectively. It is also important to understand, that\n"
+			"cell pointer register ($cpr) and the program counter register ($pc) respectively. Data are addressed in bytes, $cpr\n"
+			"is therefore the offset of the first byte of the current cell. It is also important to understand, that\n"
 			"instructions and data reside in separate address spaces which do not overlap. It is therefore an error\n"
 			"to request instructions from an address relative to the CPR or vice versa examine data from addresses relative to PC.\n\n"
 
@@ -942,7 +1098,12 @@ namespace bf::data_inspection {
 			"elements preceding this location are printed.\n\n"
 
 			"If the requested memory area exceeds the bounds of memory, it is shrinked by an integer multiple of type's size in bytes, this operation\n"
-			"is repeated for both ends of the area to prevent access violations.\n\n"
+			"is repeated for both ends of the area to prevent access violations.\n"
+			"Consecutive rows of data identical to the previous row are collapsed to a single line containing an asterisk; the last row is always printed.\n\n"
+
+			"The second form writes the raw content of the data memory to the given file. The optional range has the form begin:end, both bounds\n"
+			"being address expressions as described above. If a bound is omitted, the beginning or the end of memory is used. Without range\n"
+			"the entire memory is written.\n\n"
 
 
 			"Keep in mind that executable instructions and memory for data reside in entirely different address spaces, it is therefore an error\n"
@@ -969,7 +1130,9 @@ namespace bf::data_inspection {
 			"\"mem c2 0\"              => print two characters from the beginning of the memory.\n"
 			"\"mem sb-4 $cpr\"         => print four bytes preceding the cpu's cell pointer interpreting them as signed numbers.\n"
 			"\"mem i14 $pc+9\"         => print fourteen instructions starting at offset nine relative to the program counter.\n"
-			"\"mem -i 11\"             => print single instruction preceding the instruction at address 11 (i.e. print instruction at address 10)."
+			"\"mem -i 11\"             => print single instruction preceding the instruction at address 11 (i.e. print instruction at address 10).\n"
+			"\"mem dump tape.bin\"     => write the whole memory to file tape.bin.\n"
+			"\"mem dump t.bin $cpr:\"  => write memory from the cell pointer to the end of memory to file t.bin."
 
 			, &mem_callback);
 		cli::add_command_alias("x", "mem");
@@ -0,0 +1,295 @@
+#include "emit.h"
+#include "cli.h"
+#include "utils.h"
+#include "compiler.h"
+#include "emulator.h"
+
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <cassert>
+
+namespace bf::emit {
+
+	namespace {
+
+		/*Generator of C source from linear executable code. The compiler lays out a loop [body] as
+			i: branch t; body; t: branch_nz i + 1
+		which is emitted as a while loop, provided nothing else jumps to the condition. Loops whose entry test has been optimized away
+		end with a backward branch_nz to their first instruction and are emitted as do-while loops. Since C allows jumping into blocks,
+		any remaining jump is simply a goto to a label.*/
+		class c_generator {
+
+			std::vector<instruction> const& code_;
+			std::ptrdiff_t const memory_size_;
+			execution::cell_width const width_;
+			std::ptrdiff_t const code_size_;
+
+			std::vector<int> jump_sources_;   //number of jumps targeting each instruction
+			std::vector<bool> structured_;    //jumps lowered to structured loops
+			std::vector<bool> labeled_;       //instructions that need a label
+			std::ostringstream body_;
+
+			[[nodiscard]]
+			std::ptrdiff_t reduced(std::ptrdiff_t const count) const { return count % memory_size_; }
+
+			//Returns a C literal of the constant's value modulo the cell's width
+			[[nodiscard]]
+			std::string constant(std::ptrdiff_t const value) const {
+				return std::to_string(execution::wrap_unsigned(value, width_)) + "u";
+			}
+
+			void indent(int const depth) {
+				for (int i = 0; i < depth; ++i)
+					body_ << '\t';
+			}
+
+			//Returns the address of while loop's condition if a while loop starts at the given address within [.., end), otherwise -1
+			[[nodiscard]]
+			std::ptrdiff_t while_loop_condition(std::ptrdiff_t const address, std::ptrdiff_t const end) const {
+				instruction const& head = code_[address];
+				if (head.op_code_ != op_code::branch || head.destination_ <= address || head.destination_ >= end)
+					return -1;
+				instruction const& condition = code_[head.destination_];
+				if (condition.op_code_ != op_code::branch_nz || condition.destination_ != address + 1 || jump_sources_[head.destination_] != 1)
+					return -1;
+				return head.destination_;
+			}
+
+			//Returns the address of the outermost do-while loop's condition if such loop starts at the given address, otherwise -1
+			[[nodiscard]]
+			std::ptrdiff_t do_while_condition(std::ptrdiff_t const address, std::ptrdiff_t const end) const {
+				for (std::ptrdiff_t i = end - 1; i > address; --i)
+					if (code_[i].op_code_ == op_code::branch_nz && code_[i].destination_ == address && jump_sources_[i] == 0 && !structured_[i])
+						return i;
+				return -1;
+			}
+
+			//Returns a C expression designating the cell at [p + offset]
+			[[nodiscard]]
+			std::string cell(std::ptrdiff_t const offset) const {
+				return offset == 0 ? "*p" : "*bf_at(p, " + std::to_string(reduced(offset)) + ")";
+			}
+
+			//Returns a C string literal with given contents. All characters but the plainly printable ones are escaped
+			[[nodiscard]]
+			static std::string string_literal(std::string_view const str) {
+				std::string literal = "\"";
+				for (char const c : str)
+					if (c == '"' || c == '\\' || c == '?') //question marks could form trigraphs
+						literal.append({ '\\', c });
+					else if (c >= ' ' && c <= '~')
+						literal.push_back(c);
+					else { //octal escapes have at most three digits, therefore they cannot swallow the following character
+						unsigned char const value = static_cast<unsigned char>(c);
+						literal.append({ '\\', static_cast<char>('0' + (value >> 6)), static_cast<char>('0' + ((value >> 3) & 7)), static_cast<char>('0' + (value & 7)) });
+					}
+				literal.push_back('"');
+				return literal;
+			}
+
+			void emit_instruction(instruction const& inst, int const depth) {
+				if (inst.is_nop() || inst.op_code_ == op_code::program_entry) //nothing to be done
+					return;
+				indent(depth);
+				switch (inst.op_code_) {
+				case op_code::inc:
+					body_ << "*p += " << constant(inst.argument_) << ";\n";
+					break;
+				case op_code::dec:
+					body_ << "*p -= " << constant(inst.argument_) << ";\n";
+					break;
+				case op_code::load_const:
+					body_ << "*p = " << constant(inst.argument_) << ";\n";
+					break;
+				case op_code::right:
+					body_ << "p = bf_at(p, " << reduced(inst.argument_) << ");\n";
+					break;
+				case op_code::left:
+					body_ << "p = bf_at(p, " << -reduced(inst.argument_) << ");\n";
+					break;
+				case op_code::right_unchecked:
+					body_ << "p += " << inst.argument_ << ";\n";
+					break;
+				case op_code::read:
+					body_ << "{ int const c = getchar(); if (c != EOF) *p = (cell_t)c; }\n";
+					break;
+				case op_code::write:
+					body_ << "putchar(*p);\n";
+					break;
+				case op_code::search_right:
+				case op_code::search_left:
+				{
+					std::ptrdiff_t const stride = inst.op_code_ == op_code::search_left ? -inst.argument_ : inst.argument_;
+					body_ << "while (*p) p = bf_at(p, " << reduced(stride) << ");\n";
+					break;
+				}
+				case op_code::clear_search_right:
+				case op_code::clear_search_left:
+				{
+					std::ptrdiff_t const stride = inst.op_code_ == op_code::clear_search_left ? -inst.argument_ : inst.argument_;
+					body_ << "while (*p) { *p = 0; p = bf_at(p, " << reduced(stride) << "); }\n";
+					break;
+				}
+				case op_code::fill_range:
+					body_ << "{ cell_t* q = bf_at(p, " << reduced(inst.offset_) << "); for (long i = 0; i < " << inst.destination_
+						<< "; ++i, q = bf_at(q, " << reduced(inst.stride_) << ")) *q = " << constant(inst.argument_) << "; }\n";
+					break;
+				case op_code::inc_offset:
+					body_ << cell(inst.offset_) << " += " << constant(inst.argument_) << ";\n";
+					break;
+				case op_code::load_const_offset:
+					body_ << cell(inst.offset_) << " = " << constant(inst.argument_) << ";\n";
+					break;
+				case op_code::write_offset:
+					body_ << "putchar(" << cell(inst.offset_) << ");\n";
+					break;
+				case op_code::mul_add:
+					body_ << cell(inst.offset_) << " += (cell_t)(*p * " << constant(inst.argument_) << ");\n";
+					break;
+				case op_code::write_string:
+					body_ << "fwrite(" << string_literal(constant_string(inst.offset_, inst.argument_))
+						<< ", 1, " << inst.argument_ << ", stdout);\n";
+					break;
+				case op_code::infinite: //argument tells whether the loop is entered when the cell is not zero
+					body_ << (inst.argument_ ? "if (*p)" : "if (!*p)") << " for (;;) {}\n";
+					break;
+				case op_code::branch:
+					body_ << "goto L" << inst.destination_ << ";\n";
+					break;
+				case op_code::branch_nz:
+					body_ << "if (*p) goto L" << inst.destination_ << ";\n";
+					break;
+				case op_code::program_exit:
+					body_ << "return 0;\n";
+					break;
+				default:
+					body_ << "abort(); /* instruction " << inst.op_code_ << " has no C equivalent */\n";
+				}
+			}
+
+			//The label of the first instruction is omitted if the enclosing do-while loop starting at it has already emitted it
+			void emit_range(std::ptrdiff_t const begin, std::ptrdiff_t const end, int const depth, bool const begin_labeled = false) {
+				for (std::ptrdiff_t i = begin; i < end; ++i) {
+					if (labeled_[i] && !(begin_labeled && i == begin)) {
+						indent(depth - 1);
+						body_ << "L" << i << ":;\n";
+					}
+
+					if (std::ptrdiff_t const condition = do_while_condition(i, end); condition != -1) {
+						structured_[condition] = true;
+						indent(depth);
+						body_ << "do {\n";
+						emit_range(i, condition, depth + 1, true);
+						indent(depth);
+						body_ << "} while (*p);\n";
+						i = condition;
+					}
+					else if (std::ptrdiff_t const condition = while_loop_condition(i, end); condition != -1) {
+						structured_[i] = structured_[condition] = true;
+						indent(depth);
+						body_ << "while (*p) {\n";
+						emit_range(i + 1, condition, depth + 1);
+						indent(depth);
+						body_ << "}\n";
+						i = condition;
+					}
+					else
+						emit_instruction(code_[i], depth);
+				}
+			}
+
+		public:
+			c_generator(std::vector<instruction> const& code, std::ptrdiff_t const memory_size, execution::cell_width const width)
+				: code_{ code }, memory_size_{ memory_size }, width_{ width }, code_size_{ static_cast<std::ptrdiff_t>(code.size()) },
+				jump_sources_(code.size() + 1, 0), structured_(code.size() + 1, false), labeled_(code.size() + 1, false) {
+				assert(memory_size > 0);
+				for (instruction const& inst : code_)
+					if (inst.is_jump())
+						++jump_sources_[inst.destination_];
+			}
+
+			std::string generate() {
+				/*The first pass only determines which jumps become loops. Targets of all other jumps get labels in the second one.
+				Decisions about loops do not depend on labels, so both passes produce the same structure.*/
+				emit_range(0, code_size_, 1);
+				for (std::ptrdiff_t i = 0; i < code_size_; ++i)
+					if (code_[i].is_jump() && !structured_[i])
+						labeled_[code_[i].destination_] = true;
+				std::fill(structured_.begin(), structured_.end(), false);
+				body_.str({});
+				emit_range(0, code_size_, 1);
+
+				std::ostringstream source;
+				source << "/* Generated by the brainfuck optimizing compiler. */\n"
+					"#include <stdint.h>\n"
+					"#include <stdio.h>\n"
+					"#include <stdlib.h>\n\n"
+					"#define MEMORY_SIZE " << memory_size_ << "\n\n"
+					"typedef uint" << static_cast<int>(width_) << "_t cell_t;\n\n"
+					"static cell_t memory[MEMORY_SIZE];\n\n"
+					"/* Returns the cell at p + offset, wrapping around the boundaries of memory. |offset| < MEMORY_SIZE */\n"
+					"static inline cell_t* bf_at(cell_t* p, long offset) {\n"
+					"\tp += offset;\n"
+					"\tif (p >= memory + MEMORY_SIZE) p -= MEMORY_SIZE;\n"
+					"\telse if (p < memory) p += MEMORY_SIZE;\n"
+					"\treturn p;\n"
+					"}\n\n"
+					"int main(void) {\n"
+					"\tcell_t* p = memory;\n"
+					<< body_.str();
+				if (labeled_[code_size_])
+					source << "L" << code_size_ << ":;\n";
+				//the exit of the program returns already unless a jump leads past it
+				if (code_.empty() || code_.back().op_code_ != op_code::program_exit || labeled_[code_size_])
+					source << "\treturn 0;\n";
+				source << "}\n";
+				return source.str();
+			}
+		};
+
+		/*Function callback for the "emit" cli command. Expects the target language and the name of output file.*/
+		int emit_callback(cli::command_parameters_t const& argv) {
+			if (int const code = utils::check_command_argc(3, 3, argv))
+				return code;
+
+			if (argv[1] != "c") {
+				std::cerr << "Unknown target language " << argv[1] << ". Supported is only \"c\".\n";
+				return 4;
+			}
+			if (!previous_compilation::ready() || !previous_compilation::successful()) {
+				std::cerr << "There is no successfully compiled program to emit.\n";
+				return 5;
+			}
+
+			std::ptrdiff_t const memory_size = execution::emulator.memory_size();
+			execution::cell_width const width = execution::emulator.get_cell_width();
+			std::string const source = generate_c_source(previous_compilation::generate_executable_code(memory_size, width), memory_size, width);
+
+			std::ofstream file{ std::string{ argv[2] } };
+			if (!(file << source)) {
+				std::cerr << "Cannot write to file " << argv[2] << ".\n";
+				return 6;
+			}
+			std::cout << "C source of the program written to " << argv[2] << ".\n";
+			return 0;
+		}
+
+	} //namespace bf::emit::`anonymous`
+
+	std::string generate_c_source(std::vector<instruction> const& code, std::ptrdiff_t const memory_size, execution::cell_width const width) {
+		return c_generator{ code, memory_size, width }.generate();
+	}
+
+	void initialize() {
+		ASSERT_IS_CALLED_ONLY_ONCE;
+
+		cli::add_command("emit", cli::command_category::compilation, "Translates the compiled program to source code of another language.",
+			"Usage: \"emit\" c file_name\n"
+			"Writes the result of the last compilation including all performed optimizations as a standalone C program to the given file.\n"
+			"The program uses memory of the same size as the emulator does. Loops are emitted as structured while loops,\n"
+			"which allows the host compiler to optimize them well; compile the result e.g. by \"cc -O2 file_name\"."
+			, &emit_callback);
+	}
+
+} //namespace bf::emit
@@ -1,9 +1,16 @@
 #include "emulator.h"
 #include "cli.h"
 #include "compiler.h"
+#include "memory_kernels.h"
+#include "stats.h"
 #include <cassert>
 #include <iostream>
 #include <charconv>
+#include <iterator>
+#include <algorithm>
+#include <functional>
+#include <new>
+#include <limits>
 
 namespace bf::execution {
 
@@ -11,17 +18,139 @@ namespace bf::execution {
 
 	void cpu_emulator::breakpoint_interrupt_handler() {
 		flags_register_.breakpoint_hit() = true; //set flag to interrupt execution
-		if (breakpoints::bp_manager.should_ignore_breakpoints_at(program_counter_)) {
+		if (breakpoints_.should_ignore_breakpoints_at(program_counter_)) {
 			flags_register_.breakpoint_hit() = false; //if breakpoints shall be ignored, proceed and before that
-			do_execute(breakpoints::bp_manager.get_replaced_instruction_at(program_counter_++)); //execute the replaced instruction 
+			do_execute(breakpoints_.get_replaced_instruction_at(program_counter_++)); //execute the replaced instruction 
 		}
 		else //otherwise break completely performing further operations requested by the breakpoints
-			breakpoints::bp_manager.handle_breakpoints_at(program_counter_);
+			breakpoints_.handle_breakpoints_at(program_counter_);
 	}
 
 	void cpu_emulator::flash_program(std::vector<instruction> new_instructions) {
 		instructions_ = std::move(new_instructions);
-		breakpoints::bp_manager.clear_all();
+		packed_code_ = IR::pack_executable_code(instructions_);
+		unchecked_shifts_memory_size_ = memory_size();
+		invalidate_jit();
+		back_edges_.assign(instructions_.size(), 0);
+		breakpoints_.clear_all();
+		reset_profile();
+		trace_.clear();
+		checkpoints_.clear(); //they refer to the previous program
+	}
+
+	void cpu_emulator::patch_instruction(std::ptrdiff_t const address, instruction const& replacement) {
+		assert(address >= 0 && address < instructions_size());
+		instructions_[address] = replacement;
+		packed_code_[address] = IR::packed_instruction::pack(replacement, address);
+		deoptimize(address);
+	}
+
+	void cpu_emulator::deoptimize(std::ptrdiff_t const address) {
+		jit_program_.reset();
+		for (auto loop = compiled_loops_.begin(); loop != compiled_loops_.end();)
+			if (loop->second->contains(address)) {
+				back_edges_[loop->first] = 0;
+				loop = compiled_loops_.erase(loop);
+			}
+			else
+				++loop;
+	}
+
+	checkpoint const& cpu_emulator::take_checkpoint(bool const automatic) {
+		flush_output(); //the output belongs to the past of the checkpoint
+		checkpoint res;
+		res.id_ = next_checkpoint_id_;
+		res.automatic_ = automatic;
+		res.program_counter_ = program_counter_;
+		res.executed_instructions_ = executed_instructions_counter_;
+		res.cell_pointer_ = cell_pointer_reg_ - memory_.data();
+		res.state_ = state_ == execution_state::running ? execution_state::interrupted : state_;
+		res.breakpoint_hit_ = flags_register_.breakpoint_hit();
+		res.halt_ = flags_register_.halt();
+		res.stdin_eof_ = stdin_eof_;
+		res.input_position_ = input_.position();
+		res.memory_ = memory_.take_snapshot();
+		++next_checkpoint_id_;
+		return checkpoints_.emplace_back(std::move(res));
+	}
+
+	checkpoint const* cpu_emulator::find_checkpoint(int const id) const {
+		auto const found = std::lower_bound(checkpoints_.begin(), checkpoints_.end(), id, [](checkpoint const& c, int const id) { return c.id_ < id; });
+		return found != checkpoints_.end() && found->id_ == id ? &*found : nullptr;
+	}
+
+	bool cpu_emulator::restore_checkpoint(checkpoint const& checkpoint) {
+		flush_output();
+		[[maybe_unused]] bool const restored = memory_.restore(checkpoint.memory_);
+		assert(restored); //checkpoints are discarded whenever memory is replaced
+		program_counter_ = checkpoint.program_counter_;
+		executed_instructions_counter_ = checkpoint.executed_instructions_;
+		cell_pointer_reg_ = memory_.data() + checkpoint.cell_pointer_;
+		state_ = checkpoint.state_;
+		flags_register_.breakpoint_hit() = checkpoint.breakpoint_hit_;
+		flags_register_.halt() = checkpoint.halt_;
+		stdin_eof_ = checkpoint.stdin_eof_;
+		next_automatic_checkpoint_ = executed_instructions_counter_ + automatic_checkpoint_interval_;
+		if (checkpoint.input_position_ < 0) //the console or a pipe cannot be rewound
+			return false;
+		return input_.seek(checkpoint.input_position_);
+	}
+
+	void cpu_emulator::set_automatic_checkpoint_interval(std::ptrdiff_t const instructions) {
+		assert(instructions >= 0);
+		automatic_checkpoint_interval_ = instructions;
+		next_automatic_checkpoint_ = executed_instructions_counter_ + instructions;
+	}
+
+	void cpu_emulator::take_automatic_checkpoint() {
+		if (!automatic_checkpoint_interval_ || executed_instructions_counter_ < next_automatic_checkpoint_)
+			return;
+		next_automatic_checkpoint_ = executed_instructions_counter_ + automatic_checkpoint_interval_;
+		try {
+			take_checkpoint(true);
+		}
+		catch (std::bad_alloc const&) {
+			*diagnostics_ << "\nCannot take an automatic checkpoint, automatic checkpoints have been disabled.\n";
+			automatic_checkpoint_interval_ = 0;
+			return;
+		}
+		if (std::count_if(checkpoints_.begin(), checkpoints_.end(), std::mem_fn(&checkpoint::automatic_)) > static_cast<std::ptrdiff_t>(max_automatic_checkpoints))
+			checkpoints_.erase(std::find_if(checkpoints_.begin(), checkpoints_.end(), std::mem_fn(&checkpoint::automatic_))); //drop the oldest one
+	}
+
+	void cpu_emulator::enable_profiling(bool const enable) {
+		profiling_ = enable;
+		reset_profile();
+	}
+
+	void cpu_emulator::reset_profile() {
+		taken_jumps_.assign(profiling_ ? instructions_.size() : 0, 0);
+		profiled_runs_ = 0;
+	}
+
+	void trace_buffer::resize(std::size_t const capacity) {
+		if (capacity == 0) {
+			records_.reset();
+			mask_ = 0;
+		}
+		else {
+			std::size_t rounded = 1;
+			while (rounded < capacity)
+				rounded <<= 1;
+			records_ = std::make_unique<trace_record[]>(rounded);
+			mask_ = rounded - 1;
+		}
+		recorded_ = 0;
+	}
+
+	void cpu_emulator::enable_tracing(bool const enable, std::size_t const capacity) {
+		if (enable) {
+			assert(capacity > 0);
+			if (trace_.capacity() != capacity)
+				trace_.resize(capacity);
+			trace_.clear();
+		}
+		tracing_ = enable; //the recorded steps are kept after the tracing is disabled
 	}
 
 	flag_reference<flag::halt> cpu_emulator::halt() {
@@ -45,83 +174,209 @@ namespace bf::execution {
 		program_counter_ = 0;
 		executed_instructions_counter_ = 0;
 
-		std::memset(memory_.data(), 0, sizeof(memory_));
+		memory_.clear();
 
 		flags_register_.reset();
 		cell_pointer_reg_ = memory_.data();
 		state_ = execution_state::not_started;
 		stdin_eof_ = false;
-		assert(emulated_program_stdin_);
+		next_automatic_checkpoint_ = automatic_checkpoint_interval_;
+		trace_.clear();
 		assert(emulated_program_stdout_);
-		if (emulated_program_stdin_ != &std::cin) {
-			emulated_program_stdin_->clear(); //if a disk file is used as CPU's input, reset it
-			emulated_program_stdin_->seekg(0);
-		}
+		input_.rewind(); //if a disk file is used as CPU's input, reset it
 	}
 
-	void cpu_emulator::right(std::ptrdiff_t count) {
+	void cpu_emulator::set_memory_size(std::ptrdiff_t const cells) {
+		memory_.resize(cells * static_cast<std::ptrdiff_t>(cell_size(cell_width_)));
+		memory_size_ = cells;
+		invalidate_jit(); //native code addresses the old memory
+		checkpoints_.clear(); //their memory cannot be restored to the new one
+		reset();
+	}
+
+	void cpu_emulator::set_cell_width(cell_width const width) {
+		memory_.resize(memory_size_ * static_cast<std::ptrdiff_t>(cell_size(width)));
+		cell_width_ = width;
+		engines_ = &engines_for(width);
+		invalidate_jit(); //native code is specialized for the width
+		checkpoints_.clear();
+		reset();
+	}
+
+	namespace {
+
+		/*Returns the product of a cell and a factor modulo 2^n. Cells narrower than int are promoted to (signed) int,
+		whose overflow would be undefined - the product is therefore computed in unsigned arithmetic.*/
+		template<typename CELL>
+		[[nodiscard]]
+		CELL multiply(CELL const cell, std::ptrdiff_t const factor) {
+			return static_cast<CELL>(static_cast<std::make_unsigned_t<std::ptrdiff_t>>(cell) * static_cast<std::make_unsigned_t<std::ptrdiff_t>>(factor));
+		}
+	} //namespace bf::execution::`anonymous`
+
+	template<typename CELL>
+	CELL* cpu_emulator::shifted_cell_pointer(CELL* pointer, std::ptrdiff_t count) {
 		assert(count != 0);
-		count %= memory_size();
-		cell_pointer_reg_ += count;
+		if (count >= memory_size_ || -count >= memory_size_) //most shifts are short; avoid the division for them
+			count %= memory_size_;
+		pointer += count;
+
+		if (pointer >= cells<CELL>() + memory_size_)   //if the value exceeds memory's bounds
+			pointer -= memory_size_;
+		else if (pointer < cells<CELL>())
+			pointer += memory_size_;
+		return pointer;
+	}
+
+	template<typename CELL>
+	CELL* cpu_emulator::search_zero_cell(CELL* const pointer, std::ptrdiff_t const stride) {
+		auto const found = kernels::find_zero(cells<CELL>(), memory_size_, pointer - cells<CELL>(), stride);
+		return found ? cells<CELL>() + *found : nullptr;
+	}
+
+	template<typename CELL>
+	CELL* cpu_emulator::clear_to_zero_cell(CELL* const pointer, std::ptrdiff_t const stride) {
+		return cells<CELL>() + kernels::clear_to_zero(cells<CELL>(), memory_size_, pointer - cells<CELL>(), stride);
+	}
 
-		if (cell_pointer_reg_ >= memory_end())   //if the value exceeds memory's bounds
-			cell_pointer_reg_ -= memory_size();
-		else if (cell_pointer_reg_ < memory_begin())
-			cell_pointer_reg_ += memory_size();
+	template<typename CELL>
+	void cpu_emulator::fill_cells(CELL* const first, std::ptrdiff_t const count, std::ptrdiff_t const stride, CELL const value) {
+		kernels::fill(cells<CELL>(), memory_size_, first - cells<CELL>(), count, stride, value);
 	}
 
-	void cpu_emulator::do_execute(instruction const& instruction) {
+	template<typename CELL>
+	void cpu_emulator::execute_instruction(instruction const& instruction) {
+		CELL* cpr = current_cell<CELL>(); //written back once the instruction has been executed
 		++executed_instructions_counter_;
 		switch (instruction.op_code_) {
 		case op_code::nop: //no-op
 			break;
 		case op_code::inc: //increase value of cell under the pointer
-			*cell_pointer_reg_ += static_cast<memory_cell_t>(instruction.argument_);
+			*cpr += static_cast<CELL>(instruction.argument_);
 			break;
 		case op_code::right: //move the pointer to right
-			right(instruction.argument_);
+			cpr = shifted_cell_pointer(cpr, instruction.argument_);
+			break;
+		case op_code::right_unchecked: //move the pointer to right without wrapping around, provided it is still safe
+			if (unchecked_shifts_safe()) {
+				cpr += instruction.argument_;
+				assert(cpr >= cells<CELL>() && cpr < cells<CELL>() + memory_size_);
+			}
+			else
+				cpr = shifted_cell_pointer(cpr, instruction.argument_);
 			break;
-		case op_code::jump: //TODO set it correctly, right now destination_ points to label
+		//all engines increment the PC before executing an instruction, therefore the jump is located at the previous address
+		case op_code::branch: //TODO set it correctly, right now destination_ points to label
+			count_taken_jump(program_counter_ - 1);
 			program_counter_ = instruction.destination_; //unconditionally jump to destination
 			break;
-		case op_code::jump_not_zero: //check value under the pointer. If it's nonzero, jump to the destination
-			if (*cell_pointer_reg_)
-				program_counter_ = instruction.destination_; //TODO same as for op_code::jump
+		case op_code::branch_nz: //check value under the pointer. If it's nonzero, jump to the destination
+			if (*cpr) {
+				count_taken_jump(program_counter_ - 1);
+				program_counter_ = instruction.destination_; //TODO same as for op_code::branch
+			}
 			break;
-		case op_code::read: //read char from stdin
-			if (int const read_char = emulated_program_stdin_->get(); read_char == std::char_traits<char>::eof()) {
-				std::cout << "\nEnd of input stream hit.\n";
+		case op_code::read: //read char from stdin; pending output may be a prompt, hence it is flushed unless the input is at hand already
+			if (!input_.buffered())
+				flush_output();
+			if (int const read_char = input_.get(); read_char == std::char_traits<char>::eof()) {
+				*diagnostics_ << "\nEnd of input stream hit.\n";
 				if (stdin_eof_)
 					flags_register_.os_interrupt() = true;
 				stdin_eof_ = true;
 			}
-			else
-				*cell_pointer_reg_ = static_cast<memory_cell_t>(read_char);
+			else {
+				*cpr = static_cast<CELL>(static_cast<unsigned char>(read_char));
+				++input_bytes_;
+			}
 			break;
 		case op_code::write: //print char to stdout
-			emulated_program_stdout_->put(static_cast<char>(*cell_pointer_reg_));
+			put_output(static_cast<char>(*cpr)); //only the lowest byte of wider cells is written
 			break;
 		case op_code::breakpoint: //pause the execution due to a breakpoint
 			--executed_instructions_counter_;
 			flags_register_.breakpoint_hit() = true;
 			break;
 		case op_code::load_const:
-			*cell_pointer_reg_ = static_cast<memory_cell_t>(instruction.argument_);
+			*cpr = static_cast<CELL>(instruction.argument_);
+			break;
+		case op_code::inc_offset: //offset-addressed forms operate on [cpr + offset] without moving the pointer
+			*shifted_cell_pointer(cpr, instruction.offset_) += static_cast<CELL>(instruction.argument_);
+			break;
+		case op_code::load_const_offset:
+			*shifted_cell_pointer(cpr, instruction.offset_) = static_cast<CELL>(instruction.argument_);
+			break;
+		case op_code::write_string: { //write a string of the constant pool
+			std::string_view const string = constant_string(instruction.offset_, instruction.argument_);
+			write_output(string.data(), string.size());
+			break;
+		}
+		case op_code::write_offset:
+			put_output(static_cast<char>(*shifted_cell_pointer(cpr, instruction.offset_)));
+			break;
+		case op_code::mul_add: //add a multiple of the current cell to [cpr + offset]
+			*shifted_cell_pointer(cpr, instruction.offset_) += multiply(*cpr, instruction.argument_);
+			break;
+		case op_code::search_right: //move the pointer by stride until it points to a zero cell
+		case op_code::search_left:
+			if (CELL* const found = search_zero_cell(cpr,
+				instruction.op_code_ == op_code::search_left ? -instruction.argument_ : instruction.argument_); found)
+				cpr = found;
+			else {
+				std::cerr << "Search at offset " << instruction.source_loc_ << " cannot find any zero cell and would never terminate. Halting.\n";
+				halt() = true;
+			}
+			break;
+		case op_code::clear_search_right: //clear cells on the way to a zero cell
+		case op_code::clear_search_left:
+			cpr = clear_to_zero_cell(cpr, instruction.op_code_ == op_code::clear_search_left ? -instruction.argument_ : instruction.argument_);
+			break;
+		case op_code::fill_range: //set a strided range of cells starting at [cpr + offset] to a constant
+			fill_cells(instruction.offset_ ? shifted_cell_pointer(cpr, instruction.offset_) : cpr, instruction.destination_, instruction.stride_, static_cast<CELL>(instruction.argument_));
+			break;
+		case op_code::infinite: //loop which never terminates once it is entered; the argument tells whether it is entered when the cell is not zero
+			if (instruction.argument_ ? *cpr != 0 : *cpr == 0) {
+				std::cerr << "Loop at offset " << instruction.source_loc_ << " has been entered and would never terminate. Halting.\n";
+				halt() = true;
+			}
+			break;
+		case op_code::program_entry: //formal instructions marking boundaries of the program behave as no-ops
+		case op_code::program_exit:
 			break;
-			//TODO add instruction like infinite, search etc
 		default: //die painfully
 			--executed_instructions_counter_;
 			std::cerr << "Unknown instruction " << instruction.op_code_ << " at offset " << instruction.source_loc_ << ". Halting.\n";
 			halt() = true;
 		}
+		cell_pointer_reg_ = reinterpret_cast<tape::byte_t*>(cpr);
 
 	}
 
-	void cpu_emulator::execution_stops_callback() {
+	void cpu_emulator::flush_output() {
+		emulated_program_stdout_->write(output_buffer_.data(), static_cast<std::streamsize>(output_buffer_size_));
 		emulated_program_stdout_->flush();
+		output_bytes_ += output_buffer_size_;
+		output_buffer_size_ = 0;
+	}
+
+	void cpu_emulator::write_output(char const* const data, std::size_t const length) {
+		if (output_buffer_size_ + length > output_buffer_capacity) {
+			flush_output();
+			if (length > output_buffer_capacity) { //would not fit even into an empty buffer
+				emulated_program_stdout_->write(data, static_cast<std::streamsize>(length));
+				output_bytes_ += length;
+				return;
+			}
+		}
+		std::copy_n(data, length, output_buffer_.data() + output_buffer_size_);
+		output_buffer_size_ += length;
+	}
+
+	void cpu_emulator::execution_stops_callback() {
+		flush_output();
 		execution_state new_state = execution_state::interrupted;
 		if (program_counter_ > 0 && instructions_[program_counter_ - 1].op_code_ == op_code::program_exit) {
-			std::cout << "\nExecution has finished.\n";
+			*diagnostics_ << "\nExecution has finished.\n";
 			new_state = execution_state::finished; //set state to finished. Memory may still be inspected, but PC is out of bounds
 		}
 		if (state_ != execution_state::halted)
@@ -130,26 +385,14 @@ namespace bf::execution {
 			cli::execute_command("stop", false);
 	}
 
-	void cpu_emulator::do_execute() {
-		assert(has_program()); //may be removed later if I find a case in which it is undesirable to crash if no program is contained.
-		assert(program_counter_ >= 0 && program_counter_ <= static_cast<std::ptrdiff_t>(instructions_.size())); //Sanity check for PC not out of bounds
-		assert(!flags_register_.halt());
-		state_ = execution_state::running;
-		flags_register_.os_interrupt() = false;
-		if (flags_register_.breakpoint_hit()) {  //we continue after a breakpoint, PC is pointing to the BP's address. First execute the substituted instruction
-			flags_register_.breakpoint_hit() = false;
-			if (breakpoints::bp_manager.count_breakpoints_at(program_counter_))
-				do_execute(breakpoints::bp_manager.get_replaced_instruction_at(program_counter_++));
-			else
-				do_execute(instructions_[program_counter_++]);
-			if (flags_register_.single_step())
-				return execution_stops_callback();
-		}
-
+	template<typename CELL>
+	void cpu_emulator::execute_debug() {
 		//the execution cannot proceed unless the halt flag is cleared 
 		for (; !flags_register_.halt() && program_counter_ < static_cast<std::ptrdiff_t>(instructions_.size());) {
 			assert(program_counter_ >= 0);
-			do_execute(instructions_[program_counter_++]); //increment PC immediatelly after instruction fetching to mimic real-life CPU 
+			if (tracing_)
+				trace_.record(program_counter_, current_cell<CELL>() - cells<CELL>(), static_cast<std::uint32_t>(*current_cell<CELL>()));
+			execute_instruction<CELL>(instructions_[program_counter_++]); //increment PC immediatelly after instruction fetching to mimic real-life CPU 
 			if (flags_register_.breakpoint_hit()) {
 				--program_counter_; //execution hit a breakpoint, decrement the PC to make it store hit BP's address
 				breakpoint_interrupt_handler(); //handle the interrupt request
@@ -158,13 +401,499 @@ namespace bf::execution {
 			}
 			assert(program_counter_ >= 0); //safety and sanity check
 			if (flags_register_.os_interrupt()) {
-				std::cout << "\nOperating system raised an interrupt signal!\n";
+				*diagnostics_ << "\nOperating system raised an interrupt signal!\n";
 				break;
 			}
 			if (flags_register_.single_step() || flags_register_.halt())
 				break;
 		}
+	}
+
+	//GCC and Clang support taking addresses of labels, which allows the fast engine to jump straight to the next handler
+#if defined(__GNUC__)
+#define BF_THREADED_DISPATCH
+#endif
+
+	template<typename CELL, bool COUNT_BACK_EDGES, bool TRACE>
+	void cpu_emulator::execute_fast() {
+		/*Registers of the CPU are cached in local variables for the whole run and written back by spill_registers before anything
+		that may observe them (breakpoint handling, unknown instructions, the end of execution) happens.
+		The engine executes the packed code; full records are only read for instructions packed in full form. */
+		IR::packed_instruction const* const code = packed_code_.data();
+		instruction const* const full_code = instructions_.data();
+		std::ptrdiff_t const code_size = instructions_size();
+		std::ptrdiff_t pc = program_counter_;
+		CELL* cpr = current_cell<CELL>();
+		std::ptrdiff_t executed = 0; //instructions executed since the last write back to executed_instructions_counter_
+		std::ptrdiff_t poll_countdown = interrupt_poll_interval;
+		bool const unchecked_shifts = unchecked_shifts_safe();
+		std::ptrdiff_t* const taken_jumps = profiling_ ? taken_jumps_.data() : nullptr; //counters of the profile, if it is collected
+		CELL const* const memory = cells<CELL>();
+
+		auto const spill_registers = [&] {
+			program_counter_ = pc;
+			cell_pointer_reg_ = reinterpret_cast<tape::byte_t*>(cpr);
+			executed_instructions_counter_ += executed;
+			executed = 0;
+		};
+		auto const reload_registers = [&] {
+			pc = program_counter_;
+			cpr = current_cell<CELL>();
+		};
+
+		if (pc == code_size) //nothing left to execute
+			return;
+
+#ifdef BF_THREADED_DISPATCH
+		/*Each handler is stored at the index of the op_code it executes, hence the table does not depend on the order of enumerators.
+		Op codes never present in executable code (e.g. dec and left) are left to the debug engine.*/
+		void* dispatch_table[IR::packed_instruction::handler_count];
+		std::fill(std::begin(dispatch_table), std::end(dispatch_table), &&op_unknown);
+#define BF_SET_HANDLER(name, handler) dispatch_table[IR::packed_instruction::handler_of(op_code::name)] = &&op_##handler
+		BF_SET_HANDLER(nop, nop);
+		BF_SET_HANDLER(inc, inc);
+		BF_SET_HANDLER(right, right);
+		BF_SET_HANDLER(right_unchecked, right_unchecked);
+		BF_SET_HANDLER(branch, branch);
+		BF_SET_HANDLER(branch_nz, branch_nz);
+		BF_SET_HANDLER(read, read);
+		BF_SET_HANDLER(write, write);
+		BF_SET_HANDLER(search_right, search_right);
+		BF_SET_HANDLER(search_left, search_left);
+		BF_SET_HANDLER(clear_search_right, clear_search_right);
+		BF_SET_HANDLER(clear_search_left, clear_search_left);
+		BF_SET_HANDLER(load_const, load_const);
+		BF_SET_HANDLER(inc_offset, inc_offset);
+		BF_SET_HANDLER(load_const_offset, load_const_offset);
+		BF_SET_HANDLER(write_offset, write_offset);
+		BF_SET_HANDLER(mul_add, mul_add);
+		BF_SET_HANDLER(write_string, write_string);
+		BF_SET_HANDLER(fill_range, full_form);
+		BF_SET_HANDLER(infinite, full_form);
+		BF_SET_HANDLER(breakpoint, breakpoint);
+		BF_SET_HANDLER(program_entry, program_entry);
+		BF_SET_HANDLER(program_exit, program_exit);
+#undef BF_SET_HANDLER
+		dispatch_table[IR::packed_instruction::full_form] = &&op_full_form;
+		dispatch_table[IR::packed_instruction::end_of_code] = &&op_end_of_code;
+
+#define BF_DISPATCH() do { BF_TRACE(); goto* dispatch_table[code[pc].handler_]; } while (0)
+#define BF_HANDLER(name) op_##name
+#else
+#define BF_DISPATCH() do { BF_TRACE(); goto dispatch; } while (0)
+#define BF_HANDLER(name) case IR::packed_instruction::handler_of(op_code::name)
+#endif
+		//every instruction is recorded right before its handler is entered
+#define BF_TRACE() do { if constexpr (TRACE) trace_.record(pc, cpr - memory, static_cast<std::uint32_t>(*cpr)); } while (0)
+#define BF_NEXT() do { ++pc; ++executed; BF_DISPATCH(); } while (0)
+
+		BF_DISPATCH();
+#ifndef BF_THREADED_DISPATCH
+	dispatch:
+		switch (code[pc].handler_) {
+#endif
+		BF_HANDLER(nop) :
+		BF_HANDLER(program_entry) :
+			BF_NEXT();
+
+		BF_HANDLER(inc) :
+			*cpr += static_cast<CELL>(code[pc].argument_);
+			BF_NEXT();
+
+		BF_HANDLER(right) :
+			cpr = shifted_cell_pointer(cpr, code[pc].argument_);
+			BF_NEXT();
+
+		BF_HANDLER(right_unchecked) :
+			cpr = unchecked_shifts ? cpr + code[pc].argument_ : shifted_cell_pointer(cpr, code[pc].argument_);
+			BF_NEXT();
+
+		BF_HANDLER(branch) :
+			if (taken_jumps)
+				++taken_jumps[pc];
+			pc += code[pc].argument_;
+			++executed;
+			BF_DISPATCH();
+
+		BF_HANDLER(branch_nz) :
+			if (!*cpr)
+				BF_NEXT();
+			if (taken_jumps)
+				++taken_jumps[pc];
+			if constexpr (COUNT_BACK_EDGES)
+				if (code[pc].argument_ < 0 && ++back_edges_[pc + code[pc].argument_] >= tier_up_threshold) {
+					hot_loop_end_ = pc + 1; //the tiered engine enters the loop's native code at its header
+					pc += code[pc].argument_;
+					++executed;
+					spill_registers();
+					return;
+				}
+			pc += code[pc].argument_;
+			++executed;
+			if (--poll_countdown == 0) { //periodically check for interrupts requested by the OS
+				poll_countdown = interrupt_poll_interval;
+				if (flags_register_.os_interrupt() || flags_register_.halt())
+					goto stop;
+				if (automatic_checkpoint_interval_) {
+					spill_registers();
+					take_automatic_checkpoint();
+				}
+			}
+			BF_DISPATCH();
+
+		BF_HANDLER(read) :
+			if (!input_.buffered())
+				flush_output();
+			if (int const read_char = input_.get(); read_char == std::char_traits<char>::eof()) {
+				*diagnostics_ << "\nEnd of input stream hit.\n";
+				if (stdin_eof_)
+					flags_register_.os_interrupt() = true;
+				stdin_eof_ = true;
+			}
+			else {
+				*cpr = static_cast<CELL>(static_cast<unsigned char>(read_char));
+				++input_bytes_;
+			}
+			++pc;
+			++executed;
+			if (flags_register_.os_interrupt())
+				goto stop;
+			BF_DISPATCH();
+
+		BF_HANDLER(write) :
+			put_output(static_cast<char>(*cpr));
+			BF_NEXT();
+
+		BF_HANDLER(load_const) :
+			*cpr = static_cast<CELL>(code[pc].argument_);
+			BF_NEXT();
+
+		BF_HANDLER(search_right) :
+			if (CELL* const found = search_zero_cell(cpr, code[pc].argument_); found) {
+				cpr = found;
+				BF_NEXT();
+			}
+			goto slow_path; //the search never terminates, let the debug engine report it
+
+		BF_HANDLER(search_left) :
+			if (CELL* const found = search_zero_cell(cpr, -code[pc].argument_); found) {
+				cpr = found;
+				BF_NEXT();
+			}
+			goto slow_path;
+
+		BF_HANDLER(clear_search_right) :
+			cpr = clear_to_zero_cell(cpr, code[pc].argument_);
+			BF_NEXT();
+
+		BF_HANDLER(clear_search_left) :
+			cpr = clear_to_zero_cell(cpr, -code[pc].argument_);
+			BF_NEXT();
+
+		BF_HANDLER(inc_offset) :
+			*shifted_cell_pointer(cpr, code[pc].offset_) += static_cast<CELL>(code[pc].argument_);
+			BF_NEXT();
+
+		BF_HANDLER(load_const_offset) :
+			*shifted_cell_pointer(cpr, code[pc].offset_) = static_cast<CELL>(code[pc].argument_);
+			BF_NEXT();
+
+		BF_HANDLER(write_offset) :
+			put_output(static_cast<char>(*shifted_cell_pointer(cpr, code[pc].offset_)));
+			BF_NEXT();
+
+		BF_HANDLER(mul_add) :
+			*shifted_cell_pointer(cpr, code[pc].offset_) += multiply(*cpr, code[pc].argument_);
+			BF_NEXT();
+
+		BF_HANDLER(write_string) :
+		{
+			std::string_view const string = constant_string(code[pc].argument_, code[pc].offset_);
+			write_output(string.data(), string.size());
+			BF_NEXT();
+		}
+
+#ifdef BF_THREADED_DISPATCH
+	op_full_form:
+#else
+		case IR::packed_instruction::full_form:
+		BF_HANDLER(fill_range) :
+		BF_HANDLER(infinite) :
+#endif
+		{
+			//operands of the instruction do not fit the packed encoding, they are read from its full record
+			instruction const& full = full_code[pc];
+			if (full.op_code_ == op_code::fill_range) {
+				fill_cells(full.offset_ ? shifted_cell_pointer(cpr, full.offset_) : cpr, full.destination_, full.stride_, static_cast<CELL>(full.argument_));
+				BF_NEXT();
+			}
+			spill_registers();
+			execute_instruction<CELL>(full_code[program_counter_++]);
+			if (flags_register_.halt())
+				return;
+			reload_registers();
+			if (flags_register_.os_interrupt() || pc == code_size)
+				goto stop;
+			BF_DISPATCH();
+		}
+
+		BF_HANDLER(breakpoint) :
+			spill_registers();
+			breakpoint_interrupt_handler(); //executes the replaced instruction provided all breakpoints here shall be ignored
+			if (flags_register_.breakpoint_hit()) //the breakpoint is still pending; registers are already written back
+				return;
+			reload_registers();
+			if (flags_register_.os_interrupt() || flags_register_.halt())
+				goto stop;
+			if (pc == code_size) //the replaced instruction was the last one
+				goto stop;
+			BF_DISPATCH();
+
+		BF_HANDLER(program_exit) :
+			++pc;
+			++executed;
+			goto stop;
+
+#ifdef BF_THREADED_DISPATCH
+	op_end_of_code:
+#else
+		case IR::packed_instruction::end_of_code:
+#endif
+			goto stop; //the code does not end with program_exit, pc stays at the end of code
+
+#ifdef BF_THREADED_DISPATCH
+	op_unknown:
+#else
+		default:
+#endif
+		slow_path:
+			//let the debug engine execute the instruction; it reports unknown or failing instructions and halts
+			spill_registers();
+			execute_instruction<CELL>(full_code[program_counter_++]);
+			return;
+#ifndef BF_THREADED_DISPATCH
+		}
+#endif
+
+	stop:
+		spill_registers();
+		if (flags_register_.os_interrupt())
+			*diagnostics_ << "\nOperating system raised an interrupt signal!\n";
+
+#undef BF_NEXT
+#undef BF_HANDLER
+#undef BF_DISPATCH
+#undef BF_TRACE
+	}
+
+	template<typename CELL>
+	int cpu_emulator::jit_read_helper(jit::context* const context, unsigned char* const cell) {
+		cpu_emulator& cpu = *static_cast<cpu_emulator*>(context->owner_);
+		if (!cpu.input_.buffered())
+			cpu.flush_output();
+		if (int const read_char = cpu.input_.get(); read_char == std::char_traits<char>::eof()) {
+			*cpu.diagnostics_ << "\nEnd of input stream hit.\n";
+			if (cpu.stdin_eof_)
+				cpu.flags_register_.os_interrupt() = true;
+			cpu.stdin_eof_ = true;
+		}
+		else {
+			*reinterpret_cast<CELL*>(cell) = static_cast<CELL>(static_cast<unsigned char>(read_char));
+			++cpu.input_bytes_;
+		}
+		return cpu.flags_register_.os_interrupt() ? 1 : 0;
+	}
+
+	template<typename CELL>
+	void cpu_emulator::jit_write_helper(jit::context* const context, unsigned char const* const cell) {
+		static_cast<cpu_emulator*>(context->owner_)->put_output(static_cast<char>(*reinterpret_cast<CELL const*>(cell)));
+	}
+
+	template<typename CELL>
+	unsigned char* cpu_emulator::jit_search_helper(jit::context* const context, unsigned char* const from, std::ptrdiff_t const stride) {
+		return reinterpret_cast<unsigned char*>(static_cast<cpu_emulator*>(context->owner_)->search_zero_cell(reinterpret_cast<CELL*>(from), stride));
+	}
+
+	template<typename CELL>
+	unsigned char* cpu_emulator::jit_clear_search_helper(jit::context* const context, unsigned char* const from, std::ptrdiff_t const stride) {
+		return reinterpret_cast<unsigned char*>(static_cast<cpu_emulator*>(context->owner_)->clear_to_zero_cell(reinterpret_cast<CELL*>(from), stride));
+	}
+
+	template<typename CELL>
+	void cpu_emulator::jit_fill_helper(jit::context* const context, unsigned char* const first, std::ptrdiff_t const address) {
+		cpu_emulator& cpu = *static_cast<cpu_emulator*>(context->owner_);
+		instruction const& fill = cpu.instructions_[address];
+		cpu.fill_cells(reinterpret_cast<CELL*>(first), fill.destination_, fill.stride_, static_cast<CELL>(fill.argument_));
+	}
+
+	bool cpu_emulator::enable_jit(bool const enable) {
+		if (enable && !jit::available)
+			return false;
+		jit_enabled_ = enable;
+		tiering_enabled_ = tiering_enabled_ && !enable;
+		return true;
+	}
+
+	bool cpu_emulator::enable_tiering(bool const enable) {
+		if (enable && !jit::available)
+			return false;
+		tiering_enabled_ = enable;
+		jit_enabled_ = jit_enabled_ && !enable;
+		return true;
+	}
+
+	template<typename CELL>
+	jit::context cpu_emulator::jit_context() {
+		jit::context context{};
+		context.owner_ = this;
+		context.read_ = &jit_read_helper<CELL>;
+		context.write_ = &jit_write_helper<CELL>;
+		context.search_ = &jit_search_helper<CELL>;
+		context.clear_search_ = &jit_clear_search_helper<CELL>;
+		context.fill_ = &jit_fill_helper<CELL>;
+		return context;
+	}
+
+	template<typename CELL>
+	bool cpu_emulator::run_native(jit::compiled_program const& program, jit::context& context) {
+		context.cell_pointer_ = cell_pointer_reg_;
+		context.executed_instructions_ = executed_instructions_counter_;
+		context.poll_countdown_ = interrupt_poll_interval;
+
+		program_counter_ = program.run(context, program_counter_);	//registers are consistent whenever the native code returns
+		cell_pointer_reg_ = context.cell_pointer_;
+		executed_instructions_counter_ = context.executed_instructions_;
+
+		switch (context.exit_reason_) {
+		case jit::exit_reason::finished:
+			return false;
+		case jit::exit_reason::poll:
+			take_automatic_checkpoint();
+			break;
+		case jit::exit_reason::leave: //the interpreter continues
+			break;
+		case jit::exit_reason::interpret: //behave exactly as the debug engine would for this instruction
+			execute_instruction<CELL>(instructions_[program_counter_++]);
+			if (flags_register_.breakpoint_hit()) {
+				--program_counter_;
+				breakpoint_interrupt_handler();
+				if (flags_register_.breakpoint_hit())
+					return false;
+			}
+			break;
+			ASSERT_NO_OTHER_OPTION;
+		}
+
+		if (flags_register_.os_interrupt()) {
+			*diagnostics_ << "\nOperating system raised an interrupt signal!\n";
+			return false;
+		}
+		return !flags_register_.halt();
+	}
+
+	template<typename CELL>
+	void cpu_emulator::execute_jit() {
+		if (!jit_program_)
+			jit_program_ = jit::compile(instructions_, memory_.data(), memory_size_, cell_width_, unchecked_shifts_safe());
+		if (!jit_program_) { //the program cannot be translated, the interpreter is the only option
+			std::cerr << "The JIT cannot translate the flashed program. Using the interpreter instead.\n";
+			jit_enabled_ = false;
+			return execute_fast<CELL>();
+		}
+
+		jit::context context = jit_context<CELL>();
+		while (program_counter_ < instructions_size())
+			if (!run_native<CELL>(*jit_program_, context))
+				return;
+	}
+
+	void cpu_emulator::promote_loop(std::ptrdiff_t const header, std::ptrdiff_t const end) {
+		if (std::unique_ptr<jit::compiled_program> native = jit::compile_region(instructions_, header, end, memory_.data(), memory_size_, cell_width_, unchecked_shifts_safe()))
+			compiled_loops_.emplace(header, std::move(native));
+		else
+			back_edges_[header] = std::numeric_limits<std::ptrdiff_t>::min();
+	}
+
+	template<typename CELL>
+	void cpu_emulator::execute_tiered() {
+		jit::context context = jit_context<CELL>();
+		std::ptrdiff_t last_loop = -1; //header of the loop whose native code has returned last
+		while (program_counter_ < instructions_size()) {
+			//native code is entered at the header of its loop or wherever it has returned to the emulator within the loop
+			auto loop = compiled_loops_.find(program_counter_);
+			if (loop == compiled_loops_.end())
+				if (auto const last = compiled_loops_.find(last_loop); last != compiled_loops_.end() && last->second->contains(program_counter_))
+					loop = last;
+
+			if (loop != compiled_loops_.end()) {
+				last_loop = loop->first;
+				if (!run_native<CELL>(*loop->second, context))
+					return;
+				continue;
+			}
+
+			hot_loop_end_ = 0;
+			execute_fast<CELL, true>(); //returns at the header of a loop which has become hot or once the execution stops
+			if (!hot_loop_end_)
+				return;
+			if (compiled_loops_.count(program_counter_) == 0)
+				promote_loop(program_counter_, hot_loop_end_);
+		}
+	}
+
+	void cpu_emulator::do_execute() {
+		if (!stats::measuring())
+			return resume_execution();
+
+		std::ptrdiff_t const instructions = executed_instructions_counter_;
+		std::size_t const input_bytes = input_bytes_, output_bytes = output_bytes_;
+		stats::clock::time_point const start = stats::clock::now();
+		resume_execution();
+		stats::record_execution(executed_instructions_counter_ - instructions, stats::clock::now() - start, input_bytes_ - input_bytes, output_bytes_ - output_bytes);
+	}
+
+	void cpu_emulator::resume_execution() {
+		assert(has_program()); //may be removed later if I find a case in which it is undesirable to crash if no program is contained.
+		assert(program_counter_ >= 0 && program_counter_ <= static_cast<std::ptrdiff_t>(instructions_.size())); //Sanity check for PC not out of bounds
+		assert(!flags_register_.halt());
+		if (profiling_ && state_ == execution_state::not_started)
+			++profiled_runs_;
+		state_ = execution_state::running;
+		flags_register_.os_interrupt() = false;
+		breakpoints_.update_watchpoints(); //the state of the CPU might have changed since the instrumentation was chosen
+		if (flags_register_.breakpoint_hit()) {  //we continue after a breakpoint, PC is pointing to the BP's address. First execute the substituted instruction
+			flags_register_.breakpoint_hit() = false;
+			if (breakpoints_.is_instrumented(program_counter_))
+				do_execute(breakpoints_.get_replaced_instruction_at(program_counter_++));
+			else
+				do_execute(instructions_[program_counter_++]);
+			if (flags_register_.single_step())
+				return execution_stops_callback();
+		}
+
+		//single stepping requires the engine to stop after every instruction, which only the debug engine does
+		if (flags_register_.single_step())
+			(this->*engines_->debug_)();
+		else if (!flags_register_.halt() && !flags_register_.os_interrupt()) {
+			if (tracing_) //the steps are recorded by the fast engine only
+				(this->*engines_->traced_)();
+			else if (jit_enabled_ && !profiling_) //the native code does not collect the profile
+				(this->*engines_->jit_)();
+			else if (tiering_enabled_ && !profiling_)
+				(this->*engines_->tiered_)();
+			else
+				(this->*engines_->fast_)();
+		}
 		execution_stops_callback();
 	}
-} //namespace bf::execution
 
+	cpu_emulator::engines const& cpu_emulator::engines_for(cell_width const width) {
+		return visit_cell_type(width, [](auto const cell) -> engines const& {
+			using cell_t = std::remove_const_t<decltype(cell)>;
+			static constexpr engines specialized{ &cpu_emulator::execute_instruction<cell_t>, &cpu_emulator::execute_debug<cell_t>,
+				&cpu_emulator::execute_fast<cell_t>, &cpu_emulator::execute_jit<cell_t>, &cpu_emulator::execute_tiered<cell_t>,
+				&cpu_emulator::execute_fast<cell_t, false, true> };
+			return specialized;
+		});
+	}
+} //namespace bf::execution
\ No newline at end of file
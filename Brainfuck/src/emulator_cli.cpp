@@ -11,6 +11,8 @@
 #include <iomanip>
 #include <filesystem>
 #include <csignal>
+#include <new>
+#include <sstream>
 
 namespace bf::execution {
 
@@ -27,11 +29,24 @@ namespace bf::execution {
 		}
 
 		/*Function callback for the flash cli command.
-		Expects no arguments. Does a simple check whether there is a program that could be flashed and if there is, does so.
-		After the flash the cpu is reset and has its memory cleared.*/
+		Expects an optional argument "jit" or "tiered" choosing native execution and an optional width of cells in bits. Does a simple check whether
+		there is a program that could be flashed and if there is, does so. After the flash the cpu is reset and has its memory cleared.*/
 		int flash_callback(cli::command_parameters_t const& argv) {
-			if (int const code = utils::check_command_argc(1, 1, argv))
+			if (int const code = utils::check_command_argc(1, 3, argv))
 				return code;
+			bool jit = false, tiered = false;
+			std::optional<cell_width> width;
+			for (std::size_t i = 1; i < argv.size(); ++i)
+				if (argv[i] == "jit" && !jit && !tiered)
+					jit = true;
+				else if (argv[i] == "tiered" && !jit && !tiered)
+					tiered = true;
+				else if (std::optional<cell_width> const parsed = parse_cell_width(argv[i]); parsed && !width)
+					width = parsed;
+				else {
+					cli::print_command_error(cli::command_error::argument_not_recognized);
+					return 6;
+				}
 			if (!previous_compilation::ready()) {
 				std::cerr << "You must first compile a program. See the \"compilation\" group of commands, especially \"compile\".\n";
 				return 4;
@@ -41,9 +56,24 @@ namespace bf::execution {
 					"Illegal code cannot be flashed into the CPU.\n";
 				return 5;
 			}
-			emulator.flash_program(previous_compilation::generate_executable_code());
+			if (!emulator.enable_jit(jit) || !emulator.enable_tiering(tiered)) {
+				std::cerr << "The JIT is not available on this platform.\n";
+				return 7;
+			}
+			//the engines specialized for the width are selected before the code, whose constants are folded for the width, is generated
+			if (width && *width != emulator.get_cell_width())
+				try {
+					emulator.set_cell_width(*width);
+				}
+				catch (std::bad_alloc const&) {
+					std::cerr << "Cannot allocate data memory of " << emulator.memory_size() << ' ' << static_cast<int>(*width) << "-bit cells.\n";
+					return 8;
+				}
+			emulator.flash_program(previous_compilation::generate_executable_code(emulator.memory_size(), emulator.get_cell_width()));
 			emulator.reset();
-			std::cout << "Code successfully flashed into the emulator's memory.\n";
+			std::cout << "Code successfully flashed into the emulator's memory"
+				<< (emulator.jit_enabled() ? " for native execution" : emulator.tiering_enabled() ? " for tiered execution" : "")
+				<< " using " << static_cast<int>(emulator.get_cell_width()) << "-bit cells.\n";
 			return 0;
 		}
 
@@ -210,12 +240,12 @@ namespace bf::execution {
 
 			int redirect_stream(data_stream_direction const stream_direction, std::string_view const new_stream_name) {
 				if (stream_direction == data_stream_direction::out)
-					emulator.emulated_program_stdout()->flush(); //if we are abour to replace the output stream, we need to flush the old one
+					emulator.flush_output(); //if we are abour to replace the output stream, we need to flush the old one
 
 				if (new_stream_name == "std") //the new stream is one of standard ones
 					switch (stream_direction) {
 						case data_stream_direction::in:
-							emulator.emulated_program_stdin() = &std::cin;
+							emulator.emulated_program_input().attach(std::cin);
 							stdin_path = "debugger's stdin";
 							std::cout << "Successfully redirected input to stdin.\n";
 							return 0;
@@ -236,14 +266,15 @@ namespace bf::execution {
 					return 5;
 				}
 
-				//static buffers. This solution limits the scope while preserving the lifetime of their internal buffers
-				static std::ifstream file_in;
+				//static buffer. This solution limits the scope while preserving the lifetime of its internal buffer
 				static std::ofstream file_out;
 
 				switch (stream_direction) {
 					case data_stream_direction::in:
-						file_in = std::ifstream{ new_stream };
-						emulator.emulated_program_stdin() = &file_in;
+						if (!emulator.emulated_program_input().open_file(new_stream)) { //the input is mapped to memory, reset only rewinds the mapping
+							std::cout << "Cannot map " << new_stream << " to memory.\n";
+							return 5;
+						}
 						std::cout << "Successfully redirected input to " << new_stream << '\n';
 						stdin_path = std::move(new_stream);
 						break;
@@ -275,10 +306,10 @@ namespace bf::execution {
 					cli::print_command_error(cli::command_error::argument_required);
 					return 6;
 				case 3u:
-					if (auto const stream_direction = helper::parse_stream_direction(argv[1]); stream_direction.has_value())
+					if (auto const stream_direction = helper::parse_stream_direction(argv[1]); !stream_direction.has_value())
 						return 4;
 					else
-						return helper::redirect_stream(stream_direction.value(), argv[2]);
+						return helper::redirect_stream(*stream_direction, argv[2]);
 					ASSERT_NO_OTHER_OPTION;
 			}
 		}
@@ -292,6 +323,117 @@ namespace bf::execution {
 		}
 
 
+		/*Function callback for the memsize cli command. Without arguments prints the size of the CPU's data memory,
+		otherwise expects a positive number of cells the memory shall be resized to. Resizing resets the CPU.*/
+		int memsize_callback(cli::command_parameters_t const& argv) {
+			if (int const code = utils::check_command_argc(1, 2, argv))
+				return code;
+
+			if (argv.size() == 1u) {
+				std::cout << "The emulator's data memory is " << emulator.memory_size() << " cell" << utils::print_plural(emulator.memory_size()) << " wide, cells have "
+					<< static_cast<int>(emulator.get_cell_width()) << " bits.\n";
+				return 0;
+			}
+
+			std::optional<int> const cells = utils::parse_positive_argument(argv[1]);
+			if (!cells.has_value())
+				return 4;
+			try {
+				emulator.set_memory_size(*cells);
+			}
+			catch (std::bad_alloc const&) {
+				std::cerr << "Cannot allocate data memory of " << *cells << " cells. The memory has been left unchanged.\n";
+				return 5;
+			}
+			std::cout << "Data memory resized to " << *cells << " cell" << utils::print_plural(*cells) << ". The CPU has been reset.\n";
+			return 0;
+		}
+
+		/*Function callback for the checkpoint cli command. Without arguments captures the current state of the CPU,
+		"auto N" enables automatic checkpoints every N instructions and "auto off" disables them.*/
+		int checkpoint_callback(cli::command_parameters_t const& argv) {
+			if (int const code = utils::check_command_argc(1, 3, argv))
+				return code;
+
+			if (argv.size() == 1u) {
+				if (!assert_emulator_has_program())
+					return 5;
+				if (emulator.state() == execution_state::running) {
+					std::cerr << "CPU is currently running, stop the execution first.\n";
+					return 6;
+				}
+				try {
+					checkpoint const& taken = emulator.take_checkpoint();
+					std::cout << "Checkpoint " << taken.id_ << " taken at address " << taken.program_counter_ << " after " << taken.executed_instructions_
+						<< " instruction" << utils::print_plural(taken.executed_instructions_) << ", " << taken.memory_->page_count()
+						<< " page" << utils::print_plural(taken.memory_->page_count()) << " of memory stored.\n";
+				}
+				catch (std::bad_alloc const&) {
+					std::cerr << "Cannot track writes to memory, no checkpoint has been taken.\n";
+					return 7;
+				}
+				return 0;
+			}
+
+			if (argv[1] != "auto" || argv.size() != 3u) {
+				cli::print_command_error(cli::command_error::argument_not_recognized);
+				return 3;
+			}
+			if (argv[2] == "off") {
+				emulator.set_automatic_checkpoint_interval(0);
+				std::cout << "Automatic checkpoints disabled.\n";
+				return 0;
+			}
+			std::optional<int> const interval = utils::parse_positive_argument(argv[2]);
+			if (!interval.has_value())
+				return 4;
+			emulator.set_automatic_checkpoint_interval(*interval);
+			std::cout << "A checkpoint will be taken every " << *interval << " instruction" << utils::print_plural(*interval) << ".\n";
+			return 0;
+		}
+
+		/*Function callback for the checkpoints cli command. Prints a table of all checkpoints.*/
+		int checkpoints_callback(cli::command_parameters_t const& argv) {
+			if (int const code = utils::check_command_argc(1, 1, argv))
+				return code;
+
+			std::ostringstream buffer;
+			buffer << "Checkpoints:\n" << std::right << std::setw(6) << "ID" << std::setw(12) << "ADDRESS" << std::setw(16) << "INSTRUCTIONS"
+				<< std::setw(8) << "PAGES" << "   KIND\n";
+			for (checkpoint const& c : emulator.checkpoints())
+				buffer << std::setw(6) << c.id_ << '.' << std::setw(11) << c.program_counter_ << std::setw(16) << c.executed_instructions_
+				<< std::setw(8) << c.memory_->page_count() << "   " << (c.automatic_ ? "automatic" : "manual") << '\n';
+			if (emulator.automatic_checkpoint_interval())
+				buffer << "Automatic checkpoints are taken every " << emulator.automatic_checkpoint_interval() << " instructions.\n";
+			std::cout << buffer.str();
+			return 0;
+		}
+
+		/*Function callback for the restore cli command. Returns the CPU to the state captured by the checkpoint with given id.*/
+		int restore_callback(cli::command_parameters_t const& argv) {
+			if (int const code = utils::check_command_argc(2, 2, argv))
+				return code;
+
+			std::optional<int> const id = utils::parse_nonnegative_argument(argv[1]);
+			if (!id.has_value())
+				return 3;
+			checkpoint const* const target = emulator.find_checkpoint(*id);
+			if (!target) {
+				std::cerr << "Checkpoint " << *id << " does not exist.\n";
+				return 4;
+			}
+			if (emulator.state() == execution_state::running) {
+				std::cerr << "CPU is currently running, stop the execution first.\n";
+				return 5;
+			}
+			bool const input_rewound = emulator.restore_checkpoint(*target);
+			std::cout << "Restored checkpoint " << *id << " at address " << emulator.program_counter() << " after "
+				<< emulator.executed_instructions_counter() << " instruction" << utils::print_plural(emulator.executed_instructions_counter()) << ".\n";
+			if (!input_rewound)
+				std::cout << "The program's input could not be rewound, it continues where it is.\n";
+			return 0;
+		}
+
 		/*Function callback for the cli stop command. Takes no arguments and acts almost as a pseudo command especially
 		useful to call it's hook.*/
 		int stop_callback(cli::command_parameters_t const& argv) {
@@ -337,9 +479,22 @@ namespace bf::execution {
 			"cell pointer to the beginning of memory and reseting all flags. It is necesarry if the CPU halted."
 			, &reset_callback);
 
+		cli::add_command("memsize", cli::command_category::execution, "Queries or changes the size of the CPU's data memory.",
+			"Usage: \"memsize\" [cells]\n"
+			"Without arguments prints the number of cells in the emulator's data memory.\n"
+			"If a positive number of cells is given, the memory is replaced by a new zeroed one of that size and the CPU is reset.\n"
+			"The cell pointer wraps around at the memory's boundaries, therefore the size affects the behaviour of programs."
+			, &memsize_callback);
+
 		cli::add_command("flash", cli::command_category::execution, "Loads the previously compiled program into the emulator's memory.",
-			"Usage: \"flash\" (no arguments)\n"
+			"Usage: \"flash\" [jit | tiered] [8|16|32]\n"
 			"If the last compilation ended successfully, loads the compiled code into cpu emulator and resets it.\n"
+			"With argument \"jit\" the code is translated to native machine code on the first run and executed natively.\n"
+			"With argument \"tiered\" the code is interpreted and only loops that have been entered many times are translated\n"
+			"to native code, which the execution switches to at their beginning. Setting a breakpoint in such a loop discards its native code.\n"
+			"Instructions that cannot run natively (e.g. breakpoints) as well as single stepping are handled by the interpreter.\n"
+			"A number chooses the width of memory cells in bits, the previous width (8 bits initially) is kept otherwise.\n"
+			"Each width has its own specialization of the emulator and constants are folded for it. Changing the width clears the memory.\n"
 			, &flash_callback);
 
 		cli::add_command("run", cli::command_category::execution, "Reset the cpu emulator and start executing flashed code.",
@@ -374,6 +529,28 @@ namespace bf::execution {
 			"Necessary to initiate step-debugging.\n"
 			, &start_callback);
 
+		cli::add_command("checkpoint", cli::command_category::execution, "Captures the state of the CPU to be restored later.",
+			"Usage: \"checkpoint\" [\"auto\" (instructions | \"off\")]\n"
+			"Without arguments captures the registers, flags, counters, the position within the input file and data memory.\n"
+			"Memory is captured incrementally, only pages written since the previous checkpoint are copied.\n"
+			"With \"auto\" the CPU takes a checkpoint every given number of instructions by itself, keeping the newest "
+			+ std::to_string(cpu_emulator::max_automatic_checkpoints) + " of them.\n"
+			"Checkpoints survive \"run\" and \"reset\", but they are discarded when a program is flashed or memory is resized."
+			, &checkpoint_callback);
+
+		cli::add_command("checkpoints", cli::command_category::execution, "Lists checkpoints.",
+			"Usage: \"checkpoints\" (no args)\n"
+			"Prints all checkpoints which may be restored by \"restore\"."
+			, &checkpoints_callback);
+
+		cli::add_command("restore", cli::command_category::execution, "Returns the CPU to the state of a checkpoint.",
+			"Usage: \"restore\" checkpoint_number\n"
+			"Restores the state captured by the checkpoint, after which the execution may be continued from there again.\n"
+			"Only pages of memory which may differ are copied. If the program reads a file, it is rewound to the captured position.\n"
+			"The output already written by the program is not affected. Restoring an automatic checkpoint and continuing\n"
+			"to a breakpoint replays the part of the execution preceding it."
+			, &restore_callback);
+
 	}
 
 
@@ -0,0 +1,244 @@
+#include "expression.h"
+#include "utils.h"
+
+#include <iostream>
+#include <locale>
+#include <array>
+#include <algorithm>
+#include <cassert>
+
+namespace bf::expression {
+
+	namespace {
+
+		using op_code = compiled_expression::op_code;
+
+		[[nodiscard]]
+		bool is_alpha(char const c) { return std::isalpha(c, std::locale::classic()); }
+		[[nodiscard]]
+		bool is_digit(char const c) { return std::isdigit(c, std::locale::classic()); }
+		[[nodiscard]]
+		bool is_space(char const c) { return std::isspace(c, std::locale::classic()); }
+
+		//Binary operators grouped by their priority, the lowest first
+		struct binary_operator {
+			std::string_view token_;
+			op_code op_code_;
+		};
+
+		constexpr binary_operator logical_or_operators[] = { {"||", op_code::logical_or} };
+		constexpr binary_operator logical_and_operators[] = { {"&&", op_code::logical_and} };
+		constexpr binary_operator comparison_operators[] = {
+			{"==", op_code::equal}, {"!=", op_code::not_equal}, {"<", op_code::less},
+			{"<=", op_code::less_equal}, {">", op_code::greater}, {">=", op_code::greater_equal}
+		};
+		constexpr binary_operator additive_operators[] = { {"+", op_code::add}, {"-", op_code::subtract} };
+		constexpr binary_operator multiplicative_operators[] = { {"*", op_code::multiply}, {"/", op_code::divide}, {"%", op_code::remainder} };
+
+		/*Recursive descent parser emitting the code of the stack machine in postfix order. Each level of priority is parsed by
+		a separate function; the first error encountered is remembered and stops the parsing.*/
+		class parser {
+			std::vector<std::string_view> const tokens_;
+			std::size_t position_ = 0;
+			std::vector<compiled_expression::instruction> code_;
+			std::size_t depth_ = 0, max_depth_ = 0; //current and maximal depth of the stack during evaluation
+			std::string error_;
+
+			[[nodiscard]]
+			std::string_view peek() const { return position_ < tokens_.size() ? tokens_[position_] : std::string_view{}; }
+
+			bool accept(std::string_view const token) {
+				if (peek() != token)
+					return false;
+				++position_;
+				return true;
+			}
+
+			void fail(std::string message) {
+				if (error_.empty())
+					error_ = std::move(message);
+			}
+
+			void emit(op_code const op_code, std::ptrdiff_t const value = 0) {
+				switch (op_code) {
+				case op_code::constant: case op_code::cell_pointer: case op_code::program_counter:
+					max_depth_ = std::max(max_depth_, ++depth_);
+					break;
+				case op_code::cell: case op_code::negate: case op_code::logical_not: //replace the operand
+					break;
+				default: //binary operators replace two operands by the result
+					--depth_;
+				}
+				code_.push_back({ op_code, value });
+			}
+
+			template<std::size_t N>
+			void parse_binary(binary_operator const (&operators)[N], void (parser::* const operand)()) {
+				(this->*operand)();
+				for (bool matched = true; matched && error_.empty();) {
+					matched = false;
+					for (binary_operator const& op : operators)
+						if (accept(op.token_)) {
+							(this->*operand)();
+							emit(op.op_code_);
+							matched = true;
+							break;
+						}
+				}
+			}
+
+			void parse_logical_or() { parse_binary(logical_or_operators, &parser::parse_logical_and); }
+			void parse_logical_and() { parse_binary(logical_and_operators, &parser::parse_comparison); }
+			void parse_comparison() { parse_binary(comparison_operators, &parser::parse_additive); }
+			void parse_additive() { parse_binary(additive_operators, &parser::parse_multiplicative); }
+			void parse_multiplicative() { parse_binary(multiplicative_operators, &parser::parse_unary); }
+
+			void parse_unary() {
+				if (accept("-")) {
+					parse_unary();
+					emit(op_code::negate);
+				}
+				else if (accept("!")) {
+					parse_unary();
+					emit(op_code::logical_not);
+				}
+				else if (accept("+"))
+					parse_unary();
+				else
+					parse_primary();
+			}
+
+			void parse_primary() {
+				std::string_view const token = peek();
+				if (token.empty())
+					return fail("Unexpected end of expression.");
+				++position_;
+
+				if (is_digit(token.front())) {
+					std::optional<int> const value = utils::parse_nonnegative_argument(token);
+					if (!value.has_value())
+						return fail("Invalid number " + std::string{ token } + '.');
+					emit(op_code::constant, *value);
+				}
+				else if (token == "$cpr")
+					emit(op_code::cell_pointer);
+				else if (token == "$pc")
+					emit(op_code::program_counter);
+				else if (token == "mem") {
+					if (!accept("["))
+						return fail("Expected [ after mem.");
+					parse_logical_or();
+					if (!accept("]"))
+						return fail("Expected ] closing the index of memory.");
+					emit(op_code::cell);
+				}
+				else if (token == "(") {
+					parse_logical_or();
+					if (!accept(")"))
+						return fail("Expected ) closing the parenthesis.");
+				}
+				else
+					fail("Unexpected token " + std::string{ token } + '.');
+			}
+
+		public:
+			explicit parser(std::string_view const expression) : tokens_{ tokenize(expression) } {}
+
+			/*Parses the whole expression. Returns the code or an empty optional after printing the error.*/
+			[[nodiscard]]
+			std::optional<std::vector<compiled_expression::instruction>> parse() {
+				parse_logical_or();
+				if (error_.empty() && position_ != tokens_.size())
+					fail("Unexpected token " + std::string{ peek() } + '.');
+				if (error_.empty() && max_depth_ > compiled_expression::max_stack_depth)
+					fail("The expression is too complex.");
+				if (!error_.empty()) {
+					std::cerr << "Invalid expression: " << error_ << '\n';
+					return std::nullopt;
+				}
+				assert(depth_ == 1);
+				return std::move(code_);
+			}
+		};
+
+		[[nodiscard]]
+		std::ptrdiff_t apply_binary(op_code const op_code, std::ptrdiff_t const left, std::ptrdiff_t const right) {
+			switch (op_code) {
+			case op_code::multiply: return left * right;
+			case op_code::divide: return right ? left / right : 0;
+			case op_code::remainder: return right ? left % right : 0;
+			case op_code::add: return left + right;
+			case op_code::subtract: return left - right;
+			case op_code::less: return left < right;
+			case op_code::less_equal: return left <= right;
+			case op_code::greater: return left > right;
+			case op_code::greater_equal: return left >= right;
+			case op_code::equal: return left == right;
+			case op_code::not_equal: return left != right;
+			case op_code::logical_and: return left && right;
+			case op_code::logical_or: return left || right;
+				ASSERT_NO_OTHER_OPTION;
+			}
+		}
+
+	} //namespace bf::expression::`anonymous`
+
+	std::vector<std::string_view> tokenize(std::string_view const expression) {
+		std::vector<std::string_view> tokens;
+		for (std::size_t begin = 0; begin < expression.size(); ) {
+			if (is_space(expression[begin])) {
+				++begin;
+				continue;
+			}
+
+			std::size_t end = begin + 1;
+			if (expression[begin] == '$' || is_alpha(expression[begin])) //parse a name of a variable or an identifier
+				while (end < expression.size() && is_alpha(expression[end]))
+					++end;
+			else if (is_digit(expression[begin])) //parse numeric literal
+				while (end < expression.size() && is_digit(expression[end]))
+					++end;
+			else if (end < expression.size()) //most operators are single characters, only a few consist of two
+				for (std::string_view const op : { "==", "!=", "<=", ">=", "&&", "||" })
+					if (expression.substr(begin, 2) == op) {
+						++end;
+						break;
+					}
+			tokens.push_back(expression.substr(begin, end - begin));
+			begin = end;
+		}
+		return tokens;
+	}
+
+	std::optional<compiled_expression> compiled_expression::compile(std::string_view const source) {
+		std::optional<std::vector<instruction>> code = parser{ source }.parse();
+		if (!code.has_value())
+			return std::nullopt;
+		return compiled_expression{ std::string{ source }, std::move(*code) };
+	}
+
+	std::ptrdiff_t compiled_expression::evaluate(machine_state const& state) const {
+		std::array<std::ptrdiff_t, max_stack_depth> stack;
+		std::size_t top = 0; //number of values on the stack
+
+		for (instruction const& inst : code_)
+			switch (inst.op_code_) {
+			case op_code::constant: stack[top++] = inst.value_; break;
+			case op_code::cell_pointer: stack[top++] = state.cell_pointer_; break;
+			case op_code::program_counter: stack[top++] = state.program_counter_; break;
+			case op_code::cell: {
+				std::ptrdiff_t const index = stack[top - 1] % state.memory_size_;
+				stack[top - 1] = execution::read_cell(state.memory_, index < 0 ? index + state.memory_size_ : index, state.cell_width_);
+				break;
+			}
+			case op_code::negate: stack[top - 1] = -stack[top - 1]; break;
+			case op_code::logical_not: stack[top - 1] = !stack[top - 1]; break;
+			default: //binary operations replace both operands by the result
+				std::ptrdiff_t const right = stack[--top];
+				stack[top - 1] = apply_binary(inst.op_code_, stack[top - 1], right);
+			}
+		assert(top == 1);
+		return stack[0];
+	}
+
+} //namespace bf::expression
@@ -0,0 +1,209 @@
+#include "headless.h"
+#include "utils.h"
+#include "compiler.h"
+#include "emulator.h"
+#include "opt/optimizer_pass.h"
+
+#include <iostream>
+#include <streambuf>
+#include <string>
+#include <string_view>
+#include <array>
+#include <optional>
+#include <new>
+
+#ifdef _WIN32
+#include <io.h>
+#include <fcntl.h>
+#else
+#include <unistd.h>
+#include <cerrno>
+#endif
+
+namespace bf::headless {
+
+	namespace {
+
+		constexpr char const* usage = "Usage: brainfuck run [-O0 | -O1 | -O2] [-jit | -tiered] [-mN] [-c8 | -c16 | -c32] [-v] file\n";
+
+		constexpr int stdin_descriptor = 0;
+		constexpr int stdout_descriptor = 1;
+
+		/*Writes all bytes to the file descriptor. Returns false on error.*/
+		[[nodiscard]]
+		bool write_descriptor(int const descriptor, char const* data, std::size_t size) {
+			while (size > 0) {
+#ifdef _WIN32
+				int const count = _write(descriptor, data, static_cast<unsigned>(size));
+#else
+				::ssize_t const count = ::write(descriptor, data, size);
+				if (count < 0 && errno == EINTR)
+					continue;
+#endif
+				if (count <= 0)
+					return false;
+				data += count;
+				size -= static_cast<std::size_t>(count);
+			}
+			return true;
+		}
+
+		/*Stream buffer writing to a file descriptor directly, bypassing the standard streams and their synchronization.
+		The input is read by the emulator's input buffer, which maps or prefetches the descriptor itself.*/
+		class descriptor_buffer : public std::streambuf {
+			int const descriptor_;
+			std::array<char, 1 << 16> buffer_;
+
+		protected:
+			int_type overflow(int_type const character) override {
+				if (sync() != 0)
+					return traits_type::eof();
+				if (!traits_type::eq_int_type(character, traits_type::eof())) {
+					*pptr() = traits_type::to_char_type(character);
+					pbump(1);
+				}
+				return traits_type::not_eof(character);
+			}
+
+			//the emulator writes its output in large chunks, which are passed to the descriptor without being copied
+			std::streamsize xsputn(char const* const data, std::streamsize const count) override {
+				if (count <= epptr() - pptr())
+					return std::streambuf::xsputn(data, count);
+				if (sync() != 0 || !write_descriptor(descriptor_, data, static_cast<std::size_t>(count)))
+					return 0;
+				return count;
+			}
+
+			int sync() override {
+				bool const written = write_descriptor(descriptor_, pbase(), static_cast<std::size_t>(pptr() - pbase()));
+				setp(buffer_.data(), buffer_.data() + buffer_.size());
+				return written ? 0 : -1;
+			}
+
+		public:
+			explicit descriptor_buffer(int const descriptor) : descriptor_{ descriptor } {
+#ifdef _WIN32
+				_setmode(descriptor_, _O_BINARY); //programs read and write raw bytes, no translation of line ends may be performed
+#endif
+				setp(buffer_.data(), buffer_.data() + buffer_.size());
+			}
+
+			~descriptor_buffer() override { sync(); }
+
+			descriptor_buffer(descriptor_buffer const&) = delete;
+			descriptor_buffer& operator=(descriptor_buffer const&) = delete;
+		};
+
+		struct options {
+			opt::opt_level_t level_ = opt::opt_level_t::none;
+			bool jit_ = false;
+			bool tiered_ = false;
+			bool verbose_ = false;
+			std::optional<std::ptrdiff_t> memory_size_;
+			execution::cell_width cell_width_ = execution::default_cell_width;
+			std::string_view file_;
+		};
+
+		/*Parses the command line arguments. Returns an empty optional if they are invalid.*/
+		[[nodiscard]]
+		std::optional<options> parse_options(int const argc, char const* const* const argv) {
+			options res;
+			for (int i = 0; i < argc; ++i) {
+				std::string_view const arg = argv[i];
+				if (arg == "-O0")
+					res.level_ = opt::opt_level_t::none;
+				else if (arg == "-jit")
+					res.jit_ = true;
+				else if (arg == "-tiered")
+					res.tiered_ = true;
+				else if (arg == "-v")
+					res.verbose_ = true;
+				else if (arg.substr(0, 2) == "-m") {
+					std::optional<int> const cells = utils::parse_positive_argument(arg.substr(2));
+					if (!cells.has_value())
+						return std::nullopt;
+					res.memory_size_ = *cells;
+				}
+				else if (arg.substr(0, 2) == "-c") {
+					std::optional<execution::cell_width> const width = execution::parse_cell_width(arg.substr(2));
+					if (!width.has_value())
+						return std::nullopt;
+					res.cell_width_ = *width;
+				}
+				else if (arg.substr(0, 2) == "-O") {
+					std::optional<opt::opt_level_t> const level = opt::get_opt_by_name(arg);
+					if (!level.has_value())
+						return std::nullopt;
+					res.level_ = *level;
+				}
+				else if (res.file_.empty() && arg.substr(0, 1) != "-")
+					res.file_ = arg;
+				else
+					return std::nullopt;
+			}
+			if (res.file_.empty())
+				return std::nullopt;
+			return res;
+		}
+
+	} //namespace bf::headless::`anonymous`
+
+	int run(int const argc, char const* const* const argv) {
+		std::optional<options> const options = parse_options(argc, argv);
+		if (!options.has_value()) {
+			std::cerr << usage;
+			return invalid_usage;
+		}
+
+		std::optional<std::string> source = utils::read_file(options->file_);
+		if (!source.has_value()) {
+			std::cerr << "Cannot read file " << options->file_ << ".\n";
+			return program_not_found;
+		}
+		if (!compile_source(std::move(*source))) {
+			for (syntax_error const& error : previous_compilation::syntax_errors())
+				std::cerr << options->file_ << ':' << error.location_ << ": " << error.message_ << '\n';
+			return syntax_errors;
+		}
+		if (options->level_ != opt::opt_level_t::none)
+			static_cast<void>(opt::perform_optimizations(previous_compilation::basic_blocks_mutable(), { options->level_ },
+				options->memory_size_.value_or(execution::emulator.memory_size()), true));
+
+		execution::cpu_emulator& cpu = execution::emulator;
+		try {
+			cpu.set_cell_width(options->cell_width_);
+			if (options->memory_size_.has_value())
+				cpu.set_memory_size(*options->memory_size_);
+		}
+		catch (std::bad_alloc const&) {
+			std::cerr << "Cannot allocate data memory of " << options->memory_size_.value_or(cpu.memory_size()) << " cells of "
+				<< static_cast<int>(options->cell_width_) << " bits.\n";
+			return execution_failed;
+		}
+		cpu.flash_program(previous_compilation::generate_executable_code(cpu.memory_size(), cpu.get_cell_width()));
+		cpu.enable_jit(options->jit_);
+		cpu.enable_tiering(options->tiered_);
+		cpu.reset();
+
+		descriptor_buffer output_buffer{ stdout_descriptor };
+		std::ostream output{ &output_buffer }, no_diagnostics{ nullptr };
+#ifdef _WIN32
+		_setmode(stdin_descriptor, _O_BINARY); //programs read raw bytes, no translation of line ends may be performed
+#endif
+		cpu.emulated_program_input().open_descriptor(stdin_descriptor); //input redirected from a file is mapped, a pipe is prefetched
+		cpu.emulated_program_stdout() = &output;
+		cpu.diagnostics_stream() = options->verbose_ ? &std::cerr : &no_diagnostics;
+		cpu.suppress_stop_interrupt() = true; //there are no commands, not even "stop"
+
+		cpu.do_execute();
+		bool const finished = cpu.state() == execution::execution_state::finished;
+		output.flush();
+
+		//the emulator outlives the streams
+		cpu.emulated_program_input().attach(std::cin);
+		cpu.emulated_program_stdout() = &std::cout;
+		cpu.diagnostics_stream() = &std::cout;
+		return finished && output ? success : execution_failed;
+	}
+
+} //namespace bf::headless
@@ -0,0 +1,295 @@
+#include "input_buffer.h"
+
+#include <cassert>
+#include <utility>
+#include <algorithm>
+#include <mutex>
+#include <condition_variable>
+#include <thread>
+#include <string>
+
+#ifdef _WIN32
+#define NOMINMAX
+#include <Windows.h>
+#include <io.h>
+#else
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <cerrno>
+#endif
+
+namespace bf::execution {
+
+	namespace {
+
+		/*Reads at most size bytes from the file descriptor. Returns the number of bytes read, zero at the end of file and a negative number on error.*/
+		[[nodiscard]]
+		std::ptrdiff_t read_descriptor(int const descriptor, char* const data, std::size_t const size) {
+#ifdef _WIN32
+			return _read(descriptor, data, static_cast<unsigned>(size));
+#else
+			::ssize_t count;
+			do
+				count = ::read(descriptor, data, size);
+			while (count < 0 && errno == EINTR);
+			return count;
+#endif
+		}
+	} //namespace bf::execution::`anonymous`
+
+	/*A disk file mapped to memory as a whole. Input starts origin_ bytes into the file.*/
+	struct input_buffer::mapping {
+		char const* data_ = nullptr; //nullptr if the file is empty, nothing is mapped then
+		std::size_t size_ = 0;
+		std::size_t origin_ = 0;
+
+		mapping() = default;
+		mapping(mapping const&) = delete;
+		mapping& operator=(mapping const&) = delete;
+
+		~mapping() {
+			if (!data_)
+				return;
+#ifdef _WIN32
+			UnmapViewOfFile(data_);
+#else
+			munmap(const_cast<char*>(data_), size_);
+#endif
+		}
+
+		[[nodiscard]]
+		char const* begin() const { return data_ + origin_; }
+
+		[[nodiscard]]
+		char const* end() const { return data_ + size_; }
+
+		/*Maps the whole file and places the origin at its current position. Returns nullptr if the file is not a disk file
+		or if it cannot be mapped.*/
+#ifdef _WIN32
+		[[nodiscard]]
+		static std::unique_ptr<mapping> map(HANDLE const file) {
+			LARGE_INTEGER size, position;
+			if (file == INVALID_HANDLE_VALUE || GetFileType(file) != FILE_TYPE_DISK || !GetFileSizeEx(file, &size)
+				|| !SetFilePointerEx(file, LARGE_INTEGER{}, &position, FILE_CURRENT))
+				return nullptr;
+			std::unique_ptr<mapping> res = std::make_unique<mapping>();
+			res->size_ = static_cast<std::size_t>(size.QuadPart);
+			res->origin_ = std::min(res->size_, static_cast<std::size_t>(position.QuadPart));
+			if (res->size_ == 0) //empty files cannot be mapped
+				return res;
+			HANDLE const file_mapping = CreateFileMappingW(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+			if (!file_mapping)
+				return nullptr;
+			res->data_ = static_cast<char const*>(MapViewOfFile(file_mapping, FILE_MAP_READ, 0, 0, 0));
+			CloseHandle(file_mapping); //the view keeps the mapping alive
+			return res->data_ ? std::move(res) : nullptr;
+		}
+#else
+		[[nodiscard]]
+		static std::unique_ptr<mapping> map(int const descriptor) {
+			struct ::stat status;
+			if (::fstat(descriptor, &status) != 0 || !S_ISREG(status.st_mode))
+				return nullptr;
+			::off_t const position = ::lseek(descriptor, 0, SEEK_CUR);
+			if (position < 0)
+				return nullptr;
+			std::unique_ptr<mapping> res = std::make_unique<mapping>();
+			res->size_ = static_cast<std::size_t>(status.st_size);
+			res->origin_ = std::min(res->size_, static_cast<std::size_t>(position));
+			if (res->size_ == 0) //empty files cannot be mapped
+				return res;
+			void* const data = ::mmap(nullptr, res->size_, PROT_READ, MAP_PRIVATE, descriptor, 0);
+			if (data == MAP_FAILED)
+				return nullptr;
+			res->data_ = static_cast<char const*>(data);
+#ifdef MADV_SEQUENTIAL
+			::madvise(data, res->size_, MADV_SEQUENTIAL); //programs read their input from the beginning to the end
+#endif
+			return res;
+		}
+#endif
+	};
+
+	/*Ring buffer filled by a background thread reading a descriptor. The reader thread owns the prefetcher together with the input buffer,
+	since it cannot be woken up while it waits for data of a pipe or the console. An abandoned prefetcher is released once the reader returns.*/
+	struct input_buffer::prefetcher {
+		static constexpr std::size_t capacity = 1 << 20;
+		static constexpr std::size_t chunk_size = 1 << 16; //the largest read requested at once
+
+		int const descriptor_;
+		std::unique_ptr<char[]> const ring_ = std::make_unique<char[]>(capacity);
+
+		std::mutex mutex_;
+		std::condition_variable changed_;
+		std::size_t produced_ = 0, consumed_ = 0; //total numbers of bytes read from the descriptor and consumed by the emulator
+		bool ended_ = false; //the end of the descriptor has been hit or reading it has failed
+		bool abandoned_ = false; //the input buffer reads something else now
+
+		explicit prefetcher(int const descriptor) : descriptor_{ descriptor } {}
+
+		//Body of the reader thread
+		static void read_ahead(std::shared_ptr<prefetcher> const self) {
+			for (;;) {
+				std::size_t offset, size;
+				{
+					std::unique_lock lock{ self->mutex_ };
+					self->changed_.wait(lock, [&self] { return self->abandoned_ || self->produced_ - self->consumed_ < capacity; });
+					if (self->abandoned_)
+						return;
+					offset = self->produced_ % capacity;
+					size = std::min({ chunk_size, capacity - offset, capacity - (self->produced_ - self->consumed_) });
+				}
+				//the region is free, the emulator does not touch it until it is produced
+				std::ptrdiff_t const count = read_descriptor(self->descriptor_, self->ring_.get() + offset, size);
+				{
+					std::lock_guard const lock{ self->mutex_ };
+					if (count > 0)
+						self->produced_ += static_cast<std::size_t>(count);
+					else
+						self->ended_ = true;
+				}
+				self->changed_.notify_all();
+				if (count <= 0)
+					return;
+			}
+		}
+	};
+
+	input_buffer::input_buffer() = default;
+
+	input_buffer::input_buffer(std::istream& stream) : stream_{ &stream } {}
+
+	input_buffer::input_buffer(input_buffer&& other) noexcept
+		: position_{ std::exchange(other.position_, nullptr) }, end_{ std::exchange(other.end_, nullptr) }, window_{ std::exchange(other.window_, nullptr) },
+		stream_{ std::exchange(other.stream_, nullptr) }, mapping_{ std::move(other.mapping_) }, prefetcher_{ std::move(other.prefetcher_) } {}
+
+	input_buffer& input_buffer::operator=(input_buffer&& other) noexcept {
+		if (this != &other) {
+			close();
+			position_ = std::exchange(other.position_, nullptr);
+			end_ = std::exchange(other.end_, nullptr);
+			window_ = std::exchange(other.window_, nullptr);
+			stream_ = std::exchange(other.stream_, nullptr);
+			mapping_ = std::move(other.mapping_);
+			prefetcher_ = std::move(other.prefetcher_);
+		}
+		return *this;
+	}
+
+	input_buffer::~input_buffer() {
+		close();
+	}
+
+	void input_buffer::close() {
+		if (prefetcher_) {
+			{
+				std::lock_guard const lock{ prefetcher_->mutex_ };
+				prefetcher_->abandoned_ = true;
+			}
+			prefetcher_->changed_.notify_all();
+			prefetcher_.reset();
+		}
+		mapping_.reset();
+		stream_ = nullptr;
+		position_ = end_ = window_ = nullptr;
+	}
+
+	void input_buffer::attach(std::istream& stream) {
+		close();
+		stream_ = &stream;
+	}
+
+	bool input_buffer::open_file(std::filesystem::path const& path) {
+		std::unique_ptr<mapping> mapped;
+#ifdef _WIN32
+		HANDLE const file = CreateFileW(path.c_str(), GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_WRITE, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+		if (file == INVALID_HANDLE_VALUE)
+			return false;
+		mapped = mapping::map(file);
+		CloseHandle(file); //the mapping keeps the file open
+#else
+		int const descriptor = ::open(path.c_str(), O_RDONLY);
+		if (descriptor < 0)
+			return false;
+		mapped = mapping::map(descriptor);
+		::close(descriptor); //the mapping keeps the file open
+#endif
+		if (!mapped)
+			return false;
+		close();
+		mapping_ = std::move(mapped);
+		rewind();
+		return true;
+	}
+
+	void input_buffer::open_descriptor(int const descriptor) {
+#ifdef _WIN32
+		std::unique_ptr<mapping> mapped = mapping::map(reinterpret_cast<HANDLE>(_get_osfhandle(descriptor)));
+#else
+		std::unique_ptr<mapping> mapped = mapping::map(descriptor);
+#endif
+		close();
+		if (mapped) {
+			mapping_ = std::move(mapped);
+			rewind();
+			return;
+		}
+		prefetcher_ = std::make_shared<prefetcher>(descriptor);
+		std::thread{ &prefetcher::read_ahead, prefetcher_ }.detach();
+	}
+
+	int input_buffer::refill() {
+		if (stream_)
+			return stream_->get();
+		if (!prefetcher_) //the mapped file has ended
+			return std::char_traits<char>::eof();
+
+		prefetcher& source = *prefetcher_;
+		std::unique_lock lock{ source.mutex_ };
+		source.consumed_ += static_cast<std::size_t>(position_ - window_);
+		source.changed_.notify_all(); //the reader may be waiting for free space
+		source.changed_.wait(lock, [&source] { return source.produced_ != source.consumed_ || source.ended_; });
+
+		std::size_t const offset = source.consumed_ % prefetcher::capacity;
+		window_ = position_ = source.ring_.get() + offset;
+		end_ = window_ + std::min(source.produced_ - source.consumed_, prefetcher::capacity - offset);
+		if (position_ == end_)
+			return std::char_traits<char>::eof();
+		return static_cast<unsigned char>(*position_++);
+	}
+
+	std::streamoff input_buffer::position() const {
+		if (mapping_)
+			return static_cast<std::streamoff>(position_ - mapping_->begin());
+		if (stream_ && !is_debugger_stdin())
+			return static_cast<std::streamoff>(stream_->tellg());
+		return -1;
+	}
+
+	bool input_buffer::seek(std::streamoff const position) {
+		if (mapping_) {
+			if (position < 0 || position > mapping_->end() - mapping_->begin())
+				return false;
+			position_ = mapping_->begin() + position;
+			return true;
+		}
+		if (!stream_ || is_debugger_stdin())
+			return false;
+		stream_->clear();
+		return static_cast<bool>(stream_->seekg(position));
+	}
+
+	void input_buffer::rewind() {
+		if (mapping_) {
+			window_ = position_ = mapping_->begin();
+			end_ = mapping_->end();
+		}
+		else if (stream_ && !is_debugger_stdin()) {
+			stream_->clear();
+			stream_->seekg(0);
+		}
+	}
+
+} //namespace bf::execution
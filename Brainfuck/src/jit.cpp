@@ -0,0 +1,604 @@
+#include "jit.h"
+
+#include <cassert>
+#include <cstring>
+#include <cstddef>
+#include <limits>
+#include <initializer_list>
+#include <algorithm>
+
+#ifdef _WIN32
+#define NOMINMAX
+#include <Windows.h>
+#else
+#include <sys/mman.h>
+#endif
+
+namespace bf::execution::jit {
+
+	namespace {
+
+		//Offsets of context's members used as 8-bit displacements relative to r12
+		constexpr std::uint8_t cell_pointer_disp = static_cast<std::uint8_t>(offsetof(context, cell_pointer_));
+		constexpr std::uint8_t executed_disp = static_cast<std::uint8_t>(offsetof(context, executed_instructions_));
+		constexpr std::uint8_t poll_disp = static_cast<std::uint8_t>(offsetof(context, poll_countdown_));
+		constexpr std::uint8_t exit_reason_disp = static_cast<std::uint8_t>(offsetof(context, exit_reason_));
+		constexpr std::uint8_t read_disp = static_cast<std::uint8_t>(offsetof(context, read_));
+		constexpr std::uint8_t write_disp = static_cast<std::uint8_t>(offsetof(context, write_));
+		constexpr std::uint8_t search_disp = static_cast<std::uint8_t>(offsetof(context, search_));
+		constexpr std::uint8_t clear_search_disp = static_cast<std::uint8_t>(offsetof(context, clear_search_));
+		constexpr std::uint8_t fill_disp = static_cast<std::uint8_t>(offsetof(context, fill_));
+		static_assert(offsetof(context, fill_) < 128, "Members of the context must be addressable by 8-bit displacements!");
+
+		/*Minimalistic assembler producing position independent x86-64 machine code. Jumps refer to labels,
+		whose rel32 displacements are patched once the whole code has been emitted.*/
+		class assembler {
+
+		public:
+			using label = std::size_t;
+
+		private:
+			struct fixup {
+				std::size_t position_; //position of the 32-bit field
+				label target_;
+				std::ptrdiff_t base_;  //position the displacement is relative to; -1 for rel32 relative to the end of the field
+			};
+
+			std::vector<std::uint8_t> code_;
+			std::vector<std::ptrdiff_t> labels_;
+			std::vector<fixup> fixups_;
+
+		public:
+			label new_label() {
+				labels_.push_back(-1);
+				return labels_.size() - 1;
+			}
+
+			void bind(label const label) {
+				assert(labels_[label] == -1 && "Label may be bound only once!");
+				labels_[label] = static_cast<std::ptrdiff_t>(code_.size());
+			}
+
+			[[nodiscard]]
+			std::ptrdiff_t position() const { return static_cast<std::ptrdiff_t>(code_.size()); }
+
+			void bytes(std::initializer_list<std::uint8_t> const bytes) {
+				code_.insert(code_.end(), bytes);
+			}
+
+			void imm32(std::int32_t const value) {
+				auto const unsigned_value = static_cast<std::uint32_t>(value);
+				for (int i = 0; i < 4; ++i)
+					code_.push_back(static_cast<std::uint8_t>(unsigned_value >> (8 * i)));
+			}
+
+			void imm16(std::int16_t const value) {
+				auto const unsigned_value = static_cast<std::uint16_t>(value);
+				code_.push_back(static_cast<std::uint8_t>(unsigned_value));
+				code_.push_back(static_cast<std::uint8_t>(unsigned_value >> 8));
+			}
+
+			void imm64(std::uint64_t const value) {
+				for (int i = 0; i < 8; ++i)
+					code_.push_back(static_cast<std::uint8_t>(value >> (8 * i)));
+			}
+
+			//rel32 displacement of the given label relative to the end of the emitted field
+			void rel32(label const target) {
+				fixups_.push_back({ code_.size(), target, -1 });
+				imm32(0);
+			}
+
+			//32-bit offset of the given label relative to the given position (used by jump tables)
+			void offset32(label const target, std::ptrdiff_t const base) {
+				fixups_.push_back({ code_.size(), target, base });
+				imm32(0);
+			}
+
+			std::vector<std::uint8_t>& resolve() {
+				for (fixup const& fixup : fixups_) {
+					assert(labels_[fixup.target_] != -1 && "Jump to an unbound label!");
+					std::ptrdiff_t const base = fixup.base_ == -1 ? static_cast<std::ptrdiff_t>(fixup.position_) + 4 : fixup.base_;
+					auto const value = static_cast<std::uint32_t>(static_cast<std::int32_t>(labels_[fixup.target_] - base));
+					for (int i = 0; i < 4; ++i)
+						code_[fixup.position_ + i] = static_cast<std::uint8_t>(value >> (8 * i));
+				}
+				return code_;
+			}
+		};
+
+		[[nodiscard]]
+		bool fits_int32(std::ptrdiff_t const value) {
+			return std::numeric_limits<std::int32_t>::min() <= value && value <= std::numeric_limits<std::int32_t>::max();
+		}
+
+		/*Translates a program instruction by instruction. Register usage of the generated code:
+			rbx = cell pointer register, r12 = pointer to the context, r13 = first cell of memory,
+			r14 = end of memory, r15 = counter of executed instructions, rax, rcx and argument registers are scratch.
+		Pointers are byte addresses, shifts and offsets are therefore scaled by the size of cells, whose width determines
+		the operand size of instructions accessing memory.
+		To keep the instruction counter cheap, it is increased by the length of the whole straight-line segment at its leader.
+		Whenever the native code leaves a segment prematurely, the instructions that haven't been executed are subtracted again.*/
+		class translator {
+
+			std::vector<instruction> const& code_;
+			unsigned char* const memory_;
+			std::ptrdiff_t const memory_size_; //in cells
+			cell_width const width_;
+			std::ptrdiff_t const cell_size_;
+			std::ptrdiff_t const memory_bytes_;
+			bool const unchecked_shifts_;
+			std::ptrdiff_t const code_size_;
+			std::ptrdiff_t const begin_, end_; //the translated region of code
+
+			assembler as_;
+			//the following vectors are indexed by addresses relative to the beginning of the region
+			std::vector<assembler::label> entry_labels_; //entry into instruction including the counting done by segment leaders
+			std::vector<assembler::label> body_labels_;  //beginning of the instruction's own code
+			std::vector<std::ptrdiff_t> segment_ends_;   //address of the first instruction past the segment each instruction belongs to
+			std::vector<bool> leaders_;
+			assembler::label common_exit_ = as_.new_label();
+			assembler::label jump_table_ = as_.new_label();
+
+			struct exit_stub {
+				assembler::label label_;
+				exit_reason reason_;
+				std::ptrdiff_t program_counter_;
+				std::ptrdiff_t correction_;
+			};
+			std::vector<exit_stub> exit_stubs_;
+
+			[[nodiscard]]
+			bool in_region(std::ptrdiff_t const address) const { return begin_ <= address && address < end_; }
+
+			//Returns a label of code returning to the emulator which shall continue with the instruction at the given address
+			assembler::label exit_to(exit_reason const reason, std::ptrdiff_t const program_counter, std::ptrdiff_t const current) {
+				assembler::label const label = as_.new_label();
+				//instructions between the new PC and the end of current segment were counted, but won't be executed natively.
+				//The region is only left by jumps and at its end, where segments end as well
+				std::ptrdiff_t const correction = reason == exit_reason::leave || (reason == exit_reason::poll && program_counter <= current)
+					? 0 : segment_ends_[current - begin_] - program_counter;
+				exit_stubs_.push_back({ label, reason, program_counter, correction });
+				return label;
+			}
+
+			void find_segments() {
+				std::ptrdiff_t const size = end_ - begin_;
+				leaders_.assign(size + 1, false);
+				leaders_[0] = leaders_[size] = true;
+				for (std::ptrdiff_t i = begin_; i < end_; ++i)
+					if (instruction const& inst = code_[i]; inst.op_code_ == op_code::branch || inst.op_code_ == op_code::branch_nz) {
+						leaders_[i + 1 - begin_] = true;
+						if (in_region(inst.destination_))
+							leaders_[inst.destination_ - begin_] = true;
+					}
+					else if (inst.op_code_ == op_code::program_exit)
+						leaders_[i + 1 - begin_] = true;
+
+				segment_ends_.assign(size, end_);
+				for (std::ptrdiff_t i = size - 1, end = end_; i >= 0; --i) {
+					segment_ends_[i] = end;
+					if (leaders_[i])
+						end = begin_ + i;
+				}
+			}
+
+			void emit_prologue() {
+				as_.bytes({ 0x53, 0x41, 0x54, 0x41, 0x55, 0x41, 0x56, 0x41, 0x57 }); //push rbx, r12, r13, r14, r15
+				as_.bytes({ 0x48, 0x83, 0xEC, 0x20 }); //sub rsp, 32 - shadow space for Win64 calls, keeps the stack aligned
+#ifdef _WIN32
+				as_.bytes({ 0x49, 0x89, 0xCC }); //mov r12, rcx
+#else
+				as_.bytes({ 0x49, 0x89, 0xFC }); //mov r12, rdi
+#endif
+				as_.bytes({ 0x49, 0x8B, 0x5C, 0x24, cell_pointer_disp }); //mov rbx, [r12 + cell_pointer]
+				as_.bytes({ 0x4D, 0x8B, 0x7C, 0x24, executed_disp });     //mov r15, [r12 + executed_instructions]
+				as_.bytes({ 0x49, 0xBD }); //mov r13, memory begin
+				as_.imm64(reinterpret_cast<std::uintptr_t>(memory_));
+				as_.bytes({ 0x49, 0xBE }); //mov r14, memory end
+				as_.imm64(reinterpret_cast<std::uintptr_t>(memory_ + memory_bytes_));
+
+				//jump to the entry of requested instruction through a table of offsets, which starts at the beginning of the region
+				if (begin_) {
+#ifdef _WIN32
+					as_.bytes({ 0x48, 0x81, 0xEA }); //sub rdx, begin
+#else
+					as_.bytes({ 0x48, 0x81, 0xEE }); //sub rsi, begin
+#endif
+					as_.imm32(static_cast<std::int32_t>(begin_));
+				}
+				as_.bytes({ 0x48, 0x8D, 0x05 }); //lea rax, [rip + jump_table]
+				as_.rel32(jump_table_);
+#ifdef _WIN32
+				as_.bytes({ 0x48, 0x63, 0x0C, 0x90 }); //movsxd rcx, dword [rax + rdx*4]
+#else
+				as_.bytes({ 0x48, 0x63, 0x0C, 0xB0 }); //movsxd rcx, dword [rax + rsi*4]
+#endif
+				as_.bytes({ 0x48, 0x01, 0xC8 }); //add rax, rcx
+				as_.bytes({ 0xFF, 0xE0 });       //jmp rax
+			}
+
+			void emit_common_exit() {
+				as_.bind(common_exit_);
+				as_.bytes({ 0x49, 0x89, 0x5C, 0x24, cell_pointer_disp }); //mov [r12 + cell_pointer], rbx
+				as_.bytes({ 0x4D, 0x89, 0x7C, 0x24, executed_disp });     //mov [r12 + executed_instructions], r15
+				as_.bytes({ 0x48, 0x83, 0xC4, 0x20 }); //add rsp, 32
+				as_.bytes({ 0x41, 0x5F, 0x41, 0x5E, 0x41, 0x5D, 0x41, 0x5C, 0x5B }); //pop r15, r14, r13, r12, rbx
+				as_.bytes({ 0xC3 }); //ret
+			}
+
+			void emit_exit_stubs() {
+				for (exit_stub const& stub : exit_stubs_) {
+					as_.bind(stub.label_);
+					as_.bytes({ 0x41, 0xC7, 0x44, 0x24, exit_reason_disp }); //mov dword [r12 + exit_reason], reason
+					as_.imm32(static_cast<std::int32_t>(stub.reason_));
+					as_.bytes({ 0x48, 0xC7, 0xC0 }); //mov rax, program counter
+					as_.imm32(static_cast<std::int32_t>(stub.program_counter_));
+					if (stub.correction_) {
+						as_.bytes({ 0x49, 0x81, 0xEF }); //sub r15, correction
+						as_.imm32(static_cast<std::int32_t>(stub.correction_));
+					}
+					as_.bytes({ 0xE9 }); //jmp common_exit
+					as_.rel32(common_exit_);
+				}
+			}
+
+			//Instructions entered in the middle of a segment have to count the rest of it themselves
+			void emit_entry_stubs() {
+				for (std::ptrdiff_t i = 0; i < end_ - begin_; ++i)
+					if (!leaders_[i]) {
+						as_.bind(entry_labels_[i]);
+						as_.bytes({ 0x49, 0x81, 0xC7 }); //add r15, remaining instructions of the segment
+						as_.imm32(static_cast<std::int32_t>(segment_ends_[i] - begin_ - i));
+						as_.bytes({ 0xE9 });
+						as_.rel32(body_labels_[i]);
+					}
+			}
+
+			void emit_jump_table() {
+				as_.bind(jump_table_);
+				std::ptrdiff_t const base = as_.position();
+				for (assembler::label const entry : entry_labels_)
+					as_.offset32(entry, base);
+			}
+
+			//Moves rbx by count cells wrapping around the memory's boundaries
+			void emit_shift(std::ptrdiff_t count) {
+				count %= memory_size_;
+				if (count == 0)
+					return;
+				as_.bytes({ 0x48, 0x81, 0xC3 }); //add rbx, count
+				as_.imm32(static_cast<std::int32_t>(count * cell_size_));
+				if (count > 0) {
+					as_.bytes({ 0x4C, 0x39, 0xF3, 0x72, 0x07 }); //cmp rbx, r14; jb +7
+					as_.bytes({ 0x48, 0x81, 0xEB });             //sub rbx, memory_size
+				}
+				else {
+					as_.bytes({ 0x4C, 0x39, 0xEB, 0x73, 0x07 }); //cmp rbx, r13; jae +7
+					as_.bytes({ 0x48, 0x81, 0xC3 });             //add rbx, memory_size
+				}
+				as_.imm32(static_cast<std::int32_t>(memory_bytes_));
+			}
+
+			//Loads the address of cell [rbx + offset] into rax wrapping around the memory's boundaries
+			void emit_offset_address(std::ptrdiff_t offset) {
+				offset %= memory_size_;
+				as_.bytes({ 0x48, 0x8D, 0x83 }); //lea rax, [rbx + offset]
+				as_.imm32(static_cast<std::int32_t>(offset * cell_size_));
+				if (offset > 0) {
+					as_.bytes({ 0x4C, 0x39, 0xF0, 0x72, 0x06 }); //cmp rax, r14; jb +6
+					as_.bytes({ 0x48, 0x2D });                   //sub rax, memory_size
+				}
+				else if (offset < 0) {
+					as_.bytes({ 0x4C, 0x39, 0xE8, 0x73, 0x06 }); //cmp rax, r13; jae +6
+					as_.bytes({ 0x48, 0x05 });                   //add rax, memory_size
+				}
+				else
+					return;
+				as_.imm32(static_cast<std::int32_t>(memory_bytes_));
+			}
+
+			enum class cell_operand : std::uint8_t { cell_pointer = 0x03, rax = 0x00 }; //ModRM bytes of [rbx] and [rax]
+
+			//Emits the immediate of an instruction operating on a cell, i.e. the value truncated to the width of cells
+			void emit_cell_immediate(std::ptrdiff_t const value) {
+				switch (width_) {
+				case cell_width::bits8:
+					as_.bytes({ static_cast<std::uint8_t>(value) });
+					break;
+				case cell_width::bits16:
+					as_.imm16(static_cast<std::int16_t>(static_cast<std::uint16_t>(value)));
+					break;
+				case cell_width::bits32:
+					as_.imm32(static_cast<std::int32_t>(static_cast<std::uint32_t>(value)));
+					break;
+				}
+			}
+
+			//Emits the operand size prefix and the opcode of an instruction operating on a cell; 8-bit and wider forms differ by the opcode
+			void emit_cell_opcode(std::uint8_t const byte_opcode, std::uint8_t const wide_opcode) {
+				if (width_ == cell_width::bits16)
+					as_.bytes({ 0x66 });
+				as_.bytes({ width_ == cell_width::bits8 ? byte_opcode : wide_opcode });
+			}
+
+			//add [operand], value
+			void emit_cell_add(cell_operand const operand, std::ptrdiff_t const value) {
+				emit_cell_opcode(0x80, 0x81);
+				as_.bytes({ static_cast<std::uint8_t>(operand) });
+				emit_cell_immediate(value);
+			}
+
+			//mov [operand], value
+			void emit_cell_store(cell_operand const operand, std::ptrdiff_t const value) {
+				emit_cell_opcode(0xC6, 0xC7);
+				as_.bytes({ static_cast<std::uint8_t>(operand) });
+				emit_cell_immediate(value);
+			}
+
+			enum class pointer_arg { cell_pointer, rax };
+
+			//Calls a helper from the context passing the context, a cell pointer and optionally an immediate as arguments
+			void emit_helper_call(std::uint8_t const helper_disp, pointer_arg const pointer, std::ptrdiff_t const immediate = 0) {
+#ifdef _WIN32
+				as_.bytes({ 0x4C, 0x89, 0xE1 }); //mov rcx, r12
+				if (pointer == pointer_arg::cell_pointer)
+					as_.bytes({ 0x48, 0x89, 0xDA }); //mov rdx, rbx
+				else
+					as_.bytes({ 0x48, 0x89, 0xC2 }); //mov rdx, rax
+				if (immediate) {
+					as_.bytes({ 0x49, 0xC7, 0xC0 }); //mov r8, immediate
+					as_.imm32(static_cast<std::int32_t>(immediate));
+				}
+#else
+				as_.bytes({ 0x4C, 0x89, 0xE7 }); //mov rdi, r12
+				if (pointer == pointer_arg::cell_pointer)
+					as_.bytes({ 0x48, 0x89, 0xDE }); //mov rsi, rbx
+				else
+					as_.bytes({ 0x48, 0x89, 0xC6 }); //mov rsi, rax
+				if (immediate) {
+					as_.bytes({ 0x48, 0xC7, 0xC2 }); //mov rdx, immediate
+					as_.imm32(static_cast<std::int32_t>(immediate));
+				}
+#endif
+				as_.bytes({ 0x41, 0xFF, 0x54, 0x24, helper_disp }); //call [r12 + helper]
+			}
+
+			/*Emits a jump to the entry of target instruction. Backward jumps periodically return to the emulator to poll CPU's flags,
+			jumps out of the region return to the emulator right away.*/
+			void emit_jump(std::ptrdiff_t const target, std::ptrdiff_t const current) {
+				if (!in_region(target)) {
+					as_.bytes({ 0xE9 });
+					as_.rel32(exit_to(exit_reason::leave, target, current));
+					return;
+				}
+				if (target <= current) {
+					as_.bytes({ 0x49, 0xFF, 0x4C, 0x24, poll_disp }); //dec qword [r12 + poll_countdown]
+					as_.bytes({ 0x0F, 0x84 });                        //jz poll_exit
+					as_.rel32(exit_to(exit_reason::poll, target, current));
+				}
+				as_.bytes({ 0xE9 }); //jmp target
+				as_.rel32(entry_labels_[target - begin_]);
+			}
+
+			void emit_instruction(std::ptrdiff_t const address) {
+				instruction const& inst = code_[address];
+
+				switch (inst.op_code_) {
+				case op_code::nop:
+				case op_code::program_entry:
+					break;
+				case op_code::inc:
+					if (wrap_unsigned(inst.argument_, width_))
+						emit_cell_add(cell_operand::cell_pointer, inst.argument_);
+					break;
+				case op_code::load_const:
+					emit_cell_store(cell_operand::cell_pointer, inst.argument_);
+					break;
+				case op_code::right:
+					emit_shift(inst.argument_);
+					break;
+				case op_code::right_unchecked:
+					if (!unchecked_shifts_)
+						emit_shift(inst.argument_);
+					else if (inst.argument_) {
+						as_.bytes({ 0x48, 0x81, 0xC3 }); //add rbx, count
+						as_.imm32(static_cast<std::int32_t>(inst.argument_ * cell_size_));
+					}
+					break;
+				case op_code::branch:
+					emit_jump(inst.destination_, address);
+					break;
+				case op_code::branch_nz:
+				{
+					assembler::label const not_taken = as_.new_label();
+					emit_cell_opcode(0x80, 0x83); //cmp [rbx], 0 - the wide forms use a sign extended 8-bit immediate
+					as_.bytes({ 0x3B, 0x00, 0x0F, 0x84 }); //jz not_taken
+					as_.rel32(not_taken);
+					emit_jump(inst.destination_, address);
+					as_.bind(not_taken);
+					break;
+				}
+				case op_code::read:
+					emit_helper_call(read_disp, pointer_arg::cell_pointer);
+					as_.bytes({ 0x85, 0xC0, 0x0F, 0x85 }); //test eax, eax; jnz stop
+					as_.rel32(exit_to(exit_reason::poll, address + 1, address));
+					break;
+				case op_code::write:
+					emit_helper_call(write_disp, pointer_arg::cell_pointer);
+					break;
+				case op_code::search_right:
+				case op_code::search_left:
+					emit_helper_call(search_disp, pointer_arg::cell_pointer, inst.op_code_ == op_code::search_left ? -inst.argument_ : inst.argument_);
+					as_.bytes({ 0x48, 0x85, 0xC0, 0x0F, 0x84 }); //test rax, rax; jz interpret - let the emulator report an endless search
+					as_.rel32(exit_to(exit_reason::interpret, address, address));
+					as_.bytes({ 0x48, 0x89, 0xC3 }); //mov rbx, rax
+					break;
+				case op_code::clear_search_right:
+				case op_code::clear_search_left:
+					emit_helper_call(clear_search_disp, pointer_arg::cell_pointer, inst.op_code_ == op_code::clear_search_left ? -inst.argument_ : inst.argument_);
+					as_.bytes({ 0x48, 0x89, 0xC3 }); //mov rbx, rax
+					break;
+				case op_code::fill_range: //the helper reads the rest of operands from the instruction itself
+					if (address == 0) { //the address is passed as an immediate, which is not emitted when zero
+						as_.bytes({ 0xE9 });
+						as_.rel32(exit_to(exit_reason::interpret, address, address));
+						break;
+					}
+					emit_offset_address(inst.offset_);
+					emit_helper_call(fill_disp, pointer_arg::rax, address);
+					break;
+				case op_code::inc_offset:
+					emit_offset_address(inst.offset_);
+					emit_cell_add(cell_operand::rax, inst.argument_);
+					break;
+				case op_code::load_const_offset:
+					emit_offset_address(inst.offset_);
+					emit_cell_store(cell_operand::rax, inst.argument_);
+					break;
+				case op_code::write_offset:
+					emit_offset_address(inst.offset_);
+					emit_helper_call(write_disp, pointer_arg::rax);
+					break;
+				case op_code::mul_add:
+					emit_offset_address(inst.offset_);
+					switch (width_) { //load the current cell zero extended to ecx
+					case cell_width::bits8:
+						as_.bytes({ 0x0F, 0xB6, 0x0B }); //movzx ecx, byte [rbx]
+						break;
+					case cell_width::bits16:
+						as_.bytes({ 0x0F, 0xB7, 0x0B }); //movzx ecx, word [rbx]
+						break;
+					case cell_width::bits32:
+						as_.bytes({ 0x8B, 0x0B }); //mov ecx, dword [rbx]
+						break;
+					}
+					as_.bytes({ 0x69, 0xC9 }); //imul ecx, ecx, factor
+					as_.imm32(static_cast<std::int32_t>(static_cast<std::uint32_t>(wrap_unsigned(inst.argument_, width_))));
+					emit_cell_opcode(0x00, 0x01); //add [rax], cl/cx/ecx
+					as_.bytes({ 0x08 });
+					break;
+				case op_code::program_exit:
+					as_.bytes({ 0xE9 });
+					as_.rel32(exit_to(exit_reason::finished, address + 1, address));
+					break;
+				default: //breakpoints and instructions without native translation are executed by the emulator
+					as_.bytes({ 0xE9 });
+					as_.rel32(exit_to(exit_reason::interpret, address, address));
+				}
+			}
+
+			//Returns true iff all immediates of the instruction can be encoded
+			[[nodiscard]]
+			bool is_encodable(instruction const& inst) const {
+				return fits_int32(inst.argument_) && fits_int32(inst.offset_)
+					&& (!inst.is_shift() || fits_int32(inst.argument_ * cell_size_))
+					&& (!inst.is_jump() || (0 <= inst.destination_ && inst.destination_ < code_size_));
+			}
+
+		public:
+			translator(std::vector<instruction> const& code, std::ptrdiff_t const begin, std::ptrdiff_t const end, unsigned char* const memory,
+				std::ptrdiff_t const memory_size, cell_width const width, bool const unchecked_shifts)
+				: code_{ code }, memory_{ memory }, memory_size_{ memory_size }, width_{ width },
+				cell_size_{ static_cast<std::ptrdiff_t>(cell_size(width)) }, memory_bytes_{ memory_size * cell_size_ }, unchecked_shifts_{ unchecked_shifts },
+				code_size_{ static_cast<std::ptrdiff_t>(code.size()) }, begin_{ begin }, end_{ end } {}
+
+			[[nodiscard]]
+			bool translatable() const {
+				return fits_int32(memory_bytes_) && fits_int32(code_size_)
+					&& std::all_of(code_.begin() + begin_, code_.begin() + end_, [this](instruction const& inst) { return is_encodable(inst); });
+			}
+
+			std::vector<std::uint8_t>& translate() {
+				assert(translatable());
+				for (std::ptrdiff_t i = begin_; i < end_; ++i) {
+					entry_labels_.push_back(as_.new_label());
+					body_labels_.push_back(as_.new_label());
+				}
+				find_segments();
+
+				emit_prologue();
+				for (std::ptrdiff_t i = begin_; i < end_; ++i) {
+					if (leaders_[i - begin_]) {
+						as_.bind(entry_labels_[i - begin_]);
+						as_.bytes({ 0x49, 0x81, 0xC7 }); //add r15, segment length
+						as_.imm32(static_cast<std::int32_t>(segment_ends_[i - begin_] - i));
+					}
+					as_.bind(body_labels_[i - begin_]);
+					emit_instruction(i);
+				}
+				//falling off the end of code finishes the execution as well, falling off a region leaves it
+				as_.bytes({ 0xE9 });
+				as_.rel32(exit_to(end_ == code_size_ ? exit_reason::finished : exit_reason::leave, end_, end_ - 1));
+
+				emit_entry_stubs();
+				emit_exit_stubs();
+				emit_common_exit();
+				emit_jump_table();
+				return as_.resolve();
+			}
+		};
+
+		void* allocate_executable(std::vector<std::uint8_t> const& code) {
+#ifdef _WIN32
+			void* const memory = VirtualAlloc(nullptr, code.size(), MEM_COMMIT | MEM_RESERVE, PAGE_READWRITE);
+			if (!memory)
+				return nullptr;
+			std::memcpy(memory, code.data(), code.size());
+			DWORD old_protection;
+			if (!VirtualProtect(memory, code.size(), PAGE_EXECUTE_READ, &old_protection)) {
+				VirtualFree(memory, 0, MEM_RELEASE);
+				return nullptr;
+			}
+			FlushInstructionCache(GetCurrentProcess(), memory, code.size());
+			return memory;
+#else
+			void* const memory = mmap(nullptr, code.size(), PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+			if (memory == MAP_FAILED)
+				return nullptr;
+			std::memcpy(memory, code.data(), code.size());
+			if (mprotect(memory, code.size(), PROT_READ | PROT_EXEC)) {
+				munmap(memory, code.size());
+				return nullptr;
+			}
+			return memory;
+#endif
+		}
+	}
+
+	compiled_program::~compiled_program() {
+#ifdef _WIN32
+		VirtualFree(memory_, 0, MEM_RELEASE);
+#else
+		munmap(memory_, size_);
+#endif
+	}
+
+	std::unique_ptr<compiled_program> compile(std::vector<instruction> const& code, unsigned char* const memory,
+		std::ptrdiff_t const memory_size, cell_width const width, bool const unchecked_shifts) {
+		return compile_region(code, 0, static_cast<std::ptrdiff_t>(code.size()), memory, memory_size, width, unchecked_shifts);
+	}
+
+	std::unique_ptr<compiled_program> compile_region(std::vector<instruction> const& code, std::ptrdiff_t const begin, std::ptrdiff_t const end,
+		unsigned char* const memory, std::ptrdiff_t const memory_size, cell_width const width, bool const unchecked_shifts) {
+
+		if constexpr (!available)
+			return nullptr;
+
+		assert(0 <= begin && begin <= end && end <= static_cast<std::ptrdiff_t>(code.size()));
+		if (begin == end)
+			return nullptr;
+
+		translator translator{ code, begin, end, memory, memory_size, width, unchecked_shifts };
+		if (!translator.translatable())
+			return nullptr;
+
+		std::vector<std::uint8_t> const& machine_code = translator.translate();
+		void* const executable = allocate_executable(machine_code);
+		if (!executable)
+			return nullptr;
+
+		return std::make_unique<compiled_program>(executable, machine_code.size(),
+			reinterpret_cast<std::ptrdiff_t(*)(context*, std::ptrdiff_t)>(executable), begin, end);
+	}
+}
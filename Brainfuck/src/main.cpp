@@ -2,6 +2,8 @@
 
 
 #include <iostream>
+#include <string>
+#include <string_view>
 
 #include "emulator.h"
 #include "cli.h"
@@ -9,6 +11,14 @@
 #include "optimizer.h"
 #include "breakpoint.h"
 #include "data_inspection.h"
+#include "emit.h"
+#include "program_image.h"
+#include "profiler.h"
+#include "trace.h"
+#include "bench.h"
+#include "batch.h"
+#include "headless.h"
+#include "stats.h"
 
 
 namespace bf {
@@ -20,14 +30,33 @@ namespace bf {
 		breakpoints::initialize();
 		data_inspection::initialize();
 		opt::initialize();
+		emit::initialize();
+		image::initialize();
+		profiler::initialize();
+		trace::initialize();
+		bench::initialize();
+		batch::initialize();
+		stats::initialize();
 	}
 } //namespace bf
 
 
-int main([[maybe_unused]] int argc, [[maybe_unused]] char** argv) {
+int main(int argc, char** argv) {
 	std::ios::sync_with_stdio(false);
 
+	//"brainfuck run [options] file" executes the program without the debugger, no commands need to be registered
+	if (argc > 1 && std::string_view{ argv[1] } == "run")
+		return bf::headless::run(argc - 2, argv + 2);
+
 	bf::initialize_commands();
 
+	//"brainfuck bench [args]" runs the benchmark and exits, so that it can be invoked from scripts tracking performance between builds
+	if (argc > 1 && std::string_view{ argv[1] } == "bench") {
+		std::string command = "bench";
+		for (int i = 2; i < argc; ++i)
+			command.append(" ").append(argv[i]);
+		return bf::cli::execute_command(std::move(command), false);
+	}
+
 	bf::cli::cli_command_loop();
 }
@@ -0,0 +1,374 @@
+#include "memory_kernels.h"
+
+#include <cassert>
+#include <cstdint>
+#include <cstring>
+#include <numeric>
+#include <algorithm>
+#include <array>
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#define BF_VECTOR_KERNELS
+#elif defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define BF_VECTOR_KERNELS
+#endif
+
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+
+namespace bf::execution::kernels {
+
+	namespace {
+
+#ifdef BF_VECTOR_KERNELS
+#if defined(__AVX2__)
+		constexpr std::ptrdiff_t vector_width = 32; //in bytes
+
+		/*Returns a bitmask with ones at positions of bytes of zero cells in [pointer, pointer + vector_width) bytes.
+		All bits corresponding to a zero cell are set, regardless of its width.*/
+		template<typename CELL>
+		std::uint32_t zero_mask(CELL const* const pointer) {
+			__m256i const data = _mm256_loadu_si256(reinterpret_cast<__m256i const*>(pointer));
+			__m256i const zero = _mm256_setzero_si256();
+			if constexpr (sizeof(CELL) == 1)
+				return static_cast<std::uint32_t>(_mm256_movemask_epi8(_mm256_cmpeq_epi8(data, zero)));
+			else if constexpr (sizeof(CELL) == 2)
+				return static_cast<std::uint32_t>(_mm256_movemask_epi8(_mm256_cmpeq_epi16(data, zero)));
+			else
+				return static_cast<std::uint32_t>(_mm256_movemask_epi8(_mm256_cmpeq_epi32(data, zero)));
+		}
+
+		//Stores bytes of values selected by the mask to [pointer, pointer + vector_width) bytes, the other bytes are kept
+		template<typename CELL>
+		void blend_store(CELL* const pointer, std::uint8_t const* const mask, CELL const value) {
+			__m256i const data = _mm256_loadu_si256(reinterpret_cast<__m256i const*>(pointer));
+			__m256i const selected = _mm256_loadu_si256(reinterpret_cast<__m256i const*>(mask));
+			__m256i values;
+			if constexpr (sizeof(CELL) == 1)
+				values = _mm256_set1_epi8(static_cast<char>(value));
+			else if constexpr (sizeof(CELL) == 2)
+				values = _mm256_set1_epi16(static_cast<short>(value));
+			else
+				values = _mm256_set1_epi32(static_cast<int>(value));
+			_mm256_storeu_si256(reinterpret_cast<__m256i*>(pointer), _mm256_blendv_epi8(data, values, selected));
+		}
+#else
+		constexpr std::ptrdiff_t vector_width = 16; //in bytes
+
+		/*Returns a bitmask with ones at positions of bytes of zero cells in [pointer, pointer + vector_width) bytes.
+		All bits corresponding to a zero cell are set, regardless of its width.*/
+		template<typename CELL>
+		std::uint32_t zero_mask(CELL const* const pointer) {
+			__m128i const data = _mm_loadu_si128(reinterpret_cast<__m128i const*>(pointer));
+			__m128i const zero = _mm_setzero_si128();
+			if constexpr (sizeof(CELL) == 1)
+				return static_cast<std::uint32_t>(_mm_movemask_epi8(_mm_cmpeq_epi8(data, zero)));
+			else if constexpr (sizeof(CELL) == 2)
+				return static_cast<std::uint32_t>(_mm_movemask_epi8(_mm_cmpeq_epi16(data, zero)));
+			else
+				return static_cast<std::uint32_t>(_mm_movemask_epi8(_mm_cmpeq_epi32(data, zero)));
+		}
+
+		//Stores bytes of values selected by the mask to [pointer, pointer + vector_width) bytes, the other bytes are kept
+		template<typename CELL>
+		void blend_store(CELL* const pointer, std::uint8_t const* const mask, CELL const value) {
+			__m128i const data = _mm_loadu_si128(reinterpret_cast<__m128i const*>(pointer));
+			__m128i const selected = _mm_loadu_si128(reinterpret_cast<__m128i const*>(mask));
+			__m128i values;
+			if constexpr (sizeof(CELL) == 1)
+				values = _mm_set1_epi8(static_cast<char>(value));
+			else if constexpr (sizeof(CELL) == 2)
+				values = _mm_set1_epi16(static_cast<short>(value));
+			else
+				values = _mm_set1_epi32(static_cast<int>(value));
+			_mm_storeu_si128(reinterpret_cast<__m128i*>(pointer), _mm_or_si128(_mm_and_si128(selected, values), _mm_andnot_si128(selected, data)));
+		}
+#endif
+
+		//Strides up to this value are scanned by vector kernels. Larger ones touch too few cells of each vector to be worth it
+		constexpr std::ptrdiff_t max_vector_stride = 8;
+
+		int lowest_set_bit(std::uint32_t const mask) {
+			assert(mask);
+#ifdef _MSC_VER
+			unsigned long index;
+			_BitScanForward(&index, mask);
+			return static_cast<int>(index);
+#else
+			return __builtin_ctz(mask);
+#endif
+		}
+
+		int highest_set_bit(std::uint32_t const mask) {
+			assert(mask);
+#ifdef _MSC_VER
+			unsigned long index;
+			_BitScanReverse(&index, mask);
+			return static_cast<int>(index);
+#else
+			return 31 - __builtin_clz(mask);
+#endif
+		}
+
+		/*Masks selecting the first bytes of cells visited by the search in consecutive vectors. Since the number of cells in a vector
+		need not be divisible by the stride, the pattern repeats every stride / gcd(cells per vector, stride) vectors.*/
+		template<typename CELL>
+		struct stride_masks {
+			static constexpr std::ptrdiff_t cell_size = sizeof(CELL);
+			static constexpr std::ptrdiff_t vector_cells = vector_width / cell_size;
+
+			std::array<std::uint32_t, max_vector_stride> masks_{};
+			std::ptrdiff_t period_;
+
+			//When reversed, the masks are generated for a search going to lower addresses, whose first vector ends with the start cell
+			stride_masks(std::ptrdiff_t const stride, bool const reversed)
+				: period_{ stride / std::gcd(vector_cells, stride) } {
+				assert(0 < stride && stride <= max_vector_stride);
+				for (std::ptrdiff_t vector = 0; vector < period_; ++vector)
+					for (std::ptrdiff_t bit = 0; bit < vector_width; bit += cell_size) {
+						std::ptrdiff_t const distance = vector * vector_width + (reversed ? vector_width - cell_size - bit : bit); //in bytes
+						if (distance % (stride * cell_size) == 0)
+							masks_[vector] |= std::uint32_t{ 1 } << bit;
+					}
+			}
+		};
+
+		template<typename CELL>
+		std::ptrdiff_t vector_find_zero_right(CELL const* const tape, std::ptrdiff_t const size, std::ptrdiff_t const start, std::ptrdiff_t const stride) {
+			using masks_t = stride_masks<CELL>;
+			masks_t const masks{ stride, false };
+
+			std::ptrdiff_t position = start;
+			for (std::ptrdiff_t vector = 0; position + masks_t::vector_cells <= size; position += masks_t::vector_cells) {
+				if (std::uint32_t const hits = zero_mask(tape + position) & masks.masks_[vector]; hits)
+					return position + lowest_set_bit(hits) / masks_t::cell_size;
+				if (++vector == masks.period_)
+					vector = 0;
+			}
+
+			//scan the tail, which is shorter than a vector, cell by cell
+			for (position += (stride - (position - start) % stride) % stride; position < size; position += stride)
+				if (tape[position] == 0)
+					return position;
+			return npos;
+		}
+
+		template<typename CELL>
+		std::ptrdiff_t vector_find_zero_left(CELL const* const tape, std::ptrdiff_t const start, std::ptrdiff_t const stride) {
+			using masks_t = stride_masks<CELL>;
+			masks_t const masks{ stride, true };
+
+			std::ptrdiff_t position = start; //the highest cell not yet scanned
+			for (std::ptrdiff_t vector = 0; position - masks_t::vector_cells + 1 >= 0; position -= masks_t::vector_cells) {
+				std::ptrdiff_t const base = position - masks_t::vector_cells + 1;
+				if (std::uint32_t const hits = zero_mask(tape + base) & masks.masks_[vector]; hits)
+					return base + highest_set_bit(hits) / masks_t::cell_size;
+				if (++vector == masks.period_)
+					vector = 0;
+			}
+
+			for (position -= (stride - (start - position) % stride) % stride; position >= 0; position -= stride)
+				if (tape[position] == 0)
+					return position;
+			return npos;
+		}
+
+		/*Masks selecting all bytes of cells set by a strided fill in consecutive vectors. The pattern repeats with the same period
+		as that of stride_masks.*/
+		template<typename CELL>
+		struct fill_masks {
+			static constexpr std::ptrdiff_t cell_size = sizeof(CELL);
+			static constexpr std::ptrdiff_t vector_cells = vector_width / cell_size;
+
+			std::array<std::array<std::uint8_t, vector_width>, max_vector_stride> masks_{};
+			std::ptrdiff_t period_;
+
+			explicit fill_masks(std::ptrdiff_t const stride)
+				: period_{ stride / std::gcd(vector_cells, stride) } {
+				assert(0 < stride && stride <= max_vector_stride);
+				for (std::ptrdiff_t vector = 0; vector < period_; ++vector)
+					for (std::ptrdiff_t cell = 0; cell < vector_cells; ++cell)
+						if ((vector * vector_cells + cell) % stride == 0)
+							std::fill_n(masks_[vector].begin() + cell * cell_size, cell_size, std::uint8_t{ 0xFF });
+			}
+		};
+
+		/*Sets every stride-th cell of the first count ones by whole vectors, blending the value into the cells in between.
+		No cell past the last one set is touched.*/
+		template<typename CELL>
+		void vector_fill(CELL* const tape, std::ptrdiff_t const count, std::ptrdiff_t const stride, CELL const value) {
+			using masks_t = fill_masks<CELL>;
+			masks_t const masks{ stride };
+
+			std::ptrdiff_t const end = (count - 1) * stride + 1;
+			std::ptrdiff_t position = 0;
+			for (std::ptrdiff_t vector = 0; position + masks_t::vector_cells <= end; position += masks_t::vector_cells) {
+				blend_store(tape + position, masks.masks_[vector].data(), value);
+				if (++vector == masks.period_)
+					vector = 0;
+			}
+
+			for (position += (stride - position % stride) % stride; position < end; position += stride)
+				tape[position] = value;
+		}
+#endif
+
+		//Sets count cells tape[0], tape[stride]... to value, none of them lies beyond the end of the tape
+		template<typename CELL>
+		void fill_segment(CELL* const tape, std::ptrdiff_t const count, std::ptrdiff_t const stride, CELL const value) {
+			if (stride == 1) {
+				if constexpr (sizeof(CELL) == 1)
+					std::memset(tape, value, static_cast<std::size_t>(count));
+				else
+					std::fill_n(tape, count, value);
+				return;
+			}
+#ifdef BF_VECTOR_KERNELS
+			if (stride <= max_vector_stride)
+				return vector_fill(tape, count, stride, value);
+#endif
+			for (std::ptrdiff_t i = 0; i < count; ++i)
+				tape[i * stride] = value;
+		}
+
+		template<typename CELL>
+		std::ptrdiff_t scalar_find_zero_right(CELL const* const tape, std::ptrdiff_t const size, std::ptrdiff_t start, std::ptrdiff_t const stride) {
+			for (; start < size; start += stride)
+				if (tape[start] == 0)
+					return start;
+			return npos;
+		}
+
+		template<typename CELL>
+		std::ptrdiff_t scalar_find_zero_left(CELL const* const tape, std::ptrdiff_t start, std::ptrdiff_t const stride) {
+			for (; start >= 0; start -= stride)
+				if (tape[start] == 0)
+					return start;
+			return npos;
+		}
+	}
+
+	template<typename CELL>
+	std::ptrdiff_t find_zero_right(CELL const* const tape, std::ptrdiff_t const size, std::ptrdiff_t const start, std::ptrdiff_t const stride) {
+		assert(tape && 0 <= start && start < size && stride > 0);
+
+		if constexpr (sizeof(CELL) == 1)
+			if (stride == 1) { //the standard library has the best kernel for this case
+				void const* const found = std::memchr(tape + start, 0, static_cast<std::size_t>(size - start));
+				return found ? static_cast<CELL const*>(found) - tape : npos;
+			}
+#ifdef BF_VECTOR_KERNELS
+		if (stride <= max_vector_stride)
+			return vector_find_zero_right(tape, size, start, stride);
+#endif
+		return scalar_find_zero_right(tape, size, start, stride);
+	}
+
+	template<typename CELL>
+	std::ptrdiff_t find_zero_left(CELL const* const tape, std::ptrdiff_t const start, std::ptrdiff_t const stride) {
+		assert(tape && 0 <= start && stride > 0);
+
+#ifdef BF_VECTOR_KERNELS
+		if (stride <= max_vector_stride)
+			return vector_find_zero_left(tape, start, stride);
+#endif
+		return scalar_find_zero_left(tape, start, stride);
+	}
+
+	template<typename CELL>
+	std::optional<std::ptrdiff_t> find_zero(CELL const* const tape, std::ptrdiff_t const size, std::ptrdiff_t position, std::ptrdiff_t const stride) {
+		assert(tape && 0 <= position && position < size && stride != 0);
+
+		std::ptrdiff_t const step = (stride < 0 ? -stride : stride) % size;
+		if (step == 0) //the pointer returns to the same cell after each iteration
+			return tape[position] == 0 ? std::optional{ position } : std::nullopt;
+
+		/*Scan linear segments up to the boundary of the tape, then continue from the wrapped position.
+		The search visits size / gcd(size, step) distinct cells; once all of them have been seen without success, it never terminates.*/
+		std::ptrdiff_t const reachable_cells = size / std::gcd(size, step);
+		for (std::ptrdiff_t visited = 0; visited < reachable_cells;) {
+			if (stride > 0) {
+				if (std::ptrdiff_t const found = find_zero_right(tape, size, position, step); found != npos)
+					return found;
+				std::ptrdiff_t const segment = (size - position + step - 1) / step;
+				visited += segment;
+				position += segment * step - size;
+			}
+			else {
+				if (std::ptrdiff_t const found = find_zero_left(tape, position, step); found != npos)
+					return found;
+				std::ptrdiff_t const segment = position / step + 1;
+				visited += segment;
+				position += size - segment * step;
+			}
+		}
+		return std::nullopt;
+	}
+
+	template<typename CELL>
+	void fill(CELL* const tape, std::ptrdiff_t const size, std::ptrdiff_t position, std::ptrdiff_t count, std::ptrdiff_t const stride, CELL const value) {
+		assert(tape && 0 <= position && position < size && count >= 0 && stride > 0);
+
+		std::ptrdiff_t const step = stride % size;
+		if (step == 0) { //all cells are the same one
+			if (count)
+				tape[position] = value;
+			return;
+		}
+
+		count = std::min(count, size / std::gcd(size, step)); //further cells would only be set again
+		while (count > 0) { //fill linear segments up to the boundary of the tape, then continue from the wrapped position
+			std::ptrdiff_t const segment = std::min(count, (size - position + step - 1) / step);
+			fill_segment(tape + position, segment, step, value);
+			count -= segment;
+			position += segment * step - size;
+		}
+	}
+
+	template<typename CELL>
+	std::ptrdiff_t clear_to_zero(CELL* const tape, std::ptrdiff_t const size, std::ptrdiff_t position, std::ptrdiff_t const stride) {
+		assert(tape && 0 <= position && position < size && stride != 0);
+
+		std::ptrdiff_t const step = (stride < 0 ? -stride : stride) % size;
+		if (step == 0) { //the pointer returns to the same cell, which is zero after the first iteration
+			tape[position] = 0;
+			return position;
+		}
+
+		/*Each linear segment up to the boundary of the tape is cleared up to the first zero cell found in it. Every cell is cleared
+		when it is left, therefore the search stops at the latest when it returns to a cell it has already visited.*/
+		for (;;)
+			if (stride > 0) {
+				std::ptrdiff_t const found = find_zero_right(tape, size, position, step);
+				std::ptrdiff_t const segment = found != npos ? (found - position) / step : (size - position + step - 1) / step;
+				fill_segment(tape + position, segment, step, CELL{ 0 });
+				if (found != npos)
+					return found;
+				position += segment * step - size;
+			}
+			else {
+				std::ptrdiff_t const found = find_zero_left(tape, position, step);
+				std::ptrdiff_t const segment = found != npos ? (position - found) / step : position / step + 1;
+				if (segment)
+					fill_segment(tape + position - (segment - 1) * step, segment, step, CELL{ 0 });
+				if (found != npos)
+					return found;
+				position += size - segment * step;
+			}
+	}
+
+#define BF_INSTANTIATE_KERNELS(CELL) \
+	template std::ptrdiff_t find_zero_right(CELL const*, std::ptrdiff_t, std::ptrdiff_t, std::ptrdiff_t); \
+	template std::ptrdiff_t find_zero_left(CELL const*, std::ptrdiff_t, std::ptrdiff_t); \
+	template std::optional<std::ptrdiff_t> find_zero(CELL const*, std::ptrdiff_t, std::ptrdiff_t, std::ptrdiff_t); \
+	template void fill(CELL*, std::ptrdiff_t, std::ptrdiff_t, std::ptrdiff_t, std::ptrdiff_t, CELL); \
+	template std::ptrdiff_t clear_to_zero(CELL*, std::ptrdiff_t, std::ptrdiff_t, std::ptrdiff_t);
+
+	BF_INSTANTIATE_KERNELS(std::uint8_t)
+	BF_INSTANTIATE_KERNELS(std::uint16_t)
+	BF_INSTANTIATE_KERNELS(std::uint32_t)
+#undef BF_INSTANTIATE_KERNELS
+}
@@ -1,12 +1,33 @@
 #include "opt/arithmetic.h"
 #include "anal/analysis.h"
+#include "IR/inst_types.h"
 
+#include <algorithm>
+#include <map>
+#include <optional>
 
 #include <execution>
 #include <numeric>
 
 namespace bf::opt {
 
+	/*Returns true iff changes of the current cell cannot be moved across the instruction, because it may read the cell
+	(e.g. IO, conditional jumps, infinite loops, searches or multiplications), overwrite it or move the pointer.*/
+	[[nodiscard]]
+	static bool blocks_propagation(instruction const& inst) {
+		switch (inst.op_code_) {
+		case op_code::nop:
+		case op_code::write_string: //does not access memory at all
+			return false;
+		case op_code::inc_offset:
+		case op_code::load_const_offset:
+		case op_code::write_offset:
+			return inst.offset_ == 0; //other cells than the current one are not affected
+		default:
+			return true;
+		}
+	}
+
 	static void propagate_forward(analysis::same_offset_iterator iter) {
 		assert(iter);
 		assert(iter->is_const());
@@ -21,7 +42,7 @@ namespace bf::opt {
 				constant.make_nop();
 				break;
 			}
-			else if (inst.is_io())
+			else if (blocks_propagation(inst)) //the cell is read before the remaining changes or they may operate on another cell
 				break;
 	}
 
@@ -34,7 +55,7 @@ namespace bf::opt {
 				inst.make_nop();
 			else if (inst.is_const())
 				MUST_NOT_BE_REACHED;
-			else if (inst.is_io())
+			else if (blocks_propagation(inst)) //the cell is read after the preceding changes or they may operate on another cell
 				break;
 	}
 
@@ -44,6 +65,7 @@ namespace bf::opt {
 			return 0;
 
 		analysis::pointer_movement analysis_res{ block };
+		std::ptrdiff_t const original_nops = std::count_if(block->ops_.begin(), block->ops_.end(), std::mem_fn(&instruction::is_nop));
 
 		for (auto const iter_to_const : block->inst_filter(&instruction::is_const)) {
 
@@ -52,6 +74,53 @@ namespace bf::opt {
 			propagate_backward(same_offset_iter);
 			propagate_forward(same_offset_iter);
 		}
+		//every eliminated instruction is turned into a nop
+		return std::count_if(block->ops_.begin(), block->ops_.end(), std::mem_fn(&instruction::is_nop)) - original_nops;
+	}
+
+	std::ptrdiff_t global_const_propagator::do_optimize(std::vector<basic_block*>& program) const {
+		if (program.empty())
+			return 0;
+
+		std::map<basic_block const*, analysis::known_cells> const entry_states = analysis::analyze_known_cells(program, memory_size_);
+		std::ptrdiff_t change_count = 0;
+
+		for (basic_block* const block : program) {
+			auto const entry = entry_states.find(block);
+			if (entry == entry_states.end()) //never executed, dead code elimination takes care of it
+				continue;
+
+			analysis::known_cells state = entry->second;
+			for (instruction& inst : block->ops_) {
+				std::optional<std::ptrdiff_t> const loaded_cell = inst.op_code_ == op_code::load_const ? std::optional<std::ptrdiff_t>{ 0 }
+					: inst.op_code_ == op_code::load_const_offset ? std::optional<std::ptrdiff_t>{ inst.offset_ } : std::nullopt;
+				if (loaded_cell && state.value(*loaded_cell) == static_cast<std::uint32_t>(inst.argument_)) {
+					inst.make_nop(); //the cell already holds the constant
+					++change_count;
+				}
+				else
+					state.execute(inst);
+			}
+
+			if (!block->is_cjump())
+				continue;
+			//both successors may be the same block, which then has this block as its predecessor only once
+			if (state.is_zero(0)) { //the jump is never taken
+				if (block->jump_successor_ != block->natural_successor_)
+					block->jump_successor_->remove_predecessor(block);
+				block->jump_successor_ = nullptr;
+				block->ops_.back().make_nop();
+				++change_count;
+			}
+			else if (state.is_non_zero(0)) { //the jump is always taken
+				if (block->natural_successor_ != block->jump_successor_)
+					block->natural_successor_->remove_predecessor(block);
+				block->natural_successor_ = nullptr;
+				block->ops_.back().op_code_ = op_code::branch;
+				++change_count;
+			}
+		}
+		return change_count;
 	}
 
 	namespace {
@@ -90,8 +159,10 @@ namespace bf::opt {
 			INST = Opcode that is considered positive in the given arithmetic operation. Either 'op_code::inc' or 'op_code::right.' */
 
 			assert(block);
-			//This function makes instrucitons nop when they shall be removed. This makes sure that it's ok!
-			assert(std::none_of(std::execution::seq, block->ops_.begin(), block->ops_.end(), std::mem_fn(&instruction::is_nop)));
+			/*Nops left by preceding passes (or by the other half of arithmetic_tag::both) are skipped, since they do not separate
+			the operations. This function makes instructions nop as well when they shall be removed.*/
+			auto const considered = [](instruction const& inst) { return (inst.*traits::PREDICATE)() || inst.is_nop(); };
+			std::ptrdiff_t simplified_ranges = 0;
 
 			/*Algorithm:
 			Take each contiguous range of instructions from block's code that satisfy the predicate. If it consists of less than two instructions, ignore it.
@@ -109,20 +180,23 @@ namespace bf::opt {
 			After this process, all arithmetic instructions preceded by other AI can be deleted.
 			Then all AI with argument == 0 can be deleted as well. (Additions and subtractions compensated each other and the range can be deletd as a whole.)*/
 
-			for (auto const [head, end] : utils::iterate_ranges_if(block->ops_.begin(), block->ops_.end(), std::mem_fn(traits::PREDICATE))) {
-				if (std::distance(head, end) < 2)
+			for (auto const [begin, end] : utils::iterate_ranges_if(block->ops_.begin(), block->ops_.end(), considered)) {
+				if (std::count_if(begin, end, std::mem_fn(traits::PREDICATE)) < 2)
 					continue;
 
 				//Compute the result of all operations (reduce instructions' arguments)
-				std::ptrdiff_t const result_of_operations = std::transform_reduce(std::execution::seq, head, end, std::ptrdiff_t{ 0 },
-					std::plus{}, std::mem_fn(&instruction::argument));
-				//Make all instructions in the range nops. The first one will be modified to perform requested operation
-				std::for_each(std::execution::seq, head, end, std::mem_fn(&instruction::make_nop));
+				std::ptrdiff_t const result_of_operations = std::transform_reduce(std::execution::seq, begin, end, std::ptrdiff_t{ 0 },
+					std::plus{}, [](instruction const& inst) { return (inst.*traits::PREDICATE)() ? inst.argument() : 0; });
+				auto const head = std::find_if(begin, end, std::mem_fn(traits::PREDICATE));
+				//Make all instructions in the range nops. The first operation will be modified to perform requested operation
+				std::for_each(std::execution::seq, begin, end, std::mem_fn(&instruction::make_nop));
 
 				//If result != 0 make the first instruction perform something
 				if (result_of_operations != 0)
-					* head = instruction{ traits::INST, result_of_operations, head->source_offset_ };
+					* head = instruction{ traits::INST, result_of_operations, head->source_loc_ };
+				++simplified_ranges;
 			}
+			return simplified_ranges;
 		}
 	}
 
@@ -132,7 +206,7 @@ namespace bf::opt {
 	Value arithmetic is a sequence of two or more consecutive instructions 'inc' and 'dec', which modify the values in memory. E.g +++++++---+-----;
 	These sequences are identified, evaluated and in accordance to the as-if rule replaced by a single instruction that has the same effect.
 
-	Returns the number of eliminated instructions.
+	Returns the number of simplified sequences.
 	*/
 
 	template<arithmetic_tag TAG>
@@ -146,6 +220,99 @@ namespace bf::opt {
 			return do_simplify_arithmetic<TAG>(block);
 	}
 
+	std::ptrdiff_t pointer_folder::do_optimize(basic_block* const block) {
+		if (!block)
+			return 0;
+
+		analysis::pointer_movement const analysis_res{ block };
+		std::ptrdiff_t const original_shifts = std::count_if(block->ops_.begin(), block->ops_.end(), std::mem_fn(&instruction::is_shift));
+		if (original_shifts == 0)
+			return 0;
+
+		//stationary ranges are sorted by offset, but instructions have to be emitted in the order of their execution
+		std::vector<analysis::ptr_stationary_range> ranges = analysis_res.stationary_ranges();
+		std::sort(ranges.begin(), ranges.end(), [](auto const& lhs, auto const& rhs) { return lhs.begin_ < rhs.begin_; });
+
+		std::vector<instruction> folded;
+		folded.reserve(block->ops_.size());
+		std::ptrdiff_t materialized_offset = 0; //offset the cell pointer has been actually moved to by the emitted code
+		std::ptrdiff_t emitted_shifts = 0;
+
+		auto const materialize = [&](std::ptrdiff_t const offset, source_location const& loc) {
+			if (offset == materialized_offset)
+				return;
+			folded.push_back(instruction{ op_code::right, offset - materialized_offset, loc });
+			materialized_offset = offset;
+			++emitted_shifts;
+		};
+
+		std::ptrdiff_t unknown_moves = 0;
+		for (auto const& [offset, begin, end, moves_before] : ranges)
+			for (auto inst = begin; inst != end; ++inst) {
+				if (moves_before != unknown_moves) { //a search has moved the pointer, which is where the following offsets start
+					unknown_moves = moves_before;
+					materialized_offset = 0;
+				}
+				std::ptrdiff_t const relative = offset - materialized_offset;
+				if (relative == 0) {
+					folded.push_back(*inst);
+					continue;
+				}
+
+				switch (inst->op_code_) {
+				case op_code::inc:
+					folded.push_back(IR::inc_offset_instruction::make(inst->source_loc_, relative, inst->argument_));
+					break;
+				case op_code::load_const:
+					folded.push_back(IR::load_const_offset_instruction::make(inst->source_loc_, relative, inst->argument_));
+					break;
+				case op_code::write:
+					folded.push_back(IR::write_offset_instruction::make(inst->source_loc_, relative));
+					break;
+				case op_code::write_string: //does not access memory at all
+					folded.push_back(*inst);
+					break;
+				case op_code::fill_range: //addresses its cells relative to the pointer already
+					folded.push_back(*inst);
+					folded.back().offset_ += relative;
+					break;
+				default: //no offset-addressed form - the pointer has to be moved first
+					materialize(offset, inst->source_loc_);
+					folded.push_back(*inst);
+				}
+			}
+
+		//perform the rest of pointer's movement before leaving the block; it starts at the last search, even if no instruction follows it
+		if (analysis_res.unknown_moves() != unknown_moves)
+			materialized_offset = 0;
+		if (analysis_res.ptr_delta() != materialized_offset)
+			materialize(analysis_res.ptr_delta(), block->ops_.back().source_loc_);
+
+		if (emitted_shifts >= original_shifts)
+			return 0; //nothing to gain
+
+		block->ops_ = std::move(folded);
+		return original_shifts - emitted_shifts;
+	}
+
+	void fold_constants_for_cell_width(std::vector<instruction>::iterator const first, std::vector<instruction>::iterator const last, execution::cell_width const width) {
+		for (auto inst = first; inst != last; ++inst)
+			switch (inst->op_code_) {
+			case op_code::inc:
+			case op_code::inc_offset:
+			case op_code::mul_add:
+				inst->argument_ = execution::wrap_signed(inst->argument_, width);
+				break;
+			case op_code::load_const:
+			case op_code::load_const_offset:
+			case op_code::fill_range:
+				inst->argument_ = execution::wrap_unsigned(inst->argument_, width);
+				break;
+			default:
+				break;
+			}
+	}
+
 #if 0
 	template<arithmetic_tag TAG>
 	std::ptrdiff_t arithmetic_simplifier<TAG>::optimize(basic_block* const block) {
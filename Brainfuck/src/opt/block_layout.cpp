@@ -0,0 +1,98 @@
+#include "opt/block_layout.h"
+
+#include <algorithm>
+#include <numeric>
+#include <map>
+#include <cassert>
+
+namespace bf::opt {
+
+	namespace {
+
+		/*Estimates the number of executions of the block. All its instructions are executed equally often, but the optimizer may have
+		merged instructions of differently hot parts of the source, hence the highest count found in the profile is used.*/
+		[[nodiscard]]
+		std::ptrdiff_t block_executions(basic_block const* const block, profiler::execution_profile const& profile) {
+			std::ptrdiff_t res = 0;
+			for (instruction const& inst : block->ops_)
+				res = std::max(res, profile.executions(inst.source_loc_));
+			return res;
+		}
+
+		//Estimates the number of times the control passes from the block to its natural successor
+		[[nodiscard]]
+		std::ptrdiff_t fallthrough_executions(basic_block const* const block, std::ptrdiff_t const executions, profiler::execution_profile const& profile) {
+			if (block->is_cjump())
+				return std::max<std::ptrdiff_t>(executions - profile.taken(block->ops_.back().source_loc_), 0);
+			return executions;
+		}
+
+	} //namespace bf::opt::`anonymous`
+
+	std::vector<basic_block*> profile_guided_layout(std::vector<basic_block*> const& layout, profiler::execution_profile const& profile) {
+		if (layout.empty() || profile.executions_.empty())
+			return layout;
+
+		std::map<basic_block const*, std::size_t> positions; //original position of each block
+		for (std::size_t i = 0; i < layout.size(); ++i)
+			positions.emplace(layout[i], i);
+
+		std::vector<std::ptrdiff_t> executions(layout.size());
+		std::transform(layout.begin(), layout.end(), executions.begin(), [&profile](basic_block const* const block) { return block_executions(block, profile); });
+
+		struct edge {
+			std::size_t from_, to_;
+			std::ptrdiff_t weight_;
+		};
+		std::vector<edge> edges;
+		for (std::size_t i = 0; i < layout.size(); ++i)
+			if (basic_block const* const successor = layout[i]->natural_successor_; successor)
+				edges.push_back(edge{ i, positions.at(successor), fallthrough_executions(layout[i], executions[i], profile) });
+		//ties are broken by the original order, which already makes most natural successors fall through
+		std::stable_sort(edges.begin(), edges.end(), [](edge const& a, edge const& b) { return a.weight_ > b.weight_; });
+
+		/*Chains are kept as linked lists of positions. Blocks of one chain form a set of a union-find structure,
+		whose representative stores the first and last block of the chain.*/
+		std::size_t constexpr none = static_cast<std::size_t>(-1);
+		std::vector<std::size_t> next(layout.size(), none), parent(layout.size()), first(layout.size()), last(layout.size());
+		std::iota(parent.begin(), parent.end(), std::size_t{ 0 });
+		std::iota(first.begin(), first.end(), std::size_t{ 0 });
+		std::iota(last.begin(), last.end(), std::size_t{ 0 });
+		auto const chain_of = [&parent](std::size_t block) {
+			while (parent[block] != block)
+				block = parent[block] = parent[parent[block]];
+			return block;
+		};
+
+		for (edge const& edge : edges) {
+			std::size_t const from_chain = chain_of(edge.from_), to_chain = chain_of(edge.to_);
+			//the edge can fall through only if it joins the end of one chain to the beginning of another; the entry must begin the code
+			if (from_chain == to_chain || last[from_chain] != edge.from_ || first[to_chain] != edge.to_ || edge.to_ == 0)
+				continue;
+			next[edge.from_] = edge.to_;
+			parent[to_chain] = from_chain;
+			last[from_chain] = last[to_chain];
+		}
+
+		//chains are ordered by their hottest blocks, the entry goes first
+		std::vector<std::size_t> chains;
+		std::vector<std::ptrdiff_t> heat(layout.size(), 0);
+		for (std::size_t i = 0; i < layout.size(); ++i) {
+			std::size_t const chain = chain_of(i);
+			if (chain == i)
+				chains.push_back(i);
+			heat[chain] = std::max(heat[chain], executions[i]);
+		}
+		assert(chains.front() == chain_of(0) && first[chains.front()] == 0);
+		std::stable_sort(chains.begin() + 1, chains.end(), [&heat](std::size_t const a, std::size_t const b) { return heat[a] > heat[b]; });
+
+		std::vector<basic_block*> res;
+		res.reserve(layout.size());
+		for (std::size_t const chain : chains)
+			for (std::size_t block = first[chain]; block != none; block = next[block])
+				res.push_back(layout[block]);
+		assert(res.size() == layout.size());
+		return res;
+	}
+
+}
@@ -1,5 +1,6 @@
 #include "opt/branches.h"
 #include "anal/analysis.h"
+#include "IR/inst_types.h"
 
 namespace bf::opt {
 
@@ -17,7 +18,8 @@ namespace bf::opt {
 
 		for (basic_block* const predecessor : block->predecessors_) {
 			assert(predecessor->has_successor(block));
-			new_target->add_predecessor(predecessor);
+			if (!new_target->has_predecessor(predecessor)) //the predecessor may already reach the target through its other edge
+				new_target->add_predecessor(predecessor);
 
 			//If the predecessor already has a jump instruction, modify only its target
 			if (predecessor->is_jump()) {
@@ -30,7 +32,7 @@ namespace bf::opt {
 				assert(predecessor->jump_successor_ == nullptr);
 				predecessor->natural_successor_ = nullptr;
 				predecessor->jump_successor_ = new_target;
-				predecessor->ops_.push_back({ op_code::jump, std::ptrdiff_t{0xdead'beef}, block->ops_.front().source_loc_ });
+				predecessor->ops_.push_back(IR::branch_instruction::make(op_code::branch, block->ops_.front().source_loc_, 0xdead'beef));
 			}
 		}
 		block->orphan();
@@ -46,12 +48,18 @@ namespace bf::opt {
 
 		for (basic_block* (basic_block::* successor) : basic_block::successor_ptrs) {
 			basic_block*& branch = block->*successor;
-			branch->remove_predecessor(block);
+			basic_block* const original = branch;
 			while (branch->is_pure_cjump() && branch != branch->*successor) {
 				++opt_count;
 				branch = branch->*successor;
 			}
-			branch->add_predecessor(block);
+			if (branch == original)
+				continue;
+			//both edges of the block may lead to the same blocks
+			if (!block->has_successor(original))
+				original->remove_predecessor(block);
+			if (!branch->has_predecessor(block))
+				branch->add_predecessor(block);
 		}
 
 		return opt_count;
@@ -70,7 +78,7 @@ namespace bf::opt {
 
 		basic_block* basic_block::* const connection = predecessor->choose_successor_ptr(block);
 
-		if (pred_eval.has_const_result() && pred_eval.const_result() == 0)
+		if (pred_eval.has_zero_result())
 			predecessor->*connection = block->natural_successor_;
 		else if (pred_eval.has_non_zero_result())
 			predecessor->*connection = block->jump_successor_;
@@ -78,7 +86,8 @@ namespace bf::opt {
 			MUST_NOT_BE_REACHED;
 
 		block->orphan();
-		(predecessor->*connection)->add_predecessor(predecessor);
+		if (!(predecessor->*connection)->has_predecessor(predecessor))
+			(predecessor->*connection)->add_predecessor(predecessor);
 		return 1;
 	}
 
@@ -8,6 +8,8 @@ namespace bf::opt {
 			return 0;
 
 		assert(block->natural_successor_ && block->jump_successor_ == nullptr);
+		if (block->natural_successor_ == block)
+			return 0; //empty infinite loop, there is no other block to bypass it to
 
 		basic_block* const new_target = block->natural_successor_;
 		for (basic_block* const pred : block->predecessors_) {
@@ -27,7 +29,7 @@ namespace bf::opt {
 			return 0;
 
 		basic_block* const my_pred = block->get_unique_predecessor();
-		if (!my_pred || my_pred->is_pure_cjump())
+		if (!my_pred || my_pred == block || my_pred->is_pure_cjump()) //an unreachable loop may be its own unique predecessor
 			return 0;
 
 		if (my_pred->is_ujump())
@@ -1,9 +1,13 @@
 #include "opt/inner_loops.h"
 #include "anal/analysis.h"
+#include "IR/inst_types.h"
 
 #include <algorithm>
 #include <numeric>
 #include <execution>
+#include <map>
+#include <limits>
+#include <cstdint>
 
 namespace bf::opt {
 
@@ -69,7 +73,7 @@ namespace bf::opt {
 				return 0;
 
 			analysis::block_evaluation const body_eval{ loop.body() };
-			if (body_eval.has_visible_sideeffects() || !body_eval.has_const_result() || body_eval.const_result() == 0)
+			if (body_eval.has_visible_sideeffects() || !body_eval.has_const_result() || !body_eval.has_non_zero_result())
 				return 0;
 			condition->ops_.front().make_infinite_on_not_zero();
 			condition->jump_successor_ = nullptr;
@@ -77,6 +81,49 @@ namespace bf::opt {
 			return 1;
 		}
 
+		//Fills of fewer cells are left as individual stores, which are cheaper to execute, especially as native code
+		constexpr std::ptrdiff_t min_fill_count = 4;
+
+		struct constant_store {
+			std::ptrdiff_t value_;
+			source_location loc_;
+		};
+
+		/*Returns instructions setting the cells to the given values. Cells with equal values, whose offsets form an arithmetic progression
+		of at least min_fill_count elements, are set by fill_range instructions emitted first, individual stores of the others follow.*/
+		std::vector<instruction> emit_stores(std::map<std::ptrdiff_t, constant_store> const& stores) {
+			std::map<std::ptrdiff_t, std::vector<std::ptrdiff_t>> offsets_by_value; //offsets are sorted, since stores are
+			for (auto const& [offset, store] : stores)
+				offsets_by_value[store.value_].push_back(offset);
+
+			std::vector<instruction> res;
+			std::map<std::ptrdiff_t, constant_store> remaining = stores;
+			for (auto const& [value, offsets] : offsets_by_value)
+				for (std::size_t first = 0; first + 1 < offsets.size();) { //progressions are found greedily
+					std::ptrdiff_t const stride = offsets[first + 1] - offsets[first];
+					std::size_t last = first + 1;
+					while (last + 1 < offsets.size() && offsets[last + 1] - offsets[last] == stride)
+						++last;
+					std::ptrdiff_t const count = static_cast<std::ptrdiff_t>(last - first + 1);
+					if (count < min_fill_count || stride > std::numeric_limits<std::int32_t>::max()) {
+						++first;
+						continue;
+					}
+
+					res.push_back(IR::fill_range_instruction::make(stores.at(offsets[first]).loc_, offsets[first], value, count, static_cast<std::int32_t>(stride)));
+					for (std::size_t i = first; i <= last; ++i)
+						remaining.erase(offsets[i]);
+					first = last + 1;
+				}
+
+			for (auto const& [offset, store] : remaining)
+				if (offset == 0)
+					res.push_back(IR::load_const_instruction::make(store.loc_, store.value_));
+				else
+					res.push_back(IR::load_const_offset_instruction::make(store.loc_, offset, store.value_));
+			return res;
+		}
+
 	}
 
 	std::ptrdiff_t infinite_loop_optimizer::do_optimize(basic_block* const block) {
@@ -104,7 +151,8 @@ namespace bf::opt {
 		if (body_eval.has_visible_sideeffects())
 			return 0;
 
-		if ((body_eval.has_const_result() && body_eval.const_result() == 0) || body_eval.value_delta()) {
+		//a delta which is a multiple of the smallest modulus may leave narrow cells unchanged, the loop would never terminate
+		if (body_eval.has_zero_result() || (!body_eval.has_const_result() && body_eval.value_delta() % execution::min_cell_modulus != 0)) {
 
 			condition->ops_.front() = instruction{ op_code::load_const, 0, loop.body()->ops_.front().source_loc_ };
 			condition->jump_successor_ = nullptr;
@@ -115,6 +163,129 @@ namespace bf::opt {
 	}
 
 
+	std::ptrdiff_t clear_search_loop_optimizer::do_optimize(basic_block* const condition) {
+		inner_loop const loop{ condition };
+		if (!loop.is_ok())
+			return 0;
+
+		analysis::pointer_movement const movement{ loop.body() };
+		if (movement.ptr_delta() == 0)
+			return 0;
+
+		//the body may do nothing but clear the loop cell, i.e. the one under the pointer at its entry, and move the pointer
+		bool clears = false;
+		for (auto const& [offset, begin, end, unknown_moves] : movement.stationary_ranges())
+			for (auto inst = begin; inst != end; ++inst)
+				if (offset == 0 && inst->is_const() && inst->argument_ == 0)
+					clears = true;
+				else if (!inst->is_nop())
+					return 0;
+		if (!clears) //the loop only moves the pointer, it is a plain search
+			return 0;
+
+		loop.cond()->ops_.front().make_clear_search(movement.ptr_delta());
+		loop.cond()->jump_successor_ = nullptr;
+		loop.body()->remove_predecessor(condition);
+		return 1;
+	}
+
+
+	std::ptrdiff_t fill_range_folder::do_optimize(basic_block* const block) {
+		if (!block)
+			return 0;
+
+		std::vector<instruction>& ops = block->ops_;
+		std::vector<instruction> folded;
+		std::ptrdiff_t eliminated_stores = 0;
+
+		for (std::size_t i = 0; i < ops.size();) {
+			//a run consists only of constant stores, fills and shifts; nothing reads the cells, hence only their final values matter
+			std::map<std::ptrdiff_t, constant_store> stores; //offset from the pointer at the beginning of the run => value
+			std::ptrdiff_t offset = 0;
+			std::ptrdiff_t original_stores = 0;
+			std::size_t run_end = i;
+
+			for (; run_end < ops.size(); ++run_end)
+				if (instruction const& inst = ops[run_end]; inst.is_shift())
+					offset += inst.argument();
+				else if (inst.is_const() || inst.op_code_ == op_code::load_const_offset) {
+					stores[offset + inst.offset_] = { inst.argument_, inst.source_loc_ };
+					++original_stores;
+				}
+				else if (inst.op_code_ == op_code::fill_range) {
+					IR::fill_range_instruction const fill{ inst };
+					for (std::ptrdiff_t cell = 0; cell < fill.count(); ++cell)
+						stores[offset + fill.offset() + cell * fill.stride()] = { fill.value(), inst.source_loc_ };
+				}
+				else if (!inst.is_nop())
+					break;
+
+			std::vector<instruction> replacement = emit_stores(stores);
+			std::ptrdiff_t const remaining_stores = std::count_if(replacement.begin(), replacement.end(),
+				[](instruction const& inst) { return inst.op_code_ != op_code::fill_range; });
+			if (remaining_stores >= original_stores) { //there is nothing to gain, copy the run (or the instruction ending it) unchanged
+				std::size_t const copied_end = std::max(run_end, i + 1);
+				folded.insert(folded.end(), ops.begin() + i, ops.begin() + copied_end);
+				i = copied_end;
+				continue;
+			}
+
+			folded.insert(folded.end(), replacement.begin(), replacement.end());
+			if (offset != 0)
+				folded.push_back(instruction{ op_code::right, offset, ops[run_end - 1].source_loc_ });
+			eliminated_stores += original_stores - remaining_stores;
+			i = run_end;
+		}
+
+		if (eliminated_stores)
+			ops = std::move(folded);
+		return eliminated_stores;
+	}
+
+
+	std::ptrdiff_t multiplication_loop_optimizer::do_optimize(basic_block* const condition) {
+		inner_loop const loop{ condition };
+		if (!loop.is_ok())
+			return 0;
+
+		analysis::pointer_movement const movement{ loop.body() };
+		if (movement.ptr_delta() != 0 || !movement.ptr_moves())
+			return 0; //unbalanced loops cannot be optimized and stationary ones are handled by clear_loop_optimizer
+
+		//sum up the change of every cell touched by one iteration of the loop
+		std::map<std::ptrdiff_t, std::ptrdiff_t> deltas;
+		for (auto const& [offset, begin, end, unknown_moves] : movement.stationary_ranges())
+			for (auto inst = begin; inst != end; ++inst)
+				if (inst->is_arithmetic())
+					deltas[offset] += inst->argument_;
+				else if (inst->op_code_ == op_code::inc_offset)
+					deltas[offset + inst->offset_] += inst->argument_;
+				else if (!inst->is_nop())
+					return 0; //IO, constants or nested control flow; this is not a pure multiplication loop
+
+		/*The loop cell has to change by exactly one per iteration. For a decrement the loop runs [cpr] times,
+		for an increment it runs -[cpr] times (modulo the cell width), which is handled by negating all factors.*/
+		auto const loop_cell = deltas.find(0);
+		if (loop_cell == deltas.end() || (loop_cell->second != -1 && loop_cell->second != 1))
+			return 0;
+		std::ptrdiff_t const direction = -loop_cell->second;
+		deltas.erase(loop_cell);
+
+		source_location const& loc = loop.body()->ops_.front().source_loc_;
+		std::vector<instruction> replacement;
+		replacement.reserve(deltas.size() + 1);
+		for (auto const [offset, delta] : deltas)
+			if (delta != 0)
+				replacement.push_back(IR::mul_add_instruction::make(loc, offset, delta * direction));
+		replacement.push_back(instruction{ op_code::load_const, 0, loc });
+
+		condition->ops_ = std::move(replacement);
+		condition->jump_successor_ = nullptr;
+		loop.body()->remove_predecessor(condition);
+		return 1;
+	}
+
+
 	std::ptrdiff_t search_loop_optimizer::do_optimize(basic_block* const condition) {
 		inner_loop const loop{ condition };
 		if (!loop.is_ok())
@@ -1,8 +1,15 @@
 #include "opt/optimizer_pass.h"
+#include "opt/arithmetic.h"
+#include "opt/branches.h"
+#include "opt/cleanup.h"
+#include "opt/inner_loops.h"
+#include "opt/output.h"
+#include "opt/prefix_evaluation.h"
 #include "cli.h"
 #include "utils.h"
 #include "compiler.h"
 #include "emulator.h"
+#include "stats.h"
 #include <execution>
 #include <numeric>
 #include <iostream>
@@ -13,6 +20,12 @@
 #include <memory>
 #include <fstream>
 #include <iomanip>
+#include <deque>
+#include <atomic>
+#include <chrono>
+#include <map>
+#include <functional>
+#include <unordered_map>
 namespace bf::opt {
 
 	void generate_dot_file(std::vector<basic_block*> const& blocks, std::string file_name) {
@@ -57,7 +70,16 @@ namespace bf::opt {
 	std::optional<opt_level_t> get_opt_by_name(std::string_view const optimization_name) {
 		using namespace std::string_view_literals;
 		static std::unordered_map<std::string_view, opt_level_t> const optimization_levels{
-
+			{"op_folding"sv,        opt_level_t::op_folding},
+			{"const_propagation"sv, opt_level_t::const_propagation},
+			{"loops"sv,             opt_level_t::loops},
+			{"jump_threading"sv,    opt_level_t::jump_threading},
+			{"cleanup"sv,           opt_level_t::cleanup},
+			{"pointer_folding"sv,   opt_level_t::pointer_folding},
+			{"write_folding"sv,     opt_level_t::write_folding},
+			{"-O1"sv,               opt_level_t::O1},
+			{"-O2"sv,               opt_level_t::O2},
+			{"all"sv,               opt_level_t::all}
 		};
 
 		if (optimization_levels.count(optimization_name) == 0) {
@@ -75,6 +97,231 @@ namespace bf::opt {
 
 	namespace {
 
+		/*Schedules optimizer passes. Peephole passes are run on a worklist of blocks which initially contains the whole program but settled blocks.
+		Whenever some pass changes a block, the block and all its neighbours (from before and after the change) are queued again,
+		since the change may have enabled further optimizations of blocks connected to it. Everything else stays optimized.
+		Passes creating offset-addressed instructions and strings obscure the patterns recognized by other passes,
+		therefore they run in a second phase after the first one has reached its fixpoint.
+
+		The worklist is processed in rounds. Block-local passes of a round run on all queued blocks in parallel first, since they touch
+		nothing but the instructions of their own block. Passes editing the control flow graph then run serially on the same blocks.*/
+		class pass_manager {
+
+			struct scheduled_pass {
+				char const* const name_;
+				std::unique_ptr<peephole_optimizer_pass> const pass_;
+				std::atomic<std::ptrdiff_t> change_count_{ 0 };
+				std::atomic<std::chrono::nanoseconds::rep> time_{ 0 }; //summed over all threads running the pass
+
+				scheduled_pass(char const* const name, std::unique_ptr<peephole_optimizer_pass> pass)
+					: name_{ name }, pass_{ std::move(pass) } {}
+			};
+
+			//passes are not movable due to the atomic counter
+			using phase_t = std::deque<scheduled_pass>;
+
+			//pass traversing the whole program, run once the peephole passes have reached their fixpoint
+			struct scheduled_global_pass {
+				char const* const name_;
+				std::unique_ptr<global_optimizer_pass> const pass_; //nullptr unless the pass is enabled
+				std::ptrdiff_t change_count_ = 0;
+				std::chrono::nanoseconds time_{ 0 };
+
+				std::ptrdiff_t run(std::vector<basic_block*>& program) {
+					if (!pass_)
+						return 0;
+					auto const start = std::chrono::steady_clock::now();
+					std::ptrdiff_t const changes = pass_->optimize(program);
+					time_ += std::chrono::steady_clock::now() - start;
+					change_count_ += changes;
+					return changes;
+				}
+			};
+
+			phase_t early_passes_, late_passes_;
+			scheduled_global_pass dead_code_elimination_; //enabled by cleanup
+			scheduled_global_pass global_const_propagation_; //enabled by const_propagation with cleanup, only run in the early phase
+			std::ptrdiff_t block_visits_ = 0;
+			std::set<basic_block const*> settled_; //blocks optimized before the run and not reached by any change since
+
+			template<typename PASS>
+			static void schedule(phase_t& phase, opt_level_t const mask, opt_level_t const level, char const* const name) {
+				if (includes(mask, level))
+					phase.emplace_back(name, std::make_unique<PASS>());
+			}
+
+			//Returns all blocks connected to the given one
+			[[nodiscard]]
+			static std::vector<basic_block*> neighbours(basic_block* const block) {
+				std::vector<basic_block*> res(block->predecessors_.begin(), block->predecessors_.end());
+				for (auto const successor : basic_block::successor_ptrs)
+					if (block->*successor)
+						res.push_back(block->*successor);
+				return res;
+			}
+
+			//Runs the pass on the given block recording the number of changes and the time it took
+			static std::ptrdiff_t run_pass(scheduled_pass& pass, basic_block* const block) {
+				auto const start = std::chrono::steady_clock::now();
+				std::ptrdiff_t const changes = pass.pass_->optimize(block);
+				pass.time_ += std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count();
+				pass.change_count_ += changes;
+				return changes;
+			}
+
+			//Runs the block-local passes of the given phase on the given block. Called concurrently for distinct blocks
+			static std::ptrdiff_t run_local_passes(basic_block* const block, phase_t& phase) {
+				std::ptrdiff_t block_changes = 0;
+				for (scheduled_pass& pass : phase)
+					if (pass.pass_->is_block_local())
+						block_changes += run_pass(pass, block);
+				return block_changes;
+			}
+
+			//Runs the passes of the given phase that edit the control flow graph on the given block. Stops as soon as the block gets orphaned
+			static std::ptrdiff_t run_cfg_passes(basic_block* const block, phase_t& phase) {
+				std::ptrdiff_t block_changes = 0;
+				for (scheduled_pass& pass : phase)
+					if (!pass.pass_->is_block_local()) {
+						block_changes += run_pass(pass, block);
+						if (block->is_orphaned())
+							break;
+					}
+				return block_changes;
+			}
+
+			//Runs the passes of the given phase until no block can be optimized any further. Returns the number of changes
+			std::ptrdiff_t run_to_fixpoint(std::vector<basic_block*> const& program, phase_t& phase) {
+				std::vector<basic_block*> round;
+				std::vector<basic_block*> worklist;
+				std::copy_if(program.begin(), program.end(), std::back_inserter(worklist), [this](basic_block* const block) { return settled_.count(block) == 0; });
+				std::set<basic_block*> queued(worklist.begin(), worklist.end());
+				auto const enqueue = [&](basic_block* const block) {
+					if (queued.insert(block).second)
+						worklist.push_back(block);
+				};
+
+				std::ptrdiff_t change_count = 0;
+				while (!worklist.empty()) {
+					round.clear();
+					std::copy_if(worklist.begin(), worklist.end(), std::back_inserter(round), //skip blocks merged into others or eliminated
+						[](basic_block* const block) { return !block->is_orphaned(); });
+					worklist.clear();
+					queued.clear();
+					block_visits_ += static_cast<std::ptrdiff_t>(round.size());
+
+					//parallel phase; blocks are distinct, therefore the passes never touch the same instructions
+					std::vector<std::ptrdiff_t> round_changes(round.size());
+					std::transform(std::execution::par, round.begin(), round.end(), round_changes.begin(),
+						[&phase](basic_block* const block) { return run_local_passes(block, phase); });
+
+					//serial phase committing edits of the control flow graph
+					for (std::size_t i = 0; i < round.size(); ++i) {
+						basic_block* const block = round[i];
+						if (block->is_orphaned()) //merged into its predecessor earlier within this round
+							continue;
+						std::vector<basic_block*> affected = neighbours(block);
+						std::ptrdiff_t const block_changes = round_changes[i] + run_cfg_passes(block, phase);
+						if (block_changes == 0)
+							continue;
+
+						change_count += block_changes;
+						if (!block->is_orphaned()) {
+							enqueue(block);
+							std::vector<basic_block*> const current = neighbours(block);
+							affected.insert(affected.end(), current.begin(), current.end());
+						}
+						std::for_each(affected.begin(), affected.end(), enqueue);
+						settled_.erase(block);
+						for (basic_block* const neighbour : affected)
+							settled_.erase(neighbour);
+					}
+				}
+				return change_count;
+			}
+
+			/*Runs the peephole passes of the phase to their fixpoint followed by the global passes, until neither changes anything.
+			Unreachable blocks are not reported as neighbours of live ones, hence they have to be found by a traversal of the whole program.
+			Constants propagated across blocks may make further blocks unreachable and enable peephole passes again, dead code is
+			therefore eliminated right after the propagation. Peephole passes may still see unreachable blocks, since jump threading
+			creates them while the worklist runs (an unreachable loop may even be its own unique predecessor). The global passes do not tell which blocks they have changed, no block is settled once they change any.*/
+			std::ptrdiff_t run_phase(std::vector<basic_block*>& program, phase_t& phase, bool const propagate_globally) {
+				std::ptrdiff_t change_count = 0;
+				for (;;) {
+					change_count += run_to_fixpoint(program, phase);
+					std::ptrdiff_t const propagated = propagate_globally ? global_const_propagation_.run(program) : 0;
+					std::ptrdiff_t const eliminated = dead_code_elimination_.run(program);
+					change_count += propagated;
+					if (eliminated == 0 && propagated == 0)
+						return change_count;
+					settled_.clear();
+				}
+			}
+
+			template<typename PASS, typename... ARGS>
+			[[nodiscard]]
+			static std::unique_ptr<global_optimizer_pass> make_global(opt_level_t const mask, opt_level_t const level, ARGS const&... args) {
+				return includes(mask, level) ? std::make_unique<PASS>(args...) : nullptr;
+			}
+
+		public:
+			pass_manager(opt_level_t const mask, std::ptrdiff_t const memory_size)
+				: dead_code_elimination_{ "dead blocks", make_global<dead_code_elimination>(mask, opt_level_t::cleanup) },
+				global_const_propagation_{ "global const propagation", make_global<global_const_propagator>(mask, opt_level_t::const_propagation | opt_level_t::cleanup,
+					memory_size) } {
+				schedule<nop_elimination>(early_passes_, mask, opt_level_t::cleanup, "nop elimination");
+				schedule<arithmetic_simplifier<arithmetic_tag::both>>(early_passes_, mask, opt_level_t::op_folding, "operation folding");
+				schedule<local_const_propagator>(early_passes_, mask, opt_level_t::const_propagation, "const propagation");
+				schedule<clear_loop_optimizer>(early_passes_, mask, opt_level_t::loops, "clear loops");
+				schedule<multiplication_loop_optimizer>(early_passes_, mask, opt_level_t::loops, "multiplication loops");
+				schedule<clear_search_loop_optimizer>(early_passes_, mask, opt_level_t::loops, "clear search loops");
+				schedule<search_loop_optimizer>(early_passes_, mask, opt_level_t::loops, "search loops");
+				schedule<infinite_loop_optimizer>(early_passes_, mask, opt_level_t::loops, "infinite loops");
+				schedule<pure_ujump_elimination>(early_passes_, mask, opt_level_t::jump_threading, "jump elimination");
+				schedule<cjump_destination_optimization>(early_passes_, mask, opt_level_t::jump_threading, "conditional jump threading");
+				schedule<single_entry_cjump_optimization>(early_passes_, mask, opt_level_t::jump_threading, "known conditions");
+				schedule<empty_block_elimination>(early_passes_, mask, opt_level_t::cleanup, "empty block elimination");
+				schedule<block_merging>(early_passes_, mask, opt_level_t::cleanup, "block merging");
+
+				schedule<pointer_folder>(late_passes_, mask, opt_level_t::pointer_folding, "pointer folding");
+				schedule<write_string_folder>(late_passes_, mask, opt_level_t::write_folding, "write folding");
+				schedule<fill_range_folder>(late_passes_, mask, opt_level_t::loops, "range fills");
+				if (!late_passes_.empty()) { //folded blocks may become mergeable
+					schedule<nop_elimination>(late_passes_, mask, opt_level_t::cleanup, "nop elimination");
+					schedule<empty_block_elimination>(late_passes_, mask, opt_level_t::cleanup, "empty block elimination");
+					schedule<block_merging>(late_passes_, mask, opt_level_t::cleanup, "block merging");
+				}
+			}
+
+			//Optimizes the given program. Orphaned blocks are removed from the vector, but they are not deallocated.
+			std::ptrdiff_t run(std::vector<basic_block*>& program, std::set<basic_block const*> settled) {
+				settled_ = std::move(settled);
+				return run_phase(program, early_passes_, true) + run_phase(program, late_passes_, false);
+			}
+
+			[[nodiscard]]
+			optimization_statistics statistics() const {
+				optimization_statistics res; //the cleanup passes are scheduled in both phases
+				for (phase_t const* phase : { &early_passes_, &late_passes_ })
+					for (scheduled_pass const& pass : *phase) {
+						pass_statistics& statistics = res[pass.name_];
+						statistics.changes_ += pass.change_count_;
+						statistics.time_ += std::chrono::nanoseconds{ pass.time_ };
+					}
+				for (scheduled_global_pass const* pass : { &dead_code_elimination_, &global_const_propagation_ })
+					if (pass->pass_)
+						res[pass->name_] = pass_statistics{ pass->change_count_, pass->time_ };
+				return res;
+			}
+
+			void print_statistics() const {
+				for (auto const& [name, statistics] : this->statistics())
+					if (statistics.changes_)
+						std::cout << '\t' << std::left << std::setw(28) << name << statistics.changes_ << '\n';
+				std::cout << "Visited " << block_visits_ << " block" << utils::print_plural(block_visits_) << ".\n";
+			}
+		};
+
 
 		/*Function callback for the "optimize" cli command. Parses its arguments as optimization flags
 		and then performs specified optimizations on the result of previous compilation.*/
@@ -97,37 +344,83 @@ namespace bf::opt {
 					return 4;
 				}
 
-			if (!requested_optimizations.empty())
-				perform_optimizations(previous_compilation::basic_blocks_mutable(), requested_optimizations);
-			else
+			if (requested_optimizations.empty()) {
 				std::cout << "No optimizations were performed.\n";
+				return 0;
+			}
+
+			std::uint32_t mask = 0; //identifies the requested optimizations in the cache of compiled programs
+			for (opt_level_t const optimization : requested_optimizations)
+				mask |= static_cast<std::uint32_t>(optimization);
+			//values of cells are propagated in memory of the current size; only the optimization of the whole program reports its statistics
+			std::ptrdiff_t const memory_size = execution::emulator.memory_size();
+			bool const performed = previous_compilation::transform_incrementally("optimize:" + std::to_string(mask) + ";memory:" + std::to_string(memory_size),
+				[requested_optimizations, memory_size](auto& program, bool const whole_program, auto const& settled) {
+					perform_optimizations(program, requested_optimizations, memory_size, !whole_program, settled);
+				});
+			if (!performed)
+				std::cout << "Optimizations are deferred until the program is needed, it may be found in the cache.\n";
 
 			return 0;
 		}
 
+		/*Function callback for the "prefix_eval" cli command. Expects an optional argument "on", "off" or the number of instructions
+		that may be executed at compile time. Prints the current setting if there is no argument.*/
+		int prefix_eval_callback(cli::command_parameters_t const& argv) {
+			if (int const code = utils::check_command_argc(1, 2, argv))
+				return code;
+
+			if (argv.size() == 2) {
+				if (argv[1] == "on")
+					prefix_evaluation_budget() = default_prefix_evaluation_budget;
+				else if (argv[1] == "off")
+					prefix_evaluation_budget() = 0;
+				else if (std::optional<int> const budget = utils::parse_positive_argument(argv[1]); budget.has_value())
+					prefix_evaluation_budget() = *budget;
+				else {
+					cli::print_command_error(cli::command_error::argument_not_recognized);
+					return 4;
+				}
+			}
+
+			if (std::ptrdiff_t const budget = prefix_evaluation_budget(); budget > 0)
+				std::cout << "Programs are evaluated at compile time until their first read, at most " << budget
+				<< " instruction" << utils::print_plural(budget) << ". Takes effect when the program is flashed.\n";
+			else
+				std::cout << "Evaluation of programs at compile time is disabled.\n";
+			return 0;
+		}
+
 	} //namespace bf::opt::`anonymous`
 
-	void perform_optimizations(std::vector<std::unique_ptr<basic_block>>& program, std::set<opt_level_t> const& requested_optimizations) {
+	optimization_statistics perform_optimizations(std::vector<std::unique_ptr<basic_block>>& program, std::set<opt_level_t> const& requested_optimizations,
+		std::ptrdiff_t const memory_size, bool const quiet, std::set<basic_block const*> const& settled) {
 
 		if (requested_optimizations.empty())
-			return;
+			return {};
 
-		std::cout << "Optimizing engine initialized.\n";
+		if (!quiet)
+			std::cout << "Optimizing engine initialized.\n";
 
 		//First construct a new vector of raw pointers to prevent mixing them with std::unique_ptr. We do not take over any ownership.
 		std::vector<basic_block*> block_ptrs;
 		block_ptrs.reserve(program.size());
 		std::transform(program.begin(), program.end(), std::back_inserter(block_ptrs), std::mem_fn(&std::unique_ptr<basic_block>::get));
 
-		//if (requested_optimizations.count(opt_level_t::op_folding)) { // Folding of operations was requested
-//		std::cout << "Operation folding initiated.\n";
-//		int const fold_count = peephole::combine_adjacent_operations(optimized_blocks);
-//		std::cout << "Folding finished, " << fold_count << " fold" << utils::print_plural(fold_count) << " performed.\n";
-		//}
+		opt_level_t const mask = std::accumulate(requested_optimizations.begin(), requested_optimizations.end(), opt_level_t::none, std::bit_or{});
+		pass_manager manager{ mask, memory_size };
+		std::ptrdiff_t const change_count = manager.run(block_ptrs, settled);
 
-		//TODO opportunity to add other optimizations;
+		//orphaned blocks have been kept alive until now, since the worklist may still refer to them
+		program.erase(std::remove_if(program.begin(), program.end(), std::mem_fn(&basic_block::is_orphaned)), program.end());
 
-		std::cout << "Optimizations ended.\n";
+		if (!quiet) {
+			manager.print_statistics();
+			std::cout << "Optimizations ended, " << change_count << " change" << utils::print_plural(change_count) << " performed.\n";
+		}
+		optimization_statistics statistics = manager.statistics();
+		stats::record_passes(statistics);
+		return statistics;
 	}
 
 	//TODO add verbose mode to namespace ::bf::cli
@@ -140,14 +433,34 @@ namespace bf::opt {
 			"Performs specified optimizations on the saved program. Accepts unlimited number of arguments which specify all the\n"
 			"optimizations that are to be performed, the order of which is irrelevant, as the optimizer chooses the optimal order of\n"
 			"operations on its own. Resulting program is saved internally and ready to be flashed into the emulator's instruction memory\n"
-			"using the \"flash\" command.\n\n"
+			"using the \"flash\" command. Values of cells are propagated assuming memory of the current size, which wraps around;\n"
+			"the program shall be optimized again if the memory is made smaller.\n\n"
 
 			"Currently supported optimization flags:\n"
 			"\top_folding         Folds multiple occurences of the same instruction in a row.\n"
 			"\tconst_propagation  Precalculates values of cells if they are known at compile time, independent on the IO.\n"
-			//TODO fix the help string
+			"\t                   Known values are propagated across blocks, loops never entered are removed.\n"
+			"\tloops              Replaces clear, search, multiplication and infinite loops by specialized instructions.\n"
+			"\t                   Runs of cells set to the same constant are filled by a single instruction.\n"
+			"\tjump_threading     Skips jumps to other jumps and conditions whose outcome is known.\n"
+			"\tcleanup            Removes nops, empty and unreachable blocks and merges blocks executed one after another.\n"
+			"\tpointer_folding    Replaces shifts of the cell pointer within blocks by offset-addressed instructions.\n"
+			"\twrite_folding      Folds writes of known constants into strings.\n"
+			"Optimization levels:\n"
+			"\t-O1                op_folding, loops and cleanup.\n"
+			"\t-O2                All of the above.\n"
+			"\tall                Every optimization the optimizer knows.\n"
 
 			, &optimize_callback);
+
+		cli::add_command("prefix_eval", cli::command_category::optimization, "Controls evaluation of programs at compile time.",
+			"Usage: \"prefix_eval\" [on | off | max_instructions]\n"
+			"Since memory starts zeroed, programs behave deterministically until they read input for the first time. If enabled, this part of\n"
+			"the program is executed when it is flashed or emitted and it is replaced by code storing the resulting memory and printing\n"
+			"the output produced so far. The evaluation stops at the first read or after executing the given number of instructions\n"
+			"(" + std::to_string(default_prefix_evaluation_budget) + " if \"on\" is given). Breakpoints within the evaluated part can never be hit.\n"
+			"Without arguments prints the current setting. Disabled by default."
+			, &prefix_eval_callback);
 	}
 
 } //namespace bf::opt
@@ -0,0 +1,81 @@
+#include "opt/output.h"
+#include "IR/inst_types.h"
+
+#include <map>
+#include <optional>
+#include <string>
+
+namespace bf::opt {
+
+	namespace {
+
+		//Returns the offset of the cell the instruction stores a constant to or writes, nullopt for any other instruction
+		[[nodiscard]]
+		std::optional<std::ptrdiff_t> constant_io_offset(instruction const& inst) {
+			switch (inst.op_code_) {
+			case op_code::load_const:
+			case op_code::write:
+				return 0;
+			case op_code::load_const_offset:
+			case op_code::write_offset:
+				return inst.offset_;
+			default:
+				return std::nullopt;
+			}
+		}
+
+	} //namespace bf::opt::`anonymous`
+
+	std::ptrdiff_t write_string_folder::do_optimize(basic_block* const block) {
+		if (!block)
+			return 0;
+
+		std::vector<instruction>& ops = block->ops_;
+		std::vector<instruction> folded;
+		std::ptrdiff_t eliminated_writes = 0;
+
+		for (std::size_t i = 0; i < ops.size();) {
+			//a run consists only of constant stores and writes of cells that have been assigned a constant within the run
+			std::map<std::ptrdiff_t, std::ptrdiff_t> known_cells;
+			std::string written;
+			source_location const* first_write = nullptr;
+			std::size_t run_end = i;
+
+			for (; run_end < ops.size(); ++run_end) {
+				instruction const& inst = ops[run_end];
+				std::optional<std::ptrdiff_t> const offset = constant_io_offset(inst);
+				if (!offset)
+					break;
+				if (inst.op_code_ == op_code::load_const || inst.op_code_ == op_code::load_const_offset)
+					known_cells[*offset] = inst.argument_;
+				else if (auto const known = known_cells.find(*offset); known != known_cells.end()) {
+					written.push_back(static_cast<char>(known->second));
+					if (!first_write)
+						first_write = &inst.source_loc_;
+				}
+				else
+					break; //the value of written cell is not known
+			}
+
+			if (written.size() < 2) { //there is nothing to gain, copy the instruction and try again at the next one
+				folded.push_back(ops[i++]);
+				continue;
+			}
+
+			folded.push_back(IR::write_string_instruction::make(*first_write, intern_constant(written), static_cast<std::ptrdiff_t>(written.size())));
+			for (auto const [offset, value] : known_cells) //the run's stores may be observed later, hence they are kept
+				if (offset == 0)
+					folded.push_back(instruction{ op_code::load_const, value, ops[run_end - 1].source_loc_ });
+				else
+					folded.push_back(IR::load_const_offset_instruction::make(ops[run_end - 1].source_loc_, offset, value));
+
+			eliminated_writes += static_cast<std::ptrdiff_t>(written.size()) - 1;
+			i = run_end;
+		}
+
+		if (eliminated_writes)
+			ops = std::move(folded);
+		return eliminated_writes;
+	}
+
+}
@@ -0,0 +1,188 @@
+#include "opt/prefix_evaluation.h"
+#include "IR/inst_types.h"
+#include "memory_kernels.h"
+
+#include <string>
+#include <cassert>
+
+namespace bf::opt {
+
+	namespace {
+
+		/*State of the program being executed at compile time. Memory cells of the given unsigned type wrap around the same way they do in the emulator.*/
+		template<typename CELL>
+		class evaluator {
+
+			std::vector<instruction> const& code_;
+			std::ptrdiff_t const memory_size_;
+			std::vector<CELL> memory_;
+
+		public:
+			std::ptrdiff_t cell_pointer_ = 0;
+			std::ptrdiff_t program_counter_ = 0;
+			std::string output_;
+
+		private:
+			[[nodiscard]]
+			std::ptrdiff_t shifted(std::ptrdiff_t const pointer, std::ptrdiff_t const count) const {
+				std::ptrdiff_t const result = pointer + count % memory_size_;
+				return result >= memory_size_ ? result - memory_size_ : result < 0 ? result + memory_size_ : result;
+			}
+
+			[[nodiscard]]
+			CELL& cell(std::ptrdiff_t const offset = 0) { return memory_[shifted(cell_pointer_, offset)]; }
+
+			/*Executes the instruction at PC. Returns false without changing the state if the instruction cannot be evaluated
+			at compile time - it reads input, stops the program or would never terminate.*/
+			bool step() {
+				instruction const& inst = code_[program_counter_];
+				switch (inst.op_code_) {
+				case op_code::nop:
+				case op_code::program_entry:
+					break;
+				case op_code::inc:
+					cell() += static_cast<CELL>(inst.argument_);
+					break;
+				case op_code::dec:
+					cell() -= static_cast<CELL>(inst.argument_);
+					break;
+				case op_code::right:
+				case op_code::right_unchecked:
+					cell_pointer_ = shifted(cell_pointer_, inst.argument_);
+					break;
+				case op_code::left:
+					cell_pointer_ = shifted(cell_pointer_, -inst.argument_);
+					break;
+				case op_code::branch:
+					program_counter_ = inst.destination_;
+					return true;
+				case op_code::branch_nz:
+					if (cell()) {
+						program_counter_ = inst.destination_;
+						return true;
+					}
+					break;
+				case op_code::write:
+					output_.push_back(static_cast<char>(cell()));
+					break;
+				case op_code::write_offset:
+					output_.push_back(static_cast<char>(cell(inst.offset_)));
+					break;
+				case op_code::write_string:
+					output_.append(constant_string(inst.offset_, inst.argument_));
+					break;
+				case op_code::load_const:
+					cell() = static_cast<CELL>(inst.argument_);
+					break;
+				case op_code::load_const_offset:
+					cell(inst.offset_) = static_cast<CELL>(inst.argument_);
+					break;
+				case op_code::inc_offset:
+					cell(inst.offset_) += static_cast<CELL>(inst.argument_);
+					break;
+				case op_code::mul_add:
+					//computed in unsigned arithmetic, narrow cells would be promoted to int, whose overflow is undefined
+					cell(inst.offset_) += static_cast<CELL>(static_cast<std::size_t>(cell()) * static_cast<std::size_t>(inst.argument_));
+					break;
+				case op_code::search_right:
+				case op_code::search_left:
+				{
+					std::ptrdiff_t const stride = inst.op_code_ == op_code::search_left ? -inst.argument_ : inst.argument_;
+					std::optional<std::ptrdiff_t> const found = execution::kernels::find_zero(memory_.data(), memory_size_, cell_pointer_, stride);
+					if (!found)
+						return false; //the emulator reports endless searches
+					cell_pointer_ = *found;
+					break;
+				}
+				case op_code::clear_search_right:
+				case op_code::clear_search_left:
+					cell_pointer_ = execution::kernels::clear_to_zero(memory_.data(), memory_size_, cell_pointer_,
+						inst.op_code_ == op_code::clear_search_left ? -inst.argument_ : inst.argument_);
+					break;
+				case op_code::fill_range:
+					execution::kernels::fill(memory_.data(), memory_size_, shifted(cell_pointer_, inst.offset_), inst.destination_, inst.stride_, static_cast<CELL>(inst.argument_));
+					break;
+				case op_code::infinite:
+					if (inst.argument_ ? cell() != 0 : cell() == 0)
+						return false;
+					break;
+				default: //reads, breakpoints, the exit and unknown instructions stop the evaluation
+					return false;
+				}
+				++program_counter_;
+				return true;
+			}
+
+		public:
+			evaluator(std::vector<instruction> const& code, std::ptrdiff_t const memory_size)
+				: code_{ code }, memory_size_{ memory_size }, memory_(static_cast<std::size_t>(memory_size), 0) {
+				assert(memory_size > 0);
+			}
+
+			//Executes at most step_budget instructions and stops at the first one that cannot be evaluated
+			void run(std::ptrdiff_t step_budget) {
+				for (std::ptrdiff_t const code_size = static_cast<std::ptrdiff_t>(code_.size()); step_budget > 0 && program_counter_ < code_size; --step_budget)
+					if (!step())
+						break;
+			}
+
+			[[nodiscard]]
+			std::vector<CELL> const& memory() const { return memory_; }
+		};
+
+		template<typename CELL>
+		std::vector<instruction> evaluate_prefix(std::vector<instruction> code, std::ptrdiff_t const memory_size, std::ptrdiff_t const step_budget) {
+			evaluator<CELL> eval{ code, memory_size };
+			eval.run(step_budget);
+			if (eval.program_counter_ <= 1) //only the program's entry has been executed
+				return code;
+
+			source_location const loc = code.front().source_loc_;
+			std::vector<instruction> res;
+			res.push_back(code.front());
+
+			//initial contents of memory are zeroes, therefore only the cells that differ have to be stored
+			std::vector<CELL> const& memory = eval.memory();
+			for (std::ptrdiff_t i = 0; i < memory_size; ++i)
+				if (memory[i] == 0)
+					continue;
+				else if (i == 0)
+					res.push_back(instruction{ op_code::load_const, static_cast<std::ptrdiff_t>(memory[i]), loc });
+				else
+					res.push_back(IR::load_const_offset_instruction::make(loc, i, static_cast<std::ptrdiff_t>(memory[i])));
+
+			if (!eval.output_.empty())
+				res.push_back(IR::write_string_instruction::make(loc, intern_constant(eval.output_), static_cast<std::ptrdiff_t>(eval.output_.size())));
+			if (eval.cell_pointer_ != 0)
+				res.push_back(instruction{ op_code::right, eval.cell_pointer_, loc });
+
+			std::ptrdiff_t const relocation = static_cast<std::ptrdiff_t>(res.size()) + 1; //the original code follows after the jump
+			instruction resume{ op_code::branch, 0, loc };
+			resume.destination_ = eval.program_counter_ + relocation;
+			res.push_back(resume);
+
+			for (instruction& inst : code)
+				if (inst.is_jump())
+					inst.destination_ += relocation;
+			res.insert(res.end(), code.begin(), code.end());
+			return res;
+		}
+
+	} //namespace bf::opt::`anonymous`
+
+	std::ptrdiff_t& prefix_evaluation_budget() {
+		static std::ptrdiff_t budget = 0;
+		return budget;
+	}
+
+	std::vector<instruction> evaluate_io_free_prefix(std::vector<instruction> code, std::ptrdiff_t const memory_size,
+		execution::cell_width const width, std::ptrdiff_t const step_budget) {
+		if (step_budget <= 0 || code.empty())
+			return code;
+
+		return execution::visit_cell_type(width, [&](auto const cell) {
+			return evaluate_prefix<std::remove_const_t<decltype(cell)>>(std::move(code), memory_size, step_budget);
+		});
+	}
+
+}
@@ -0,0 +1,297 @@
+#include "profiler.h"
+#include "cli.h"
+#include "utils.h"
+#include "emulator.h"
+#include "breakpoint.h"
+
+#include <iostream>
+#include <iomanip>
+#include <fstream>
+#include <sstream>
+#include <algorithm>
+#include <numeric>
+#include <cassert>
+
+namespace bf::profiler {
+
+	namespace {
+
+		//number of loops listed by "profile report" unless specified otherwise
+		constexpr int default_report_length = 10;
+
+		//first line of all profile files
+		constexpr std::string_view profile_file_header = "bf_profile 1";
+
+		/*Returns the flashed program with breakpoints replaced by the instructions they had been placed over.*/
+		[[nodiscard]]
+		std::vector<instruction> flashed_program() {
+			return execution::emulator.breakpoints().original_program();
+		}
+
+		/*Prints the hottest loops of the flashed program with their share of all executed instructions.*/
+		void print_report(int const length) {
+			std::vector<instruction> const code = flashed_program();
+			std::vector<std::ptrdiff_t> const& taken_jumps = execution::emulator.taken_jumps();
+			std::ptrdiff_t const runs = execution::emulator.profiled_runs();
+
+			std::vector<std::ptrdiff_t> const executions = instruction_executions(code, taken_jumps, runs);
+			std::ptrdiff_t const total = std::accumulate(executions.begin(), executions.end(), std::ptrdiff_t{ 0 });
+			std::cout << "Profile of " << runs << " run" << utils::print_plural(runs) << ", " << total << " executed instruction"
+				<< utils::print_plural(total) << ".\n";
+			if (total == 0)
+				return;
+
+			std::vector<loop_profile> const loops = hottest_loops(code, taken_jumps, runs);
+			if (loops.empty()) {
+				std::cout << "No loop has been executed.\n";
+				return;
+			}
+
+			std::cout << std::setw(4) << "#" << std::setw(20) << "loop" << std::setw(16) << "iterations"
+				<< std::setw(18) << "instructions" << std::setw(9) << "share" << '\n';
+			for (std::size_t i = 0; i < loops.size() && i < static_cast<std::size_t>(length); ++i) {
+				loop_profile const& loop = loops[i];
+				std::ostringstream location;
+				location << loop.begin_ << '-' << loop.end_;
+				std::cout << std::setw(4) << i + 1 << std::setw(20) << location.str() << std::setw(16) << loop.iterations_
+					<< std::setw(18) << loop.executed_instructions_ << std::setw(8) << std::fixed << std::setprecision(2)
+					<< 100.0 * static_cast<double>(loop.executed_instructions_) / static_cast<double>(total) << "%\n";
+			}
+			if (loops.size() > static_cast<std::size_t>(length))
+				std::cout << "... and " << loops.size() - static_cast<std::size_t>(length) << " more.\n";
+		}
+
+		/*Returns the profile of the flashed program collected during its previous runs.*/
+		[[nodiscard]]
+		execution_profile last_profile() {
+			return collect(flashed_program(), execution::emulator.taken_jumps(), execution::emulator.profiled_runs());
+		}
+
+		/*Implementation of "profile save". Writes the profile of the flashed program to the file.*/
+		int save_profile(std::string_view const file_name) {
+			if (!execution::emulator.profiling_enabled()) {
+				std::cerr << "Profiling is disabled. Enable it by \"profile on\" and run the program.\n";
+				return 5;
+			}
+			if (!save(std::string{ file_name }, last_profile())) {
+				std::cerr << "Cannot write to file " << file_name << ".\n";
+				return 6;
+			}
+			std::cout << "The profile has been written to " << file_name << ".\n";
+			return 0;
+		}
+
+		/*Implementation of "profile use". Chooses the profile guiding the optimizations.*/
+		int use_profile(std::string_view const source) {
+			if (source == "off") {
+				active_profile().reset();
+				std::cout << "Programs will not be optimized with respect to a profile.\n";
+				return 0;
+			}
+			if (source == "last") {
+				if (!execution::emulator.profiling_enabled()) {
+					std::cerr << "Profiling is disabled. Enable it by \"profile on\" and run the program.\n";
+					return 5;
+				}
+				active_profile() = last_profile();
+			}
+			else if (std::optional<execution_profile> loaded = load(std::string{ source }); loaded.has_value())
+				active_profile() = std::move(loaded);
+			else {
+				std::cerr << "File " << source << " does not exist or it is not a profile.\n";
+				return 6;
+			}
+			std::cout << "The profile will guide the layout of programs flashed from now on.\n";
+			return 0;
+		}
+
+		/*Function callback for the "profile" cli command. Controls the profiling of executed programs and prints its results.*/
+		int profile_callback(cli::command_parameters_t const& argv) {
+			if (int const code = utils::check_command_argc(1, 3, argv))
+				return code;
+
+			if (argv.size() == 1u) {
+				std::cout << "Profiling is " << (execution::emulator.profiling_enabled() ? "enabled" : "disabled") << ".\n";
+				return 0;
+			}
+			if (argv[1] == "report") {
+				int length = default_report_length;
+				if (argv.size() == 3u) {
+					std::optional<int> const requested = utils::parse_positive_argument(argv[2]);
+					if (!requested.has_value()) {
+						cli::print_command_error(cli::command_error::argument_not_recognized);
+						return 4;
+					}
+					length = *requested;
+				}
+				if (!execution::emulator.profiling_enabled()) {
+					std::cerr << "Profiling is disabled. Enable it by \"profile on\" and run the program.\n";
+					return 5;
+				}
+				print_report(length);
+				return 0;
+			}
+			if (argv[1] == "save" || argv[1] == "use") {
+				if (argv.size() != 3u) {
+					cli::print_command_error(cli::command_error::argument_not_recognized);
+					return 4;
+				}
+				return argv[1] == "save" ? save_profile(argv[2]) : use_profile(argv[2]);
+			}
+			if (argv.size() == 3u) {
+				cli::print_command_error(cli::command_error::argument_not_recognized);
+				return 4;
+			}
+
+			if (argv[1] == "on" || argv[1] == "off") {
+				execution::emulator.enable_profiling(argv[1] == "on");
+				std::cout << "Profiling has been " << (execution::emulator.profiling_enabled() ? "enabled" : "disabled") << ".\n";
+			}
+			else if (argv[1] == "reset") {
+				execution::emulator.reset_profile();
+				std::cout << "The profile has been cleared.\n";
+			}
+			else {
+				cli::print_command_error(cli::command_error::argument_not_recognized);
+				return 4;
+			}
+			return 0;
+		}
+
+	} //namespace bf::profiler::`anonymous`
+
+	std::vector<std::ptrdiff_t> instruction_executions(std::vector<instruction> const& code, std::vector<std::ptrdiff_t> const& taken_jumps, std::ptrdiff_t const runs) {
+		std::size_t const size = code.size();
+		if (taken_jumps.size() != size) //no profile has been collected for this code
+			return std::vector<std::ptrdiff_t>(size, 0);
+
+		//blocks begin at the program's entry, at destinations of jumps and right after them
+		std::vector<bool> leaders(size + 1, false);
+		std::vector<std::ptrdiff_t> arrivals(size + 1, 0); //number of taken jumps to each address
+		leaders[0] = true;
+		for (std::size_t address = 0; address < size; ++address)
+			if (code[address].is_jump()) {
+				assert(code[address].destination_ >= 0 && static_cast<std::size_t>(code[address].destination_) <= size);
+				leaders[code[address].destination_] = leaders[address + 1] = true;
+				arrivals[code[address].destination_] += taken_jumps[address];
+			}
+
+		std::vector<std::ptrdiff_t> res(size, 0);
+		std::ptrdiff_t current = 0; //executions of the block containing the current address
+		std::ptrdiff_t fallthrough = runs; //number of times the control fell through to the current address
+		for (std::size_t address = 0; address < size; ++address) {
+			if (leaders[address])
+				current = arrivals[address] + fallthrough;
+			res[address] = current;
+
+			switch (code[address].op_code_) {
+			case op_code::branch:
+			case op_code::program_exit:
+				fallthrough = 0;
+				break;
+			case op_code::branch_nz:
+				fallthrough = std::max<std::ptrdiff_t>(current - taken_jumps[address], 0);
+				break;
+			default:
+				fallthrough = current;
+			}
+		}
+		return res;
+	}
+
+	std::vector<loop_profile> hottest_loops(std::vector<instruction> const& code, std::vector<std::ptrdiff_t> const& taken_jumps, std::ptrdiff_t const runs) {
+		std::vector<std::ptrdiff_t> const executions = instruction_executions(code, taken_jumps, runs);
+		std::vector<std::ptrdiff_t> executed_before(code.size() + 1, 0); //number of instructions executed at lower addresses
+		std::partial_sum(executions.begin(), executions.end(), executed_before.begin() + 1);
+
+		std::vector<loop_profile> res;
+		for (std::size_t address = 0; address < code.size(); ++address) {
+			instruction const& jump = code[address];
+			if (jump.op_code_ != op_code::branch_nz || static_cast<std::size_t>(jump.destination_) > address)
+				continue; //only backward conditional jumps close loops
+
+			std::ptrdiff_t const begin = jump.destination_;
+			if (std::ptrdiff_t const instructions = executed_before[address + 1] - executed_before[begin]; instructions > 0)
+				res.push_back(loop_profile{ code[begin].source_loc_, jump.source_loc_, executions[begin], instructions });
+		}
+
+		std::stable_sort(res.begin(), res.end(), [](loop_profile const& a, loop_profile const& b) {
+			return a.executed_instructions_ > b.executed_instructions_;
+		});
+		return res;
+	}
+
+	execution_profile collect(std::vector<instruction> const& code, std::vector<std::ptrdiff_t> const& taken_jumps, std::ptrdiff_t const runs) {
+		std::vector<std::ptrdiff_t> const executions = instruction_executions(code, taken_jumps, runs);
+		execution_profile res;
+		//instructions originating at the same location may have been duplicated by the optimizer, the hottest copy is remembered
+		auto const record = [](std::map<source_location, std::ptrdiff_t>& counts, source_location const loc, std::ptrdiff_t const count) {
+			if (count > 0) {
+				std::ptrdiff_t& recorded = counts[loc];
+				recorded = std::max(recorded, count);
+			}
+		};
+		for (std::size_t address = 0; address < code.size(); ++address) {
+			record(res.executions_, code[address].source_loc_, executions[address]);
+			if (code[address].op_code_ == op_code::branch_nz)
+				record(res.taken_jumps_, code[address].source_loc_, taken_jumps[address]);
+		}
+		return res;
+	}
+
+	std::string to_text(execution_profile const& profile) {
+		std::ostringstream res;
+		res << profile_file_header << '\n';
+		for (auto const& [loc, count] : profile.executions_)
+			res << "executed " << loc.line_ << ' ' << loc.column_ << ' ' << count << '\n';
+		for (auto const& [loc, count] : profile.taken_jumps_)
+			res << "taken " << loc.line_ << ' ' << loc.column_ << ' ' << count << '\n';
+		return res.str();
+	}
+
+	bool save(std::string const& file_name, execution_profile const& profile) {
+		std::ofstream file{ file_name };
+		return static_cast<bool>(file << to_text(profile));
+	}
+
+	std::optional<execution_profile> load(std::string const& file_name) {
+		std::ifstream file{ file_name };
+		if (std::string header; !std::getline(file, header) || header != profile_file_header)
+			return std::nullopt;
+
+		execution_profile res;
+		std::string kind;
+		source_location loc;
+		std::ptrdiff_t count;
+		while (file >> kind >> loc.line_ >> loc.column_ >> count) {
+			if (kind != "executed" && kind != "taken")
+				return std::nullopt;
+			(kind == "executed" ? res.executions_ : res.taken_jumps_)[loc] = count;
+		}
+		if (!file.eof()) //the loop stopped due to a malformed line
+			return std::nullopt;
+		return res;
+	}
+
+	std::optional<execution_profile>& active_profile() {
+		static std::optional<execution_profile> profile;
+		return profile;
+	}
+
+	void initialize() {
+		ASSERT_IS_CALLED_ONLY_ONCE;
+
+		cli::add_command("profile", cli::command_category::execution, "Collects and reports the profile of executed programs.",
+			"Usage: \"profile\" [on | off | reset | report [count] | save file_name | use {last | off | file_name}]\n"
+			"If enabled, the emulator counts executions of all basic blocks of the flashed program. Runs accumulate in the profile\n"
+			"until it is reset or a new program is flashed. Profiled programs are always interpreted, even if the JIT is enabled.\n"
+			"\"report\" lists the given number of hottest loops (" + std::to_string(default_report_length) + " by default) with their source\n"
+			"locations, numbers of iterations and the share of executed instructions spent within them including nested loops.\n"
+			"\"save\" writes the profile keyed by source locations to a file, so that it can be used for later compilations of the same source.\n"
+			"\"use\" chooses the profile guiding the layout of flashed programs: the profile of the last runs, one saved to a file or none.\n"
+			"Hot basic blocks are then laid out next to each other so that hot edges fall through, never executed blocks are moved to the end.\n"
+			"Without arguments prints whether profiling is enabled. Disabled by default."
+			, &profile_callback);
+	}
+
+} //namespace bf::profiler
@@ -0,0 +1,308 @@
+#include "program_image.h"
+#include "cli.h"
+#include "utils.h"
+#include "compiler.h"
+#include "emulator.h"
+
+#include <iostream>
+#include <fstream>
+#include <filesystem>
+#include <algorithm>
+#include <type_traits>
+#include <cstring>
+#include <thread>
+#include <cassert>
+#include <new>
+
+namespace bf::image {
+
+	namespace {
+
+		static_assert(std::is_trivially_copyable_v<instruction>, "Instructions are stored in images byte by byte!");
+
+		constexpr char image_magic[8] = { 'B', 'F', 'I', 'M', 'A', 'G', 'E', '\0' };
+		constexpr std::uint32_t image_version = 3;
+		constexpr std::uint64_t endianness_marker = 0x0102030405060708;
+
+		/*Header at the beginning of each image. It is followed by instruction_count_ raw instructions, pool_size_
+		bytes of strings referred to by write_string instructions and key_size_ bytes of the key. The header's size is a
+		multiple of the instructions' alignment, therefore the instructions can be used right where the file is mapped.*/
+		struct image_header {
+			char magic_[8];
+			std::uint32_t version_;
+			std::uint32_t instruction_size_; //sizeof(instruction) of the build that saved the image
+			std::uint64_t endianness_;
+			std::uint64_t instruction_count_;
+			std::uint64_t memory_size_; //size of memory the code had been generated for
+			std::uint64_t pool_size_;
+			std::uint64_t key_size_;
+			std::uint32_t cell_width_; //width of cells in bits the constants had been folded for
+			std::uint32_t reserved_ = 0;
+		};
+		static_assert(sizeof(image_header) == 64 && sizeof(image_header) % alignof(instruction) == 0);
+
+		/*Returns true iff the header has been written by a build with identical layout of instructions.*/
+		[[nodiscard]]
+		bool is_compatible(image_header const& header) {
+			return std::memcmp(header.magic_, image_magic, sizeof image_magic) == 0 && header.version_ == image_version
+				&& header.instruction_size_ == sizeof(instruction) && header.endianness_ == endianness_marker
+				&& (header.cell_width_ == static_cast<std::uint32_t>(execution::cell_width::bits8) || header.cell_width_ == static_cast<std::uint32_t>(execution::cell_width::bits16)
+					|| header.cell_width_ == static_cast<std::uint32_t>(execution::cell_width::bits32));
+		}
+
+		/*Returns true iff the loaded code can be safely executed, i.e. it contains only known operations, all jumps stay within the code and it ends by program_exit.*/
+		[[nodiscard]]
+		bool is_well_formed(std::vector<instruction> const& code, std::size_t const pool_size) {
+			auto const well_formed = [&](instruction const& inst) {
+				if (inst.op_code_ < op_code::nop || inst.op_code_ > op_code::program_exit)
+					return false;
+				if (inst.is_jump())
+					return inst.destination_ >= 0 && inst.destination_ < static_cast<std::ptrdiff_t>(code.size());
+				if (inst.op_code_ == op_code::write_string)
+					return inst.offset_ >= 0 && inst.argument_ >= 0 && static_cast<std::size_t>(inst.offset_ + inst.argument_) <= pool_size;
+				if (inst.op_code_ == op_code::fill_range)
+					return inst.destination_ > 0 && inst.stride_ > 0;
+				return true;
+			};
+			return !code.empty() && code.back().op_code_ == op_code::program_exit && std::all_of(code.begin(), code.end(), well_formed);
+		}
+
+		[[nodiscard]]
+		std::filesystem::path cache_directory() {
+			return ".bfcache";
+		}
+
+		[[nodiscard]]
+		std::filesystem::path cached_file(std::string_view const key) {
+			static char const digits[] = "0123456789abcdef";
+			std::string name(16, '0');
+			for (std::uint64_t value = hash(key), i = 0; i < 16; ++i, value >>= 4)
+				name[15 - i] = digits[value & 0xf];
+			return cache_directory() / (name + ".bfimg");
+		}
+
+		/*Function callback for the "save" cli command. Expects the name of output file.*/
+		int save_callback(cli::command_parameters_t const& argv) {
+			if (int const code = utils::check_command_argc(2, 2, argv))
+				return code;
+
+			if (!previous_compilation::ready() || !previous_compilation::successful()) {
+				std::cerr << "There is no successfully compiled program to save.\n";
+				return 4;
+			}
+
+			std::ptrdiff_t const memory_size = execution::emulator.memory_size();
+			execution::cell_width const width = execution::emulator.get_cell_width();
+			if (!save(std::string{ argv[1] }, previous_compilation::generate_executable_code(memory_size, width), memory_size, width)) {
+				std::cerr << "Cannot write to file " << argv[1] << ".\n";
+				return 5;
+			}
+			std::cout << "Image of the program written to " << argv[1] << ".\n";
+			return 0;
+		}
+
+		/*Function callback for the "load" cli command. Expects the name of an image created by the "save" command.*/
+		int load_callback(cli::command_parameters_t const& argv) {
+			if (int const code = utils::check_command_argc(2, 2, argv))
+				return code;
+
+			std::optional<loaded_image> image = load(std::string{ argv[1] });
+			if (!image) {
+				std::cerr << "File " << argv[1] << " does not exist or it is not an image created by this build.\n";
+				return 4;
+			}
+			//the prefix of the program may have been evaluated with respect to the memory's wraparound
+			if (image->memory_size_ != execution::emulator.memory_size()) {
+				std::cerr << "The image had been created for memory of " << image->memory_size_ << " cells, but the emulator has "
+					<< execution::emulator.memory_size() << ". Set the size of memory using \"memsize\" first.\n";
+				return 5;
+			}
+			//constants of the code have been folded for the width of cells, the emulator has to use the same one
+			if (image->cell_width_ != execution::emulator.get_cell_width())
+				try {
+					execution::emulator.set_cell_width(image->cell_width_);
+					std::cout << "The emulator has switched to " << static_cast<int>(image->cell_width_) << "-bit cells the image had been created for.\n";
+				}
+				catch (std::bad_alloc const&) {
+					std::cerr << "Cannot allocate memory for " << static_cast<int>(image->cell_width_) << "-bit cells the image had been created for.\n";
+					return 6;
+				}
+			execution::emulator.flash_program(std::move(image->code_));
+			execution::emulator.reset();
+			std::cout << "Image successfully flashed into the emulator's memory.\n";
+			return 0;
+		}
+
+		/*Function callback for the "cache" cli command. Shows the state of the cache, enables, disables or clears it.*/
+		int cache_callback(cli::command_parameters_t const& argv) {
+			if (int const code = utils::check_command_argc(1, 2, argv))
+				return code;
+
+			if (argv.size() == 1u)
+				std::cout << "The cache of compiled programs is " << (cache::enabled() ? "enabled" : "disabled") << ".\n";
+			else if (argv[1] == "on" || argv[1] == "off") {
+				cache::enabled() = argv[1] == "on";
+				std::cout << "The cache of compiled programs has been " << (cache::enabled() ? "enabled" : "disabled")
+					<< ". The change applies to following compilations.\n";
+			}
+			else if (argv[1] == "clear")
+				std::cout << "Removed " << cache::clear() << " cached programs.\n";
+			else {
+				cli::print_command_error(cli::command_error::argument_not_recognized);
+				return 4;
+			}
+			return 0;
+		}
+
+	} //namespace bf::image::`anonymous`
+
+	bool save(std::string const& file_name, std::vector<instruction> const& code, std::ptrdiff_t const memory_size,
+		execution::cell_width const width, std::string_view const key) {
+		//strings written by the code are stored in the image, their offsets are made relative to the image's pool
+		std::vector<instruction> stored = code;
+		std::string pool;
+		for (instruction& inst : stored)
+			if (inst.op_code_ == op_code::write_string) {
+				std::string_view const string = constant_string(inst.offset_, inst.argument_);
+				inst.offset_ = static_cast<std::ptrdiff_t>(pool.size());
+				pool.append(string);
+			}
+
+		image_header header{};
+		std::memcpy(header.magic_, image_magic, sizeof image_magic);
+		header.version_ = image_version;
+		header.instruction_size_ = sizeof(instruction);
+		header.endianness_ = endianness_marker;
+		header.instruction_count_ = stored.size();
+		header.memory_size_ = static_cast<std::uint64_t>(memory_size);
+		header.pool_size_ = pool.size();
+		header.key_size_ = key.size();
+		header.cell_width_ = static_cast<std::uint32_t>(width);
+
+		std::ofstream file{ file_name, std::ios::binary | std::ios::trunc };
+		file.write(reinterpret_cast<char const*>(&header), sizeof header);
+		file.write(reinterpret_cast<char const*>(stored.data()), static_cast<std::streamsize>(stored.size() * sizeof(instruction)));
+		file.write(pool.data(), static_cast<std::streamsize>(pool.size()));
+		file.write(key.data(), static_cast<std::streamsize>(key.size()));
+		return static_cast<bool>(file.flush());
+	}
+
+	std::optional<loaded_image> load(std::string const& file_name, std::optional<std::string_view> const key) {
+		std::optional<utils::mapped_file> const file = utils::mapped_file::open(file_name);
+		if (!file)
+			return std::nullopt;
+
+		std::string_view const bytes = file->view();
+		if (bytes.size() < sizeof(image_header))
+			return std::nullopt;
+		image_header header;
+		std::memcpy(&header, bytes.data(), sizeof header);
+		if (!is_compatible(header) || header.instruction_count_ > bytes.size() / sizeof(instruction))
+			return std::nullopt;
+
+		std::size_t const code_size = static_cast<std::size_t>(header.instruction_count_) * sizeof(instruction);
+		if (bytes.size() - sizeof header - code_size != header.pool_size_ + header.key_size_)
+			return std::nullopt;
+		std::string_view const pool = bytes.substr(sizeof header + code_size, static_cast<std::size_t>(header.pool_size_));
+		std::string_view const stored_key = bytes.substr(sizeof header + code_size + pool.size());
+		if (key.has_value() && *key != stored_key)
+			return std::nullopt;
+
+		//the mapping is page aligned and so is the first instruction following the header; no parsing is needed
+		instruction const* const first = reinterpret_cast<instruction const*>(bytes.data() + sizeof header);
+		loaded_image result{ std::vector<instruction>(first, first + header.instruction_count_), static_cast<std::ptrdiff_t>(header.memory_size_),
+			static_cast<execution::cell_width>(header.cell_width_) };
+		if (!is_well_formed(result.code_, pool.size()))
+			return std::nullopt;
+
+		//relocate the strings to the process' constant pool
+		if (!pool.empty()) {
+			std::ptrdiff_t const base = intern_constant(pool);
+			for (instruction& inst : result.code_)
+				if (inst.op_code_ == op_code::write_string)
+					inst.offset_ += base;
+		}
+		return result;
+	}
+
+	std::uint64_t hash(std::string_view const bytes) {
+		//FNV-1a processing whole words at a time, followed by a final avalanche
+		constexpr std::uint64_t prime = 0x100000001b3;
+		std::uint64_t res = 0xcbf29ce484222325 ^ bytes.size();
+		std::size_t i = 0;
+		for (; i + sizeof(std::uint64_t) <= bytes.size(); i += sizeof(std::uint64_t)) {
+			std::uint64_t word;
+			std::memcpy(&word, bytes.data() + i, sizeof word);
+			res = (res ^ word) * prime;
+		}
+		for (; i < bytes.size(); ++i)
+			res = (res ^ static_cast<unsigned char>(bytes[i])) * prime;
+
+		res ^= res >> 33;
+		res *= 0xff51afd7ed558ccd;
+		res ^= res >> 33;
+		return res;
+	}
+
+	namespace cache {
+
+		bool& enabled() {
+			static bool enabled = false;
+			return enabled;
+		}
+
+		std::optional<loaded_image> lookup(std::string_view const key) {
+			return load(cached_file(key).string(), key);
+		}
+
+		void store(std::string_view const key, std::vector<instruction> const& code, std::ptrdiff_t const memory_size, execution::cell_width const width) {
+			std::error_code error;
+			std::filesystem::create_directories(cache_directory(), error);
+			if (error) //the cache is only an optimization, a failure to store the image is of no interest
+				return;
+
+			//programs may be compiled by multiple threads; the image is written aside and renamed, so nobody can see it incomplete
+			std::filesystem::path const file = cached_file(key);
+			std::filesystem::path temporary = file;
+			temporary += "." + std::to_string(std::hash<std::thread::id>{}(std::this_thread::get_id())) + ".tmp";
+			if (save(temporary.string(), code, memory_size, width, key))
+				std::filesystem::rename(temporary, file, error);
+			std::filesystem::remove(temporary, error); //nothing is left behind should any of the steps fail
+		}
+
+		std::ptrdiff_t clear() {
+			std::error_code error;
+			std::ptrdiff_t removed = 0;
+			for (auto const& entry : std::filesystem::directory_iterator{ cache_directory(), error })
+				if (entry.path().extension() == ".bfimg" && std::filesystem::remove(entry.path(), error))
+					++removed;
+			return removed;
+		}
+	}
+
+	void initialize() {
+		ASSERT_IS_CALLED_ONLY_ONCE;
+
+		cli::add_command("save", cli::command_category::compilation, "Saves the compiled program to a binary image.",
+			"Usage: \"save\" file_name\n"
+			"Writes the executable code generated from the last compilation including all performed optimizations to the given file.\n"
+			"The code is generated for memory of the same size as the emulator has. The image can be flashed by the \"load\" command\n"
+			"without compiling the program again; it can only be loaded by the same build of the debugger."
+			, &save_callback);
+
+		cli::add_command("load", cli::command_category::execution, "Flashes a program from a binary image.",
+			"Usage: \"load\" file_name\n"
+			"Loads executable code from an image created by the \"save\" command and flashes it into the emulator.\n"
+			"The emulator's memory must have the same size as it had when the image was saved."
+			, &load_callback);
+
+		cli::add_command("cache", cli::command_category::compilation, "Controls the cache of compiled programs.",
+			"Usage: \"cache\" [on | off | clear]\n"
+			"Without arguments prints whether the cache is enabled. If the cache is enabled, compiled and optimized programs\n"
+			"are stored in the .bfcache directory, identified by a hash of their source code, all requested optimizations and the size of memory.\n"
+			"Compilation and optimizations are then deferred until the code is needed and skipped altogether if it is found in the cache.\n"
+			"\"clear\" removes all cached programs."
+			, &cache_callback);
+	}
+
+} //namespace bf::image
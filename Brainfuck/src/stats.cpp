@@ -0,0 +1,238 @@
+#include "stats.h"
+#include "cli.h"
+#include "utils.h"
+
+#include <iostream>
+#include <iomanip>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <utility>
+#include <vector>
+#include <algorithm>
+#include <limits>
+#include <cctype>
+
+namespace bf::stats {
+
+	namespace {
+
+		/*Everything recorded while a single command is being measured.*/
+		struct measurement {
+			std::vector<std::pair<std::string, clock::duration>> phases_; //in the order of first entry
+			opt::optimization_statistics passes_;
+			std::ptrdiff_t executions_ = 0;
+			std::ptrdiff_t executed_instructions_ = 0;
+			clock::duration execution_time_{ 0 };
+			std::size_t input_bytes_ = 0;
+			std::size_t output_bytes_ = 0;
+		};
+
+		thread_local measurement* current_measurement = nullptr; //measurement of the command running on this thread, nullptr if there is none
+
+		bool every_command = false; //the "stats" mode
+		std::string json_file; //file the measurements are appended to, empty if they are only printed
+
+		[[nodiscard]]
+		double seconds(clock::duration const time) {
+			return std::chrono::duration<double>(time).count();
+		}
+
+		[[nodiscard]]
+		double milliseconds(clock::duration const time) {
+			return std::chrono::duration<double, std::milli>(time).count();
+		}
+
+		//Returns the string as a JSON string literal
+		[[nodiscard]]
+		std::string json_string(std::string_view const str) {
+			std::ostringstream res;
+			res << '"';
+			for (char const c : str)
+				if (c == '"' || c == '\\')
+					res << '\\' << c;
+				else if (static_cast<unsigned char>(c) < 0x20)
+					res << "\\u" << std::hex << std::setw(4) << std::setfill('0') << static_cast<int>(c) << std::dec << std::setfill(' ');
+				else
+					res << c;
+			res << '"';
+			return res.str();
+		}
+
+		void print_text(std::string_view const command, clock::duration const wall_time, measurement const& measured) {
+			std::ostringstream report;
+			report << std::fixed << std::setprecision(3);
+			report << "Command " << std::quoted(command) << " took " << milliseconds(wall_time) << " ms of wall time.\n";
+			for (auto const& [phase, time] : measured.phases_)
+				report << '\t' << std::left << std::setw(28) << phase << std::right << std::setw(26) << milliseconds(time) << " ms\n";
+			for (auto const& [name, statistics] : measured.passes_)
+				report << '\t' << std::left << std::setw(28) << name << std::right << std::setw(8) << statistics.changes_
+				<< " changes" << std::setw(10) << milliseconds(statistics.time_) << " ms\n";
+			if (measured.executions_) {
+				double const execution_seconds = seconds(measured.execution_time_);
+				report << '\t' << measured.executed_instructions_ << " instruction" << utils::print_plural(measured.executed_instructions_)
+					<< " executed in " << milliseconds(measured.execution_time_) << " ms, " << std::setprecision(1)
+					<< (execution_seconds > 0 ? measured.executed_instructions_ / execution_seconds / 1e6 : 0.0) << std::setprecision(3)
+					<< " M instructions/s, " << measured.input_bytes_ << " byte" << utils::print_plural(measured.input_bytes_) << " of input, "
+					<< measured.output_bytes_ << " byte" << utils::print_plural(measured.output_bytes_) << " of output.\n";
+			}
+			std::cout << report.str();
+		}
+
+		//Returns the measurement as a single line holding a JSON object
+		[[nodiscard]]
+		std::string to_json(std::string_view const command, clock::duration const wall_time, measurement const& measured) {
+			std::ostringstream json;
+			json << std::setprecision(9);
+			json << "{\"command\":" << json_string(command) << ",\"seconds\":" << seconds(wall_time) << ",\"phases\":{";
+			for (std::size_t i = 0; i < measured.phases_.size(); ++i)
+				json << (i ? "," : "") << json_string(measured.phases_[i].first) << ':' << seconds(measured.phases_[i].second);
+			json << "},\"passes\":{";
+			bool first = true;
+			for (auto const& [name, statistics] : measured.passes_) {
+				json << (first ? "" : ",") << json_string(name) << ":{\"changes\":" << statistics.changes_
+					<< ",\"seconds\":" << seconds(statistics.time_) << '}';
+				first = false;
+			}
+			json << '}';
+			if (measured.executions_) {
+				double const execution_seconds = seconds(measured.execution_time_);
+				json << ",\"execution\":{\"instructions\":" << measured.executed_instructions_ << ",\"seconds\":" << execution_seconds
+					<< ",\"instructions_per_second\":" << (execution_seconds > 0 ? measured.executed_instructions_ / execution_seconds : 0.0)
+					<< ",\"input_bytes\":" << measured.input_bytes_ << ",\"output_bytes\":" << measured.output_bytes_ << '}';
+			}
+			json << "}\n";
+			return json.str();
+		}
+
+		/*Function callback for the "time" cli command. Executes its arguments as a command and measures it.
+		Arguments containing whitespace are quoted again, since the cli has removed their quotes.*/
+		int time_callback(cli::command_parameters_t const& argv) {
+			if (int const code = utils::check_command_argc(2, std::numeric_limits<int>::max(), argv))
+				return code;
+
+			std::string command;
+			for (std::size_t i = 1; i < argv.size(); ++i) {
+				if (i > 1)
+					command += ' ';
+				if (std::any_of(argv[i].begin(), argv[i].end(), [](char const c) { return std::isspace(static_cast<unsigned char>(c)); }))
+					command.append("\"").append(argv[i]).append("\"");
+				else
+					command.append(argv[i]);
+			}
+			return measure(command, [&command] { return cli::execute_command(command, false); });
+		}
+
+		/*Function callback for the "stats" cli command. Expects "on", "off" or "json" followed by a file name or "off".
+		Prints the current setting if there is no argument.*/
+		int stats_callback(cli::command_parameters_t const& argv) {
+			if (int const code = utils::check_command_argc(1, 3, argv))
+				return code;
+
+			if (argv.size() == 2 && argv[1] == "on")
+				every_command = true;
+			else if (argv.size() == 2 && argv[1] == "off")
+				every_command = false;
+			else if (argv.size() == 3 && argv[1] == "json")
+				json_file = argv[2] == "off" ? std::string{} : std::string{ argv[2] };
+			else if (argv.size() != 1) {
+				cli::print_command_error(cli::command_error::argument_not_recognized);
+				return 4;
+			}
+
+			std::cout << (every_command ? "Every command is measured" : "Only commands prefixed by \"time\" are measured");
+			if (json_file.empty())
+				std::cout << ", measurements are only printed.\n";
+			else
+				std::cout << ", measurements are appended to " << std::quoted(json_file) << " as well.\n";
+			return 0;
+		}
+
+	} //namespace bf::stats::`anonymous`
+
+	bool measuring() {
+		return current_measurement != nullptr;
+	}
+
+	bool measuring_every_command() {
+		return every_command;
+	}
+
+	int measure(std::string_view const command, std::function<int()> const& execute) {
+		if (measuring()) //a nested command belongs to the enclosing measurement
+			return execute();
+
+		measurement measured;
+		current_measurement = &measured;
+		clock::time_point const start = clock::now();
+		int code;
+		try {
+			code = execute();
+		}
+		catch (...) {
+			current_measurement = nullptr;
+			throw;
+		}
+		clock::duration const wall_time = clock::now() - start;
+		current_measurement = nullptr;
+
+		print_text(command, wall_time, measured);
+		if (!json_file.empty())
+			if (std::ofstream file{ json_file, std::ios::app }; !(file << to_json(command, wall_time, measured)))
+				std::cerr << "Cannot append the measurement to " << std::quoted(json_file) << ".\n";
+		return code;
+	}
+
+	void record_phase(std::string_view const phase, clock::duration const time) {
+		if (!measuring())
+			return;
+		std::vector<std::pair<std::string, clock::duration>>& phases = current_measurement->phases_;
+		auto const found = std::find_if(phases.begin(), phases.end(), [phase](auto const& recorded) { return recorded.first == phase; });
+		if (found == phases.end())
+			phases.emplace_back(std::string{ phase }, time);
+		else
+			found->second += time;
+	}
+
+	void record_passes(opt::optimization_statistics const& passes) {
+		if (!measuring())
+			return;
+		for (auto const& [name, statistics] : passes) {
+			opt::pass_statistics& recorded = current_measurement->passes_[name];
+			recorded.changes_ += statistics.changes_;
+			recorded.time_ += statistics.time_;
+		}
+	}
+
+	void record_execution(std::ptrdiff_t const instructions, clock::duration const time, std::size_t const input_bytes, std::size_t const output_bytes) {
+		if (!measuring())
+			return;
+		++current_measurement->executions_;
+		current_measurement->executed_instructions_ += instructions;
+		current_measurement->execution_time_ += time;
+		current_measurement->input_bytes_ += input_bytes;
+		current_measurement->output_bytes_ += output_bytes;
+	}
+
+	void initialize() {
+		ASSERT_IS_CALLED_ONLY_ONCE;
+
+		cli::add_command("time", cli::command_category::general, "Executes a command and reports where its time went.",
+			"Usage: \"time\" command [arguments...]\n"
+			"Executes the command and prints its wall time followed by the time spent in the phases of the toolchain it has gone through:\n"
+			"the syntax check, the frontend building basic blocks and the generation of executable code, then every optimizer pass\n"
+			"with the number of changes it has made. Executions of the program (e.g. by \"run\" or \"continue\") are reported\n"
+			"by the number of executed instructions, instructions per second and the numbers of bytes read and written by the program.\n"
+			"See \"stats\" to measure every command or to keep the measurements in a JSON file."
+			, &time_callback);
+
+		cli::add_command("stats", cli::command_category::general, "Controls the measurement of commands.",
+			"Usage: \"stats\" [on | off | json {file_name | off}]\n"
+			"While \"on\", every command is measured as if it had been prefixed by \"time\". Off by default.\n"
+			"\"json\" chooses a file each measurement is appended to as a single line holding a JSON object with the command,\n"
+			"its wall time and the measured phases, passes and executions in seconds, so that they can be compared across builds.\n"
+			"Without arguments prints the current setting."
+			, &stats_callback);
+	}
+
+} //namespace bf::stats
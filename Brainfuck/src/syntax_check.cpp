@@ -5,27 +5,257 @@
 #include <deque>
 #include <algorithm>
 #include <cassert>
+#include <array>
+#include <bitset>
+#include <cstring>
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#define BF_VECTOR_LEXER
+#elif defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define BF_VECTOR_LEXER
+#elif defined(__aarch64__) || defined(_M_ARM64)
+#include <arm_neon.h>
+#define BF_VECTOR_LEXER
+#endif
+
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+
 namespace bf {
 
+	namespace {
 
-	bool operator<(source_location const& lhs, source_location const& rhs) noexcept {
-		return lhs.line_ != rhs.line_ ? lhs.line_ < rhs.line_ : lhs.column_ < rhs.column_;
-	}
+		constexpr std::size_t chunk_size = 64; //number of characters classified at once, one bit of a 64bit mask per character
+
+		/*Bitmasks of character classes within a chunk of source code. Bit i corresponds to the i-th character of the chunk.*/
+		struct chunk_masks {
+			std::uint64_t commands_ = 0;
+			std::uint64_t opening_ = 0;
+			std::uint64_t closing_ = 0;
+			std::uint64_t newlines_ = 0;
+			std::uint64_t tabs_ = 0;
+		};
+
+		[[nodiscard]]
+		std::ptrdiff_t popcount(std::uint64_t const mask) { return static_cast<std::ptrdiff_t>(std::bitset<64>{ mask }.count()); }
+
+		[[nodiscard]]
+		int lowest_set_bit(std::uint64_t const mask) {
+			assert(mask);
+#ifdef _MSC_VER
+			unsigned long index;
+			_BitScanForward64(&index, mask);
+			return static_cast<int>(index);
+#else
+			return __builtin_ctzll(mask);
+#endif
+		}
+
+		[[nodiscard]]
+		int highest_set_bit(std::uint64_t const mask) {
+			assert(mask);
+#ifdef _MSC_VER
+			unsigned long index;
+			_BitScanReverse64(&index, mask);
+			return static_cast<int>(index);
+#else
+			return 63 - __builtin_clzll(mask);
+#endif
+		}
+
+#ifdef BF_VECTOR_LEXER
+#if defined(__AVX2__)
+		constexpr std::size_t vector_width = 32;
+		using vector_t = __m256i;
+
+		vector_t load(char const* const pointer) { return _mm256_loadu_si256(reinterpret_cast<__m256i const*>(pointer)); }
+		vector_t equal(vector_t const data, char const c) { return _mm256_cmpeq_epi8(data, _mm256_set1_epi8(c)); }
+		vector_t either(vector_t const a, vector_t const b) { return _mm256_or_si256(a, b); }
+		//characters are compared as signed, which is fine for ranges of ASCII characters
+		vector_t in_range(vector_t const data, char const low, char const high) {
+			return _mm256_and_si256(_mm256_cmpgt_epi8(data, _mm256_set1_epi8(low - 1)), _mm256_cmpgt_epi8(_mm256_set1_epi8(high + 1), data));
+		}
+		std::uint64_t to_mask(vector_t const comparison) { return static_cast<std::uint32_t>(_mm256_movemask_epi8(comparison)); }
+#elif defined(__aarch64__) || defined(_M_ARM64)
+		constexpr std::size_t vector_width = 16;
+		using vector_t = uint8x16_t;
+
+		vector_t load(char const* const pointer) { return vld1q_u8(reinterpret_cast<std::uint8_t const*>(pointer)); }
+		vector_t equal(vector_t const data, char const c) { return vceqq_u8(data, vdupq_n_u8(static_cast<std::uint8_t>(c))); }
+		vector_t either(vector_t const a, vector_t const b) { return vorrq_u8(a, b); }
+		vector_t in_range(vector_t const data, char const low, char const high) {
+			return vandq_u8(vcgeq_u8(data, vdupq_n_u8(static_cast<std::uint8_t>(low))), vcleq_u8(data, vdupq_n_u8(static_cast<std::uint8_t>(high))));
+		}
+		//NEON has no movemask, select one bit per lane and sum each half of the vector horizontally
+		std::uint64_t to_mask(vector_t const comparison) {
+			static constexpr std::uint8_t lane_bits[16] = { 1, 2, 4, 8, 16, 32, 64, 128, 1, 2, 4, 8, 16, 32, 64, 128 };
+			uint8x16_t const bits = vandq_u8(comparison, vld1q_u8(lane_bits));
+			return std::uint64_t{ vaddv_u8(vget_low_u8(bits)) } | std::uint64_t{ vaddv_u8(vget_high_u8(bits)) } << 8;
+		}
+#else
+		constexpr std::size_t vector_width = 16;
+		using vector_t = __m128i;
+
+		vector_t load(char const* const pointer) { return _mm_loadu_si128(reinterpret_cast<__m128i const*>(pointer)); }
+		vector_t equal(vector_t const data, char const c) { return _mm_cmpeq_epi8(data, _mm_set1_epi8(c)); }
+		vector_t either(vector_t const a, vector_t const b) { return _mm_or_si128(a, b); }
+		vector_t in_range(vector_t const data, char const low, char const high) {
+			return _mm_and_si128(_mm_cmpgt_epi8(data, _mm_set1_epi8(low - 1)), _mm_cmpgt_epi8(_mm_set1_epi8(high + 1), data));
+		}
+		std::uint64_t to_mask(vector_t const comparison) { return static_cast<std::uint32_t>(_mm_movemask_epi8(comparison)); }
+#endif
+
+		/*Classifies chunk_size characters starting at the given pointer, vector_width of them at a time.*/
+		chunk_masks classify(char const* const chunk) {
+			chunk_masks res;
+			for (std::size_t lane = 0; lane < chunk_size; lane += vector_width) {
+				vector_t const data = load(chunk + lane);
+				vector_t const opening = equal(data, '['), closing = equal(data, ']');
+				//'+', ',', '-' and '.' are consecutive in ASCII
+				vector_t const commands = either(either(in_range(data, '+', '.'), either(equal(data, '<'), equal(data, '>'))), either(opening, closing));
+
+				res.commands_ |= to_mask(commands) << lane;
+				res.opening_ |= to_mask(opening) << lane;
+				res.closing_ |= to_mask(closing) << lane;
+				res.newlines_ |= to_mask(equal(data, '\n')) << lane;
+				res.tabs_ |= to_mask(equal(data, '\t')) << lane;
+			}
+			return res;
+		}
+#else
+		/*Classes of individual characters used by the scalar classifier.*/
+		enum character_class : std::uint8_t {
+			command = 1, opening = 2, closing = 4, newline = 8, tab = 16
+		};
+
+		constexpr std::array<std::uint8_t, 256> character_classes = [] {
+			std::array<std::uint8_t, 256> res{};
+			for (unsigned char const c : { '+', '-', '<', '>', ',', '.' })
+				res[c] = command;
+			res['['] = command | opening;
+			res[']'] = command | closing;
+			res['\n'] = newline;
+			res['\t'] = tab;
+			return res;
+		}();
+
+		/*Classifies chunk_size characters starting at the given pointer one by one.*/
+		chunk_masks classify(char const* const chunk) {
+			chunk_masks res;
+			for (std::size_t i = 0; i < chunk_size; ++i) {
+				std::uint8_t const type = character_classes[static_cast<unsigned char>(chunk[i])];
+				std::uint64_t const bit = std::uint64_t{ 1 } << i;
+				res.commands_ |= type & command ? bit : 0;
+				res.opening_ |= type & opening ? bit : 0;
+				res.closing_ |= type & closing ? bit : 0;
+				res.newlines_ |= type & newline ? bit : 0;
+				res.tabs_ |= type & tab ? bit : 0;
+			}
+			return res;
+		}
+#endif
+
+		/*Classifies all characters of the source code chunk by chunk and calls the given function with the chunk's masks
+		and the position of its first character. The last, incomplete chunk is padded by zeroes, which belong to no class.*/
+		template<typename FUNC>
+		void for_each_chunk(std::string_view const source_code, FUNC&& func) {
+			std::size_t position = 0;
+			for (; position + chunk_size <= source_code.size(); position += chunk_size)
+				func(classify(source_code.data() + position), position);
+
+			if (position < source_code.size()) {
+				char tail[chunk_size] = {};
+				std::memcpy(tail, source_code.data() + position, source_code.size() - position);
+				func(classify(tail), position);
+			}
+		}
+
+		/*Updates the number of opened loops by brackets of a chunk. Returns false if some closing bracket has no matching opening one.
+		The final depth is a difference of the numbers of brackets; only if the chunk closes more loops than are opened so far,
+		may the prefix sum of brackets drop below zero and the brackets have to be checked one by one.*/
+		bool update_depth(chunk_masks const& masks, std::ptrdiff_t& depth) {
+			std::ptrdiff_t const closing = popcount(masks.closing_);
+			if (closing <= depth) {
+				depth += popcount(masks.opening_) - closing;
+				return true;
+			}
+
+			for (std::uint64_t brackets = masks.opening_ | masks.closing_; brackets; brackets &= brackets - 1)
+				if (masks.opening_ & (brackets & (~brackets + 1))) //test the lowest set bit
+					++depth;
+				else if (depth-- == 0)
+					return false;
+			return true;
+		}
+
+	} //namespace bf::`anonymous`
 
 	bool is_syntactically_valid(std::string_view const source_code) {
 
 		//Has to perform a syntax check as fast as possible - only braces are counted, no additional information gets generated
-		int opened_loops = 0; //counter of opened loops
-		for (char const character : source_code)  //Compare each character of the source code with two possible loop instructions 
-			if (character == '[')
-				++opened_loops; //a new loop is opened
-			else if (character == ']')
-				if (opened_loops) //if we have some loops to close, close one
-					--opened_loops;
+		std::ptrdiff_t opened_loops = 0; //counter of opened loops
+		bool balanced = true;
+		for_each_chunk(source_code, [&](chunk_masks const& masks, std::size_t) {
+			balanced = balanced && update_depth(masks, opened_loops); //Closing a loop when there isn't any opened is a syntax error
+			});
+
+		return balanced && opened_loops == 0; //source code's syntax is ok if there are no opened loops left
+	}
+
+	source_summary summarize_source(std::string_view const part) {
+		source_summary res;
+		for_each_chunk(part, [&res](chunk_masks const& masks, std::size_t const chunk_position) {
+			if (masks.newlines_) {
+				res.newlines_ += static_cast<std::size_t>(popcount(masks.newlines_));
+				res.last_newline_ = chunk_position + highest_set_bit(masks.newlines_);
+			}
+
+			//as in update_depth, brackets are visited one by one only if the chunk may reach a new minimum
+			std::ptrdiff_t const closing = popcount(masks.closing_);
+			if (closing <= res.depth_ - res.min_depth_) {
+				res.depth_ += popcount(masks.opening_) - closing;
+				return;
+			}
+			for (std::uint64_t brackets = masks.opening_ | masks.closing_; brackets; brackets &= brackets - 1)
+				if (masks.opening_ & (brackets & (~brackets + 1))) //test the lowest set bit
+					++res.depth_;
 				else
-					return false; //Closing a loop when there isn't any opened is a syntax error
+					res.min_depth_ = std::min(res.min_depth_, --res.depth_);
+			});
+		return res;
+	}
+
+	command_bitmap::command_bitmap(std::string_view const source_code)
+		: size_{ source_code.size() } {
+		std::size_t const words = (size_ + chunk_size - 1) / chunk_size;
+		commands_.reserve(words);
+		newlines_.reserve(words);
 
-		return opened_loops == 0; //source code's syntax is ok if there are no opened loops left
+		std::ptrdiff_t opened_loops = 0;
+		bool balanced = true;
+		for_each_chunk(source_code, [&](chunk_masks const& masks, std::size_t) {
+			commands_.push_back(masks.commands_);
+			newlines_.push_back(masks.newlines_);
+			balanced = balanced && update_depth(masks, opened_loops);
+			});
+		brackets_match_ = balanced && opened_loops == 0;
+	}
+
+	std::size_t command_bitmap::next_set_bit(std::vector<std::uint64_t> const& bitmap, std::size_t const position, std::size_t const size) {
+		if (position >= size)
+			return npos;
+
+		std::size_t word = position / chunk_size;
+		std::uint64_t mask = bitmap[word] & (~std::uint64_t{ 0 } << position % chunk_size);
+		while (!mask)
+			if (++word == bitmap.size())
+				return npos;
+			else
+				mask = bitmap[word];
+		return word * chunk_size + lowest_set_bit(mask);
 	}
 
 	static_assert(cli::TAB_WIDTH > 0 && (cli::TAB_WIDTH & (cli::TAB_WIDTH - 1)) == 0,
@@ -37,25 +267,32 @@ namespace bf {
 		std::deque<source_location> opened_loops; //stack of coordinates of opening braces 
 		source_location current_loc{ 1,0 };
 
-		for (char const character : source_code) {//traverse whole source code char by char counting whitespaces and validating loops
-			++current_loc.column_;
-
-			switch (character) {
-			case '\n': current_loc = { current_loc.line_ + 1, 0 }; break;
-			case '\t': //tab == 8 spaces or less ('\t' aligns to a multiple of eight)
-				current_loc.column_ = (current_loc.column_ + ::bf::cli::TAB_WIDTH) & ~std::ptrdiff_t(::bf::cli::TAB_WIDTH - 1);
-				break;
-			case '[':
-				opened_loops.push_back(current_loc); //push current location onto the stack
-				break;
-			case ']':
-				if (!opened_loops.empty()) //we are inside a loop => close it
-					opened_loops.pop_back();
-				else //no loops opened, generate an error message
-					syntax_errors.emplace_back("Unexpected token ']' not preceded by a matching '['", current_loc);
-				break;
+		std::size_t last_position = static_cast<std::size_t>(-1); //position of the last character affecting the location
+
+		//only brackets, line breaks and tabs are visited, other characters just advance the column
+		for_each_chunk(source_code, [&](chunk_masks const& masks, std::size_t const chunk_position) {
+			for (std::uint64_t interesting = masks.opening_ | masks.closing_ | masks.newlines_ | masks.tabs_; interesting; interesting &= interesting - 1) {
+				std::size_t const position = chunk_position + lowest_set_bit(interesting);
+				current_loc.column_ += static_cast<int>(position - last_position);
+				last_position = position;
+
+				switch (source_code[position]) {
+				case '\n': current_loc = { current_loc.line_ + 1, 0 }; break;
+				case '\t': //tab == 8 spaces or less ('\t' aligns to a multiple of eight)
+					current_loc.column_ = (current_loc.column_ + ::bf::cli::TAB_WIDTH) & ~(::bf::cli::TAB_WIDTH - 1);
+					break;
+				case '[':
+					opened_loops.push_back(current_loc); //push current location onto the stack
+					break;
+				case ']':
+					if (!opened_loops.empty()) //we are inside a loop => close it
+						opened_loops.pop_back();
+					else //no loops opened, generate an error message
+						syntax_errors.emplace_back("Unexpected token ']' not preceded by a matching '['", current_loc);
+					break;
+				}
 			}
-		}
+			});
 
 		if (opened_loops.empty()) //If there's no unclosed loop, we have found all errors and we can return early
 			return syntax_errors;
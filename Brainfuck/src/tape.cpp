@@ -0,0 +1,355 @@
+#include "tape.h"
+
+#include <cassert>
+#include <cstring>
+#include <new>
+#include <utility>
+#include <algorithm>
+#include <atomic>
+#include <mutex>
+#include <iterator>
+
+#ifdef _WIN32
+#define NOMINMAX
+#include <Windows.h>
+#else
+#include <sys/mman.h>
+#include <unistd.h>
+#include <signal.h>
+#endif
+
+namespace bf::execution {
+
+	namespace {
+
+		std::size_t page_size() {
+#ifdef _WIN32
+			SYSTEM_INFO info;
+			GetSystemInfo(&info);
+			return static_cast<std::size_t>(info.dwPageSize);
+#else
+			return static_cast<std::size_t>(sysconf(_SC_PAGESIZE));
+#endif
+		}
+
+		std::size_t round_up_to_pages(std::size_t const bytes, std::size_t const page) {
+			return (bytes + page - 1) / page * page;
+		}
+
+		std::atomic<std::uint64_t> next_mapping_id{ 1 };
+
+		/*Calls the function for each run of consecutive pages in the sorted vector, passing the first page and the number of pages.
+		Protection of memory is changed by runs to keep the number of system calls low.*/
+		template<typename FUNCTION>
+		void for_each_run(std::vector<std::size_t> const& pages, FUNCTION const& function) {
+			for (std::size_t i = 0; i < pages.size();) {
+				std::size_t j = i + 1;
+				while (j < pages.size() && pages[j] == pages[j - 1] + 1)
+					++j;
+				function(pages[i], j - i);
+				i = j;
+			}
+		}
+	}
+
+	/*Registry of tapes whose writes are tracked. On POSIX systems it owns the handler of memory protection faults, which marks the written
+	page of a tape dirty and makes it writable; the faulting instruction is then restarted. Faults outside of tracked pages are passed
+	to the previously installed handler, therefore accesses to the guard pages still terminate the program.*/
+	class write_tracker {
+		static constexpr std::size_t max_tracked_tapes = 16;
+		static inline std::atomic<tape*> tracked_[max_tracked_tapes] = {};
+		static inline std::mutex mutex_; //serializes registration
+
+#ifndef _WIN32
+		static inline struct sigaction previous_segv_action_, previous_bus_action_;
+
+		static void pass_to_previous(int const signal, siginfo_t* const info, void* const context) {
+			struct sigaction const& previous = signal == SIGSEGV ? previous_segv_action_ : previous_bus_action_;
+			if (previous.sa_flags & SA_SIGINFO)
+				return previous.sa_sigaction(signal, info, context);
+			if (previous.sa_handler != SIG_DFL && previous.sa_handler != SIG_IGN)
+				return previous.sa_handler(signal);
+			//restore the default action; the faulting instruction is restarted and faults again
+			struct sigaction default_action {};
+			default_action.sa_handler = SIG_DFL;
+			sigemptyset(&default_action.sa_mask);
+			sigaction(signal, &default_action, nullptr);
+		}
+
+		static void fault_handler(int const signal, siginfo_t* const info, void* const context) {
+			for (std::atomic<tape*> const& slot : tracked_)
+				if (tape* const tracked = slot.load(std::memory_order_acquire); tracked && tracked->mark_written(info->si_addr))
+					return;
+			pass_to_previous(signal, info, context);
+		}
+
+		static void install_handler() {
+			struct sigaction action {};
+			action.sa_sigaction = &fault_handler;
+			action.sa_flags = SA_SIGINFO | SA_NODEFER;
+			sigemptyset(&action.sa_mask);
+			sigaction(SIGSEGV, &action, &previous_segv_action_);
+			sigaction(SIGBUS, &action, &previous_bus_action_); //some systems report writes to read-only pages this way
+		}
+#endif
+
+	public:
+		//Registers the tape. Returns false if too many tapes are tracked already
+		static bool add(tape* const tracked) {
+			std::lock_guard const lock{ mutex_ };
+#ifndef _WIN32
+			static bool const installed = (install_handler(), true);
+			static_cast<void>(installed);
+#endif
+			for (std::atomic<tape*>& slot : tracked_)
+				if (!slot.load()) {
+					slot.store(tracked, std::memory_order_release);
+					return true;
+				}
+			return false;
+		}
+
+		static void remove(tape* const tracked) {
+			std::lock_guard const lock{ mutex_ };
+			for (std::atomic<tape*>& slot : tracked_)
+				if (slot.load() == tracked)
+					slot.store(nullptr, std::memory_order_release);
+		}
+	};
+
+	tape::tape(std::ptrdiff_t const size) {
+		map(size);
+	}
+
+	tape::~tape() {
+		unmap();
+	}
+
+	void tape::map(std::ptrdiff_t const size) {
+		assert(size > 0 && !mapping_);
+
+		std::size_t const page = page_size();
+		std::size_t const usable = round_up_to_pages(static_cast<std::size_t>(size) * sizeof(byte_t), page);
+		std::size_t const total = usable + 2 * page;
+
+		/*The whole region is reserved inaccessible first, then the part between the guard pages is made readable and writable.*/
+#ifdef _WIN32
+		void* const region = VirtualAlloc(nullptr, total, MEM_RESERVE | MEM_WRITE_WATCH, PAGE_NOACCESS);
+		if (!region)
+			throw std::bad_alloc{};
+		if (!VirtualAlloc(static_cast<char*>(region) + page, usable, MEM_COMMIT, PAGE_READWRITE)) {
+			VirtualFree(region, 0, MEM_RELEASE);
+			throw std::bad_alloc{};
+		}
+#else
+		void* const region = mmap(nullptr, total, PROT_NONE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+		if (region == MAP_FAILED)
+			throw std::bad_alloc{};
+		if (mprotect(static_cast<char*>(region) + page, usable, PROT_READ | PROT_WRITE)) {
+			munmap(region, total);
+			throw std::bad_alloc{};
+		}
+#endif
+		mapping_ = region;
+		mapping_size_ = total;
+		guard_size_ = page;
+		mapping_id_ = next_mapping_id++;
+		bytes_ = reinterpret_cast<byte_t*>(static_cast<char*>(region) + page);
+		size_ = size;
+	}
+
+	void tape::unmap() {
+		if (!mapping_)
+			return;
+		stop_tracking();
+#ifdef _WIN32
+		VirtualFree(mapping_, 0, MEM_RELEASE);
+#else
+		munmap(mapping_, mapping_size_);
+#endif
+		mapping_ = nullptr;
+		bytes_ = nullptr;
+		size_ = 0;
+		mapping_size_ = guard_size_ = 0;
+	}
+
+	void tape::resize(std::ptrdiff_t const size) {
+		assert(size > 0);
+		tape replacement{ size }; //allocate first to keep the current tape if it fails
+		stop_tracking(); //snapshots of the current mapping cannot be restored to the new one
+		std::swap(bytes_, replacement.bytes_);
+		std::swap(size_, replacement.size_);
+		std::swap(mapping_, replacement.mapping_);
+		std::swap(mapping_size_, replacement.mapping_size_);
+		std::swap(guard_size_, replacement.guard_size_);
+		std::swap(mapping_id_, replacement.mapping_id_);
+	}
+
+	void tape::clear() {
+		if (!tracking_) {
+			std::memset(bytes_, 0, static_cast<std::size_t>(size_) * sizeof(byte_t));
+			return;
+		}
+		//all pages are written, there is no point in tracking them one by one
+		std::vector<std::size_t> all_pages(page_count());
+		for (std::size_t i = 0; i < all_pages.size(); ++i)
+			all_pages[i] = i;
+		unprotect_pages(all_pages);
+		std::memset(bytes_, 0, static_cast<std::size_t>(size_) * sizeof(byte_t));
+		base_ = nullptr; //the contents derive from the zeroed tape again
+		clean_pages(all_pages);
+	}
+
+	void tape::start_tracking() {
+		assert(!tracking_);
+		if (!write_tracker::add(this))
+			throw std::bad_alloc{};
+		tracking_ = true;
+		dirty_.assign(page_count(), 0);
+		dirty_pages_.clear();
+		dirty_pages_.reserve(page_count());
+		base_ = nullptr;
+
+		//the contents are not known to be zero, hence all nonzero pages are considered written
+		std::size_t const page = guard_size_;
+		std::vector<std::size_t> all_pages(page_count());
+		for (std::size_t i = 0; i < all_pages.size(); ++i) {
+			all_pages[i] = i;
+			unsigned char const* const first = bytes_ + i * page;
+			if (std::any_of(first, first + page, [](unsigned char const cell) { return cell != 0; })) {
+				dirty_[i] = 1;
+				dirty_pages_.push_back(i);
+			}
+		}
+#ifdef _WIN32
+		ResetWriteWatch(bytes_, page_count() * page);
+#else
+		std::vector<std::size_t> clean;
+		std::copy_if(all_pages.begin(), all_pages.end(), std::back_inserter(clean), [this](std::size_t const i) { return !dirty_[i]; });
+		for_each_run(clean, [this, page](std::size_t const first, std::size_t const count) {
+			mprotect(bytes_ + first * page, count * page, PROT_READ);
+		});
+#endif
+	}
+
+	void tape::stop_tracking() {
+		if (!tracking_)
+			return;
+		write_tracker::remove(this);
+		tracking_ = false;
+#ifndef _WIN32
+		mprotect(bytes_, page_count() * guard_size_, PROT_READ | PROT_WRITE);
+#endif
+		dirty_.clear();
+		dirty_pages_.clear();
+		base_ = nullptr;
+	}
+
+	bool tape::mark_written(void const* const address) noexcept {
+		if (!tracking_)
+			return false;
+		unsigned char const* const byte = static_cast<unsigned char const*>(address);
+		if (byte < bytes_ || byte >= bytes_ + page_count() * guard_size_) //faults in the guard pages are genuine errors
+			return false;
+		std::size_t const index = static_cast<std::size_t>(byte - bytes_) / guard_size_;
+		if (dirty_[index]) //a write to a writable page cannot fault, the fault is not ours
+			return false;
+		dirty_[index] = 1;
+		dirty_pages_.push_back(index); //never reallocates
+#ifndef _WIN32
+		mprotect(bytes_ + index * guard_size_, guard_size_, PROT_READ | PROT_WRITE);
+#endif
+		return true;
+	}
+
+	std::vector<std::size_t> tape::written_pages() const {
+#ifdef _WIN32
+		std::vector<std::size_t> res = dirty_pages_; //nonzero pages found when the tracking started
+		std::vector<void*> addresses(page_count());
+		ULONG_PTR count = addresses.size();
+		DWORD granularity;
+		if (GetWriteWatch(0, bytes_, page_count() * guard_size_, addresses.data(), &count, &granularity) == 0)
+			for (ULONG_PTR i = 0; i < count; ++i)
+				res.push_back(static_cast<std::size_t>(static_cast<unsigned char*>(addresses[i]) - bytes_) / guard_size_);
+		std::sort(res.begin(), res.end());
+		res.erase(std::unique(res.begin(), res.end()), res.end());
+#else
+		std::vector<std::size_t> res = dirty_pages_;
+		std::sort(res.begin(), res.end());
+#endif
+		return res;
+	}
+
+	void tape::clean_pages(std::vector<std::size_t> const& pages) {
+		for (std::size_t const page : pages)
+			dirty_[page] = 0;
+		dirty_pages_.erase(std::remove_if(dirty_pages_.begin(), dirty_pages_.end(), [this](std::size_t const page) { return !dirty_[page]; }),
+			dirty_pages_.end());
+#ifdef _WIN32
+		assert(dirty_pages_.empty()); //write watching can only be reset for all pages at once
+		ResetWriteWatch(bytes_, page_count() * guard_size_);
+#else
+		for_each_run(pages, [this](std::size_t const first, std::size_t const count) {
+			mprotect(bytes_ + first * guard_size_, count * guard_size_, PROT_READ);
+		});
+#endif
+	}
+
+	void tape::unprotect_pages([[maybe_unused]] std::vector<std::size_t> const& pages) {
+#ifndef _WIN32
+		for_each_run(pages, [this](std::size_t const first, std::size_t const count) {
+			mprotect(bytes_ + first * guard_size_, count * guard_size_, PROT_READ | PROT_WRITE);
+		});
+#endif
+	}
+
+	std::shared_ptr<tape_snapshot const> tape::take_snapshot() {
+		if (!tracking_)
+			start_tracking();
+
+		std::size_t const page = guard_size_;
+		auto snapshot = std::make_shared<tape_snapshot>();
+		snapshot->parent_ = base_;
+		snapshot->mapping_id_ = mapping_id_;
+		snapshot->pages_ = written_pages();
+		snapshot->contents_.resize(snapshot->pages_.size() * page);
+		for (std::size_t i = 0; i < snapshot->pages_.size(); ++i)
+			std::memcpy(snapshot->contents_.data() + i * page, bytes_ + snapshot->pages_[i] * page, page);
+
+		clean_pages(snapshot->pages_);
+		base_ = snapshot;
+		return snapshot;
+	}
+
+	bool tape::restore(std::shared_ptr<tape_snapshot const> const& snapshot) {
+		assert(snapshot);
+		if (snapshot->mapping_id_ != mapping_id_ || !tracking_)
+			return false;
+
+		std::vector<std::size_t> pages = written_pages();
+		for (tape_snapshot const* s : { base_.get(), snapshot.get() })
+			for (; s; s = s->parent_.get())
+				pages.insert(pages.end(), s->pages_.begin(), s->pages_.end());
+		std::sort(pages.begin(), pages.end());
+		pages.erase(std::unique(pages.begin(), pages.end()), pages.end());
+
+		unprotect_pages(pages);
+		std::size_t const page = guard_size_;
+		for (std::size_t const index : pages) {
+			unsigned char* const destination = bytes_ + index * page;
+			//the newest snapshot storing the page holds its contents; pages stored by none of them are zero
+			tape_snapshot const* s = snapshot.get();
+			for (; s; s = s->parent_.get())
+				if (auto const stored = std::lower_bound(s->pages_.begin(), s->pages_.end(), index); stored != s->pages_.end() && *stored == index) {
+					std::memcpy(destination, s->contents_.data() + static_cast<std::size_t>(stored - s->pages_.begin()) * page, page);
+					break;
+				}
+			if (!s)
+				std::memset(destination, 0, page);
+		}
+		clean_pages(pages);
+		base_ = snapshot;
+		return true;
+	}
+
+}
@@ -0,0 +1,160 @@
+#include "trace.h"
+#include "cli.h"
+#include "utils.h"
+#include "breakpoint.h"
+
+#include <iostream>
+#include <iomanip>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <algorithm>
+#include <optional>
+#include <new>
+
+namespace bf::trace {
+
+	namespace {
+
+		//number of steps kept by the trace unless specified otherwise
+		constexpr int default_trace_capacity = 1 << 20;
+
+		//number of the most recent steps listed by "trace show" unless specified otherwise
+		constexpr int default_show_length = 20;
+
+		[[nodiscard]]
+		execution::trace_buffer const& recorded_trace() {
+			return execution::emulator.trace();
+		}
+
+		/*Prints whether the emulator is tracing and how many steps the trace holds.*/
+		void print_status() {
+			execution::trace_buffer const& trace = recorded_trace();
+			std::cout << "Tracing is " << (execution::emulator.tracing_enabled() ? "enabled" : "disabled") << ". The trace holds " << trace.size()
+				<< " step" << utils::print_plural(trace.size()) << " of " << trace.recorded() << " recorded, its capacity is " << trace.capacity() << ".\n";
+		}
+
+		/*Implementation of "trace on". Enables the tracing with a trace holding the given number of steps.*/
+		int enable_tracing(int const capacity) {
+			try {
+				execution::emulator.enable_tracing(true, static_cast<std::size_t>(capacity));
+			}
+			catch (std::bad_alloc const&) {
+				std::cerr << "Cannot allocate a trace of " << capacity << " steps.\n";
+				return 5;
+			}
+			std::cout << "Tracing has been enabled, the trace keeps the last " << recorded_trace().capacity() << " steps.\n";
+			return 0;
+		}
+
+		/*Implementation of "trace show". Prints the given number of the most recent steps.*/
+		int show_trace(int const length) {
+			execution::trace_buffer const& trace = recorded_trace();
+			std::size_t const count = std::min(trace.size(), static_cast<std::size_t>(length));
+			if (count == 0) {
+				std::cout << "The trace is empty.\n";
+				return 0;
+			}
+			std::ostringstream steps;
+			print_steps(steps, trace, execution::emulator.breakpoints().original_program(), trace.size() - count, count);
+			std::cout << "Last " << count << " step" << utils::print_plural(count) << " of " << trace.recorded() << " recorded:\n" << steps.str();
+			return 0;
+		}
+
+		/*Implementation of "trace dump". Writes all held steps to the file.*/
+		int dump_trace(std::string_view const file_name) {
+			execution::trace_buffer const& trace = recorded_trace();
+			std::ofstream file{ std::string{ file_name } };
+			if (file)
+				print_steps(file, trace, execution::emulator.breakpoints().original_program(), 0, trace.size());
+			if (!file) {
+				std::cerr << "Cannot write to file " << file_name << ".\n";
+				return 6;
+			}
+			std::cout << trace.size() << " step" << utils::print_plural(trace.size()) << ' ' << utils::print_plural(trace.size(), "has", "have") << " been written to " << file_name << ".\n";
+			return 0;
+		}
+
+		/*Function callback for the "trace" cli command. Controls the recording of executed steps and decodes the trace.*/
+		int trace_callback(cli::command_parameters_t const& argv) {
+			if (int const code = utils::check_command_argc(1, 3, argv))
+				return code;
+			if (argv.size() == 1u) {
+				print_status();
+				return 0;
+			}
+			if (argv[1] == "on" || argv[1] == "show") {
+				int length = argv[1] == "on" ? default_trace_capacity : default_show_length;
+				if (argv.size() == 3u) {
+					std::optional<int> const requested = utils::parse_positive_argument(argv[2]);
+					if (!requested.has_value()) {
+						cli::print_command_error(cli::command_error::argument_not_recognized);
+						return 4;
+					}
+					length = *requested;
+				}
+				return argv[1] == "on" ? enable_tracing(length) : show_trace(length);
+			}
+			if (argv[1] == "dump") {
+				if (argv.size() != 3u) {
+					cli::print_command_error(cli::command_error::argument_not_recognized);
+					return 4;
+				}
+				return dump_trace(argv[2]);
+			}
+			if (argv.size() == 3u) {
+				cli::print_command_error(cli::command_error::argument_not_recognized);
+				return 4;
+			}
+			if (argv[1] == "off") {
+				execution::emulator.enable_tracing(false);
+				std::cout << "Tracing has been disabled.\n";
+			}
+			else if (argv[1] == "clear") {
+				execution::emulator.clear_trace();
+				std::cout << "The trace has been cleared.\n";
+			}
+			else {
+				cli::print_command_error(cli::command_error::argument_not_recognized);
+				return 4;
+			}
+			return 0;
+		}
+
+	} //namespace bf::trace::`anonymous`
+
+	void print_steps(std::ostream& stream, execution::trace_buffer const& trace, std::vector<instruction> const& code, std::size_t const first, std::size_t const count) {
+		std::uint64_t const oldest = trace.recorded() - trace.size(); //number of the step with index zero
+		stream << std::setw(12) << "step" << std::setw(10) << "address" << std::setw(12) << "location" << "  " << std::left << std::setw(20) << "instruction"
+			<< std::right << std::setw(10) << "cell" << std::setw(12) << "value" << '\n';
+		for (std::size_t i = first; i < first + count; ++i) {
+			execution::trace_record const& step = trace[i];
+			stream << std::setw(12) << oldest + i << std::setw(10) << step.address_;
+			if (step.address_ < code.size()) {
+				std::ostringstream location;
+				location << code[step.address_].source_loc_;
+				stream << std::setw(12) << location.str() << "  " << std::left << std::setw(20) << code[step.address_].op_code_ << std::right;
+			}
+			else //the trace does not belong to the flashed program
+				stream << std::setw(12) << "?" << "  " << std::left << std::setw(20) << "?" << std::right;
+			stream << std::setw(10) << step.cell_ << std::setw(12) << step.value_ << '\n';
+		}
+	}
+
+	void initialize() {
+		ASSERT_IS_CALLED_ONLY_ONCE;
+
+		cli::add_command("trace", cli::command_category::execution, "Records executed instructions into a ring buffer.",
+			"Usage: \"trace\" [on [size] | off | clear | show [count] | dump file_name]\n"
+			"If enabled, the emulator records the address, CPR and the value of the current cell before every executed instruction\n"
+			"into a trace keeping the given number of the most recent steps (" + std::to_string(default_trace_capacity) + " by default,\n"
+			"rounded up to a power of two). Unlike single stepping, recording does not stop the execution, hence long runs can be traced.\n"
+			"Traced programs are always interpreted, even if the JIT or the tiering is enabled. The trace is cleared whenever the program\n"
+			"is flashed or restarted and kept after the tracing is disabled.\n"
+			"\"show\" lists the given number of the most recent steps (" + std::to_string(default_show_length) + " by default) with source\n"
+			"locations and mnemonics of their instructions, \"dump\" writes all steps held by the trace to a file in the same format.\n"
+			"Without arguments prints whether tracing is enabled and how many steps the trace holds. Disabled by default."
+			, &trace_callback);
+	}
+
+} //namespace bf::trace
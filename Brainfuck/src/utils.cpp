@@ -5,8 +5,20 @@
 #include <fstream>
 #include <iostream>
 #include <charconv>
+#include <cstring>
 #include <type_traits>
 
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <Windows.h>
+#else
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
 namespace bf::utils {
 
 	int check_command_argc(std::ptrdiff_t const min, std::ptrdiff_t const max, cli::command_parameters_t const& argv) {
@@ -101,6 +113,50 @@ namespace bf::utils {
 		return std::nullopt; //empty std::optional in case file_name isn't a path to valid file
 	}
 
+	std::optional<mapped_file> mapped_file::open(std::string_view const file_name) {
+		std::filesystem::path const name{ file_name };
+		if (!std::filesystem::exists(name) || std::filesystem::is_directory(name))
+			return std::nullopt;
+
+		std::size_t const size = static_cast<std::size_t>(std::filesystem::file_size(name));
+		if (size == 0) //empty files cannot be mapped, but there is nothing to map anyway
+			return mapped_file{ nullptr, 0 };
+
+#ifdef _WIN32
+		HANDLE const file = CreateFileW(name.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+		if (file == INVALID_HANDLE_VALUE)
+			return std::nullopt;
+		HANDLE const mapping = CreateFileMappingW(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+		CloseHandle(file); //the mapping keeps the file open
+		if (!mapping)
+			return std::nullopt;
+		void const* const data = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+		CloseHandle(mapping); //the view keeps the mapping alive
+		if (!data)
+			return std::nullopt;
+#else
+		int const file = ::open(name.c_str(), O_RDONLY);
+		if (file < 0)
+			return std::nullopt;
+		void* const data = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, file, 0);
+		close(file); //the mapping keeps the file open
+		if (data == MAP_FAILED)
+			return std::nullopt;
+		madvise(data, size, MADV_SEQUENTIAL); //both the syntax check and the compiler scan the source from the beginning to the end
+#endif
+		return mapped_file{ static_cast<char const*>(data), size };
+	}
+
+	mapped_file::~mapped_file() {
+		if (!data_)
+			return;
+#ifdef _WIN32
+		UnmapViewOfFile(data_);
+#else
+		munmap(const_cast<char*>(data_), size_);
+#endif
+	}
+
 	bool prompt_user_yesno() {
 		std::cout << "Please, choose either yes or no. [Y/N].\t";
 		char input_char;